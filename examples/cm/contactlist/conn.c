@@ -44,6 +44,7 @@ enum
 {
   PROP_ACCOUNT = 1,
   PROP_SIMULATION_DELAY,
+  PROP_SNAPSHOT_FILE,
   N_PROPS
 };
 
@@ -51,6 +52,7 @@ struct _ExampleContactListConnectionPrivate
 {
   gchar *account;
   guint simulation_delay;
+  gchar *snapshot_file;
   ExampleContactList *contact_list;
   gboolean away;
 };
@@ -82,6 +84,10 @@ get_property (GObject *object,
       g_value_set_uint (value, self->priv->simulation_delay);
       break;
 
+    case PROP_SNAPSHOT_FILE:
+      g_value_set_string (value, self->priv->snapshot_file);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, spec);
     }
@@ -107,6 +113,11 @@ set_property (GObject *object,
       self->priv->simulation_delay = g_value_get_uint (value);
       break;
 
+    case PROP_SNAPSHOT_FILE:
+      g_free (self->priv->snapshot_file);
+      self->priv->snapshot_file = g_value_dup_string (value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, spec);
     }
@@ -120,6 +131,7 @@ finalize (GObject *object)
 
   tp_contacts_mixin_finalize (object);
   g_free (self->priv->account);
+  g_free (self->priv->snapshot_file);
 
   G_OBJECT_CLASS (example_contact_list_connection_parent_class)->finalize (
       object);
@@ -208,6 +220,12 @@ create_channel_managers (TpBaseConnection *conn)
           EXAMPLE_TYPE_CONTACT_LIST,
           "connection", conn,
           "simulation-delay", self->priv->simulation_delay,
+          /* we report every change to our groups, so the base class can
+           * answer questions about group membership without asking us */
+          "group-membership-index", TRUE,
+          /* a real CM would put this in its cache directory, so that the
+           * roster can be shown before it has been downloaded */
+          "snapshot-file", self->priv->snapshot_file,
           NULL));
 
   g_signal_connect (self->priv->contact_list, "alias-updated",
@@ -456,6 +474,12 @@ example_contact_list_connection_class_init (
   g_object_class_install_property (object_class, PROP_SIMULATION_DELAY,
       param_spec);
 
+  param_spec = g_param_spec_string ("snapshot-file", "Snapshot file",
+      "File in which to keep a copy of the contact list, or NULL", NULL,
+      G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+  g_object_class_install_property (object_class, PROP_SNAPSHOT_FILE,
+      param_spec);
+
   tp_contacts_mixin_class_init (object_class,
       G_STRUCT_OFFSET (ExampleContactListConnectionClass, contacts_mixin));
 
@@ -0,0 +1,1636 @@
+/* Content-addressed cache of contacts' avatars
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "config.h"
+
+#include <telepathy-glib/contact.h>
+
+#include <errno.h>
+#include <fcntl.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_SYS_FILE_H
+#include <sys/file.h>
+#endif
+
+#include <glib/gstdio.h>
+
+#include <telepathy-glib/util.h>
+
+#define DEBUG_FLAG TP_DEBUG_CONTACTS
+#include "telepathy-glib/contact-internal.h"
+#include "telepathy-glib/debug-internal.h"
+
+/**
+ * SECTION:avatar-cache
+ * @title: Avatar cache
+ * @short_description: the cache behind #TpContact:avatar-file
+ *
+ * Avatars retrieved for %TP_CONTACT_FEATURE_AVATAR_DATA are kept in a cache
+ * shared by every process using telepathy-glib, in
+ * <filename>$XDG_CACHE_HOME/telepathy/avatars/store</filename>. Each image
+ * is stored once, named after a hash of its contents, however many
+ * contacts, accounts and protocols use it; a single index file maps
+ * avatar tokens to images and records when each image was last used.
+ *
+ * Each process keeps a copy of the index in memory. When it writes the
+ * index back, it locks the file and merges its changes with those made by
+ * other processes in the meantime, so that no process forgets about
+ * images stored by another.
+ *
+ * The cache is limited to a quota: when it is exceeded, the least recently
+ * used images are removed.
+ *
+ * Since: 0.UNRELEASED
+ */
+
+#define DEFAULT_QUOTA (64 * 1024 * 1024)
+/* how long to wait after a change before rewriting the index */
+#define SAVE_DELAY_SECONDS 5
+/* don't rewrite the index just because an image was used again within
+ * this many seconds */
+#define LAST_USED_GRANULARITY 60
+/* files that aren't in the index are only deleted when they are at least
+ * this many seconds old */
+#define STRAY_FILE_MIN_AGE (60 * 60)
+/* don't check that an image is still there more often than this many
+ * seconds */
+#define VERIFY_INTERVAL 60
+
+#define INDEX_FILENAME "index"
+#define LOCK_FILENAME "index.lock"
+
+#define INDEX_GROUP_IMAGES "Images"
+#define INDEX_GROUP_TOKENS "Tokens"
+
+typedef struct {
+    guint64 size;
+    /* seconds since the epoch */
+    gint64 last_used;
+    /* g_get_monotonic_time() when the file was last seen to exist, or 0 */
+    gint64 verified;
+    /* number of tokens referring to this image */
+    guint refs;
+} Image;
+
+typedef struct {
+    /* owned hash of the image */
+    gchar *image;
+    gchar *mime_type;
+} Token;
+
+typedef struct {
+    gchar *dir;
+    gchar *index_path;
+    gchar *lock_path;
+    /* "cm/protocol/escaped-token" => owned Token */
+    GHashTable *tokens;
+    /* hash => owned Image */
+    GHashTable *images;
+    /* set of keys in tokens which this process has changed since the index
+     * was last written; they take precedence over the copy on disk */
+    GHashTable *dirty_tokens;
+    guint64 usage;
+    guint64 quota;
+
+    gboolean loaded;
+    gboolean loading;
+    /* owned GSimpleAsyncResult waiting for the index to be loaded */
+    GQueue load_waiters;
+
+    gboolean dir_created;
+    guint save_id;
+
+    /* owned GSimpleAsyncResult from _tp_avatar_cache_verify_async() */
+    GQueue verify_waiters;
+    guint verify_id;
+    /* TRUE while images are being checked in a thread */
+    gboolean verifying;
+
+    /* TRUE while the index is being merged with the copy on disk */
+    gboolean syncing;
+    /* TRUE if the index must be written again when that has finished */
+    gboolean sync_again;
+    /* owned GSimpleAsyncResult from tp_contact_avatar_cache_compact_async()
+     * waiting for the next sync */
+    GQueue compact_waiters;
+} AvatarCache;
+
+static AvatarCache *avatar_cache = NULL;
+
+static void
+image_free (gpointer p)
+{
+  g_slice_free (Image, p);
+}
+
+static void
+token_free (gpointer p)
+{
+  Token *token = p;
+
+  g_free (token->image);
+  g_free (token->mime_type);
+  g_slice_free (Token, token);
+}
+
+static GHashTable *
+tokens_new (void)
+{
+  return g_hash_table_new_full (g_str_hash, g_str_equal, g_free, token_free);
+}
+
+static GHashTable *
+images_new (void)
+{
+  return g_hash_table_new_full (g_str_hash, g_str_equal, g_free, image_free);
+}
+
+static GHashTable *
+key_set_new (void)
+{
+  return g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+}
+
+static Token *
+token_copy (const Token *token)
+{
+  Token *copy = g_slice_new0 (Token);
+
+  copy->image = g_strdup (token->image);
+  copy->mime_type = g_strdup (token->mime_type);
+  return copy;
+}
+
+static Image *
+image_copy (const Image *image)
+{
+  return g_slice_dup (Image, image);
+}
+
+/* Deep copies, so that the index can be merged in a thread while the main
+ * thread goes on using its own copy */
+static GHashTable *
+tokens_copy (GHashTable *tokens)
+{
+  GHashTable *copy = tokens_new ();
+  GHashTableIter iter;
+  gpointer key, value;
+
+  g_hash_table_iter_init (&iter, tokens);
+
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    g_hash_table_insert (copy, g_strdup (key), token_copy (value));
+
+  return copy;
+}
+
+static GHashTable *
+images_copy (GHashTable *images)
+{
+  GHashTable *copy = images_new ();
+  GHashTableIter iter;
+  gpointer key, value;
+
+  g_hash_table_iter_init (&iter, images);
+
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    g_hash_table_insert (copy, g_strdup (key), image_copy (value));
+
+  return copy;
+}
+
+static AvatarCache *
+get_avatar_cache (void)
+{
+  if (avatar_cache == NULL)
+    {
+      avatar_cache = g_slice_new0 (AvatarCache);
+      avatar_cache->dir = g_build_filename (g_get_user_cache_dir (),
+          "telepathy", "avatars", "store", NULL);
+      avatar_cache->index_path = g_build_filename (avatar_cache->dir,
+          INDEX_FILENAME, NULL);
+      avatar_cache->lock_path = g_build_filename (avatar_cache->dir,
+          LOCK_FILENAME, NULL);
+      avatar_cache->tokens = tokens_new ();
+      avatar_cache->images = images_new ();
+      avatar_cache->dirty_tokens = key_set_new ();
+      avatar_cache->quota = DEFAULT_QUOTA;
+      g_queue_init (&avatar_cache->load_waiters);
+      g_queue_init (&avatar_cache->compact_waiters);
+      g_queue_init (&avatar_cache->verify_waiters);
+    }
+
+  return avatar_cache;
+}
+
+static gchar *
+build_key (TpConnection *connection,
+    const gchar *token)
+{
+  gchar *escaped = tp_escape_as_identifier (token);
+  gchar *key = g_strdup_printf ("%s/%s/%s",
+      tp_connection_get_cm_name (connection),
+      tp_connection_get_protocol_name (connection),
+      escaped);
+
+  g_free (escaped);
+  return key;
+}
+
+static gchar *
+build_image_path (const gchar *dir,
+    const gchar *image)
+{
+  return g_build_filename (dir, image, NULL);
+}
+
+/* Recompute the reference counts of @images, and return their total size */
+static guint64
+recount (GHashTable *tokens,
+    GHashTable *images)
+{
+  GHashTableIter iter;
+  gpointer value;
+  guint64 usage = 0;
+
+  g_hash_table_iter_init (&iter, images);
+
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      Image *image = value;
+
+      image->refs = 0;
+      usage += image->size;
+    }
+
+  g_hash_table_iter_init (&iter, tokens);
+
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      Token *token = value;
+      Image *image = g_hash_table_lookup (images, token->image);
+
+      if (image != NULL)
+        image->refs++;
+    }
+
+  return usage;
+}
+
+/* Forget about tokens whose image is not in @images */
+static void
+remove_dangling_tokens (GHashTable *tokens,
+    GHashTable *images)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init (&iter, tokens);
+
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      Token *token = value;
+
+      if (!g_hash_table_contains (images, token->image))
+        g_hash_table_iter_remove (&iter);
+    }
+}
+
+/* ---- Reading and writing the index; these run in threads ---- */
+
+/* Add the contents of the index at @index_path to @tokens and @images,
+ * except for images which are no longer in @dir */
+static void
+read_index (const gchar *dir,
+    const gchar *index_path,
+    GHashTable *tokens,
+    GHashTable *images)
+{
+  GKeyFile *key_file = g_key_file_new ();
+  GError *error = NULL;
+  gchar **keys;
+  guint i;
+
+  if (!g_key_file_load_from_file (key_file, index_path, G_KEY_FILE_NONE,
+        &error))
+    {
+      DEBUG ("no usable avatar cache index: %s", error->message);
+      g_clear_error (&error);
+      g_key_file_free (key_file);
+      return;
+    }
+
+  keys = g_key_file_get_keys (key_file, INDEX_GROUP_IMAGES, NULL, NULL);
+
+  for (i = 0; keys != NULL && keys[i] != NULL; i++)
+    {
+      gchar *path = build_image_path (dir, keys[i]);
+      GStatBuf st;
+
+      /* forget about images that have been deleted behind our back */
+      if (g_stat (path, &st) == 0)
+        {
+          Image *image = g_slice_new0 (Image);
+
+          image->size = st.st_size;
+          image->last_used = g_key_file_get_int64 (key_file,
+              INDEX_GROUP_IMAGES, keys[i], NULL);
+          image->verified = g_get_monotonic_time ();
+          g_hash_table_insert (images, g_strdup (keys[i]), image);
+        }
+
+      g_free (path);
+    }
+
+  g_strfreev (keys);
+
+  keys = g_key_file_get_keys (key_file, INDEX_GROUP_TOKENS, NULL, NULL);
+
+  for (i = 0; keys != NULL && keys[i] != NULL; i++)
+    {
+      gsize len;
+      gchar **value = g_key_file_get_string_list (key_file,
+          INDEX_GROUP_TOKENS, keys[i], &len, NULL);
+
+      if (value != NULL && len >= 1 &&
+          g_hash_table_lookup (images, value[0]) != NULL)
+        {
+          Token *token = g_slice_new0 (Token);
+
+          token->image = g_strdup (value[0]);
+          token->mime_type = g_strdup (len >= 2 ? value[1] : NULL);
+          g_hash_table_insert (tokens, g_strdup (keys[i]), token);
+        }
+
+      g_strfreev (value);
+    }
+
+  g_strfreev (keys);
+  g_key_file_free (key_file);
+}
+
+static void
+write_index (const gchar *index_path,
+    GHashTable *tokens,
+    GHashTable *images)
+{
+  GKeyFile *key_file = g_key_file_new ();
+  GHashTableIter iter;
+  gpointer key, value;
+  GError *error = NULL;
+  gchar *contents;
+  gsize len;
+
+  g_hash_table_iter_init (&iter, images);
+
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      Image *image = value;
+
+      g_key_file_set_int64 (key_file, INDEX_GROUP_IMAGES, key,
+          image->last_used);
+    }
+
+  g_hash_table_iter_init (&iter, tokens);
+
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      Token *token = value;
+      const gchar *list[] = { token->image, token->mime_type, NULL };
+
+      g_key_file_set_string_list (key_file, INDEX_GROUP_TOKENS, key,
+          list, token->mime_type == NULL ? 1 : 2);
+    }
+
+  contents = g_key_file_to_data (key_file, &len, NULL);
+
+  if (!g_file_set_contents (index_path, contents, len, &error))
+    {
+      DEBUG ("unable to save the avatar cache index: %s", error->message);
+      g_clear_error (&error);
+    }
+
+  g_free (contents);
+  g_key_file_free (key_file);
+}
+
+/* Take an exclusive lock on the index, waiting for other processes to
+ * release theirs. Returns a file descriptor to pass to unlock_index(), or
+ * -1 if locking is not possible, in which case we carry on regardless:
+ * at worst, a concurrent writer's changes are lost, and it is only a
+ * cache. */
+static gint
+lock_index (const gchar *lock_path)
+{
+#ifdef HAVE_FLOCK
+  gint fd = g_open (lock_path, O_RDWR | O_CREAT, 0600);
+
+  if (fd == -1)
+    {
+      DEBUG ("unable to open %s: %s", lock_path, g_strerror (errno));
+      return -1;
+    }
+
+  while (flock (fd, LOCK_EX) != 0)
+    {
+      if (errno != EINTR)
+        {
+          DEBUG ("unable to lock %s: %s", lock_path, g_strerror (errno));
+          close (fd);
+          return -1;
+        }
+    }
+
+  return fd;
+#else
+  return -1;
+#endif
+}
+
+static void
+unlock_index (gint fd)
+{
+#ifdef HAVE_FLOCK
+  if (fd != -1)
+    {
+      flock (fd, LOCK_UN);
+      close (fd);
+    }
+#endif
+}
+
+/* ---- Merging the index with the copy on disk, in a thread ---- */
+
+typedef struct {
+    gchar *dir;
+    gchar *index_path;
+    gchar *lock_path;
+    /* in: this process's copy of the index; out: the merged index */
+    GHashTable *tokens;
+    GHashTable *images;
+    /* keys of the tokens this process has changed since the last sync */
+    GHashTable *dirty_tokens;
+    guint64 quota;
+    /* also remove unreferenced images and stray files */
+    gboolean compact;
+    /* owned GSimpleAsyncResults to complete when done */
+    GQueue compact_waiters;
+
+    /* out */
+    guint64 usage;
+    guint64 freed;
+} SyncData;
+
+static void
+sync_data_free (gpointer p)
+{
+  SyncData *data = p;
+
+  g_assert (g_queue_is_empty (&data->compact_waiters));
+
+  g_free (data->dir);
+  g_free (data->index_path);
+  g_free (data->lock_path);
+  tp_clear_pointer (&data->tokens, g_hash_table_unref);
+  tp_clear_pointer (&data->images, g_hash_table_unref);
+  tp_clear_pointer (&data->dirty_tokens, g_hash_table_unref);
+  g_slice_free (SyncData, data);
+}
+
+/* Merge @disk_tokens and @disk_images, which were just read from disk,
+ * into data->tokens and data->images */
+static void
+merge_index (SyncData *data,
+    GHashTable *disk_tokens,
+    GHashTable *disk_images)
+{
+  GHashTableIter iter;
+  gpointer key, value;
+
+  /* images: ours, plus any other process's, most recent use first */
+  g_hash_table_iter_init (&iter, disk_images);
+
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      Image *disk_image = value;
+      Image *image = g_hash_table_lookup (data->images, key);
+
+      if (image == NULL)
+        {
+          g_hash_table_iter_steal (&iter);
+          g_hash_table_insert (data->images, key, disk_image);
+        }
+      else
+        {
+          image->last_used = MAX (image->last_used, disk_image->last_used);
+          image->verified = MAX (image->verified, disk_image->verified);
+        }
+    }
+
+  /* images that we know about but which aren't in the index on disk have
+   * either been stored by us since the last sync, or evicted by another
+   * process */
+  g_hash_table_iter_init (&iter, data->images);
+
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      if (!g_hash_table_contains (disk_images, key))
+        {
+          gchar *path = build_image_path (data->dir, key);
+
+          if (!g_file_test (path, G_FILE_TEST_EXISTS))
+            g_hash_table_iter_remove (&iter);
+
+          g_free (path);
+        }
+    }
+
+  /* tokens: another process's changes win, unless we changed the same
+   * token since the last sync */
+  g_hash_table_iter_init (&iter, disk_tokens);
+
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      if (!g_hash_table_contains (data->dirty_tokens, key))
+        {
+          g_hash_table_iter_steal (&iter);
+          g_hash_table_replace (data->tokens, key, value);
+        }
+    }
+
+  remove_dangling_tokens (data->tokens, data->images);
+}
+
+static gint
+compare_images_by_age (gconstpointer a,
+    gconstpointer b,
+    gpointer user_data)
+{
+  GHashTable *images = user_data;
+  const Image *ia = g_hash_table_lookup (images, *(const gchar * const *) a);
+  const Image *ib = g_hash_table_lookup (images, *(const gchar * const *) b);
+
+  /* images that nobody refers to go first, then the least recently used */
+  if ((ia->refs == 0) != (ib->refs == 0))
+    return (ia->refs == 0) ? -1 : 1;
+
+  if (ia->last_used != ib->last_used)
+    return (ia->last_used < ib->last_used) ? -1 : 1;
+
+  return 0;
+}
+
+/* Remove images, least recently used first, until the merged index fits in
+ * the quota; also remove images nobody refers to if data->compact. Images
+ * referred to by tokens we have just set are kept, since our TpContacts
+ * are using them. The index must be locked. */
+static void
+evict (SyncData *data)
+{
+  GHashTable *keep = g_hash_table_new (g_str_hash, g_str_equal);
+  GPtrArray *hashes;
+  GHashTableIter iter;
+  gpointer key, value;
+  guint n_evicted = 0;
+  guint i;
+
+  data->usage = recount (data->tokens, data->images);
+
+  g_hash_table_iter_init (&iter, data->dirty_tokens);
+
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      Token *token = g_hash_table_lookup (data->tokens, key);
+
+      if (token != NULL)
+        g_hash_table_add (keep, token->image);
+    }
+
+  hashes = g_ptr_array_sized_new (g_hash_table_size (data->images));
+  g_hash_table_iter_init (&iter, data->images);
+
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    g_ptr_array_add (hashes, key);
+
+  g_ptr_array_sort_with_data (hashes, compare_images_by_age, data->images);
+
+  for (i = 0; i < hashes->len; i++)
+    {
+      const gchar *hash = g_ptr_array_index (hashes, i);
+      Image *image = g_hash_table_lookup (data->images, hash);
+      gchar *path;
+
+      if (g_hash_table_contains (keep, hash))
+        continue;
+
+      if (!(data->compact && image->refs == 0) &&
+          (data->quota == 0 || data->usage <= data->quota))
+        continue;
+
+      path = build_image_path (data->dir, hash);
+
+      if (g_unlink (path) != 0 && errno != ENOENT)
+        DEBUG ("unable to delete %s: %s", path, g_strerror (errno));
+
+      g_free (path);
+
+      data->usage -= image->size;
+      data->freed += image->size;
+      n_evicted++;
+
+      /* this frees @hash, so we must not look at it again */
+      g_hash_table_remove (data->images, hash);
+    }
+
+  if (n_evicted > 0)
+    DEBUG ("evicted %u images (%" G_GUINT64_FORMAT " bytes)", n_evicted,
+        data->freed);
+
+  remove_dangling_tokens (data->tokens, data->images);
+
+  g_ptr_array_unref (hashes);
+  g_hash_table_unref (keep);
+}
+
+/* Delete files that aren't in the merged index, perhaps because they were
+ * written by a process that crashed before saving it; leave recent files
+ * alone, since they might be in the process of being stored. The index
+ * must be locked. */
+static void
+delete_stray_files (SyncData *data)
+{
+  GDir *dir = g_dir_open (data->dir, 0, NULL);
+  gint64 now = g_get_real_time () / G_USEC_PER_SEC;
+  const gchar *name;
+
+  if (dir == NULL)
+    return;
+
+  while ((name = g_dir_read_name (dir)) != NULL)
+    {
+      gchar *path;
+      GStatBuf st;
+
+      if (!tp_strdiff (name, INDEX_FILENAME) ||
+          !tp_strdiff (name, LOCK_FILENAME) ||
+          g_hash_table_contains (data->images, name))
+        continue;
+
+      path = g_build_filename (data->dir, name, NULL);
+
+      if (g_stat (path, &st) == 0 && S_ISREG (st.st_mode) &&
+          st.st_mtime < now - STRAY_FILE_MIN_AGE &&
+          g_unlink (path) == 0)
+        {
+          DEBUG ("deleted stray file %s", path);
+          data->freed += st.st_size;
+        }
+
+      g_free (path);
+    }
+
+  g_dir_close (dir);
+}
+
+static void
+sync_thread (GSimpleAsyncResult *result,
+    GObject *object,
+    GCancellable *cancellable)
+{
+  SyncData *data = g_simple_async_result_get_op_res_gpointer (result);
+  GHashTable *disk_tokens = tokens_new ();
+  GHashTable *disk_images = images_new ();
+  gint lock;
+
+  if (g_mkdir_with_parents (data->dir, 0700) == -1)
+    {
+      DEBUG ("unable to create %s: %s", data->dir, g_strerror (errno));
+      goto finally;
+    }
+
+  lock = lock_index (data->lock_path);
+
+  read_index (data->dir, data->index_path, disk_tokens, disk_images);
+  merge_index (data, disk_tokens, disk_images);
+  evict (data);
+
+  if (data->compact)
+    delete_stray_files (data);
+
+  write_index (data->index_path, data->tokens, data->images);
+
+  unlock_index (lock);
+
+  DEBUG ("saved %u tokens for %u images (%" G_GUINT64_FORMAT " bytes)",
+      g_hash_table_size (data->tokens), g_hash_table_size (data->images),
+      data->usage);
+
+finally:
+  g_hash_table_unref (disk_tokens);
+  g_hash_table_unref (disk_images);
+}
+
+static void start_sync (AvatarCache *cache);
+static void schedule_save (AvatarCache *cache);
+
+static void
+sync_done_cb (GObject *source_object,
+    GAsyncResult *res,
+    gpointer user_data)
+{
+  AvatarCache *cache = user_data;
+  SyncData *data = g_simple_async_result_get_op_res_gpointer (
+      G_SIMPLE_ASYNC_RESULT (res));
+  GSimpleAsyncResult *waiter;
+  GHashTableIter iter;
+  gpointer key, value;
+
+  /* tokens set while we were busy are more up to date than the merged
+   * index, and so are the images they refer to */
+  g_hash_table_iter_init (&iter, cache->dirty_tokens);
+
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      Token *token = g_hash_table_lookup (cache->tokens, key);
+      Image *image;
+
+      if (token == NULL)
+        continue;
+
+      g_hash_table_replace (data->tokens, g_strdup (key), token_copy (token));
+      image = g_hash_table_lookup (cache->images, token->image);
+
+      if (image != NULL &&
+          !g_hash_table_contains (data->images, token->image))
+        g_hash_table_insert (data->images, g_strdup (token->image),
+            image_copy (image));
+    }
+
+  /* ... and so are the times images were last used */
+  g_hash_table_iter_init (&iter, data->images);
+
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      Image *image = value;
+      Image *ours = g_hash_table_lookup (cache->images, key);
+
+      if (ours != NULL)
+        {
+          image->last_used = MAX (image->last_used, ours->last_used);
+          image->verified = MAX (image->verified, ours->verified);
+        }
+    }
+
+  g_hash_table_unref (cache->tokens);
+  g_hash_table_unref (cache->images);
+  cache->tokens = data->tokens;
+  cache->images = data->images;
+  data->tokens = NULL;
+  data->images = NULL;
+  cache->usage = recount (cache->tokens, cache->images);
+  cache->syncing = FALSE;
+
+  while ((waiter = g_queue_pop_head (&data->compact_waiters)) != NULL)
+    {
+      guint64 *freed = g_simple_async_result_get_op_res_gpointer (waiter);
+
+      *freed = data->freed;
+      g_simple_async_result_complete (waiter);
+      g_object_unref (waiter);
+    }
+
+  if (cache->sync_again || !g_queue_is_empty (&cache->compact_waiters))
+    start_sync (cache);
+  else if (g_hash_table_size (cache->dirty_tokens) > 0)
+    schedule_save (cache);
+}
+
+/* Write the index, merging it with the copy on disk, now */
+static void
+start_sync (AvatarCache *cache)
+{
+  GSimpleAsyncResult *result;
+  SyncData *data;
+
+  if (cache->save_id != 0)
+    {
+      g_source_remove (cache->save_id);
+      cache->save_id = 0;
+    }
+
+  if (cache->syncing)
+    {
+      cache->sync_again = TRUE;
+      return;
+    }
+
+  cache->syncing = TRUE;
+  cache->sync_again = FALSE;
+
+  data = g_slice_new0 (SyncData);
+  data->dir = g_strdup (cache->dir);
+  data->index_path = g_strdup (cache->index_path);
+  data->lock_path = g_strdup (cache->lock_path);
+  data->tokens = tokens_copy (cache->tokens);
+  data->images = images_copy (cache->images);
+  data->dirty_tokens = cache->dirty_tokens;
+  cache->dirty_tokens = key_set_new ();
+  data->quota = cache->quota;
+  data->compact = !g_queue_is_empty (&cache->compact_waiters);
+  data->compact_waiters = cache->compact_waiters;
+  g_queue_init (&cache->compact_waiters);
+
+  result = g_simple_async_result_new (NULL, sync_done_cb, cache,
+      start_sync);
+  g_simple_async_result_set_op_res_gpointer (result, data, sync_data_free);
+  g_simple_async_result_run_in_thread (result, sync_thread,
+      G_PRIORITY_DEFAULT, NULL);
+  g_object_unref (result);
+}
+
+static gboolean
+save_index_cb (gpointer user_data)
+{
+  AvatarCache *cache = user_data;
+
+  cache->save_id = 0;
+  start_sync (cache);
+  return FALSE;
+}
+
+static void
+schedule_save (AvatarCache *cache)
+{
+  /* don't overwrite an index that we haven't read yet */
+  if (!cache->loaded || cache->save_id != 0)
+    return;
+
+  if (cache->syncing)
+    {
+      cache->sync_again = TRUE;
+      return;
+    }
+
+  cache->save_id = g_timeout_add_seconds (SAVE_DELAY_SECONDS,
+      save_index_cb, cache);
+}
+
+static void
+enforce_quota (AvatarCache *cache)
+{
+  if (cache->quota != 0 && cache->usage > cache->quota)
+    start_sync (cache);
+}
+
+/* ---- Loading the index, in a thread ---- */
+
+typedef struct {
+    gchar *dir;
+    gchar *index_path;
+    GHashTable *tokens;
+    GHashTable *images;
+} LoadData;
+
+static void
+load_data_free (gpointer p)
+{
+  LoadData *data = p;
+
+  g_free (data->dir);
+  g_free (data->index_path);
+  tp_clear_pointer (&data->tokens, g_hash_table_unref);
+  tp_clear_pointer (&data->images, g_hash_table_unref);
+  g_slice_free (LoadData, data);
+}
+
+/* the index is replaced atomically, so we don't need to lock it just to
+ * read it */
+static void
+load_index_thread (GSimpleAsyncResult *result,
+    GObject *object,
+    GCancellable *cancellable)
+{
+  LoadData *data = g_simple_async_result_get_op_res_gpointer (result);
+
+  read_index (data->dir, data->index_path, data->tokens, data->images);
+}
+
+static void
+index_loaded_cb (GObject *source_object,
+    GAsyncResult *res,
+    gpointer user_data)
+{
+  AvatarCache *cache = user_data;
+  LoadData *data = g_simple_async_result_get_op_res_gpointer (
+      G_SIMPLE_ASYNC_RESULT (res));
+  GSimpleAsyncResult *waiter;
+  GHashTableIter iter;
+  gpointer key, value;
+
+  /* anything stored in the meantime is more up to date */
+  g_hash_table_iter_init (&iter, data->images);
+
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      if (!g_hash_table_contains (cache->images, key))
+        {
+          g_hash_table_iter_steal (&iter);
+          g_hash_table_insert (cache->images, key, value);
+        }
+    }
+
+  g_hash_table_iter_init (&iter, data->tokens);
+
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      if (!g_hash_table_contains (cache->tokens, key))
+        {
+          g_hash_table_iter_steal (&iter);
+          g_hash_table_insert (cache->tokens, key, value);
+        }
+    }
+
+  cache->usage = recount (cache->tokens, cache->images);
+  cache->loaded = TRUE;
+  cache->loading = FALSE;
+
+  DEBUG ("%u tokens for %u images (%" G_GUINT64_FORMAT " bytes) in %s",
+      g_hash_table_size (cache->tokens), g_hash_table_size (cache->images),
+      cache->usage, cache->dir);
+
+  /* avatars stored before the index was loaded haven't been saved yet */
+  if (g_hash_table_size (cache->dirty_tokens) > 0)
+    schedule_save (cache);
+
+  enforce_quota (cache);
+
+  while ((waiter = g_queue_pop_head (&cache->load_waiters)) != NULL)
+    {
+      g_simple_async_result_complete (waiter);
+      g_object_unref (waiter);
+    }
+}
+
+gboolean
+_tp_avatar_cache_is_loaded (void)
+{
+  return get_avatar_cache ()->loaded;
+}
+
+/*
+ * Calls @callback when the index has been loaded. There is no finish
+ * function: this cannot fail, since a missing or corrupt index just means
+ * an empty cache.
+ */
+void
+_tp_avatar_cache_load_async (GAsyncReadyCallback callback,
+    gpointer user_data)
+{
+  AvatarCache *cache = get_avatar_cache ();
+  GSimpleAsyncResult *result;
+  GSimpleAsyncResult *load;
+  LoadData *data;
+
+  result = g_simple_async_result_new (NULL, callback, user_data,
+      _tp_avatar_cache_load_async);
+
+  if (cache->loaded)
+    {
+      g_simple_async_result_complete_in_idle (result);
+      g_object_unref (result);
+      return;
+    }
+
+  g_queue_push_tail (&cache->load_waiters, result);
+
+  if (cache->loading)
+    return;
+
+  cache->loading = TRUE;
+
+  data = g_slice_new0 (LoadData);
+  data->dir = g_strdup (cache->dir);
+  data->index_path = g_strdup (cache->index_path);
+  data->tokens = tokens_new ();
+  data->images = images_new ();
+
+  DEBUG ("loading avatar cache index %s", cache->index_path);
+
+  load = g_simple_async_result_new (NULL, index_loaded_cb, cache,
+      load_index_thread);
+  g_simple_async_result_set_op_res_gpointer (load, data, load_data_free);
+  g_simple_async_result_run_in_thread (load, load_index_thread,
+      G_PRIORITY_DEFAULT, NULL);
+  g_object_unref (load);
+}
+
+/* ---- Looking up and storing avatars ---- */
+
+static void
+image_used (AvatarCache *cache,
+    Image *image)
+{
+  gint64 now = g_get_real_time () / G_USEC_PER_SEC;
+
+  if (now - image->last_used >= LAST_USED_GRANULARITY)
+    {
+      image->last_used = now;
+      schedule_save (cache);
+    }
+}
+
+/*
+ * Returns: (transfer full): the cached image for @token, or %NULL.
+ *  The cache must have been loaded. This only consults the index, so the
+ *  file might have been removed by another process in the meantime: use
+ *  _tp_avatar_cache_verify_async() to check.
+ */
+GFile *
+_tp_avatar_cache_lookup (TpConnection *connection,
+    const gchar *token,
+    gchar **mime_type)
+{
+  AvatarCache *cache = get_avatar_cache ();
+  gchar *key = build_key (connection, token);
+  Token *t;
+  Image *image = NULL;
+  GFile *file = NULL;
+
+  g_return_val_if_fail (cache->loaded, NULL);
+
+  t = g_hash_table_lookup (cache->tokens, key);
+
+  if (t != NULL)
+    image = g_hash_table_lookup (cache->images, t->image);
+
+  if (image != NULL)
+    {
+      gchar *path = build_image_path (cache->dir, t->image);
+
+      image_used (cache, image);
+      file = g_file_new_for_path (path);
+
+      if (mime_type != NULL)
+        *mime_type = g_strdup (t->mime_type);
+
+      g_free (path);
+    }
+
+  g_free (key);
+  return file;
+}
+
+/* ---- Checking that images are still there ---- */
+
+typedef struct {
+    gchar *dir;
+    /* hashes of the images to check */
+    GPtrArray *hashes;
+    /* set of those hashes whose files are missing */
+    GHashTable *missing;
+} VerifyData;
+
+static void
+verify_data_free (gpointer p)
+{
+  VerifyData *data = p;
+
+  g_free (data->dir);
+  g_ptr_array_unref (data->hashes);
+  g_hash_table_unref (data->missing);
+  g_slice_free (VerifyData, data);
+}
+
+static void
+verify_thread (GSimpleAsyncResult *result,
+    GObject *object,
+    GCancellable *cancellable)
+{
+  VerifyData *data = g_simple_async_result_get_op_res_gpointer (result);
+  guint i;
+
+  for (i = 0; i < data->hashes->len; i++)
+    {
+      const gchar *hash = g_ptr_array_index (data->hashes, i);
+      gchar *path = build_image_path (data->dir, hash);
+
+      if (!g_file_test (path, G_FILE_TEST_EXISTS))
+        g_hash_table_add (data->missing, g_strdup (hash));
+
+      g_free (path);
+    }
+}
+
+static gboolean verify_idle_cb (gpointer user_data);
+
+/* Complete the waiters, whose images have all been checked recently or
+ * are no longer in the index */
+static void
+complete_verify_waiters (AvatarCache *cache)
+{
+  GSimpleAsyncResult *waiter;
+
+  while ((waiter = g_queue_pop_head (&cache->verify_waiters)) != NULL)
+    {
+      const gchar *hash = g_simple_async_result_get_op_res_gpointer (waiter);
+
+      /* this frees @hash */
+      g_simple_async_result_set_op_res_gboolean (waiter,
+          g_hash_table_contains (cache->images, hash));
+      g_simple_async_result_complete (waiter);
+      g_object_unref (waiter);
+    }
+}
+
+static void
+verify_done_cb (GObject *source_object,
+    GAsyncResult *res,
+    gpointer user_data)
+{
+  AvatarCache *cache = user_data;
+  VerifyData *data = g_simple_async_result_get_op_res_gpointer (
+      G_SIMPLE_ASYNC_RESULT (res));
+  gint64 now = g_get_monotonic_time ();
+  guint i;
+
+  for (i = 0; i < data->hashes->len; i++)
+    {
+      const gchar *hash = g_ptr_array_index (data->hashes, i);
+      Image *image = g_hash_table_lookup (cache->images, hash);
+
+      if (image == NULL)
+        continue;
+
+      /* another process has evicted it since we last read the index */
+      if (g_hash_table_contains (data->missing, hash))
+        {
+          DEBUG ("Avatar %s was removed from the cache", hash);
+          g_hash_table_remove (cache->images, hash);
+        }
+      else
+        {
+          image->verified = now;
+        }
+    }
+
+  if (g_hash_table_size (data->missing) > 0)
+    {
+      remove_dangling_tokens (cache->tokens, cache->images);
+      cache->usage = recount (cache->tokens, cache->images);
+    }
+
+  cache->verifying = FALSE;
+  verify_idle_cb (cache);
+}
+
+static gboolean
+verify_idle_cb (gpointer user_data)
+{
+  AvatarCache *cache = user_data;
+  gint64 now = g_get_monotonic_time ();
+  GHashTable *seen;
+  VerifyData *data;
+  GSimpleAsyncResult *result;
+  GList *l;
+
+  cache->verify_id = 0;
+
+  data = g_slice_new0 (VerifyData);
+  data->dir = g_strdup (cache->dir);
+  data->hashes = g_ptr_array_new_with_free_func (g_free);
+  data->missing = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      NULL);
+  seen = g_hash_table_new (g_str_hash, g_str_equal);
+
+  for (l = cache->verify_waiters.head; l != NULL; l = l->next)
+    {
+      const gchar *hash = g_simple_async_result_get_op_res_gpointer (l->data);
+      Image *image = g_hash_table_lookup (cache->images, hash);
+
+      if (image != NULL &&
+          now - image->verified >= VERIFY_INTERVAL * G_USEC_PER_SEC &&
+          !g_hash_table_contains (seen, hash))
+        {
+          g_hash_table_add (seen, (gchar *) hash);
+          g_ptr_array_add (data->hashes, g_strdup (hash));
+        }
+    }
+
+  g_hash_table_unref (seen);
+
+  if (data->hashes->len == 0)
+    {
+      verify_data_free (data);
+      complete_verify_waiters (cache);
+      return FALSE;
+    }
+
+  DEBUG ("checking that %u images are still cached", data->hashes->len);
+
+  /* waiters that arrive in the meantime are dealt with next time */
+  cache->verifying = TRUE;
+  result = g_simple_async_result_new (NULL, verify_done_cb, cache,
+      verify_idle_cb);
+  g_simple_async_result_set_op_res_gpointer (result, data, verify_data_free);
+  g_simple_async_result_run_in_thread (result, verify_thread,
+      G_PRIORITY_DEFAULT, NULL);
+  g_object_unref (result);
+  return FALSE;
+}
+
+/*
+ * Check, in a thread, that the image returned by _tp_avatar_cache_lookup()
+ * for @token is still there; if another process has removed it, it is
+ * forgotten. Checks are batched, and each image is checked at most once
+ * every VERIFY_INTERVAL seconds.
+ */
+void
+_tp_avatar_cache_verify_async (TpConnection *connection,
+    const gchar *token,
+    GAsyncReadyCallback callback,
+    gpointer user_data)
+{
+  AvatarCache *cache = get_avatar_cache ();
+  GSimpleAsyncResult *result;
+  gchar *key = build_key (connection, token);
+  Token *t = g_hash_table_lookup (cache->tokens, key);
+
+  result = g_simple_async_result_new (NULL, callback, user_data,
+      _tp_avatar_cache_verify_async);
+  g_free (key);
+
+  if (t == NULL)
+    {
+      g_simple_async_result_set_op_res_gboolean (result, FALSE);
+      g_simple_async_result_complete_in_idle (result);
+      g_object_unref (result);
+      return;
+    }
+
+  g_simple_async_result_set_op_res_gpointer (result, g_strdup (t->image),
+      g_free);
+  g_queue_push_tail (&cache->verify_waiters, result);
+
+  if (cache->verify_id == 0 && !cache->verifying)
+    cache->verify_id = g_idle_add (verify_idle_cb, cache);
+}
+
+/*
+ * Returns: %FALSE if the image has been removed from the cache
+ */
+gboolean
+_tp_avatar_cache_verify_finish (GAsyncResult *result)
+{
+  g_return_val_if_fail (g_simple_async_result_is_valid (result, NULL,
+        _tp_avatar_cache_verify_async), FALSE);
+
+  return g_simple_async_result_get_op_res_gboolean (
+      G_SIMPLE_ASYNC_RESULT (result));
+}
+
+static void
+set_token (AvatarCache *cache,
+    gchar *key,
+    const gchar *hash,
+    const gchar *mime_type)
+{
+  Token *old = g_hash_table_lookup (cache->tokens, key);
+  Token *token;
+  Image *image;
+
+  if (old != NULL)
+    {
+      image = g_hash_table_lookup (cache->images, old->image);
+
+      if (image != NULL && image->refs > 0)
+        image->refs--;
+    }
+
+  token = g_slice_new0 (Token);
+  token->image = g_strdup (hash);
+  token->mime_type = g_strdup (mime_type);
+  g_hash_table_add (cache->dirty_tokens, g_strdup (key));
+  g_hash_table_insert (cache->tokens, key, token);
+
+  image = g_hash_table_lookup (cache->images, hash);
+  g_assert (image != NULL);
+  image->refs++;
+  image_used (cache, image);
+  schedule_save (cache);
+}
+
+typedef struct {
+    gchar *key;
+    gchar *hash;
+    gchar *mime_type;
+    GBytes *data;
+    GFile *file;
+} StoreData;
+
+static void
+store_data_free (gpointer p)
+{
+  StoreData *data = p;
+
+  g_free (data->key);
+  g_free (data->hash);
+  g_free (data->mime_type);
+  tp_clear_pointer (&data->data, g_bytes_unref);
+  g_clear_object (&data->file);
+  g_slice_free (StoreData, data);
+}
+
+static void
+image_written_cb (GObject *source_object,
+    GAsyncResult *res,
+    gpointer user_data)
+{
+  GSimpleAsyncResult *result = user_data;
+  StoreData *data = g_simple_async_result_get_op_res_gpointer (result);
+  AvatarCache *cache = get_avatar_cache ();
+  GError *error = NULL;
+
+  if (!g_file_replace_contents_finish (data->file, res, NULL, &error))
+    {
+      DEBUG ("Failed to store avatar in cache: %s", error->message);
+      g_simple_async_result_take_error (result, error);
+    }
+  else
+    {
+      Image *image = g_hash_table_lookup (cache->images, data->hash);
+
+      DEBUG ("Avatar %s stored in cache", data->hash);
+
+      if (image == NULL)
+        {
+          image = g_slice_new0 (Image);
+          image->size = g_bytes_get_size (data->data);
+          image->verified = g_get_monotonic_time ();
+          g_hash_table_insert (cache->images, g_strdup (data->hash), image);
+          cache->usage += image->size;
+        }
+
+      set_token (cache, data->key, data->hash, data->mime_type);
+      data->key = NULL;
+      enforce_quota (cache);
+    }
+
+  g_simple_async_result_complete (result);
+  g_object_unref (result);
+}
+
+/*
+ * Store @avatar as the image for @token. If the same image is already in
+ * the cache, it is not written again.
+ */
+void
+_tp_avatar_cache_store_async (TpConnection *connection,
+    const gchar *token,
+    const GArray *avatar,
+    const gchar *mime_type,
+    GAsyncReadyCallback callback,
+    gpointer user_data)
+{
+  AvatarCache *cache = get_avatar_cache ();
+  GSimpleAsyncResult *result;
+  StoreData *data;
+  gchar *path;
+
+  result = g_simple_async_result_new (NULL, callback, user_data,
+      _tp_avatar_cache_store_async);
+
+  data = g_slice_new0 (StoreData);
+  data->key = build_key (connection, token);
+  data->hash = g_compute_checksum_for_data (G_CHECKSUM_SHA1,
+      (const guchar *) avatar->data, avatar->len);
+  data->mime_type = g_strdup (mime_type);
+  path = build_image_path (cache->dir, data->hash);
+  data->file = g_file_new_for_path (path);
+  g_free (path);
+  g_simple_async_result_set_op_res_gpointer (result, data, store_data_free);
+
+  if (g_hash_table_lookup (cache->images, data->hash) != NULL)
+    {
+      DEBUG ("Avatar %s already in cache", data->hash);
+      set_token (cache, data->key, data->hash, data->mime_type);
+      data->key = NULL;
+      g_simple_async_result_complete_in_idle (result);
+      g_object_unref (result);
+      return;
+    }
+
+  if (!cache->dir_created)
+    {
+      if (g_mkdir_with_parents (cache->dir, 0700) == -1)
+        {
+          g_simple_async_result_set_error (result, G_IO_ERROR,
+              g_io_error_from_errno (errno),
+              "Error creating avatar cache dir: %s", g_strerror (errno));
+          g_simple_async_result_complete_in_idle (result);
+          g_object_unref (result);
+          return;
+        }
+
+      cache->dir_created = TRUE;
+    }
+
+  /* g_file_replace_contents_async() doesn't copy its argument, see
+   * <https://bugzilla.gnome.org/show_bug.cgi?id=690525>, so we have
+   * to keep a copy around */
+  data->data = g_bytes_new (avatar->data, avatar->len);
+
+  g_file_replace_contents_async (data->file,
+      g_bytes_get_data (data->data, NULL), avatar->len,
+      NULL, FALSE, G_FILE_CREATE_PRIVATE|G_FILE_CREATE_REPLACE_DESTINATION,
+      NULL, image_written_cb, result);
+}
+
+/*
+ * Returns: (transfer full): the stored image
+ */
+GFile *
+_tp_avatar_cache_store_finish (GAsyncResult *result,
+    gchar **mime_type,
+    GError **error)
+{
+  GSimpleAsyncResult *simple = (GSimpleAsyncResult *) result;
+  StoreData *data;
+
+  g_return_val_if_fail (g_simple_async_result_is_valid (result, NULL,
+        _tp_avatar_cache_store_async), NULL);
+
+  if (g_simple_async_result_propagate_error (simple, error))
+    return NULL;
+
+  data = g_simple_async_result_get_op_res_gpointer (simple);
+
+  if (mime_type != NULL)
+    *mime_type = g_strdup (data->mime_type);
+
+  return g_object_ref (data->file);
+}
+
+/* ---- Public API ---- */
+
+/**
+ * tp_contact_avatar_cache_set_quota:
+ * @max_bytes: the maximum size of the avatar cache in bytes, or 0 for no
+ *  limit
+ *
+ * Set how large this process lets the avatar cache grow before it removes
+ * the least recently used images. The default is 64 MiB.
+ *
+ * If the cache is already larger than @max_bytes, images are removed
+ * immediately (or as soon as the cache's index has been loaded).
+ *
+ * Since: 0.UNRELEASED
+ */
+void
+tp_contact_avatar_cache_set_quota (guint64 max_bytes)
+{
+  AvatarCache *cache = get_avatar_cache ();
+
+  cache->quota = max_bytes;
+
+  if (cache->loaded)
+    enforce_quota (cache);
+}
+
+/**
+ * tp_contact_avatar_cache_get_quota:
+ *
+ * <!-- -->
+ *
+ * Returns: the value set by tp_contact_avatar_cache_set_quota()
+ *
+ * Since: 0.UNRELEASED
+ */
+guint64
+tp_contact_avatar_cache_get_quota (void)
+{
+  return get_avatar_cache ()->quota;
+}
+
+/**
+ * tp_contact_avatar_cache_get_usage:
+ * @bytes: (out) (allow-none): used to return the total size of the cached
+ *  images, in bytes
+ * @n_images: (out) (allow-none): used to return the number of cached images
+ *
+ * Return how much space the avatar cache is using. The cache's index is
+ * loaded the first time an avatar is needed; until then, this returns
+ * %FALSE and sets @bytes and @n_images to 0.
+ *
+ * Returns: %TRUE if the cache's index has been loaded
+ *
+ * Since: 0.UNRELEASED
+ */
+gboolean
+tp_contact_avatar_cache_get_usage (guint64 *bytes,
+    guint *n_images)
+{
+  AvatarCache *cache = get_avatar_cache ();
+
+  if (bytes != NULL)
+    *bytes = cache->loaded ? cache->usage : 0;
+
+  if (n_images != NULL)
+    *n_images = cache->loaded ? g_hash_table_size (cache->images) : 0;
+
+  return cache->loaded;
+}
+
+static void
+compact_loaded_cb (GObject *source_object,
+    GAsyncResult *res,
+    gpointer user_data)
+{
+  AvatarCache *cache = get_avatar_cache ();
+
+  /* sync_done_cb() completes the result */
+  g_queue_push_tail (&cache->compact_waiters, user_data);
+  start_sync (cache);
+}
+
+/**
+ * tp_contact_avatar_cache_compact_async:
+ * @callback: called when the cache has been compacted
+ * @user_data: data to pass to @callback
+ *
+ * Shrink the avatar cache: remove images that no avatar token refers to,
+ * remove the least recently used images until the cache fits in the quota
+ * set by tp_contact_avatar_cache_set_quota(), and delete stray files.
+ *
+ * The cache is also kept within its quota automatically as avatars are
+ * stored, so calling this is only necessary to reclaim space immediately.
+ *
+ * Since: 0.UNRELEASED
+ */
+void
+tp_contact_avatar_cache_compact_async (GAsyncReadyCallback callback,
+    gpointer user_data)
+{
+  GSimpleAsyncResult *result;
+
+  result = g_simple_async_result_new (NULL, callback, user_data,
+      tp_contact_avatar_cache_compact_async);
+  g_simple_async_result_set_op_res_gpointer (result, g_new0 (guint64, 1),
+      g_free);
+
+  _tp_avatar_cache_load_async (compact_loaded_cb, result);
+}
+
+/**
+ * tp_contact_avatar_cache_compact_finish:
+ * @result: a #GAsyncResult
+ * @bytes_freed: (out) (allow-none): used to return the number of bytes freed
+ * @error: a #GError to fill
+ *
+ * Finishes tp_contact_avatar_cache_compact_async().
+ *
+ * Returns: %TRUE on success
+ *
+ * Since: 0.UNRELEASED
+ */
+gboolean
+tp_contact_avatar_cache_compact_finish (GAsyncResult *result,
+    guint64 *bytes_freed,
+    GError **error)
+{
+  GSimpleAsyncResult *simple = (GSimpleAsyncResult *) result;
+
+  g_return_val_if_fail (g_simple_async_result_is_valid (result, NULL,
+        tp_contact_avatar_cache_compact_async), FALSE);
+
+  if (g_simple_async_result_propagate_error (simple, error))
+    return FALSE;
+
+  if (bytes_freed != NULL)
+    {
+      guint64 *freed = g_simple_async_result_get_op_res_gpointer (simple);
+
+      *bytes_freed = *freed;
+    }
+
+  return TRUE;
+}
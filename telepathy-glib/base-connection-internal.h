@@ -33,6 +33,9 @@ void _tp_base_connection_set_handle_repo (TpBaseConnection *self,
 gpointer _tp_base_connection_find_channel_manager (TpBaseConnection *self,
     GType type);
 
+gboolean _tp_base_connection_has_client_interest (TpBaseConnection *self,
+    GQuark token);
+
 G_END_DECLS
 
 #endif
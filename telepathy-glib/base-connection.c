@@ -1405,6 +1405,27 @@ tp_base_connection_add_possible_client_interest (TpBaseConnection *self,
         g_hash_table_new (g_str_hash, g_str_equal));
 }
 
+/*
+ * _tp_base_connection_has_client_interest:
+ * @self: a connection
+ * @token: a token added with tp_base_connection_add_possible_client_interest()
+ *
+ * Returns: %TRUE if at least one client is currently interested in @token
+ */
+gboolean
+_tp_base_connection_has_client_interest (TpBaseConnection *self,
+    GQuark token)
+{
+  GHashTable *clients;
+
+  g_return_val_if_fail (TP_IS_BASE_CONNECTION (self), FALSE);
+
+  clients = g_hash_table_lookup (self->priv->client_interests,
+      GUINT_TO_POINTER (token));
+
+  return (clients != NULL && g_hash_table_size (clients) > 0);
+}
+
 /* D-Bus properties for the Requests interface */
 
 static void
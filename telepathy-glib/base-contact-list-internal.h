@@ -25,6 +25,7 @@
 
 #include <telepathy-glib/enums.h>
 #include <telepathy-glib/handle.h>
+#include <telepathy-glib/handle-repo.h>
 
 G_BEGIN_DECLS
 
@@ -79,6 +80,36 @@ gboolean _tp_base_contact_list_delete_group_by_handle (
 
 char _tp_base_contact_list_presence_state_to_letter (TpSubscriptionState ps);
 
+/* base-contact-list-snapshot.c */
+
+typedef struct _TpContactListSnapshot TpContactListSnapshot;
+
+TpContactListSnapshot *_tp_contact_list_snapshot_load (const gchar *path,
+    TpHandleRepoIface *contact_repo,
+    TpHandleRepoIface *group_repo,
+    GError **error);
+void _tp_contact_list_snapshot_free (TpContactListSnapshot *snapshot);
+
+gboolean _tp_contact_list_snapshot_save (TpBaseContactList *self,
+    TpHandleRepoIface *contact_repo,
+    const gchar *path,
+    GError **error);
+
+TpHandleSet *_tp_contact_list_snapshot_dup_contacts (
+    TpContactListSnapshot *snapshot);
+gboolean _tp_contact_list_snapshot_get_states (
+    TpContactListSnapshot *snapshot,
+    TpHandle contact,
+    TpSubscriptionState *subscribe,
+    TpSubscriptionState *publish);
+GStrv _tp_contact_list_snapshot_dup_groups (TpContactListSnapshot *snapshot);
+GStrv _tp_contact_list_snapshot_dup_contact_groups (
+    TpContactListSnapshot *snapshot,
+    TpHandle contact);
+TpHandleSet *_tp_contact_list_snapshot_dup_group_members (
+    TpContactListSnapshot *snapshot,
+    const gchar *group);
+
 G_END_DECLS
 
 #endif
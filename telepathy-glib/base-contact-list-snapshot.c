@@ -0,0 +1,504 @@
+/* ContactList channel manager - on-disk snapshot of the roster
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "config.h"
+
+#include <telepathy-glib/base-contact-list-internal.h>
+
+#include <string.h>
+
+#include <telepathy-glib/errors.h>
+#include <telepathy-glib/handle-repo.h>
+
+#define DEBUG_FLAG TP_DEBUG_CONTACT_LISTS
+#include "telepathy-glib/debug-internal.h"
+
+/*
+ * The file format is deliberately trivial, so that it can be parsed straight
+ * out of a memory mapping. All integers are little-endian.
+ *
+ *  "TPCL"                  magic
+ *  u32 version             SNAPSHOT_VERSION
+ *  u32 n_groups
+ *  n_groups times:
+ *    u32 length, followed by that many bytes of UTF-8 (no NUL)
+ *  u32 n_contacts
+ *  n_contacts times:
+ *    u32 length, followed by that many bytes of UTF-8 (no NUL)
+ *    u8 subscribe, u8 publish    (TpSubscriptionState)
+ *    u16 n_contact_groups
+ *    n_contact_groups times: u32 index into the groups above
+ */
+
+#define SNAPSHOT_MAGIC "TPCL"
+#define SNAPSHOT_VERSION 1
+
+struct _TpContactListSnapshot
+{
+  TpHandleRepoIface *contact_repo;
+  TpHandleSet *contacts;
+  /* contact handle => GUINT (subscribe | publish << 8) */
+  GHashTable *states;
+  /* normalized group names, owned */
+  GPtrArray *groups;
+  /* borrowed group name => TpHandleSet of contact handles */
+  GHashTable *group_members;
+  /* contact handle => GPtrArray of borrowed group names */
+  GHashTable *contact_groups;
+};
+
+typedef struct {
+    const guchar *data;
+    gsize remaining;
+} Reader;
+
+static gboolean
+read_bytes (Reader *reader,
+    gsize n,
+    const guchar **out)
+{
+  if (reader->remaining < n)
+    return FALSE;
+
+  *out = reader->data;
+  reader->data += n;
+  reader->remaining -= n;
+  return TRUE;
+}
+
+static gboolean
+read_u32 (Reader *reader,
+    guint32 *out)
+{
+  const guchar *p;
+
+  if (!read_bytes (reader, 4, &p))
+    return FALSE;
+
+  *out = p[0] | (p[1] << 8) | (p[2] << 16) | ((guint32) p[3] << 24);
+  return TRUE;
+}
+
+static gboolean
+read_u16 (Reader *reader,
+    guint16 *out)
+{
+  const guchar *p;
+
+  if (!read_bytes (reader, 2, &p))
+    return FALSE;
+
+  *out = p[0] | (p[1] << 8);
+  return TRUE;
+}
+
+static gchar *
+read_string (Reader *reader)
+{
+  guint32 len;
+  const guchar *p;
+
+  if (!read_u32 (reader, &len) || !read_bytes (reader, len, &p))
+    return NULL;
+
+  if (!g_utf8_validate ((const gchar *) p, len, NULL))
+    return NULL;
+
+  return g_strndup ((const gchar *) p, len);
+}
+
+static void
+write_u32 (GByteArray *out,
+    guint32 value)
+{
+  guint8 bytes[4] = { value & 0xff, (value >> 8) & 0xff,
+      (value >> 16) & 0xff, (value >> 24) & 0xff };
+
+  g_byte_array_append (out, bytes, 4);
+}
+
+static void
+write_u16 (GByteArray *out,
+    guint16 value)
+{
+  guint8 bytes[2] = { value & 0xff, (value >> 8) & 0xff };
+
+  g_byte_array_append (out, bytes, 2);
+}
+
+static void
+write_string (GByteArray *out,
+    const gchar *s)
+{
+  gsize len = strlen (s);
+
+  write_u32 (out, len);
+  g_byte_array_append (out, (const guint8 *) s, len);
+}
+
+static TpContactListSnapshot *
+snapshot_new (TpHandleRepoIface *contact_repo)
+{
+  TpContactListSnapshot *snapshot = g_slice_new0 (TpContactListSnapshot);
+
+  snapshot->contact_repo = g_object_ref (contact_repo);
+  snapshot->contacts = tp_handle_set_new (contact_repo);
+  snapshot->states = g_hash_table_new (NULL, NULL);
+  snapshot->groups = g_ptr_array_new_with_free_func (g_free);
+  snapshot->group_members = g_hash_table_new_full (g_str_hash, g_str_equal,
+      NULL, (GDestroyNotify) tp_handle_set_destroy);
+  snapshot->contact_groups = g_hash_table_new_full (NULL, NULL, NULL,
+      (GDestroyNotify) g_ptr_array_unref);
+
+  return snapshot;
+}
+
+void
+_tp_contact_list_snapshot_free (TpContactListSnapshot *snapshot)
+{
+  tp_handle_set_destroy (snapshot->contacts);
+  g_hash_table_unref (snapshot->states);
+  g_hash_table_unref (snapshot->group_members);
+  g_hash_table_unref (snapshot->contact_groups);
+  g_ptr_array_unref (snapshot->groups);
+  g_object_unref (snapshot->contact_repo);
+  g_slice_free (TpContactListSnapshot, snapshot);
+}
+
+static gboolean
+snapshot_parse (TpContactListSnapshot *snapshot,
+    Reader *reader,
+    TpHandleRepoIface *group_repo)
+{
+  const guchar *magic;
+  guint32 version, n_groups, n_contacts, i;
+
+  if (!read_bytes (reader, 4, &magic) ||
+      memcmp (magic, SNAPSHOT_MAGIC, 4) != 0 ||
+      !read_u32 (reader, &version) ||
+      version != SNAPSHOT_VERSION)
+    return FALSE;
+
+  if (!read_u32 (reader, &n_groups))
+    return FALSE;
+
+  for (i = 0; i < n_groups; i++)
+    {
+      gchar *group = read_string (reader);
+
+      if (group == NULL)
+        return FALSE;
+
+      /* keep the indexes in the file valid, even if the group name is not
+       * acceptable any more; its members will just be ignored */
+      g_ptr_array_add (snapshot->groups, group);
+
+      if (group_repo != NULL &&
+          tp_handle_ensure (group_repo, group, NULL, NULL) != 0)
+        g_hash_table_insert (snapshot->group_members, group,
+            tp_handle_set_new (snapshot->contact_repo));
+    }
+
+  if (!read_u32 (reader, &n_contacts))
+    return FALSE;
+
+  for (i = 0; i < n_contacts; i++)
+    {
+      gchar *id = read_string (reader);
+      const guchar *states;
+      guint16 n_contact_groups, j;
+      TpHandle handle;
+      GPtrArray *contact_groups = NULL;
+
+      if (id == NULL ||
+          !read_bytes (reader, 2, &states) ||
+          !read_u16 (reader, &n_contact_groups))
+        {
+          g_free (id);
+          return FALSE;
+        }
+
+      handle = tp_handle_ensure (snapshot->contact_repo, id, NULL, NULL);
+      g_free (id);
+
+      if (handle != 0 &&
+          states[0] <= TP_SUBSCRIPTION_STATE_REMOVED_REMOTELY &&
+          states[1] <= TP_SUBSCRIPTION_STATE_REMOVED_REMOTELY)
+        {
+          tp_handle_set_add (snapshot->contacts, handle);
+          g_hash_table_insert (snapshot->states, GUINT_TO_POINTER (handle),
+              GUINT_TO_POINTER (states[0] | (states[1] << 8)));
+        }
+      else
+        {
+          handle = 0;
+        }
+
+      for (j = 0; j < n_contact_groups; j++)
+        {
+          guint32 index;
+          const gchar *group;
+          TpHandleSet *members;
+
+          if (!read_u32 (reader, &index) || index >= snapshot->groups->len)
+            return FALSE;
+
+          group = g_ptr_array_index (snapshot->groups, index);
+          members = g_hash_table_lookup (snapshot->group_members, group);
+
+          if (handle == 0 || members == NULL)
+            continue;
+
+          tp_handle_set_add (members, handle);
+
+          if (contact_groups == NULL)
+            {
+              contact_groups = g_ptr_array_new ();
+              g_hash_table_insert (snapshot->contact_groups,
+                  GUINT_TO_POINTER (handle), contact_groups);
+            }
+
+          g_ptr_array_add (contact_groups, (gchar *) group);
+        }
+    }
+
+  return (reader->remaining == 0);
+}
+
+TpContactListSnapshot *
+_tp_contact_list_snapshot_load (const gchar *path,
+    TpHandleRepoIface *contact_repo,
+    TpHandleRepoIface *group_repo,
+    GError **error)
+{
+  GMappedFile *file;
+  TpContactListSnapshot *snapshot;
+  Reader reader;
+
+  file = g_mapped_file_new (path, FALSE, error);
+
+  if (file == NULL)
+    return NULL;
+
+  reader.data = (const guchar *) g_mapped_file_get_contents (file);
+  reader.remaining = g_mapped_file_get_length (file);
+
+  snapshot = snapshot_new (contact_repo);
+
+  if (!snapshot_parse (snapshot, &reader, group_repo))
+    {
+      g_set_error (error, TP_ERROR, TP_ERROR_INVALID_ARGUMENT,
+          "'%s' is not a valid contact list snapshot", path);
+      _tp_contact_list_snapshot_free (snapshot);
+      snapshot = NULL;
+    }
+  else
+    {
+      DEBUG ("loaded %u contacts in %u groups from '%s'",
+          tp_handle_set_size (snapshot->contacts), snapshot->groups->len,
+          path);
+    }
+
+  g_mapped_file_unref (file);
+  return snapshot;
+}
+
+gboolean
+_tp_contact_list_snapshot_save (TpBaseContactList *self,
+    TpHandleRepoIface *contact_repo,
+    const gchar *path,
+    GError **error)
+{
+  gboolean has_groups = TP_IS_CONTACT_GROUP_LIST (self);
+  GByteArray *out;
+  TpHandleSet *contacts;
+  GHashTable *group_indexes;
+  GStrv groups = NULL;
+  TpIntsetFastIter iter;
+  TpHandle handle;
+  gboolean ret;
+  guint i;
+
+  contacts = tp_base_contact_list_dup_contacts (self);
+  g_return_val_if_fail (contacts != NULL, FALSE);
+
+  group_indexes = g_hash_table_new (g_str_hash, g_str_equal);
+
+  out = g_byte_array_new ();
+  g_byte_array_append (out, (const guint8 *) SNAPSHOT_MAGIC, 4);
+  write_u32 (out, SNAPSHOT_VERSION);
+
+  if (has_groups)
+    groups = tp_base_contact_list_dup_groups (self);
+
+  write_u32 (out, groups == NULL ? 0 : g_strv_length (groups));
+
+  for (i = 0; groups != NULL && groups[i] != NULL; i++)
+    {
+      write_string (out, groups[i]);
+      g_hash_table_insert (group_indexes, groups[i], GUINT_TO_POINTER (i));
+    }
+
+  write_u32 (out, tp_handle_set_size (contacts));
+
+  tp_intset_fast_iter_init (&iter, tp_handle_set_peek (contacts));
+
+  while (tp_intset_fast_iter_next (&iter, &handle))
+    {
+      TpSubscriptionState subscribe = TP_SUBSCRIPTION_STATE_NO;
+      TpSubscriptionState publish = TP_SUBSCRIPTION_STATE_NO;
+      GStrv contact_groups = NULL;
+      GArray *indexes = g_array_new (FALSE, FALSE, sizeof (guint32));
+      guint8 states[2];
+
+      tp_base_contact_list_dup_states (self, handle, &subscribe, &publish,
+          NULL);
+      states[0] = subscribe;
+      states[1] = publish;
+
+      if (has_groups)
+        contact_groups = tp_base_contact_list_dup_contact_groups (self,
+            handle);
+
+      for (i = 0; contact_groups != NULL && contact_groups[i] != NULL; i++)
+        {
+          gpointer index;
+
+          if (g_hash_table_lookup_extended (group_indexes, contact_groups[i],
+                NULL, &index) && indexes->len < G_MAXUINT16)
+            {
+              guint32 index_u32 = GPOINTER_TO_UINT (index);
+
+              g_array_append_val (indexes, index_u32);
+            }
+        }
+
+      write_string (out, tp_handle_inspect (contact_repo, handle));
+      g_byte_array_append (out, states, 2);
+      write_u16 (out, indexes->len);
+
+      for (i = 0; i < indexes->len; i++)
+        write_u32 (out, g_array_index (indexes, guint32, i));
+
+      g_array_unref (indexes);
+      g_strfreev (contact_groups);
+    }
+
+  ret = g_file_set_contents (path, (const gchar *) out->data, out->len,
+      error);
+
+  if (ret)
+    DEBUG ("saved %u contacts to '%s' (%u bytes)",
+        tp_handle_set_size (contacts), path, out->len);
+
+  g_byte_array_unref (out);
+  g_hash_table_unref (group_indexes);
+  g_strfreev (groups);
+  tp_handle_set_destroy (contacts);
+  return ret;
+}
+
+TpHandleSet *
+_tp_contact_list_snapshot_dup_contacts (TpContactListSnapshot *snapshot)
+{
+  return tp_handle_set_copy (snapshot->contacts);
+}
+
+gboolean
+_tp_contact_list_snapshot_get_states (TpContactListSnapshot *snapshot,
+    TpHandle contact,
+    TpSubscriptionState *subscribe,
+    TpSubscriptionState *publish)
+{
+  gpointer value;
+  guint states;
+
+  if (!g_hash_table_lookup_extended (snapshot->states,
+        GUINT_TO_POINTER (contact), NULL, &value))
+    {
+      if (subscribe != NULL)
+        *subscribe = TP_SUBSCRIPTION_STATE_NO;
+
+      if (publish != NULL)
+        *publish = TP_SUBSCRIPTION_STATE_NO;
+
+      return FALSE;
+    }
+
+  states = GPOINTER_TO_UINT (value);
+
+  if (subscribe != NULL)
+    *subscribe = states & 0xff;
+
+  if (publish != NULL)
+    *publish = states >> 8;
+
+  return TRUE;
+}
+
+GStrv
+_tp_contact_list_snapshot_dup_groups (TpContactListSnapshot *snapshot)
+{
+  GPtrArray *ret = g_ptr_array_sized_new (snapshot->groups->len + 1);
+  guint i;
+
+  for (i = 0; i < snapshot->groups->len; i++)
+    {
+      gchar *group = g_ptr_array_index (snapshot->groups, i);
+
+      if (g_hash_table_lookup (snapshot->group_members, group) != NULL)
+        g_ptr_array_add (ret, g_strdup (group));
+    }
+
+  g_ptr_array_add (ret, NULL);
+  return (GStrv) g_ptr_array_free (ret, FALSE);
+}
+
+GStrv
+_tp_contact_list_snapshot_dup_contact_groups (TpContactListSnapshot *snapshot,
+    TpHandle contact)
+{
+  GPtrArray *groups = g_hash_table_lookup (snapshot->contact_groups,
+      GUINT_TO_POINTER (contact));
+  GPtrArray *ret;
+  guint i;
+
+  if (groups == NULL)
+    return g_new0 (gchar *, 1);
+
+  ret = g_ptr_array_sized_new (groups->len + 1);
+
+  for (i = 0; i < groups->len; i++)
+    g_ptr_array_add (ret, g_strdup (g_ptr_array_index (groups, i)));
+
+  g_ptr_array_add (ret, NULL);
+  return (GStrv) g_ptr_array_free (ret, FALSE);
+}
+
+TpHandleSet *
+_tp_contact_list_snapshot_dup_group_members (TpContactListSnapshot *snapshot,
+    const gchar *group)
+{
+  TpHandleSet *members = g_hash_table_lookup (snapshot->group_members, group);
+
+  if (members == NULL)
+    return tp_handle_set_new (snapshot->contact_repo);
+
+  return tp_handle_set_copy (members);
+}
@@ -308,6 +308,28 @@ struct _TpBaseContactListPrivate
   /* TRUE if the contact list must be downloaded at connection. Default is
    * TRUE. */
   gboolean download_at_connection;
+
+  /* maximum number of contacts per ContactsChanged signal, or 0 for no
+   * limit */
+  guint max_contacts_per_signal;
+
+  /* TRUE if we maintain group_members_index and contact_groups_index */
+  gboolean group_membership_index;
+  /* group handle => TpHandleSet of contact handles, and
+   * contact handle => TpHandleSet of group handles; NULL unless
+   * group_membership_index, and the contact list implements groups */
+  GHashTable *group_members_index;
+  GHashTable *contact_groups_index;
+
+  /* file to keep a copy of the roster in, or NULL */
+  gchar *snapshot_file;
+  /* the roster loaded from snapshot_file, while we're waiting for the
+   * real one; NULL otherwise */
+  TpContactListSnapshot *snapshot;
+  /* TRUE while announcing the contents of snapshot */
+  gboolean announcing_snapshot;
+  /* source ID for saving snapshot_file after a change, or 0 */
+  guint snapshot_save_source;
 };
 
 struct _TpBaseContactListClassPrivate
@@ -523,6 +545,9 @@ G_DEFINE_INTERFACE (TpMutableContactGroupList, tp_mutable_contact_group_list,
 enum {
     PROP_CONNECTION = 1,
     PROP_DOWNLOAD_AT_CONNECTION,
+    PROP_MAX_CONTACTS_PER_SIGNAL,
+    PROP_GROUP_MEMBERSHIP_INDEX,
+    PROP_SNAPSHOT_FILE,
     N_PROPS
 };
 
@@ -589,6 +614,8 @@ tp_base_contact_list_fail_blocked_contact_requests (
     dbus_g_method_return_error (context, error);
 }
 
+static void tp_base_contact_list_save_snapshot (TpBaseContactList *self);
+
 static void
 tp_base_contact_list_free_contents (TpBaseContactList *self)
 {
@@ -596,6 +623,11 @@ tp_base_contact_list_free_contents (TpBaseContactList *self)
       "Disconnected before blocked contacts were retrieved" };
   guint i;
 
+  /* don't lose changes made since the snapshot was last saved; this must
+   * happen while the roster and the indexes are still available */
+  if (self->priv->snapshot_save_source != 0)
+    tp_base_contact_list_save_snapshot (self);
+
   tp_base_contact_list_fail_channel_requests (self, TP_ERROR,
       TP_ERROR_DISCONNECTED,
       "Unable to complete channel request due to disconnection");
@@ -605,6 +637,9 @@ tp_base_contact_list_free_contents (TpBaseContactList *self)
     tp_clear_object (self->priv->lists + i);
 
   tp_clear_pointer (&self->priv->groups, g_hash_table_unref);
+  tp_clear_pointer (&self->priv->group_members_index, g_hash_table_unref);
+  tp_clear_pointer (&self->priv->contact_groups_index, g_hash_table_unref);
+  tp_clear_pointer (&self->priv->snapshot, _tp_contact_list_snapshot_free);
   tp_clear_object (&self->priv->contact_repo);
 
   if (self->priv->group_repo != NULL)
@@ -650,6 +685,19 @@ tp_base_contact_list_dispose (GObject *object)
     dispose (object);
 }
 
+static void
+tp_base_contact_list_finalize (GObject *object)
+{
+  TpBaseContactList *self = TP_BASE_CONTACT_LIST (object);
+  void (*finalize) (GObject *) =
+    G_OBJECT_CLASS (tp_base_contact_list_parent_class)->finalize;
+
+  g_free (self->priv->snapshot_file);
+
+  if (finalize != NULL)
+    finalize (object);
+}
+
 static void
 tp_base_contact_list_get_property (GObject *object,
     guint property_id,
@@ -668,6 +716,18 @@ tp_base_contact_list_get_property (GObject *object,
       g_value_set_boolean (value, self->priv->download_at_connection);
       break;
 
+    case PROP_MAX_CONTACTS_PER_SIGNAL:
+      g_value_set_uint (value, self->priv->max_contacts_per_signal);
+      break;
+
+    case PROP_GROUP_MEMBERSHIP_INDEX:
+      g_value_set_boolean (value, self->priv->group_membership_index);
+      break;
+
+    case PROP_SNAPSHOT_FILE:
+      g_value_set_string (value, self->priv->snapshot_file);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -693,6 +753,19 @@ tp_base_contact_list_set_property (GObject *object,
       self->priv->download_at_connection = g_value_get_boolean (value);
       break;
 
+    case PROP_MAX_CONTACTS_PER_SIGNAL:
+      self->priv->max_contacts_per_signal = g_value_get_uint (value);
+      break;
+
+    case PROP_GROUP_MEMBERSHIP_INDEX:
+      self->priv->group_membership_index = g_value_get_boolean (value);
+      break;
+
+    case PROP_SNAPSHOT_FILE:
+      g_assert (self->priv->snapshot_file == NULL);   /* construct-only */
+      self->priv->snapshot_file = g_value_dup_string (value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -836,6 +909,14 @@ tp_base_contact_list_constructed (GObject *object)
 
       _tp_base_connection_set_handle_repo (self->priv->conn,
           TP_HANDLE_TYPE_GROUP, self->priv->group_repo);
+
+      if (self->priv->group_membership_index)
+        {
+          self->priv->group_members_index = g_hash_table_new_full (NULL, NULL,
+              NULL, (GDestroyNotify) tp_handle_set_destroy);
+          self->priv->contact_groups_index = g_hash_table_new_full (NULL,
+              NULL, NULL, (GDestroyNotify) tp_handle_set_destroy);
+        }
     }
 
   if (TP_IS_MUTABLE_CONTACT_GROUP_LIST (self))
@@ -956,6 +1037,7 @@ tp_base_contact_list_class_init (TpBaseContactListClass *cls)
   object_class->set_property = tp_base_contact_list_set_property;
   object_class->constructed = tp_base_contact_list_constructed;
   object_class->dispose = tp_base_contact_list_dispose;
+  object_class->finalize = tp_base_contact_list_finalize;
 
   /**
    * TpBaseContactList:connection:
@@ -987,6 +1069,94 @@ tp_base_contact_list_class_init (TpBaseContactListClass *cls)
         "Whether the roster should be automatically downloaded at connection",
         TRUE,
         G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * TpBaseContactList:max-contacts-per-signal:
+   *
+   * The maximum number of contacts to include in a single
+   * ContactsChanged and ContactsChangedWithID signal, or 0 for no limit.
+   *
+   * If a call to tp_base_contact_list_contacts_changed() (including the
+   * implicit one for the initial roster, in
+   * tp_base_contact_list_set_list_received()) changes or removes more
+   * contacts than this, the change is split into several consecutive
+   * signals. This avoids sending multi-megabyte D-Bus messages for very
+   * large rosters.
+   *
+   * Since: 0.UNRELEASED
+   */
+  g_object_class_install_property (object_class, PROP_MAX_CONTACTS_PER_SIGNAL,
+      g_param_spec_uint ("max-contacts-per-signal", "Max contacts per signal",
+        "Maximum number of contacts in a single ContactsChanged signal, "
+        "or 0 for no limit",
+        0, G_MAXUINT, 0,
+        G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * TpBaseContactList:group-membership-index:
+   *
+   * If %TRUE, and the contact list implements %TP_TYPE_CONTACT_GROUP_LIST,
+   * the #TpBaseContactList keeps its own index of which contacts are in
+   * which groups, built from the initial roster and kept up to date by
+   * tp_base_contact_list_groups_changed(),
+   * tp_base_contact_list_groups_removed(),
+   * tp_base_contact_list_group_renamed() and
+   * tp_base_contact_list_contacts_changed().
+   *
+   * tp_base_contact_list_dup_group_members() and
+   * tp_base_contact_list_dup_contact_groups() (and hence the ContactGroups
+   * contact attribute) are then answered from the index, in time
+   * proportional to the size of the result, and the subclass's
+   * #TpContactGroupListInterface.dup_group_members and
+   * #TpContactGroupListInterface.dup_contact_groups are only used while the
+   * initial roster is being announced by
+   * tp_base_contact_list_set_list_received().
+   *
+   * Subclasses setting this property must report every membership change
+   * through tp_base_contact_list_groups_changed() or the other methods
+   * listed above.
+   *
+   * Since: 0.UNRELEASED
+   */
+  g_object_class_install_property (object_class, PROP_GROUP_MEMBERSHIP_INDEX,
+      g_param_spec_boolean ("group-membership-index", "Group membership index",
+        "Whether to keep an index of group memberships",
+        FALSE,
+        G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * TpBaseContactList:snapshot-file:
+   *
+   * If not %NULL, the path of a file in which to keep a copy of the contact
+   * list between connections, typically in the connection manager's cache
+   * directory.
+   *
+   * The file is written when tp_base_contact_list_set_list_received() is
+   * called, and a few seconds after any subsequent change. If it exists when
+   * tp_base_contact_list_set_list_pending() is called, its contents are
+   * announced straight away, so that clients can show the roster while the
+   * real one is being downloaded: the #TpBaseContactList enters
+   * %TP_CONTACT_LIST_STATE_SUCCESS at that point, and answers
+   * tp_base_contact_list_dup_contacts(), tp_base_contact_list_dup_states()
+   * and the group methods from the file.
+   *
+   * When tp_base_contact_list_set_list_received() is called, the real
+   * roster is compared with the provisional one and only the differences
+   * are signalled. Changes reported by the subclass in the meantime are
+   * ignored, since the comparison picks them up. If
+   * tp_base_contact_list_set_list_failed() is called instead, the
+   * provisional roster is kept.
+   *
+   * Blocked contacts are not saved, so RequestBlockedContacts is not
+   * answered until the real roster has been received.
+   *
+   * Since: 0.UNRELEASED
+   */
+  g_object_class_install_property (object_class, PROP_SNAPSHOT_FILE,
+      g_param_spec_string ("snapshot-file", "Snapshot file",
+        "File in which to keep a copy of the contact list, or NULL",
+        NULL,
+        G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -1819,17 +1989,346 @@ error:
   g_error_free (error);
 }
 
+/* While we are serving a snapshot, the subclass's idea of the roster is
+ * incomplete, so we ignore its changes: tp_base_contact_list_set_list_received
+ * picks them up when it compares the real roster with the snapshot. */
+static gboolean
+tp_base_contact_list_ignoring_changes (TpBaseContactList *self)
+{
+  return (self->priv->snapshot != NULL && !self->priv->announcing_snapshot);
+}
+
+static void
+tp_base_contact_list_save_snapshot (TpBaseContactList *self)
+{
+  GError *error = NULL;
+
+  if (self->priv->snapshot_save_source != 0)
+    {
+      g_source_remove (self->priv->snapshot_save_source);
+      self->priv->snapshot_save_source = 0;
+    }
+
+  if (!_tp_contact_list_snapshot_save (self, self->priv->contact_repo,
+        self->priv->snapshot_file, &error))
+    {
+      DEBUG ("unable to save contact list to '%s': %s",
+          self->priv->snapshot_file, error->message);
+      g_clear_error (&error);
+    }
+}
+
+static gboolean
+tp_base_contact_list_save_snapshot_cb (gpointer data)
+{
+  TpBaseContactList *self = data;
+
+  self->priv->snapshot_save_source = 0;
+  tp_base_contact_list_save_snapshot (self);
+  return FALSE;
+}
+
+/* Save the roster a little while after it changes, so that a burst of
+ * changes only costs one write. */
+static void
+tp_base_contact_list_schedule_snapshot_save (TpBaseContactList *self)
+{
+  if (self->priv->snapshot_file == NULL ||
+      self->priv->snapshot != NULL ||
+      self->priv->snapshot_save_source != 0)
+    return;
+
+  self->priv->snapshot_save_source = g_timeout_add_seconds (10,
+      tp_base_contact_list_save_snapshot_cb, self);
+}
+
+/* the subclass's idea of a group's members, bypassing the snapshot and the
+ * index */
+static TpHandleSet *
+tp_base_contact_list_dup_real_group_members (TpBaseContactList *self,
+    const gchar *group)
+{
+  TpHandleSet *members =
+    TP_CONTACT_GROUP_LIST_GET_INTERFACE (self)->dup_group_members (self,
+        group);
+
+  if (members == NULL)
+    members = tp_handle_set_new (self->priv->contact_repo);
+
+  return members;
+}
+
+static void tp_base_contact_list_announce_blocked_contacts (
+    TpBaseContactList *self);
+
+/* Announce the lists, the contacts and the groups, which must already be
+ * available from tp_base_contact_list_dup_contacts() etc., and the blocked
+ * contacts too if @with_blocking. */
+static void
+tp_base_contact_list_announce_roster (TpBaseContactList *self,
+    gboolean with_blocking)
+{
+  TpHandleSet *contacts;
+  guint i;
+
+  if (self->priv->lists[TP_LIST_HANDLE_SUBSCRIBE] == NULL)
+    {
+      tp_base_contact_list_new_channel (self,
+          TP_HANDLE_TYPE_LIST, TP_LIST_HANDLE_SUBSCRIBE, NULL);
+    }
+
+  if (self->priv->lists[TP_LIST_HANDLE_PUBLISH] == NULL)
+    {
+      tp_base_contact_list_new_channel (self,
+          TP_HANDLE_TYPE_LIST, TP_LIST_HANDLE_PUBLISH, NULL);
+    }
+
+  if (tp_base_contact_list_get_contact_list_persists (self) &&
+      self->priv->lists[TP_LIST_HANDLE_STORED] == NULL)
+    {
+      tp_base_contact_list_new_channel (self,
+          TP_HANDLE_TYPE_LIST, TP_LIST_HANDLE_STORED, NULL);
+    }
+
+  contacts = tp_base_contact_list_dup_contacts (self);
+  g_return_if_fail (contacts != NULL);
+
+  /* A quick sanity check to make sure that faulty implementations crash
+   * during development :-) */
+  tp_base_contact_list_dup_states (self,
+      tp_base_connection_get_self_handle (self->priv->conn),
+      NULL, NULL, NULL);
+
+  if (DEBUGGING)
+    {
+      gchar *tmp = tp_intset_dump (tp_handle_set_peek (contacts));
+
+      DEBUG ("Initial contacts: %s", tmp);
+      g_free (tmp);
+    }
+
+  tp_base_contact_list_contacts_changed_internal (self, contacts, NULL, TRUE);
+
+  if (with_blocking)
+    tp_base_contact_list_announce_blocked_contacts (self);
+
+  for (i = 0; i < TP_NUM_LIST_HANDLES; i++)
+    {
+      if (self->priv->lists[i] != NULL)
+        tp_base_contact_list_announce_channel (self, self->priv->lists[i],
+            NULL);
+    }
+
+  /* The natural thing to do here would be to iterate over all contacts, and
+   * for each contact, emit a signal adding them to their own groups. However,
+   * that emits a signal per contact. Here we turn the data model inside out,
+   * to emit one signal per group - that's probably fewer (and also means we
+   * can put them in batches for legacy Group channels). */
+  if (TP_IS_CONTACT_GROUP_LIST (self))
+    {
+      GStrv groups = tp_base_contact_list_dup_groups (self);
+
+      tp_base_contact_list_groups_created (self,
+          (const gchar * const *) groups, -1);
+
+      for (i = 0; groups != NULL && groups[i] != NULL; i++)
+        {
+          TpHandleSet *members;
+
+          /* bypass our index (if any), which is filled in by
+           * tp_base_contact_list_groups_changed() */
+          if (self->priv->snapshot != NULL)
+            members = _tp_contact_list_snapshot_dup_group_members (
+                self->priv->snapshot, groups[i]);
+          else
+            members = tp_base_contact_list_dup_real_group_members (self,
+                groups[i]);
+
+          tp_base_contact_list_groups_changed (self, members,
+              (const gchar * const *) groups + i, 1, NULL, 0);
+          tp_handle_set_destroy (members);
+        }
+
+      g_strfreev (groups);
+    }
+
+  tp_handle_set_destroy (contacts);
+}
+
+/* Announce the blocked contacts, which must already be available from
+ * tp_base_contact_list_dup_blocked_contacts(), and answer any pending
+ * requests for them. The caller is responsible for announcing the deny
+ * list. */
+static void
+tp_base_contact_list_announce_blocked_contacts (TpBaseContactList *self)
+{
+  TpHandleSet *blocked;
+
+  if (!tp_base_contact_list_can_block (self))
+    return;
+
+  if (self->priv->lists[TP_LIST_HANDLE_DENY] == NULL)
+    {
+      tp_base_contact_list_new_channel (self,
+          TP_HANDLE_TYPE_LIST, TP_LIST_HANDLE_DENY, NULL);
+    }
+
+  blocked = tp_base_contact_list_dup_blocked_contacts (self);
+
+  if (DEBUGGING)
+    {
+      gchar *tmp = tp_intset_dump (tp_handle_set_peek (blocked));
+
+      DEBUG ("Initially blocked contacts: %s", tmp);
+      g_free (tmp);
+    }
+
+  tp_base_contact_list_contact_blocking_changed (self, blocked);
+
+  if (self->priv->svc_contact_blocking &&
+      self->priv->blocked_contact_requests.length > 0)
+    {
+      GHashTable *map = tp_handle_set_to_identifier_map (blocked);
+      DBusGMethodInvocation *context;
+
+      while ((context = g_queue_pop_head (
+                  &self->priv->blocked_contact_requests)) != NULL)
+        tp_svc_connection_interface_contact_blocking_return_from_request_blocked_contacts (context, map);
+
+      g_hash_table_unref (map);
+    }
+
+  tp_handle_set_destroy (blocked);
+}
+
+static TpHandleSet *
+handle_set_minus (TpHandleSet *set,
+    TpHandleSet *remove)
+{
+  TpHandleSet *ret = tp_handle_set_copy (set);
+
+  tp_intset_destroy (tp_handle_set_difference_update (ret,
+        tp_handle_set_peek (remove)));
+  return ret;
+}
+
+/* Signal the differences between @snapshot, which has been announced, and
+ * the subclass's roster. */
+static void
+tp_base_contact_list_reconcile_snapshot (TpBaseContactList *self,
+    TpContactListSnapshot *snapshot)
+{
+  TpBaseContactListClass *cls = TP_BASE_CONTACT_LIST_GET_CLASS (self);
+  TpHandleSet *contacts, *old_contacts, *changed, *removed;
+  TpIntsetFastIter iter;
+  TpHandle contact;
+
+  contacts = tp_base_contact_list_dup_contacts (self);
+  g_return_if_fail (contacts != NULL);
+
+  old_contacts = _tp_contact_list_snapshot_dup_contacts (snapshot);
+  changed = tp_handle_set_new (self->priv->contact_repo);
+  removed = handle_set_minus (old_contacts, contacts);
+
+  tp_intset_fast_iter_init (&iter, tp_handle_set_peek (contacts));
+
+  while (tp_intset_fast_iter_next (&iter, &contact))
+    {
+      TpSubscriptionState subscribe = TP_SUBSCRIPTION_STATE_NO;
+      TpSubscriptionState publish = TP_SUBSCRIPTION_STATE_NO;
+      TpSubscriptionState old_subscribe, old_publish;
+
+      cls->dup_states (self, contact, &subscribe, &publish, NULL);
+
+      /* the request message isn't saved, so always re-announce requests */
+      if (!_tp_contact_list_snapshot_get_states (snapshot, contact,
+            &old_subscribe, &old_publish) ||
+          subscribe != old_subscribe ||
+          publish != old_publish ||
+          publish == TP_SUBSCRIPTION_STATE_ASK)
+        tp_handle_set_add (changed, contact);
+    }
+
+  DEBUG ("%u contacts changed and %u removed since the snapshot",
+      tp_handle_set_size (changed), tp_handle_set_size (removed));
+
+  if (!tp_handle_set_is_empty (changed) || !tp_handle_set_is_empty (removed))
+    tp_base_contact_list_contacts_changed_internal (self, changed, removed,
+        FALSE);
+
+  if (TP_IS_CONTACT_GROUP_LIST (self))
+    {
+      GStrv groups = tp_base_contact_list_dup_groups (self);
+      GStrv old_groups = _tp_contact_list_snapshot_dup_groups (snapshot);
+      GPtrArray *vanished = g_ptr_array_new ();
+      guint i;
+
+      tp_base_contact_list_groups_created (self,
+          (const gchar * const *) groups, -1);
+
+      for (i = 0; groups != NULL && groups[i] != NULL; i++)
+        {
+          TpHandleSet *members = tp_base_contact_list_dup_real_group_members (
+              self, groups[i]);
+          TpHandleSet *old_members =
+            _tp_contact_list_snapshot_dup_group_members (snapshot, groups[i]);
+          TpHandleSet *added = handle_set_minus (members, old_members);
+          TpHandleSet *gone = handle_set_minus (old_members, members);
+
+          if (!tp_handle_set_is_empty (added))
+            tp_base_contact_list_groups_changed (self, added,
+                (const gchar * const *) groups + i, 1, NULL, 0);
+
+          if (!tp_handle_set_is_empty (gone))
+            tp_base_contact_list_groups_changed (self, gone,
+                NULL, 0, (const gchar * const *) groups + i, 1);
+
+          tp_handle_set_destroy (gone);
+          tp_handle_set_destroy (added);
+          tp_handle_set_destroy (old_members);
+          tp_handle_set_destroy (members);
+        }
+
+      for (i = 0; old_groups[i] != NULL; i++)
+        {
+          if (groups == NULL ||
+              !tp_strv_contains ((const gchar * const *) groups,
+                old_groups[i]))
+            g_ptr_array_add (vanished, old_groups[i]);
+        }
+
+      if (vanished->len > 0)
+        tp_base_contact_list_groups_removed (self,
+            (const gchar * const *) vanished->pdata, vanished->len);
+
+      g_ptr_array_unref (vanished);
+      g_strfreev (old_groups);
+      g_strfreev (groups);
+    }
+
+  tp_handle_set_destroy (removed);
+  tp_handle_set_destroy (changed);
+  tp_handle_set_destroy (old_contacts);
+  tp_handle_set_destroy (contacts);
+}
+
 /**
  * tp_base_contact_list_set_list_pending:
  * @self: the contact list manager
  *
  * Record that receiving the initial contact list is in progress.
  *
+ * If #TpBaseContactList:snapshot-file names a valid snapshot, its contents
+ * are announced immediately, and the contact list state becomes
+ * %TP_CONTACT_LIST_STATE_SUCCESS.
+ *
  * Since: 0.13.0
  */
 void
 tp_base_contact_list_set_list_pending (TpBaseContactList *self)
 {
+  GError *error = NULL;
+
   g_return_if_fail (TP_IS_BASE_CONTACT_LIST (self));
   g_return_if_fail (self->priv->state == TP_CONTACT_LIST_STATE_NONE);
 
@@ -1837,7 +2336,31 @@ tp_base_contact_list_set_list_pending (TpBaseContactList *self)
       self->priv->state != TP_CONTACT_LIST_STATE_NONE)
     return;
 
-  self->priv->state = TP_CONTACT_LIST_STATE_WAITING;
+  if (self->priv->snapshot_file != NULL)
+    {
+      self->priv->snapshot = _tp_contact_list_snapshot_load (
+          self->priv->snapshot_file, self->priv->contact_repo,
+          self->priv->group_repo, &error);
+
+      if (self->priv->snapshot == NULL)
+        {
+          DEBUG ("not using a snapshot: %s", error->message);
+          g_clear_error (&error);
+        }
+    }
+
+  if (self->priv->snapshot != NULL)
+    {
+      self->priv->state = TP_CONTACT_LIST_STATE_SUCCESS;
+      self->priv->announcing_snapshot = TRUE;
+      tp_base_contact_list_announce_roster (self, FALSE);
+      self->priv->announcing_snapshot = FALSE;
+    }
+  else
+    {
+      self->priv->state = TP_CONTACT_LIST_STATE_WAITING;
+    }
+
   tp_svc_connection_interface_contact_list_emit_contact_list_state_changed (
       self->priv->conn, self->priv->state);
 }
@@ -1854,6 +2377,10 @@ tp_base_contact_list_set_list_pending (TpBaseContactList *self)
  * This method cannot be called after tp_base_contact_list_set_list_received()
  * is called.
  *
+ * If a roster from #TpBaseContactList:snapshot-file is being used, it
+ * is kept, and the contact list state remains
+ * %TP_CONTACT_LIST_STATE_SUCCESS.
+ *
  * Since: 0.13.0
  */
 void
@@ -1863,11 +2390,19 @@ tp_base_contact_list_set_list_failed (TpBaseContactList *self,
     const gchar *message)
 {
   g_return_if_fail (TP_IS_BASE_CONTACT_LIST (self));
-  g_return_if_fail (self->priv->state != TP_CONTACT_LIST_STATE_SUCCESS);
+  g_return_if_fail (self->priv->state != TP_CONTACT_LIST_STATE_SUCCESS ||
+      self->priv->snapshot != NULL);
 
   if (self->priv->conn == NULL)
     return;
 
+  if (self->priv->snapshot != NULL)
+    {
+      DEBUG ("keeping the snapshot, since the contact list failed: %s",
+          message);
+      return;
+    }
+
   self->priv->state = TP_CONTACT_LIST_STATE_FAILURE;
   g_clear_error (&self->priv->failure);
   self->priv->failure = g_error_new_literal (domain, code, message);
@@ -1900,162 +2435,309 @@ tp_base_contact_list_set_list_failed (TpBaseContactList *self,
  * If implemented, tp_base_contact_list_dup_blocked_contacts() must also
  * give correct results when entering this method.
  *
+ * If a roster from #TpBaseContactList:snapshot-file has been announced,
+ * only the differences between it and the real roster are signalled.
+ *
  * Since: 0.13.0
  */
 void
 tp_base_contact_list_set_list_received (TpBaseContactList *self)
 {
-  TpHandleSet *contacts;
-  guint i;
+  TpContactListSnapshot *snapshot;
 
   g_return_if_fail (TP_IS_BASE_CONTACT_LIST (self));
-  g_return_if_fail (self->priv->state != TP_CONTACT_LIST_STATE_SUCCESS);
+  g_return_if_fail (self->priv->state != TP_CONTACT_LIST_STATE_SUCCESS ||
+      self->priv->snapshot != NULL);
 
   if (self->priv->conn == NULL)
     return;
 
-  self->priv->state = TP_CONTACT_LIST_STATE_SUCCESS;
-  /* we emit the signal for this later */
+  snapshot = self->priv->snapshot;
 
-  if (self->priv->lists[TP_LIST_HANDLE_SUBSCRIBE] == NULL)
+  if (snapshot != NULL)
     {
-      tp_base_contact_list_new_channel (self,
-          TP_HANDLE_TYPE_LIST, TP_LIST_HANDLE_SUBSCRIBE, NULL);
+      /* from now on, the subclass is authoritative */
+      self->priv->snapshot = NULL;
+      tp_base_contact_list_reconcile_snapshot (self, snapshot);
+      _tp_contact_list_snapshot_free (snapshot);
+
+      tp_base_contact_list_announce_blocked_contacts (self);
+
+      if (self->priv->lists[TP_LIST_HANDLE_DENY] != NULL &&
+          g_hash_table_lookup_extended (self->priv->channel_requests,
+            self->priv->lists[TP_LIST_HANDLE_DENY], NULL, NULL))
+        tp_base_contact_list_announce_channel (self,
+            self->priv->lists[TP_LIST_HANDLE_DENY], NULL);
     }
-
-  if (self->priv->lists[TP_LIST_HANDLE_PUBLISH] == NULL)
+  else
     {
-      tp_base_contact_list_new_channel (self,
-          TP_HANDLE_TYPE_LIST, TP_LIST_HANDLE_PUBLISH, NULL);
+      self->priv->state = TP_CONTACT_LIST_STATE_SUCCESS;
+      /* we emit the signal for this later */
+
+      tp_base_contact_list_announce_roster (self, TRUE);
+
+      /* emit this last, so people can distinguish between the initial state
+       * and subsequent changes */
+      tp_svc_connection_interface_contact_list_emit_contact_list_state_changed (
+          self->priv->conn, self->priv->state);
     }
 
-  if (tp_base_contact_list_get_contact_list_persists (self) &&
-      self->priv->lists[TP_LIST_HANDLE_STORED] == NULL)
+  if (self->priv->snapshot_file != NULL)
+    tp_base_contact_list_save_snapshot (self);
+}
+
+char
+_tp_base_contact_list_presence_state_to_letter (TpSubscriptionState ps)
+{
+  switch (ps)
     {
-      tp_base_contact_list_new_channel (self,
-          TP_HANDLE_TYPE_LIST, TP_LIST_HANDLE_STORED, NULL);
+    case TP_SUBSCRIPTION_STATE_UNKNOWN:
+      return '?';
+
+    case TP_SUBSCRIPTION_STATE_YES:
+      return 'Y';
+
+    case TP_SUBSCRIPTION_STATE_NO:
+      return 'N';
+
+    case TP_SUBSCRIPTION_STATE_ASK:
+      return 'A';
+
+    case TP_SUBSCRIPTION_STATE_REMOVED_REMOTELY:
+      return 'R';
+
+    default:
+      return '!';
     }
+}
 
-  contacts = tp_base_contact_list_dup_contacts (self);
-  g_return_if_fail (contacts != NULL);
+static void
+group_index_add (TpBaseContactList *self,
+    TpHandle group,
+    TpHandleSet *contacts)
+{
+  TpHandleSet *members;
+  TpIntsetFastIter iter;
+  TpHandle contact;
 
-  /* A quick sanity check to make sure that faulty implementations crash
-   * during development :-) */
-  tp_base_contact_list_dup_states (self,
-      tp_base_connection_get_self_handle (self->priv->conn),
-      NULL, NULL, NULL);
+  members = g_hash_table_lookup (self->priv->group_members_index,
+      GUINT_TO_POINTER (group));
 
-  if (DEBUGGING)
+  if (members == NULL)
     {
-      gchar *tmp = tp_intset_dump (tp_handle_set_peek (contacts));
-
-      DEBUG ("Initial contacts: %s", tmp);
-      g_free (tmp);
+      members = tp_handle_set_new (self->priv->contact_repo);
+      g_hash_table_insert (self->priv->group_members_index,
+          GUINT_TO_POINTER (group), members);
     }
 
-  tp_base_contact_list_contacts_changed_internal (self, contacts, NULL, TRUE);
+  tp_intset_fast_iter_init (&iter, tp_handle_set_peek (contacts));
 
-  if (tp_base_contact_list_can_block (self))
+  while (tp_intset_fast_iter_next (&iter, &contact))
     {
-      TpHandleSet *blocked;
+      TpHandleSet *groups = g_hash_table_lookup (
+          self->priv->contact_groups_index, GUINT_TO_POINTER (contact));
 
-      if (self->priv->lists[TP_LIST_HANDLE_DENY] == NULL)
+      if (groups == NULL)
         {
-          tp_base_contact_list_new_channel (self,
-              TP_HANDLE_TYPE_LIST, TP_LIST_HANDLE_DENY, NULL);
+          groups = tp_handle_set_new (self->priv->group_repo);
+          g_hash_table_insert (self->priv->contact_groups_index,
+              GUINT_TO_POINTER (contact), groups);
         }
 
-      blocked = tp_base_contact_list_dup_blocked_contacts (self);
+      tp_handle_set_add (members, contact);
+      tp_handle_set_add (groups, group);
+    }
+}
 
-      if (DEBUGGING)
-        {
-          gchar *tmp = tp_intset_dump (tp_handle_set_peek (contacts));
+static void
+contact_index_remove_group (TpBaseContactList *self,
+    TpHandle contact,
+    TpHandle group)
+{
+  TpHandleSet *groups = g_hash_table_lookup (
+      self->priv->contact_groups_index, GUINT_TO_POINTER (contact));
 
-          DEBUG ("Initially blocked contacts: %s", tmp);
-          g_free (tmp);
-        }
+  if (groups == NULL)
+    return;
 
-      tp_base_contact_list_contact_blocking_changed (self, blocked);
+  tp_handle_set_remove (groups, group);
 
-      if (self->priv->svc_contact_blocking &&
-          self->priv->blocked_contact_requests.length > 0)
-        {
-          GHashTable *map = tp_handle_set_to_identifier_map (blocked);
-          DBusGMethodInvocation *context;
+  if (tp_handle_set_is_empty (groups))
+    g_hash_table_remove (self->priv->contact_groups_index,
+        GUINT_TO_POINTER (contact));
+}
 
-          while ((context = g_queue_pop_head (
-                      &self->priv->blocked_contact_requests)) != NULL)
-            tp_svc_connection_interface_contact_blocking_return_from_request_blocked_contacts (context, map);
+static void
+group_index_remove (TpBaseContactList *self,
+    TpHandle group,
+    TpHandleSet *contacts)
+{
+  TpHandleSet *members;
+  TpIntsetFastIter iter;
+  TpHandle contact;
 
-          g_hash_table_unref (map);
-        }
+  members = g_hash_table_lookup (self->priv->group_members_index,
+      GUINT_TO_POINTER (group));
 
-      tp_handle_set_destroy (blocked);
-    }
+  if (members == NULL)
+    return;
 
-  for (i = 0; i < TP_NUM_LIST_HANDLES; i++)
+  tp_intset_fast_iter_init (&iter, tp_handle_set_peek (contacts));
+
+  while (tp_intset_fast_iter_next (&iter, &contact))
     {
-      if (self->priv->lists[i] != NULL)
-        tp_base_contact_list_announce_channel (self, self->priv->lists[i],
-            NULL);
+      if (tp_handle_set_remove (members, contact))
+        contact_index_remove_group (self, contact, group);
     }
+}
 
-  /* The natural thing to do here would be to iterate over all contacts, and
-   * for each contact, emit a signal adding them to their own groups. However,
-   * that emits a signal per contact. Here we turn the data model inside out,
-   * to emit one signal per group - that's probably fewer (and also means we
-   * can put them in batches for legacy Group channels). */
-  if (TP_IS_CONTACT_GROUP_LIST (self))
+/* Forget everything about @group, typically because it has been removed */
+static void
+group_index_forget_group (TpBaseContactList *self,
+    TpHandle group)
+{
+  TpHandleSet *members;
+  TpIntsetFastIter iter;
+  TpHandle contact;
+
+  members = g_hash_table_lookup (self->priv->group_members_index,
+      GUINT_TO_POINTER (group));
+
+  if (members == NULL)
+    return;
+
+  tp_intset_fast_iter_init (&iter, tp_handle_set_peek (members));
+
+  while (tp_intset_fast_iter_next (&iter, &contact))
+    contact_index_remove_group (self, contact, group);
+
+  g_hash_table_remove (self->priv->group_members_index,
+      GUINT_TO_POINTER (group));
+}
+
+/* Forget everything about @contacts, because they have been removed from
+ * the contact list */
+static void
+group_index_forget_contacts (TpBaseContactList *self,
+    TpHandleSet *contacts)
+{
+  TpIntsetFastIter iter;
+  TpHandle contact;
+
+  tp_intset_fast_iter_init (&iter, tp_handle_set_peek (contacts));
+
+  while (tp_intset_fast_iter_next (&iter, &contact))
     {
-      GStrv groups = tp_base_contact_list_dup_groups (self);
+      TpHandleSet *groups = g_hash_table_lookup (
+          self->priv->contact_groups_index, GUINT_TO_POINTER (contact));
+      TpIntsetFastIter group_iter;
+      TpHandle group;
 
-      tp_base_contact_list_groups_created (self,
-          (const gchar * const *) groups, -1);
+      if (groups == NULL)
+        continue;
 
-      for (i = 0; groups != NULL && groups[i] != NULL; i++)
+      tp_intset_fast_iter_init (&group_iter, tp_handle_set_peek (groups));
+
+      while (tp_intset_fast_iter_next (&group_iter, &group))
         {
-          TpHandleSet *members = tp_base_contact_list_dup_group_members (self,
-              groups[i]);
+          TpHandleSet *members = g_hash_table_lookup (
+              self->priv->group_members_index, GUINT_TO_POINTER (group));
 
-          tp_base_contact_list_groups_changed (self, members,
-              (const gchar * const *) groups + i, 1, NULL, 0);
-          tp_handle_set_destroy (members);
+          if (members != NULL)
+            tp_handle_set_remove (members, contact);
         }
 
-      g_strfreev (groups);
+      g_hash_table_remove (self->priv->contact_groups_index,
+          GUINT_TO_POINTER (contact));
     }
-
-  tp_handle_set_destroy (contacts);
-
-  /* emit this last, so people can distinguish between the initial state
-   * and subsequent changes */
-  tp_svc_connection_interface_contact_list_emit_contact_list_state_changed (
-      self->priv->conn, self->priv->state);
 }
 
-char
-_tp_base_contact_list_presence_state_to_letter (TpSubscriptionState ps)
+static void
+emit_contacts_changed (TpBaseContactList *self,
+    GHashTable *changes,
+    GHashTable *change_ids,
+    GHashTable *removal_ids,
+    const GArray *removals)
 {
-  switch (ps)
+  tp_svc_connection_interface_contact_list_emit_contacts_changed_with_id (
+      self->priv->conn, changes, change_ids, removal_ids);
+  tp_svc_connection_interface_contact_list_emit_contacts_changed (
+      self->priv->conn, changes, removals);
+}
+
+/* Emit ContactsChanged(WithID) for @changes and @removals, in chunks of at
+ * most max_contacts_per_signal contacts. The tables passed to each signal
+ * borrow their keys and values from the originals. */
+static void
+emit_contacts_changed_in_chunks (TpBaseContactList *self,
+    GHashTable *changes,
+    GHashTable *change_ids,
+    GHashTable *removal_ids,
+    const GArray *removals)
+{
+  guint max = self->priv->max_contacts_per_signal;
+  GHashTable *chunk_changes, *chunk_change_ids, *chunk_removal_ids;
+  GArray *chunk_removals;
+  GHashTableIter iter;
+  gpointer key, value;
+  guint i;
+
+  if (max == 0 || g_hash_table_size (changes) + removals->len <= max)
     {
-    case TP_SUBSCRIPTION_STATE_UNKNOWN:
-      return '?';
+      emit_contacts_changed (self, changes, change_ids, removal_ids, removals);
+      return;
+    }
 
-    case TP_SUBSCRIPTION_STATE_YES:
-      return 'Y';
+  chunk_changes = g_hash_table_new (NULL, NULL);
+  chunk_change_ids = g_hash_table_new (NULL, NULL);
+  chunk_removal_ids = g_hash_table_new (NULL, NULL);
+  chunk_removals = g_array_sized_new (FALSE, FALSE, sizeof (TpHandle), max);
 
-    case TP_SUBSCRIPTION_STATE_NO:
-      return 'N';
+  g_hash_table_iter_init (&iter, changes);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      g_hash_table_insert (chunk_changes, key, value);
+      g_hash_table_insert (chunk_change_ids, key,
+          g_hash_table_lookup (change_ids, key));
 
-    case TP_SUBSCRIPTION_STATE_ASK:
-      return 'A';
+      if (g_hash_table_size (chunk_changes) >= max)
+        {
+          emit_contacts_changed (self, chunk_changes, chunk_change_ids,
+              chunk_removal_ids, chunk_removals);
+          g_hash_table_remove_all (chunk_changes);
+          g_hash_table_remove_all (chunk_change_ids);
+        }
+    }
 
-    case TP_SUBSCRIPTION_STATE_REMOVED_REMOTELY:
-      return 'R';
+  /* removals fill up whatever space is left in the last chunk of changes */
+  for (i = 0; i < removals->len; i++)
+    {
+      TpHandle handle = g_array_index (removals, TpHandle, i);
 
-    default:
-      return '!';
+      key = GUINT_TO_POINTER (handle);
+      g_array_append_val (chunk_removals, handle);
+      g_hash_table_insert (chunk_removal_ids, key,
+          g_hash_table_lookup (removal_ids, key));
+
+      if (g_hash_table_size (chunk_changes) + chunk_removals->len >= max)
+        {
+          emit_contacts_changed (self, chunk_changes, chunk_change_ids,
+              chunk_removal_ids, chunk_removals);
+          g_hash_table_remove_all (chunk_changes);
+          g_hash_table_remove_all (chunk_change_ids);
+          g_hash_table_remove_all (chunk_removal_ids);
+          g_array_set_size (chunk_removals, 0);
+        }
     }
+
+  if (g_hash_table_size (chunk_changes) > 0 || chunk_removals->len > 0)
+    emit_contacts_changed (self, chunk_changes, chunk_change_ids,
+        chunk_removal_ids, chunk_removals);
+
+  g_hash_table_unref (chunk_changes);
+  g_hash_table_unref (chunk_change_ids);
+  g_hash_table_unref (chunk_removal_ids);
+  g_array_unref (chunk_removals);
 }
 
 /**
@@ -2105,9 +2787,12 @@ tp_base_contact_list_contacts_changed_internal (TpBaseContactList *self,
   /* don't do anything if we're disconnecting, or if we haven't had the
    * initial contact list yet */
   if (tp_base_contact_list_get_state (self, NULL) !=
-      TP_CONTACT_LIST_STATE_SUCCESS)
+      TP_CONTACT_LIST_STATE_SUCCESS ||
+      tp_base_contact_list_ignoring_changes (self))
     return;
 
+  tp_base_contact_list_schedule_snapshot_save (self);
+
   self_handle = tp_base_connection_get_self_handle (self->priv->conn),
 
   sub_chan = (GObject *) self->priv->lists[TP_LIST_HANDLE_SUBSCRIBE];
@@ -2262,6 +2947,9 @@ tp_base_contact_list_contacts_changed_internal (TpBaseContactList *self,
     {
       guint i;
 
+      if (self->priv->contact_groups_index != NULL)
+        group_index_forget_contacts (self, removed);
+
       tp_intset_union_update (unsub, tp_handle_set_peek (removed));
       tp_intset_union_update (unpub, tp_handle_set_peek (removed));
 
@@ -2324,12 +3012,8 @@ tp_base_contact_list_contacts_changed_internal (TpBaseContactList *self,
           g_hash_table_size (changes), removals->len);
 
       if (self->priv->svc_contact_list)
-        {
-          tp_svc_connection_interface_contact_list_emit_contacts_changed_with_id (
-              self->priv->conn, changes, change_ids, removal_ids);
-          tp_svc_connection_interface_contact_list_emit_contacts_changed (
-              self->priv->conn, changes, removals);
-        }
+        emit_contacts_changed_in_chunks (self, changes, change_ids,
+            removal_ids, removals);
     }
 
   tp_intset_destroy (pub);
@@ -2435,7 +3119,8 @@ tp_base_contact_list_contact_blocking_changed (TpBaseContactList *self,
   /* don't do anything if we're disconnecting, or if we haven't had the
    * initial contact list yet */
   if (tp_base_contact_list_get_state (self, NULL) !=
-      TP_CONTACT_LIST_STATE_SUCCESS)
+      TP_CONTACT_LIST_STATE_SUCCESS ||
+      tp_base_contact_list_ignoring_changes (self))
     return;
 
   g_return_if_fail (tp_base_contact_list_can_block (self));
@@ -2521,6 +3206,9 @@ tp_base_contact_list_dup_contacts (TpBaseContactList *self)
   g_return_val_if_fail (tp_base_contact_list_get_state (self, NULL) ==
       TP_CONTACT_LIST_STATE_SUCCESS, NULL);
 
+  if (self->priv->snapshot != NULL)
+    return _tp_contact_list_snapshot_dup_contacts (self->priv->snapshot);
+
   return cls->dup_contacts (self);
 }
 
@@ -2641,7 +3329,18 @@ tp_base_contact_list_dup_states (TpBaseContactList *self,
   g_return_if_fail (tp_base_contact_list_get_state (self, NULL) ==
       TP_CONTACT_LIST_STATE_SUCCESS);
 
-  cls->dup_states (self, contact, subscribe, publish, publish_request);
+  if (self->priv->snapshot != NULL)
+    {
+      _tp_contact_list_snapshot_get_states (self->priv->snapshot, contact,
+          subscribe, publish);
+
+      if (publish_request != NULL)
+        *publish_request = NULL;
+    }
+  else
+    {
+      cls->dup_states (self, contact, subscribe, publish, publish_request);
+    }
 
   if (publish_request != NULL && *publish_request == NULL)
     *publish_request = g_strdup ("");
@@ -3166,6 +3865,25 @@ tp_base_contact_list_get_download_at_connection (TpBaseContactList *self)
   return self->priv->download_at_connection;
 }
 
+/**
+ * tp_base_contact_list_get_max_contacts_per_signal:
+ * @self: a contact list manager
+ *
+ * This function returns the
+ * #TpBaseContactList:max-contacts-per-signal property.
+ *
+ * Returns: the #TpBaseContactList:max-contacts-per-signal property
+ *
+ * Since: 0.UNRELEASED
+ */
+guint
+tp_base_contact_list_get_max_contacts_per_signal (TpBaseContactList *self)
+{
+  g_return_val_if_fail (TP_IS_BASE_CONTACT_LIST (self), 0);
+
+  return self->priv->max_contacts_per_signal;
+}
+
 /**
  * tp_base_contact_list_download_async:
  * @self: a contact list manager
@@ -3693,9 +4411,12 @@ tp_base_contact_list_groups_created (TpBaseContactList *self,
         g_return_if_fail (created[i] != NULL);
     }
 
-  if (self->priv->state != TP_CONTACT_LIST_STATE_SUCCESS)
+  if (self->priv->state != TP_CONTACT_LIST_STATE_SUCCESS ||
+      tp_base_contact_list_ignoring_changes (self))
     return;
 
+  tp_base_contact_list_schedule_snapshot_save (self);
+
   actually_created = g_ptr_array_sized_new (n_created + 1);
 
   for (i = 0; i < n_created; i++)
@@ -3791,9 +4512,12 @@ tp_base_contact_list_groups_removed (TpBaseContactList *self,
         g_return_if_fail (removed[i] != NULL);
     }
 
-  if (self->priv->state != TP_CONTACT_LIST_STATE_SUCCESS)
+  if (self->priv->state != TP_CONTACT_LIST_STATE_SUCCESS ||
+      tp_base_contact_list_ignoring_changes (self))
     return;
 
+  tp_base_contact_list_schedule_snapshot_save (self);
+
   old_members = tp_handle_set_new (self->priv->contact_repo);
   actually_removed = g_ptr_array_new_full (n_removed + 1, g_free);
 
@@ -3840,6 +4564,9 @@ tp_base_contact_list_groups_removed (TpBaseContactList *self,
               g_hash_table_remove (self->priv->groups,
                   GUINT_TO_POINTER (handle));
 
+              if (self->priv->group_members_index != NULL)
+                group_index_forget_group (self, handle);
+
               tp_handle_set_destroy (group_members);
             }
         }
@@ -3912,9 +4639,12 @@ tp_base_contact_list_group_renamed (TpBaseContactList *self,
   g_return_if_fail (TP_IS_BASE_CONTACT_LIST (self));
   g_return_if_fail (TP_IS_CONTACT_GROUP_LIST (self));
 
-  if (self->priv->state != TP_CONTACT_LIST_STATE_SUCCESS)
+  if (self->priv->state != TP_CONTACT_LIST_STATE_SUCCESS ||
+      tp_base_contact_list_ignoring_changes (self))
     return;
 
+  tp_base_contact_list_schedule_snapshot_save (self);
+
   old_handle = tp_handle_ensure (self->priv->group_repo, old_name, NULL, NULL);
 
   if (old_handle == 0)
@@ -3946,6 +4676,12 @@ tp_base_contact_list_group_renamed (TpBaseContactList *self,
 
   old_members = tp_base_contact_list_dup_group_members (self, old_name);
 
+  if (self->priv->group_members_index != NULL)
+    {
+      group_index_forget_group (self, old_handle);
+      group_index_add (self, new_handle, old_members);
+    }
+
   /* move the members - presumably the self-handle is the actor */
   set = tp_handle_set_peek (old_members);
   tp_group_mixin_change_members (new_chan, "", set, NULL, NULL, NULL,
@@ -4079,9 +4815,12 @@ tp_base_contact_list_groups_changed (TpBaseContactList *self,
         g_return_if_fail (removed[i] != NULL);
     }
 
-  if (self->priv->state != TP_CONTACT_LIST_STATE_SUCCESS)
+  if (self->priv->state != TP_CONTACT_LIST_STATE_SUCCESS ||
+      tp_base_contact_list_ignoring_changes (self))
     return;
 
+  tp_base_contact_list_schedule_snapshot_save (self);
+
   DEBUG ("Changing up to %u contacts, adding %" G_GSSIZE_FORMAT
       " groups, removing %" G_GSSIZE_FORMAT,
       tp_handle_set_size (contacts), n_added, n_removed);
@@ -4112,6 +4851,9 @@ tp_base_contact_list_groups_changed (TpBaseContactList *self,
       DEBUG ("Adding %u contacts to group '%s'", tp_handle_set_size (contacts),
           added[i]);
 
+      if (self->priv->group_members_index != NULL)
+        group_index_add (self, handle, contacts);
+
       if (tp_group_mixin_change_members (c, "",
           tp_handle_set_peek (contacts), NULL, NULL, NULL,
           tp_base_connection_get_self_handle (self->priv->conn),
@@ -4138,6 +4880,9 @@ tp_base_contact_list_groups_changed (TpBaseContactList *self,
       DEBUG ("Removing %u contacts from group '%s'",
           tp_handle_set_size (contacts), removed[i]);
 
+      if (self->priv->group_members_index != NULL)
+        group_index_remove (self, handle, contacts);
+
       if (tp_group_mixin_change_members (c, "",
           NULL, tp_handle_set_peek (contacts), NULL, NULL,
           tp_base_connection_get_self_handle (self->priv->conn),
@@ -4299,6 +5044,9 @@ tp_base_contact_list_dup_groups (TpBaseContactList *self)
   g_return_val_if_fail (tp_base_contact_list_get_state (self, NULL) ==
       TP_CONTACT_LIST_STATE_SUCCESS, NULL);
 
+  if (self->priv->snapshot != NULL)
+    return _tp_contact_list_snapshot_dup_groups (self->priv->snapshot);
+
   return iface->dup_groups (self);
 }
 
@@ -4353,6 +5101,34 @@ tp_base_contact_list_dup_contact_groups (TpBaseContactList *self,
   g_return_val_if_fail (tp_base_contact_list_get_state (self, NULL) ==
       TP_CONTACT_LIST_STATE_SUCCESS, NULL);
 
+  if (self->priv->snapshot != NULL)
+    return _tp_contact_list_snapshot_dup_contact_groups (self->priv->snapshot,
+        contact);
+
+  if (self->priv->contact_groups_index != NULL)
+    {
+      TpHandleSet *groups = g_hash_table_lookup (
+          self->priv->contact_groups_index, GUINT_TO_POINTER (contact));
+      GPtrArray *ret;
+      TpIntsetFastIter iter;
+      TpHandle group;
+
+      /* callers such as the ContactGroups attribute expect an array, even
+       * for contacts in no groups */
+      if (groups == NULL)
+        return g_new0 (gchar *, 1);
+
+      ret = g_ptr_array_sized_new (tp_handle_set_size (groups) + 1);
+      tp_intset_fast_iter_init (&iter, tp_handle_set_peek (groups));
+
+      while (tp_intset_fast_iter_next (&iter, &group))
+        g_ptr_array_add (ret,
+            g_strdup (tp_handle_inspect (self->priv->group_repo, group)));
+
+      g_ptr_array_add (ret, NULL);
+      return (GStrv) g_ptr_array_free (ret, FALSE);
+    }
+
   return iface->dup_contact_groups (self, contact);
 }
 
@@ -4401,6 +5177,26 @@ tp_base_contact_list_dup_group_members (TpBaseContactList *self,
   g_return_val_if_fail (tp_base_contact_list_get_state (self, NULL) ==
       TP_CONTACT_LIST_STATE_SUCCESS, NULL);
 
+  if (self->priv->snapshot != NULL)
+    return _tp_contact_list_snapshot_dup_group_members (self->priv->snapshot,
+        group);
+
+  if (self->priv->group_members_index != NULL)
+    {
+      TpHandle handle = tp_handle_lookup (self->priv->group_repo, group, NULL,
+          NULL);
+      TpHandleSet *members = NULL;
+
+      if (handle != 0)
+        members = g_hash_table_lookup (self->priv->group_members_index,
+            GUINT_TO_POINTER (handle));
+
+      if (members == NULL)
+        return tp_handle_set_new (self->priv->contact_repo);
+
+      return tp_handle_set_copy (members);
+    }
+
   return iface->dup_group_members (self, group);
 }
 
@@ -5955,8 +6751,10 @@ tp_base_contact_list_fill_blocking_contact_attributes (GObject *obj,
   g_return_if_fail (TP_IS_BLOCKABLE_CONTACT_LIST (self));
   g_return_if_fail (self->priv->conn != NULL);
 
-  /* just omit the attributes if the contact list hasn't come in yet */
-  if (self->priv->state != TP_CONTACT_LIST_STATE_SUCCESS)
+  /* just omit the attributes if the contact list hasn't come in yet (blocked
+   * contacts are not in the snapshot) */
+  if (self->priv->state != TP_CONTACT_LIST_STATE_SUCCESS ||
+      self->priv->snapshot != NULL)
     return;
 
   blocked = tp_base_contact_list_dup_blocked_contacts (self);
@@ -6038,8 +6836,20 @@ tp_base_contact_list_mixin_request_blocked_contacts (
 
     case TP_CONTACT_LIST_STATE_SUCCESS:
       {
-        TpHandleSet *blocked = tp_base_contact_list_dup_blocked_contacts (self);
-        GHashTable *map = tp_handle_set_to_identifier_map (blocked);
+        TpHandleSet *blocked;
+        GHashTable *map;
+
+        /* blocked contacts aren't in the snapshot, so wait for the real
+         * contact list */
+        if (self->priv->snapshot != NULL)
+          {
+            g_queue_push_tail (&self->priv->blocked_contact_requests,
+                context);
+            break;
+          }
+
+        blocked = tp_base_contact_list_dup_blocked_contacts (self);
+        map = tp_handle_set_to_identifier_map (blocked);
 
         tp_svc_connection_interface_contact_blocking_return_from_request_blocked_contacts (context, map);
 
@@ -72,6 +72,9 @@ TpBaseConnection *tp_base_contact_list_get_connection (
 _TP_AVAILABLE_IN_0_18
 gboolean tp_base_contact_list_get_download_at_connection (
     TpBaseContactList *self);
+_TP_AVAILABLE_IN_UNRELEASED
+guint tp_base_contact_list_get_max_contacts_per_signal (
+    TpBaseContactList *self);
 
 /* ---- Called by subclasses for ContactList (or both) ---- */
 
@@ -72,12 +72,53 @@ enum {
     N_PROPS
 };
 
+/* Answers to the tp_capabilities_supports_*() questions that don't depend on
+ * a service name or an unusual handle type, computed when the object is
+ * constructed. The _CONTACT, _ROOM and _NONE variants of a flag must be
+ * consecutive, in that order; see handle_type_shift(). */
+typedef enum {
+    SUPPORTS_TEXT_CHATS = 1 << 0,
+    SUPPORTS_TEXT_CHATROOMS = 1 << 1,
+    SUPPORTS_SMS = 1 << 2,
+    SUPPORTS_AUDIO_CALL_CONTACT = 1 << 3,
+    SUPPORTS_AUDIO_CALL_ROOM = 1 << 4,
+    SUPPORTS_AUDIO_CALL_NONE = 1 << 5,
+    SUPPORTS_AUDIO_VIDEO_CALL_CONTACT = 1 << 6,
+    SUPPORTS_AUDIO_VIDEO_CALL_ROOM = 1 << 7,
+    SUPPORTS_AUDIO_VIDEO_CALL_NONE = 1 << 8,
+    SUPPORTS_FILE_TRANSFER = 1 << 9,
+    SUPPORTS_FILE_TRANSFER_URI = 1 << 10,
+    SUPPORTS_FILE_TRANSFER_DESCRIPTION = 1 << 11,
+    SUPPORTS_FILE_TRANSFER_INITIAL_OFFSET = 1 << 12,
+    SUPPORTS_FILE_TRANSFER_TIMESTAMP = 1 << 13,
+    SUPPORTS_STREAM_TUBES_CONTACT = 1 << 14,
+    SUPPORTS_STREAM_TUBES_ROOM = 1 << 15,
+    SUPPORTS_DBUS_TUBES_CONTACT = 1 << 16,
+    SUPPORTS_DBUS_TUBES_ROOM = 1 << 17,
+    SUPPORTS_CONTACT_SEARCH = 1 << 18,
+    SUPPORTS_CONTACT_SEARCH_WITH_LIMIT = 1 << 19,
+    SUPPORTS_CONTACT_SEARCH_WITH_SERVER = 1 << 20,
+    SUPPORTS_ROOM_LIST = 1 << 21,
+    SUPPORTS_ROOM_LIST_WITH_SERVER = 1 << 22,
+} SupportsFlags;
+
 struct _TpCapabilitiesPrivate {
     GPtrArray *classes;
     gboolean contact_specific;
     GVariant *classes_variant;
+    SupportsFlags supports;
+    /* if not NULL, our key in capabilities_cache */
+    GBytes *cache_key;
 };
 
+/* serialized channel classes (owned GBytes) => borrowed TpCapabilities,
+ * for objects created by _tp_capabilities_new(); one table for
+ * contact-specific capabilities and one for the others. Like the rest of
+ * telepathy-glib, this is only used from the main thread. */
+static GHashTable *capabilities_cache[2] = { NULL, NULL };
+
+static void precompute_supports (TpCapabilities *self);
+
 /**
  * tp_capabilities_get_channel_classes:
  * @self: a #TpCapabilities object
@@ -126,6 +167,8 @@ tp_capabilities_constructed (GObject *object)
 
   if (chain_up != NULL)
     chain_up (object);
+
+  precompute_supports (self);
 }
 
 static void
@@ -133,6 +176,16 @@ tp_capabilities_dispose (GObject *object)
 {
   TpCapabilities *self = TP_CAPABILITIES (object);
 
+  if (self->priv->cache_key != NULL)
+    {
+      GHashTable *cache = capabilities_cache[self->priv->contact_specific];
+
+      if (g_hash_table_lookup (cache, self->priv->cache_key) == self)
+        g_hash_table_remove (cache, self->priv->cache_key);
+
+      tp_clear_pointer (&self->priv->cache_key, g_bytes_unref);
+    }
+
   if (self->priv->classes != NULL)
     {
       g_boxed_free (TP_ARRAY_TYPE_REQUESTABLE_CHANNEL_CLASS_LIST,
@@ -284,13 +337,23 @@ tp_capabilities_init (TpCapabilities *self)
       TpCapabilitiesPrivate);
 }
 
-/* NULL-safe for @classes */
+/* NULL-safe for @classes.
+ *
+ * TpCapabilities objects are immutable, and most contacts have the same
+ * capabilities as many others, so this returns a new reference to an existing
+ * object with the same channel classes if there is one. */
 TpCapabilities *
 _tp_capabilities_new (const GPtrArray *classes,
     gboolean contact_specific)
 {
   GPtrArray *empty = NULL;
   TpCapabilities *self;
+  GVariant *variant;
+  GBytes *key;
+  GHashTable **cache;
+
+  contact_specific = (contact_specific != FALSE);
+  cache = &capabilities_cache[contact_specific];
 
   if (classes == NULL)
     {
@@ -298,17 +361,57 @@ _tp_capabilities_new (const GPtrArray *classes,
       classes = empty;
     }
 
+  variant = _tp_boxed_to_variant (TP_ARRAY_TYPE_REQUESTABLE_CHANNEL_CLASS_LIST,
+      "a(a{sv}as)", (gpointer) classes);
+  key = g_variant_get_data_as_bytes (variant);
+  g_variant_unref (variant);
+
+  if (*cache == NULL)
+    *cache = g_hash_table_new_full (g_bytes_hash, g_bytes_equal,
+        (GDestroyNotify) g_bytes_unref, NULL);
+
+  self = g_hash_table_lookup (*cache, key);
+
+  if (self != NULL)
+    {
+      g_object_ref (self);
+      g_bytes_unref (key);
+      goto finally;
+    }
+
   self = g_object_new (TP_TYPE_CAPABILITIES,
       "channel-classes", classes,
       "contact-specific", contact_specific,
       NULL);
 
+  self->priv->cache_key = key;
+  g_hash_table_insert (*cache, g_bytes_ref (key), self);
+
+finally:
   if (empty != NULL)
     g_ptr_array_unref (empty);
 
   return self;
 }
 
+/* Returns how far to shift a _CONTACT flag to get the corresponding flag
+ * for @handle_type, or -1 if that handle type isn't precomputed */
+static gint
+handle_type_shift (TpHandleType handle_type)
+{
+  switch (handle_type)
+    {
+      case TP_HANDLE_TYPE_CONTACT:
+        return 0;
+      case TP_HANDLE_TYPE_ROOM:
+        return 1;
+      case TP_HANDLE_TYPE_NONE:
+        return 2;
+      default:
+        return -1;
+    }
+}
+
 static gboolean
 supports_simple_channel (TpCapabilities *self,
     const gchar *expected_chan_type,
@@ -371,8 +474,9 @@ supports_simple_channel (TpCapabilities *self,
 gboolean
 tp_capabilities_supports_text_chats (TpCapabilities *self)
 {
-  return supports_simple_channel (self, TP_IFACE_CHANNEL_TYPE_TEXT,
-      TP_HANDLE_TYPE_CONTACT);
+  g_return_val_if_fail (TP_IS_CAPABILITIES (self), FALSE);
+
+  return (self->priv->supports & SUPPORTS_TEXT_CHATS) != 0;
 }
 
 /**
@@ -402,8 +506,9 @@ tp_capabilities_supports_text_chats (TpCapabilities *self)
 gboolean
 tp_capabilities_supports_text_chatrooms (TpCapabilities *self)
 {
-  return supports_simple_channel (self, TP_IFACE_CHANNEL_TYPE_TEXT,
-      TP_HANDLE_TYPE_ROOM);
+  g_return_val_if_fail (TP_IS_CAPABILITIES (self), FALSE);
+
+  return (self->priv->supports & SUPPORTS_TEXT_CHATROOMS) != 0;
 }
 
 /**
@@ -428,10 +533,16 @@ tp_capabilities_supports_text_chatrooms (TpCapabilities *self)
 gboolean
 tp_capabilities_supports_sms (TpCapabilities *self)
 {
-  guint i;
-
   g_return_val_if_fail (TP_IS_CAPABILITIES (self), FALSE);
 
+  return (self->priv->supports & SUPPORTS_SMS) != 0;
+}
+
+static gboolean
+supports_sms (TpCapabilities *self)
+{
+  guint i;
+
   for (i = 0; i < self->priv->classes->len; i++)
     {
       GValueArray *arr = g_ptr_array_index (self->priv->classes, i);
@@ -581,7 +692,14 @@ gboolean
 tp_capabilities_supports_audio_call (TpCapabilities *self,
     TpHandleType handle_type)
 {
-  return supports_call_full (self, handle_type, TRUE, FALSE);
+  gint shift = handle_type_shift (handle_type);
+
+  g_return_val_if_fail (TP_IS_CAPABILITIES (self), FALSE);
+
+  if (shift < 0)
+    return supports_call_full (self, handle_type, TRUE, FALSE);
+
+  return (self->priv->supports & (SUPPORTS_AUDIO_CALL_CONTACT << shift)) != 0;
 }
 
 /**
@@ -611,7 +729,15 @@ gboolean
 tp_capabilities_supports_audio_video_call (TpCapabilities *self,
     TpHandleType handle_type)
 {
-  return supports_call_full (self, handle_type, TRUE, TRUE);
+  gint shift = handle_type_shift (handle_type);
+
+  g_return_val_if_fail (TP_IS_CAPABILITIES (self), FALSE);
+
+  if (shift < 0)
+    return supports_call_full (self, handle_type, TRUE, TRUE);
+
+  return (self->priv->supports &
+      (SUPPORTS_AUDIO_VIDEO_CALL_CONTACT << shift)) != 0;
 }
 
 typedef enum {
@@ -719,7 +845,9 @@ supports_file_transfer (TpCapabilities *self,
 gboolean
 tp_capabilities_supports_file_transfer (TpCapabilities *self)
 {
-  return supports_file_transfer (self, FT_CAP_FLAGS_NONE);
+  g_return_val_if_fail (TP_IS_CAPABILITIES (self), FALSE);
+
+  return (self->priv->supports & SUPPORTS_FILE_TRANSFER) != 0;
 }
 
 /**
@@ -737,7 +865,9 @@ tp_capabilities_supports_file_transfer (TpCapabilities *self)
 gboolean
 tp_capabilities_supports_file_transfer_uri (TpCapabilities *self)
 {
-  return supports_file_transfer (self, FT_CAP_FLAG_URI);
+  g_return_val_if_fail (TP_IS_CAPABILITIES (self), FALSE);
+
+  return (self->priv->supports & SUPPORTS_FILE_TRANSFER_URI) != 0;
 }
 
 /**
@@ -755,7 +885,9 @@ tp_capabilities_supports_file_transfer_uri (TpCapabilities *self)
 gboolean
 tp_capabilities_supports_file_transfer_description (TpCapabilities *self)
 {
-  return supports_file_transfer (self, FT_CAP_FLAG_DESCRIPTION);
+  g_return_val_if_fail (TP_IS_CAPABILITIES (self), FALSE);
+
+  return (self->priv->supports & SUPPORTS_FILE_TRANSFER_DESCRIPTION) != 0;
 }
 
 /**
@@ -775,7 +907,9 @@ tp_capabilities_supports_file_transfer_description (TpCapabilities *self)
 gboolean
 tp_capabilities_supports_file_transfer_initial_offset (TpCapabilities *self)
 {
-  return supports_file_transfer (self, FT_CAP_FLAG_OFFSET);
+  g_return_val_if_fail (TP_IS_CAPABILITIES (self), FALSE);
+
+  return (self->priv->supports & SUPPORTS_FILE_TRANSFER_INITIAL_OFFSET) != 0;
 }
 
 /**
@@ -793,7 +927,9 @@ tp_capabilities_supports_file_transfer_initial_offset (TpCapabilities *self)
 gboolean
 tp_capabilities_supports_file_transfer_timestamp (TpCapabilities *self)
 {
-  return supports_file_transfer (self, FT_CAP_FLAG_DATE);
+  g_return_val_if_fail (TP_IS_CAPABILITIES (self), FALSE);
+
+  return (self->priv->supports & SUPPORTS_FILE_TRANSFER_TIMESTAMP) != 0;
 }
 
 static gboolean
@@ -876,6 +1012,16 @@ tp_capabilities_supports_stream_tubes (TpCapabilities *self,
     TpHandleType handle_type,
     const gchar *service)
 {
+  g_return_val_if_fail (TP_IS_CAPABILITIES (self), FALSE);
+
+  /* the service is only checked for contacts' capabilities */
+  if ((service == NULL || !self->priv->contact_specific) &&
+      (handle_type == TP_HANDLE_TYPE_CONTACT ||
+       handle_type == TP_HANDLE_TYPE_ROOM))
+    return (self->priv->supports &
+        (SUPPORTS_STREAM_TUBES_CONTACT << handle_type_shift (handle_type)))
+      != 0;
+
   return tp_capabilities_supports_tubes_common (self,
       TP_IFACE_CHANNEL_TYPE_STREAM_TUBE, handle_type,
       TP_PROP_CHANNEL_TYPE_STREAM_TUBE_SERVICE, service);
@@ -909,6 +1055,15 @@ tp_capabilities_supports_dbus_tubes (TpCapabilities *self,
     TpHandleType handle_type,
     const gchar *service_name)
 {
+  g_return_val_if_fail (TP_IS_CAPABILITIES (self), FALSE);
+
+  if ((service_name == NULL || !self->priv->contact_specific) &&
+      (handle_type == TP_HANDLE_TYPE_CONTACT ||
+       handle_type == TP_HANDLE_TYPE_ROOM))
+    return (self->priv->supports &
+        (SUPPORTS_DBUS_TUBES_CONTACT << handle_type_shift (handle_type)))
+      != 0;
+
   return tp_capabilities_supports_tubes_common (self,
       TP_IFACE_CHANNEL_TYPE_DBUS_TUBE, handle_type,
       TP_PROP_CHANNEL_TYPE_DBUS_TUBE_SERVICE_NAME, service_name);
@@ -937,12 +1092,28 @@ gboolean
 tp_capabilities_supports_contact_search (TpCapabilities *self,
     gboolean *with_limit,
     gboolean *with_server)
+{
+  g_return_val_if_fail (TP_IS_CAPABILITIES (self), FALSE);
+
+  if (with_limit != NULL)
+    *with_limit = (self->priv->supports &
+        SUPPORTS_CONTACT_SEARCH_WITH_LIMIT) != 0;
+
+  if (with_server != NULL)
+    *with_server = (self->priv->supports &
+        SUPPORTS_CONTACT_SEARCH_WITH_SERVER) != 0;
+
+  return (self->priv->supports & SUPPORTS_CONTACT_SEARCH) != 0;
+}
+
+static gboolean
+supports_contact_search (TpCapabilities *self,
+    gboolean *with_limit,
+    gboolean *with_server)
 {
   gboolean ret = FALSE;
   guint i, j;
 
-  g_return_val_if_fail (TP_IS_CAPABILITIES (self), FALSE);
-
   if (with_limit)
     *with_limit = FALSE;
 
@@ -1043,6 +1214,19 @@ tp_capabilities_supports_contact_search (TpCapabilities *self,
 gboolean
 tp_capabilities_supports_room_list (TpCapabilities *self,
     gboolean *with_server)
+{
+  g_return_val_if_fail (TP_IS_CAPABILITIES (self), FALSE);
+
+  if (with_server != NULL)
+    *with_server = (self->priv->supports &
+        SUPPORTS_ROOM_LIST_WITH_SERVER) != 0;
+
+  return (self->priv->supports & SUPPORTS_ROOM_LIST) != 0;
+}
+
+static gboolean
+supports_room_list (TpCapabilities *self,
+    gboolean *with_server)
 {
   gboolean result = FALSE;
   gboolean server = FALSE;
@@ -1084,6 +1268,84 @@ tp_capabilities_supports_room_list (TpCapabilities *self,
   return result;
 }
 
+static void
+precompute_supports (TpCapabilities *self)
+{
+  static const TpHandleType call_handle_types[] = { TP_HANDLE_TYPE_CONTACT,
+      TP_HANDLE_TYPE_ROOM, TP_HANDLE_TYPE_NONE };
+  SupportsFlags supports = 0;
+  gboolean with_limit, with_server;
+  guint i;
+
+  if (supports_simple_channel (self, TP_IFACE_CHANNEL_TYPE_TEXT,
+        TP_HANDLE_TYPE_CONTACT))
+    supports |= SUPPORTS_TEXT_CHATS;
+
+  if (supports_simple_channel (self, TP_IFACE_CHANNEL_TYPE_TEXT,
+        TP_HANDLE_TYPE_ROOM))
+    supports |= SUPPORTS_TEXT_CHATROOMS;
+
+  if (supports_sms (self))
+    supports |= SUPPORTS_SMS;
+
+  for (i = 0; i < G_N_ELEMENTS (call_handle_types); i++)
+    {
+      gint shift = handle_type_shift (call_handle_types[i]);
+
+      if (supports_call_full (self, call_handle_types[i], TRUE, FALSE))
+        supports |= SUPPORTS_AUDIO_CALL_CONTACT << shift;
+
+      if (supports_call_full (self, call_handle_types[i], TRUE, TRUE))
+        supports |= SUPPORTS_AUDIO_VIDEO_CALL_CONTACT << shift;
+    }
+
+  if (supports_file_transfer (self, FT_CAP_FLAGS_NONE))
+    supports |= SUPPORTS_FILE_TRANSFER;
+
+  if (supports_file_transfer (self, FT_CAP_FLAG_URI))
+    supports |= SUPPORTS_FILE_TRANSFER_URI;
+
+  if (supports_file_transfer (self, FT_CAP_FLAG_DESCRIPTION))
+    supports |= SUPPORTS_FILE_TRANSFER_DESCRIPTION;
+
+  if (supports_file_transfer (self, FT_CAP_FLAG_OFFSET))
+    supports |= SUPPORTS_FILE_TRANSFER_INITIAL_OFFSET;
+
+  if (supports_file_transfer (self, FT_CAP_FLAG_DATE))
+    supports |= SUPPORTS_FILE_TRANSFER_TIMESTAMP;
+
+  /* tubes are only meaningful for contacts and rooms */
+  for (i = 0; i < 2; i++)
+    {
+      if (tp_capabilities_supports_tubes_common (self,
+            TP_IFACE_CHANNEL_TYPE_STREAM_TUBE, call_handle_types[i],
+            TP_PROP_CHANNEL_TYPE_STREAM_TUBE_SERVICE, NULL))
+        supports |= SUPPORTS_STREAM_TUBES_CONTACT << i;
+
+      if (tp_capabilities_supports_tubes_common (self,
+            TP_IFACE_CHANNEL_TYPE_DBUS_TUBE, call_handle_types[i],
+            TP_PROP_CHANNEL_TYPE_DBUS_TUBE_SERVICE_NAME, NULL))
+        supports |= SUPPORTS_DBUS_TUBES_CONTACT << i;
+    }
+
+  if (supports_contact_search (self, &with_limit, &with_server))
+    supports |= SUPPORTS_CONTACT_SEARCH;
+
+  if (with_limit)
+    supports |= SUPPORTS_CONTACT_SEARCH_WITH_LIMIT;
+
+  if (with_server)
+    supports |= SUPPORTS_CONTACT_SEARCH_WITH_SERVER;
+
+  if (supports_room_list (self, &with_server))
+    supports |= SUPPORTS_ROOM_LIST;
+
+  if (with_server)
+    supports |= SUPPORTS_ROOM_LIST_WITH_SERVER;
+
+  self->priv->supports = supports;
+}
+
 /**
  * tp_capabilities_dup_channel_classes_variant:
  * @self: a #TpCapabilities
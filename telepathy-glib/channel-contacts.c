@@ -110,6 +110,40 @@ dup_contacts_table (TpChannel *self,
   return target;
 }
 
+static void
+add_to_ids_table (GHashTable *target,
+    TpHandle handle,
+    GHashTable *identifiers)
+{
+  const gchar *id;
+
+  id = g_hash_table_lookup (identifiers, GUINT_TO_POINTER (handle));
+  if (id == NULL)
+    {
+      DEBUG ("Missing identifier for handle %u - broken CM", handle);
+      return;
+    }
+
+  g_hash_table_insert (target, GUINT_TO_POINTER (handle), g_strdup (id));
+}
+
+static GHashTable *
+dup_ids_table (TpIntset *source,
+    GHashTable *identifiers)
+{
+  GHashTable *target;
+  TpIntsetFastIter iter;
+  TpHandle handle;
+
+  target = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+
+  tp_intset_fast_iter_init (&iter, source);
+  while (tp_intset_fast_iter_next (&iter, &handle))
+    add_to_ids_table (target, handle, identifiers);
+
+  return target;
+}
+
 /* self->priv->group_contact_owners may contain NULL TpContact and
  * g_object_unref isn't NULL safe */
 static void
@@ -212,8 +246,22 @@ _tp_channel_contacts_group_init (TpChannel *self,
   self->priv->group_self_contact = dup_contact (self,
       self->priv->group_self_handle, identifiers);
 
-  self->priv->group_members_contacts = dup_contacts_table (self,
-      self->priv->group_members, identifiers);
+  self->priv->group_members_lazy =
+      tp_simple_client_factory_get_lazy_group_members (
+          tp_proxy_get_factory (self->priv->connection));
+
+  if (self->priv->group_members_lazy)
+    {
+      self->priv->group_members_contacts = g_hash_table_new_full (NULL, NULL,
+          NULL, g_object_unref);
+      self->priv->group_members_ids = dup_ids_table (
+          self->priv->group_members, identifiers);
+    }
+  else
+    {
+      self->priv->group_members_contacts = dup_contacts_table (self,
+          self->priv->group_members, identifiers);
+    }
 
   self->priv->group_local_pending_contacts = dup_contacts_table (self,
       self->priv->group_local_pending, identifiers);
@@ -514,9 +562,101 @@ _tp_channel_contacts_queue_prepare_finish (TpChannel *self,
   return TRUE;
 }
 
+static void
+lazy_members_prepared_cb (GObject *object,
+    GAsyncResult *result,
+    gpointer user_data)
+{
+  TpChannel *self = (TpChannel *) object;
+  GError *error = NULL;
+
+  if (!_tp_channel_contacts_queue_prepare_finish (self, result, NULL, &error))
+    {
+      DEBUG ("Failed to prepare members: %s", error->message);
+      g_clear_error (&error);
+    }
+}
+
+static gboolean
+prepare_lazy_members_cb (gpointer user_data)
+{
+  TpChannel *self = user_data;
+  GPtrArray *contacts = self->priv->group_members_to_prepare;
+
+  self->priv->group_members_to_prepare = NULL;
+  self->priv->group_members_prepare_source = 0;
+
+  DEBUG ("%p: preparing %u members", self, contacts->len);
+
+  _tp_channel_contacts_queue_prepare_async (self, contacts,
+      lazy_members_prepared_cb, NULL);
+
+  g_ptr_array_unref (contacts);
+
+  return FALSE;
+}
+
+/* Create the TpContact for a member which only has an identifier so far.
+ * The contact's features are prepared later, together with any other
+ * member materialised during this main loop iteration. */
+static TpContact *
+materialise_member (TpChannel *self,
+    TpHandle handle)
+{
+  gpointer key = GUINT_TO_POINTER (handle);
+  const gchar *id;
+  TpContact *contact;
+
+  id = g_hash_table_lookup (self->priv->group_members_ids, key);
+  if (id == NULL)
+    return NULL;
+
+  contact = tp_simple_client_factory_ensure_contact (
+      tp_proxy_get_factory (self->priv->connection), self->priv->connection,
+      handle, id);
+
+  g_hash_table_insert (self->priv->group_members_contacts, key,
+      g_object_ref (contact));
+  g_hash_table_remove (self->priv->group_members_ids, key);
+
+  if (self->priv->group_members_to_prepare == NULL)
+    self->priv->group_members_to_prepare = g_ptr_array_new_with_free_func (
+        g_object_unref);
+
+  g_ptr_array_add (self->priv->group_members_to_prepare,
+      g_object_ref (contact));
+
+  if (self->priv->group_members_prepare_source == 0)
+    self->priv->group_members_prepare_source = g_idle_add (
+        prepare_lazy_members_cb, self);
+
+  return contact;
+}
+
+/* Return a new ref to the TpContact we already have for @handle, if any */
+static TpContact *
+dup_known_contact (TpChannel *self,
+    TpHandle handle)
+{
+  gpointer key = GUINT_TO_POINTER (handle);
+  TpContact *contact;
+
+  contact = g_hash_table_lookup (self->priv->group_members_contacts, key);
+  if (contact == NULL)
+    contact = g_hash_table_lookup (self->priv->group_local_pending_contacts,
+        key);
+  if (contact == NULL)
+    contact = g_hash_table_lookup (self->priv->group_remote_pending_contacts,
+        key);
+
+  return safe_g_object_ref (contact);
+}
+
 typedef struct
 {
   GPtrArray *added;
+  /* TpHandle -> owned identifier, for lazily added members */
+  GHashTable *lazy_added;
   GArray *removed;
   GPtrArray *local_pending;
   GPtrArray *remote_pending;
@@ -528,6 +668,7 @@ static void
 members_changed_data_free (MembersChangedData *data)
 {
   tp_clear_pointer (&data->added, g_ptr_array_unref);
+  tp_clear_pointer (&data->lazy_added, g_hash_table_unref);
   tp_clear_pointer (&data->removed, g_array_unref);
   tp_clear_pointer (&data->local_pending, g_ptr_array_unref);
   tp_clear_pointer (&data->remote_pending, g_ptr_array_unref);
@@ -545,6 +686,8 @@ members_changed_prepared_cb (GObject *object,
   TpChannel *self = (TpChannel *) object;
   MembersChangedData *data = user_data;
   GPtrArray *removed;
+  GHashTableIter iter;
+  gpointer key, value;
   guint i;
 
   _tp_channel_contacts_queue_prepare_finish (self, result, NULL, NULL);
@@ -556,9 +699,10 @@ members_changed_prepared_cb (GObject *object,
   for (i = 0; i < data->removed->len; i++)
     {
       TpHandle handle = g_array_index (data->removed, TpHandle, i);
-      gpointer key = GUINT_TO_POINTER (handle);
       TpContact *contact;
 
+      key = GUINT_TO_POINTER (handle);
+
       contact = g_hash_table_lookup (self->priv->group_members_contacts, key);
       if (contact == NULL)
           contact = g_hash_table_lookup (
@@ -567,6 +711,12 @@ members_changed_prepared_cb (GObject *object,
           contact = g_hash_table_lookup (
               self->priv->group_remote_pending_contacts, key);
 
+      /* a lazy member that nobody asked about is simply forgotten */
+      if (self->priv->group_members_ids != NULL &&
+          g_hash_table_remove (self->priv->group_members_ids, key) &&
+          contact == NULL)
+        continue;
+
       if (contact == NULL)
         {
           DEBUG ("Handle %u removed but not found in our tables - broken CM",
@@ -584,7 +734,8 @@ members_changed_prepared_cb (GObject *object,
   for (i = 0; i < data->added->len; i++)
     {
       TpContact *contact = g_ptr_array_index (data->added, i);
-      gpointer key = GUINT_TO_POINTER (tp_contact_get_handle (contact));
+
+      key = GUINT_TO_POINTER (tp_contact_get_handle (contact));
 
       g_hash_table_insert (self->priv->group_members_contacts, key,
           g_object_ref (contact));
@@ -592,10 +743,26 @@ members_changed_prepared_cb (GObject *object,
       g_hash_table_remove (self->priv->group_remote_pending_contacts, key);
     }
 
+  if (data->lazy_added != NULL)
+    {
+      g_hash_table_iter_init (&iter, data->lazy_added);
+      while (g_hash_table_iter_next (&iter, &key, &value))
+        {
+          g_hash_table_insert (self->priv->group_members_ids, key,
+              g_strdup (value));
+          g_hash_table_remove (self->priv->group_local_pending_contacts, key);
+          g_hash_table_remove (self->priv->group_remote_pending_contacts, key);
+        }
+    }
+
   for (i = 0; i < data->local_pending->len; i++)
     {
       TpContact *contact = g_ptr_array_index (data->local_pending, i);
-      gpointer key = GUINT_TO_POINTER (tp_contact_get_handle (contact));
+
+      key = GUINT_TO_POINTER (tp_contact_get_handle (contact));
+
+      if (self->priv->group_members_ids != NULL)
+        g_hash_table_remove (self->priv->group_members_ids, key);
 
       g_hash_table_remove (self->priv->group_members_contacts, key);
       g_hash_table_insert (self->priv->group_local_pending_contacts, key,
@@ -615,7 +782,11 @@ members_changed_prepared_cb (GObject *object,
   for (i = 0; i < data->remote_pending->len; i++)
     {
       TpContact *contact = g_ptr_array_index (data->remote_pending, i);
-      gpointer key = GUINT_TO_POINTER (tp_contact_get_handle (contact));
+
+      key = GUINT_TO_POINTER (tp_contact_get_handle (contact));
+
+      if (self->priv->group_members_ids != NULL)
+        g_hash_table_remove (self->priv->group_members_ids, key);
 
       g_hash_table_remove (self->priv->group_members_contacts, key);
       g_hash_table_remove (self->priv->group_local_pending_contacts, key);
@@ -663,7 +834,33 @@ _tp_channel_contacts_members_changed (TpChannel *self,
   /* Ensure all TpContact, and push to a queue. This is to ensure that signals
    * does not get reordered while we prepare them. */
   data = g_slice_new (MembersChangedData);
-  data->added = dup_contact_array (self, added, ids);
+  data->lazy_added = NULL;
+
+  if (self->priv->group_members_lazy)
+    {
+      guint i;
+
+      /* Only reuse the TpContact objects we already have; other members
+       * just get their identifier remembered */
+      data->added = g_ptr_array_new_full (0, g_object_unref);
+      data->lazy_added = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+
+      for (i = 0; i < added->len; i++)
+        {
+          TpHandle handle = g_array_index (added, TpHandle, i);
+          TpContact *contact = dup_known_contact (self, handle);
+
+          if (contact != NULL)
+            g_ptr_array_add (data->added, contact);
+          else if (ids != NULL)
+            add_to_ids_table (data->lazy_added, handle, ids);
+        }
+    }
+  else
+    {
+      data->added = dup_contact_array (self, added, ids);
+    }
+
   data->removed = dup_handle_array (removed);
   data->local_pending = dup_contact_array (self, local_pending, ids);
   data->remote_pending = dup_contact_array (self, remote_pending, ids);
@@ -849,6 +1046,16 @@ tp_channel_group_get_self_contact (TpChannel *self)
  *
  * If @self is not a group, return %NULL.
  *
+ * If tp_simple_client_factory_set_lazy_group_members() was used, this
+ * creates a #TpContact for every member which did not have one yet, and
+ * those contacts do not have the features from
+ * tp_simple_client_factory_dup_contact_features() prepared when this
+ * function returns: they are only prepared later, in the background. To
+ * wait for them, pass the result to
+ * tp_simple_client_factory_upgrade_contacts_async(). In a large room,
+ * tp_channel_group_dup_member_contact_by_handle() is cheaper if only a few
+ * members are needed.
+ *
  * Returns: (transfer container) (type GLib.PtrArray) (element-type TelepathyGLib.Contact):
  *  a new #GPtrArray of #TpContact, free it with g_ptr_array_unref(), or %NULL.
  *
@@ -859,9 +1066,78 @@ tp_channel_group_dup_members_contacts (TpChannel *self)
 {
   g_return_val_if_fail (TP_IS_CHANNEL (self), NULL);
 
+  if (self->priv->group_members_ids != NULL)
+    {
+      GHashTableIter iter;
+      gpointer key;
+      GArray *handles;
+      guint i;
+
+      /* materialise_member() modifies group_members_ids */
+      handles = g_array_sized_new (FALSE, FALSE, sizeof (TpHandle),
+          g_hash_table_size (self->priv->group_members_ids));
+
+      g_hash_table_iter_init (&iter, self->priv->group_members_ids);
+      while (g_hash_table_iter_next (&iter, &key, NULL))
+        {
+          TpHandle handle = GPOINTER_TO_UINT (key);
+
+          g_array_append_val (handles, handle);
+        }
+
+      for (i = 0; i < handles->len; i++)
+        g_object_unref (materialise_member (self,
+              g_array_index (handles, TpHandle, i)));
+
+      g_array_unref (handles);
+    }
+
   return _tp_contacts_from_values (self->priv->group_members_contacts);
 }
 
+/**
+ * tp_channel_group_dup_member_contact_by_handle:
+ * @self: a channel
+ * @handle: the handle of a member of @self
+ *
+ * If @self is a group, %TP_CHANNEL_FEATURE_CONTACTS has been prepared
+ * and @handle is one of its members, return the corresponding #TpContact.
+ * Otherwise, return %NULL.
+ *
+ * This is mainly useful if tp_simple_client_factory_set_lazy_group_members()
+ * was used, in which case the #TpContact is only created when it is first
+ * requested, and the contact features from
+ * tp_simple_client_factory_dup_contact_features() are prepared
+ * asynchronously, together with any other members requested during
+ * the same main loop iteration.
+ *
+ * Returns: (transfer full): a new reference to a #TpContact, or %NULL
+ *
+ * Since: 0.UNRELEASED
+ */
+TpContact *
+tp_channel_group_dup_member_contact_by_handle (TpChannel *self,
+    TpHandle handle)
+{
+  TpContact *contact;
+
+  g_return_val_if_fail (TP_IS_CHANNEL (self), NULL);
+
+  if (self->priv->group_members_contacts == NULL)
+    return NULL;
+
+  contact = g_hash_table_lookup (self->priv->group_members_contacts,
+      GUINT_TO_POINTER (handle));
+
+  if (contact != NULL)
+    return g_object_ref (contact);
+
+  if (self->priv->group_members_ids != NULL)
+    return materialise_member (self, handle);
+
+  return NULL;
+}
+
 /**
  * tp_channel_group_dup_local_pending_contacts:
  * @self: a channel
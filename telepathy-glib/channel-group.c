@@ -27,6 +27,7 @@
 #include <telepathy-glib/gtypes.h>
 #include <telepathy-glib/interfaces.h>
 #include <telepathy-glib/proxy-subclass.h>
+#include <telepathy-glib/simple-client-factory.h>
 #include <telepathy-glib/util.h>
 
 #define DEBUG_FLAG TP_DEBUG_GROUPS
@@ -697,6 +698,97 @@ _tp_channel_glpmwi_0_16 (TpChannel *self)
       self, -1, tp_channel_glpmwi_0_16_cb, NULL, NULL, NULL);
 }
 
+static gboolean _tp_channel_group_report_backlog_cb (gpointer user_data);
+
+void
+_tp_channel_group_clear_backlog (TpChannel *self)
+{
+  if (self->priv->group_members_backlog_source != 0)
+    {
+      g_source_remove (self->priv->group_members_backlog_source);
+      self->priv->group_members_backlog_source = 0;
+    }
+
+  tp_clear_pointer (&self->priv->group_members_backlog, tp_intset_destroy);
+  tp_clear_pointer (&self->priv->group_members_backlog_ids,
+      g_hash_table_unref);
+}
+
+/* Move all but the first @batch_size members into the backlog, from which
+ * they will be reported later by _tp_channel_group_report_backlog_cb() */
+static void
+_tp_channel_group_defer_members (TpChannel *self,
+    guint batch_size,
+    GHashTable *identifiers)
+{
+  TpIntsetFastIter iter;
+  TpHandle handle;
+  guint kept = 0;
+
+  g_assert (self->priv->group_members_backlog == NULL);
+
+  self->priv->group_members_backlog = tp_intset_new ();
+  self->priv->group_members_backlog_ids = g_hash_table_new_full (NULL, NULL,
+      NULL, g_free);
+  self->priv->group_members_batch_size = batch_size;
+
+  tp_intset_fast_iter_init (&iter, self->priv->group_members);
+  while (tp_intset_fast_iter_next (&iter, &handle))
+    {
+      const gchar *id;
+
+      /* always report ourselves straight away */
+      if (handle == self->priv->group_self_handle)
+        continue;
+
+      if (kept < batch_size)
+        {
+          kept++;
+          continue;
+        }
+
+      tp_intset_add (self->priv->group_members_backlog, handle);
+
+      if (identifiers == NULL)
+        continue;
+
+      id = g_hash_table_lookup (identifiers, GUINT_TO_POINTER (handle));
+
+      if (id != NULL)
+        g_hash_table_insert (self->priv->group_members_backlog_ids,
+            GUINT_TO_POINTER (handle), g_strdup (id));
+    }
+
+  tp_intset_difference_update (self->priv->group_members,
+      self->priv->group_members_backlog);
+
+  DEBUG ("%p: reporting %u members now, and %u later", self,
+      tp_intset_size (self->priv->group_members),
+      tp_intset_size (self->priv->group_members_backlog));
+}
+
+/* The CM has told us something newer about these handles, so we must not
+ * report them from the backlog. If @reported is not NULL, the handles
+ * which were not in the backlog are appended to it. */
+static void
+_tp_channel_group_forget_backlog (TpChannel *self,
+    const GArray *handles,
+    GArray *reported)
+{
+  guint i;
+
+  for (i = 0; i < handles->len; i++)
+    {
+      TpHandle handle = g_array_index (handles, TpHandle, i);
+
+      if (tp_intset_remove (self->priv->group_members_backlog, handle))
+        g_hash_table_remove (self->priv->group_members_backlog_ids,
+            GUINT_TO_POINTER (handle));
+      else if (reported != NULL)
+        g_array_append_val (reported, handle);
+    }
+}
+
 static void
 _tp_channel_emit_initial_sets (TpChannel *self)
 {
@@ -731,6 +823,10 @@ _tp_channel_emit_initial_sets (TpChannel *self)
   g_array_unref (added);
   g_array_unref (remote_pending);
 
+  if (self->priv->group_members_backlog != NULL)
+    self->priv->group_members_backlog_source = g_idle_add (
+        _tp_channel_group_report_backlog_cb, self);
+
   _tp_channel_continue_introspection (self);
 }
 
@@ -764,6 +860,7 @@ tp_channel_got_group_properties_cb (TpProxy *proxy,
     {
       GHashTable *table;
       GArray *arr;
+      guint batch_size;
 
       DEBUG ("Received %u group properties", g_hash_table_size (asv));
 
@@ -845,6 +942,13 @@ tp_channel_got_group_properties_cb (TpProxy *proxy,
       self->priv->handle_owners_changed_sig = NULL;
       self->priv->handle_owners_changed_detailed_sig = NULL;
 
+      batch_size = tp_simple_client_factory_get_group_members_batch_size (
+          tp_proxy_get_factory (self->priv->connection));
+
+      if (batch_size > 0 &&
+          tp_intset_size (self->priv->group_members) > batch_size)
+        _tp_channel_group_defer_members (self, batch_size, table);
+
       _tp_channel_contacts_group_init (self, table);
 
       goto OUT;
@@ -987,6 +1091,7 @@ handle_members_changed (TpChannel *self,
                         guint reason,
                         GHashTable *details)
 {
+  GArray *reported_removed = NULL;
   guint i;
 
   if (self->priv->group_members == NULL)
@@ -995,6 +1100,34 @@ handle_members_changed (TpChannel *self,
   g_assert (self->priv->group_local_pending != NULL);
   g_assert (self->priv->group_remote_pending != NULL);
 
+  if (self->priv->group_members_backlog != NULL)
+    {
+      reported_removed = g_array_sized_new (FALSE, FALSE, sizeof (TpHandle),
+          removed->len);
+
+      _tp_channel_group_forget_backlog (self, added, NULL);
+      _tp_channel_group_forget_backlog (self, removed, reported_removed);
+      _tp_channel_group_forget_backlog (self, local_pending, NULL);
+      _tp_channel_group_forget_backlog (self, remote_pending, NULL);
+
+      /* Nobody has been told about members still in the backlog, so they
+       * just disappear from it, rather than being reported as removed */
+      if (reported_removed->len < removed->len)
+        {
+          DEBUG ("%p: %u unreported members left", self,
+              removed->len - reported_removed->len);
+
+          if (reported_removed->len == 0 && added->len == 0 &&
+              local_pending->len == 0 && remote_pending->len == 0)
+            {
+              g_array_unref (reported_removed);
+              return;
+            }
+        }
+
+      removed = reported_removed;
+    }
+
   for (i = 0; i < added->len; i++)
     {
       TpHandle handle = g_array_index (added, guint, i);
@@ -1147,6 +1280,84 @@ handle_members_changed (TpChannel *self,
 
   _tp_channel_contacts_members_changed (self, added, removed,
       local_pending, remote_pending, actor, details);
+
+  tp_clear_pointer (&reported_removed, g_array_unref);
+}
+
+
+static gboolean
+_tp_channel_group_report_backlog_cb (gpointer user_data)
+{
+  TpChannel *self = user_data;
+  GArray empty_array = { NULL, 0 };
+  GArray *added;
+  GHashTable *ids;
+  GHashTable *details;
+  TpIntsetFastIter iter;
+  TpHandle handle;
+  guint i;
+
+  if (tp_proxy_get_invalidated (self) != NULL)
+    {
+      self->priv->group_members_backlog_source = 0;
+      _tp_channel_group_clear_backlog (self);
+      return FALSE;
+    }
+
+  added = g_array_sized_new (FALSE, FALSE, sizeof (TpHandle),
+      self->priv->group_members_batch_size);
+  ids = g_hash_table_new (NULL, NULL);
+
+  tp_intset_fast_iter_init (&iter, self->priv->group_members_backlog);
+  while (added->len < self->priv->group_members_batch_size &&
+      tp_intset_fast_iter_next (&iter, &handle))
+    {
+      const gchar *id = g_hash_table_lookup (
+          self->priv->group_members_backlog_ids, GUINT_TO_POINTER (handle));
+
+      g_array_append_val (added, handle);
+
+      if (id != NULL)
+        g_hash_table_insert (ids, GUINT_TO_POINTER (handle), (gchar *) id);
+    }
+
+  details = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+      (GDestroyNotify) tp_g_value_slice_free);
+
+  /* this copies the identifiers, so we can forget about them below */
+  if (g_hash_table_size (ids) > 0)
+    g_hash_table_insert (details, "contact-ids",
+        tp_g_value_slice_new_boxed (TP_HASH_TYPE_HANDLE_IDENTIFIER_MAP, ids));
+
+  g_hash_table_unref (ids);
+
+  for (i = 0; i < added->len; i++)
+    {
+      handle = g_array_index (added, TpHandle, i);
+      tp_intset_remove (self->priv->group_members_backlog, handle);
+      g_hash_table_remove (self->priv->group_members_backlog_ids,
+          GUINT_TO_POINTER (handle));
+    }
+
+  DEBUG ("%p: reporting %u more members, %u left", self, added->len,
+      tp_intset_size (self->priv->group_members_backlog));
+
+  handle_members_changed (self, "", added, &empty_array, &empty_array,
+      &empty_array, 0, TP_CHANNEL_GROUP_CHANGE_REASON_NONE, details);
+
+  g_hash_table_unref (details);
+  g_array_unref (added);
+
+  /* handle_members_changed() may have emptied the backlog itself */
+  if (self->priv->group_members_backlog == NULL ||
+      tp_intset_is_empty (self->priv->group_members_backlog))
+    {
+      self->priv->group_members_backlog_source = 0;
+      _tp_channel_group_clear_backlog (self);
+      return FALSE;
+    }
+
+  return TRUE;
 }
 
 
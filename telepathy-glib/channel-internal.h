@@ -77,6 +77,15 @@ struct _TpChannelPrivate {
     /* guint => guint, NULL if not discovered yet */
     GHashTable *group_handle_owners;
 
+    /* Members which the CM told us about, but which we have not reported
+     * yet; NULL unless members are being reported in batches (see
+     * tp_simple_client_factory_set_group_members_batch_size()) */
+    TpIntset *group_members_backlog;
+    /* TpHandle => owned identifier, for handles in the backlog */
+    GHashTable *group_members_backlog_ids;
+    guint group_members_batch_size;
+    guint group_members_backlog_source;
+
     /* reffed TpContact */
     TpContact *target_contact;
     TpContact *initiator_contact;
@@ -89,6 +98,17 @@ struct _TpChannelPrivate {
     GHashTable *group_contact_owners;
     gboolean cm_too_old_for_contacts;
 
+    /* TRUE if members only get a TpContact when somebody asks for one (see
+     * tp_simple_client_factory_set_lazy_group_members()) */
+    gboolean group_members_lazy;
+    /* TpHandle -> owned identifier, for members which are not in
+     * group_members_contacts yet; NULL unless group_members_lazy */
+    GHashTable *group_members_ids;
+    /* reffed TpContact created by group_members_lazy, waiting for their
+     * features to be prepared in group_members_prepare_source */
+    GPtrArray *group_members_to_prepare;
+    guint group_members_prepare_source;
+
     /* Queue of GSimpleAsyncResult with ContactsQueueItem payload */
     GQueue *contacts_queue;
     /* Item currently being prepared, not part of contacts_queue anymore */
@@ -122,6 +142,7 @@ GHashTable *_tp_channel_get_immutable_properties (TpChannel *self);
 /* channel-group.c internals */
 
 void _tp_channel_get_group_properties (TpChannel *self);
+void _tp_channel_group_clear_backlog (TpChannel *self);
 
 /* channel-contacts.c internals */
 
@@ -1422,6 +1422,16 @@ tp_channel_dispose (GObject *object)
 
   DEBUG ("%p", self);
 
+  _tp_channel_group_clear_backlog (self);
+
+  if (self->priv->group_members_prepare_source != 0)
+    {
+      g_source_remove (self->priv->group_members_prepare_source);
+      self->priv->group_members_prepare_source = 0;
+    }
+
+  tp_clear_pointer (&self->priv->group_members_to_prepare, g_ptr_array_unref);
+
   if (self->priv->connection == NULL)
     goto finally;
 
@@ -1437,6 +1447,7 @@ tp_channel_dispose (GObject *object)
   g_clear_object (&self->priv->group_self_contact);
   tp_clear_pointer (&self->priv->group_members_contacts,
       g_hash_table_unref);
+  tp_clear_pointer (&self->priv->group_members_ids, g_hash_table_unref);
   tp_clear_pointer (&self->priv->group_local_pending_contacts,
       g_hash_table_unref);
   tp_clear_pointer (&self->priv->group_remote_pending_contacts,
@@ -219,6 +219,9 @@ _TP_AVAILABLE_IN_0_16
 TpContact *tp_channel_group_get_self_contact (TpChannel *self);
 _TP_AVAILABLE_IN_0_16
 GPtrArray *tp_channel_group_dup_members_contacts (TpChannel *self);
+_TP_AVAILABLE_IN_UNRELEASED
+TpContact *tp_channel_group_dup_member_contact_by_handle (TpChannel *self,
+    TpHandle handle);
 _TP_AVAILABLE_IN_0_16
 GPtrArray *tp_channel_group_dup_local_pending_contacts (TpChannel *self);
 _TP_AVAILABLE_IN_0_16
@@ -218,6 +218,69 @@ contacts_changed_cb (TpConnection *self,
     process_queued_contacts_changed (self);
 }
 
+/* Add the contacts from @attributes to the contacts_changed_queue, at most
+ * @page_size at a time, so the contact features are retrieved and the roster
+ * is populated one page at a time */
+static void
+queue_roster_pages (TpConnection *self,
+    GHashTable *attributes,
+    guint page_size)
+{
+  TpContactFeature feature_states = TP_CONTACT_FEATURE_SUBSCRIPTION_STATES;
+  ContactsChangedItem *item = NULL;
+  GHashTable *empty;
+  GHashTableIter iter;
+  gpointer key, value;
+  gboolean was_idle;
+
+  was_idle = g_queue_is_empty (self->priv->contacts_changed_queue);
+  empty = g_hash_table_new (NULL, NULL);
+
+  g_hash_table_iter_init (&iter, attributes);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      TpHandle handle = GPOINTER_TO_UINT (key);
+      const gchar *id = tp_asv_get_string (value,
+          TP_TOKEN_CONNECTION_CONTACT_ID);
+      TpContact *contact;
+      GError *e = NULL;
+
+      contact = tp_simple_client_factory_ensure_contact (
+          tp_proxy_get_factory (self), self, handle, id);
+
+      if (contact == NULL)
+         continue;
+
+      /* we only asked for the subscription states so far */
+      if (!_tp_contact_set_attributes (contact, value, 1, &feature_states,
+              &e))
+        {
+          DEBUG ("Error setting contact attributes: %s", e->message);
+          g_clear_error (&e);
+        }
+
+      if (item == NULL)
+        {
+          item = contacts_changed_item_new (empty, empty, empty);
+          g_queue_push_tail (self->priv->contacts_changed_queue, item);
+        }
+
+      /* Give the contact ref to the item */
+      g_ptr_array_add (item->new_contacts, contact);
+
+      if (item->new_contacts->len >= page_size)
+        item = NULL;
+    }
+
+  g_hash_table_unref (empty);
+
+  DEBUG ("%u roster contacts to prepare in pages of %u",
+      g_hash_table_size (attributes), page_size);
+
+  if (was_idle)
+    process_queued_contacts_changed (self);
+}
+
 static void
 got_contact_list_attributes_cb (TpConnection *self,
     GHashTable *attributes,
@@ -229,6 +292,7 @@ got_contact_list_attributes_cb (TpConnection *self,
   GArray *features = user_data;
   GHashTableIter iter;
   gpointer key, value;
+  guint page_size;
 
   if (error != NULL)
     {
@@ -244,6 +308,15 @@ got_contact_list_attributes_cb (TpConnection *self,
   DEBUG ("roster fetched with %d contacts", g_hash_table_size (attributes));
   self->priv->roster_fetched = TRUE;
 
+  page_size = tp_simple_client_factory_get_contact_list_page_size (
+      tp_proxy_get_factory (self));
+
+  if (page_size > 0)
+    {
+      queue_roster_pages (self, attributes, page_size);
+      goto SUCCESS;
+    }
+
   g_hash_table_iter_init (&iter, attributes);
   while (g_hash_table_iter_next (&iter, &key, &value))
     {
@@ -285,6 +358,7 @@ got_contact_list_attributes_cb (TpConnection *self,
       g_ptr_array_unref (removed);
     }
 
+SUCCESS:
   self->priv->contact_list_state = TP_CONTACT_LIST_STATE_SUCCESS;
   g_object_notify ((GObject *) self, "contact-list-state");
 
@@ -320,6 +394,14 @@ prepare_roster (TpConnection *self,
   supported_interfaces = _tp_contacts_bind_to_signals (self, features->len,
       (TpContactFeature *) features->data);
 
+  /* If the roster is retrieved in pages, only get the subscription states
+   * (which are implied by the ContactList interface) for now; the other
+   * attributes are fetched page by page by queue_roster_pages() */
+  if (supported_interfaces != NULL &&
+      tp_simple_client_factory_get_contact_list_page_size (
+          tp_proxy_get_factory (self)) > 0)
+    supported_interfaces[0] = NULL;
+
   tp_cli_connection_interface_contact_list_call_get_contact_list_attributes (
       self, -1, supported_interfaces, TRUE,
       got_contact_list_attributes_cb,
@@ -1753,6 +1835,8 @@ process_queued_blocked_changed (TpConnection *self)
    * item->removed_contacts */
   contacts = g_ptr_array_new ();
 
+  _tp_contact_changes_begin (self);
+
   g_hash_table_iter_init (&iter, item->added);
   while (g_hash_table_iter_next (&iter, &key, &value))
     {
@@ -1785,6 +1869,8 @@ process_queued_blocked_changed (TpConnection *self)
       _tp_contact_set_is_blocked (contact, FALSE);
     }
 
+  _tp_contact_changes_end (self);
+
   if (contacts->len == 0)
     {
       blocked_changed_head_ready (self);
@@ -58,6 +58,20 @@ struct _TpConnectionPrivate {
 
     /* TpHandle => weak ref to TpContact */
     GHashTable *contacts;
+    /* owned gchar * => InternedString, shared by the contacts; see
+     * contact.c */
+    GHashTable *contact_strings;
+
+    /* Contacts changed while handling a D-Bus signal, to be announced by
+     * TpConnection::contacts-changed; see contact_changes_begin() */
+    guint contact_changes_depth;
+    gboolean contact_changes_batched;
+    /* owned TpContact */
+    GPtrArray *changed_contacts;
+    /* TpContactChangeFlags, parallel to changed_contacts */
+    GArray *contact_change_flags;
+    /* borrowed TpContact => index in changed_contacts */
+    GHashTable *changed_contacts_index;
 
     TpCapabilities *capabilities;
     /* Queue of owned GSimpleAsyncResult, each result being a pending call
@@ -65,11 +79,35 @@ struct _TpConnectionPrivate {
     GQueue capabilities_queue;
 
     TpAvatarRequirements *avatar_requirements;
-    GArray *avatar_request_queue;
-    guint avatar_request_idle_id;
+    /* TpHandle, as GUINT_TO_POINTER, of contacts whose avatars are still
+     * to be requested with RequestAvatars, most urgent first */
+    GQueue avatar_request_queue;
+    /* TpHandle => owned AvatarRequest, for each queued or in-flight
+     * avatar request; see contact.c */
+    GHashTable *avatar_requests;
+    guint avatar_request_source_id;
+    /* monotonic time of the last RequestAvatars call, or 0 */
+    gint64 avatar_request_last_sent;
+    guint64 avatar_requests_completed;
+    guint64 avatar_request_total_latency;
+    guint64 avatar_request_max_latency;
+
+    /* ContactsContext (owned, opaque here) waiting to be merged into a
+     * single GetContactAttributes call; see contact.c */
+    GPtrArray *contact_attributes_batch;
+    guint contact_attributes_batch_idle_id;
 
     TpContactInfoFlags contact_info_flags;
     GList *contact_info_supported_fields;
+    /* TpHandle, as GUINT_TO_POINTER, of contacts whose information is still
+     * to be requested, in order */
+    GQueue contact_info_request_queue;
+    /* TpHandle => owned ContactInfoRequest, for each queued request and each
+     * RequestContactInfo call in flight; see contact.c */
+    GHashTable *contact_info_requests;
+    guint contact_info_request_source_id;
+    /* monotonic time at which the last batch was sent, or 0 */
+    gint64 contact_info_request_last_sent;
 
     gint balance;
     guint balance_scale;
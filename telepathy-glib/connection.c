@@ -305,6 +305,7 @@ enum {
   SIGNAL_GROUP_RENAMED,
   SIGNAL_CONTACT_LIST_CHANGED,
   SIGNAL_BLOCKED_CONTACTS_CHANGED,
+  SIGNAL_CONTACTS_CHANGED,
   N_SIGNALS
 };
 
@@ -1542,21 +1543,28 @@ tp_connection_finalize (GObject *object)
       self->priv->connection_error_details = NULL;
     }
 
-  if (self->priv->avatar_request_queue != NULL)
-    {
-      g_array_unref (self->priv->avatar_request_queue);
-      self->priv->avatar_request_queue = NULL;
-    }
+  g_queue_clear (&self->priv->avatar_request_queue);
+  tp_clear_pointer (&self->priv->avatar_requests, g_hash_table_unref);
+  tp_clear_pointer (&self->priv->contact_strings, g_hash_table_unref);
 
-  if (self->priv->avatar_request_idle_id != 0)
+  if (self->priv->avatar_request_source_id != 0)
     {
-      g_source_remove (self->priv->avatar_request_idle_id);
-      self->priv->avatar_request_idle_id = 0;
+      g_source_remove (self->priv->avatar_request_source_id);
+      self->priv->avatar_request_source_id = 0;
     }
 
   tp_contact_info_spec_list_free (self->priv->contact_info_supported_fields);
   self->priv->contact_info_supported_fields = NULL;
 
+  g_queue_clear (&self->priv->contact_info_request_queue);
+  tp_clear_pointer (&self->priv->contact_info_requests, g_hash_table_unref);
+
+  if (self->priv->contact_info_request_source_id != 0)
+    {
+      g_source_remove (self->priv->contact_info_request_source_id);
+      self->priv->contact_info_request_source_id = 0;
+    }
+
   tp_clear_pointer (&self->priv->balance_currency, g_free);
   tp_clear_pointer (&self->priv->balance_uri, g_free);
   tp_clear_pointer (&self->priv->cm_name, g_free);
@@ -2365,6 +2373,35 @@ tp_connection_class_init (TpConnectionClass *klass)
       NULL, NULL, NULL,
       G_TYPE_NONE, 2, G_TYPE_PTR_ARRAY, G_TYPE_PTR_ARRAY);
 
+  /**
+   * TpConnection::contacts-changed:
+   * @self: a #TpConnection
+   * @contacts: (type GLib.PtrArray) (element-type TelepathyGLib.Contact):
+   *  a #GPtrArray of #TpContact whose properties changed
+   * @flags: (type GLib.Array) (element-type TelepathyGLib.ContactChangeFlags):
+   *  a #GArray of #TpContactChangeFlags, one for each contact in @contacts,
+   *  describing which of that contact's properties changed
+   *
+   * Emitted once for each change notification received from the connection
+   * manager that changes the properties of one or more #TpContact objects,
+   * such as presence or alias changes. Handling this signal is much cheaper
+   * than connecting to #GObject::notify on thousands of contacts.
+   *
+   * The individual #TpContact objects also emit #GObject::notify and their
+   * own change signals, unless
+   * tp_simple_client_factory_set_batch_contact_changes() was used to turn
+   * them off.
+   *
+   * Since: 0.UNRELEASED
+   */
+  signals[SIGNAL_CONTACTS_CHANGED] = g_signal_new (
+      "contacts-changed",
+      G_OBJECT_CLASS_TYPE (klass),
+      G_SIGNAL_RUN_LAST,
+      0,
+      NULL, NULL, NULL,
+      G_TYPE_NONE, 2, G_TYPE_PTR_ARRAY, G_TYPE_ARRAY);
+
 }
 
 /**
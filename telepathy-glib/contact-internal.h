@@ -45,8 +45,33 @@ void _tp_contact_set_subscription_states (TpContact *self,
 void _tp_contact_set_is_blocked (TpContact *self,
     gboolean is_blocked);
 
+void _tp_contact_changes_begin (TpConnection *connection);
+void _tp_contact_changes_end (TpConnection *connection);
+
 void _tp_contact_connection_disposed (TpContact *contact);
 
+/* avatar-cache.c */
+gboolean _tp_avatar_cache_is_loaded (void);
+void _tp_avatar_cache_load_async (GAsyncReadyCallback callback,
+    gpointer user_data);
+GFile *_tp_avatar_cache_lookup (TpConnection *connection,
+    const gchar *token,
+    gchar **mime_type);
+void _tp_avatar_cache_verify_async (TpConnection *connection,
+    const gchar *token,
+    GAsyncReadyCallback callback,
+    gpointer user_data);
+gboolean _tp_avatar_cache_verify_finish (GAsyncResult *result);
+void _tp_avatar_cache_store_async (TpConnection *connection,
+    const gchar *token,
+    const GArray *avatar,
+    const gchar *mime_type,
+    GAsyncReadyCallback callback,
+    gpointer user_data);
+GFile *_tp_avatar_cache_store_finish (GAsyncResult *result,
+    gchar **mime_type,
+    GError **error);
+
 G_END_DECLS
 
 #endif
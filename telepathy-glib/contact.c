@@ -22,13 +22,13 @@
 
 #include <telepathy-glib/contact.h>
 
-#include <errno.h>
 #include <string.h>
 
 #include <telepathy-glib/capabilities-internal.h>
 #include <telepathy-glib/dbus.h>
 #include <telepathy-glib/gtypes.h>
 #include <telepathy-glib/interfaces.h>
+#include <telepathy-glib/simple-client-factory.h>
 #include <telepathy-glib/util.h>
 
 #define DEBUG_FLAG TP_DEBUG_CONTACTS
@@ -172,6 +172,41 @@ struct _TpContact {
  * Since: 0.11.5
  */
 
+/**
+ * TpContactChangeFlags:
+ * @TP_CONTACT_CHANGE_ALIAS: #TpContact:alias changed
+ * @TP_CONTACT_CHANGE_AVATAR_TOKEN: #TpContact:avatar-token changed
+ * @TP_CONTACT_CHANGE_PRESENCE: #TpContact:presence-type,
+ *  #TpContact:presence-status or #TpContact:presence-message changed
+ * @TP_CONTACT_CHANGE_LOCATION: #TpContact:location changed
+ * @TP_CONTACT_CHANGE_CAPABILITIES: #TpContact:capabilities changed
+ * @TP_CONTACT_CHANGE_AVATAR_DATA: #TpContact:avatar-file and
+ *  #TpContact:avatar-mime-type changed. Avatars which have to be downloaded
+ *  are retrieved asynchronously, so only changes to avatars that were
+ *  already cached, or removed, are reported this way; the others are
+ *  signalled by #GObject::notify.
+ * @TP_CONTACT_CHANGE_CONTACT_INFO: #TpContact:contact-info changed
+ * @TP_CONTACT_CHANGE_CLIENT_TYPES: #TpContact:client-types changed
+ * @TP_CONTACT_CHANGE_SUBSCRIPTION_STATES: #TpContact:subscribe-state,
+ *  #TpContact:publish-state or #TpContact:publish-request changed
+ * @TP_CONTACT_CHANGE_CONTACT_GROUPS: #TpContact:contact-groups changed
+ * @TP_CONTACT_CHANGE_CONTACT_BLOCKING: #TpContact:is-blocked changed
+ *
+ * Flags describing which properties of a #TpContact were changed, as
+ * reported by #TpConnection::contacts-changed. Each flag corresponds to
+ * the #TpContactFeature of the same name.
+ *
+ * Since: 0.UNRELEASED
+ */
+
+/**
+ * TP_TYPE_CONTACT_CHANGE_FLAGS:
+ *
+ * The #GFlagsClass type of a #TpContactChangeFlags.
+ *
+ * Since: 0.UNRELEASED
+ */
+
 G_DEFINE_TYPE (TpContact, tp_contact, G_TYPE_OBJECT)
 
 
@@ -224,6 +259,22 @@ typedef enum {
     CONTACT_FEATURE_FLAG_CONTACT_BLOCKING = 1 << TP_CONTACT_FEATURE_CONTACT_BLOCKING,
 } ContactFeatureFlags;
 
+/* Data for features that most contacts have no information for, allocated
+ * the first time one of them is set */
+typedef struct {
+    /* location */
+    GHashTable *location;
+
+    /* client types: NULL-terminated array of interned strings */
+    const gchar **client_types;
+
+    /* a list of TpContactInfoField */
+    GList *contact_info;
+    /* monotonic time at which contact_info was last received from the
+     * network, or 0 */
+    gint64 contact_info_fetched;
+} ContactExtras;
+
 struct _TpContactPrivate {
     /* basics */
     TpConnection *connection;
@@ -231,44 +282,221 @@ struct _TpContactPrivate {
     gchar *identifier;
     ContactFeatureFlags has_features;
 
+    /* the connection's pool of interned strings, which holds all the
+     * strings below that are not owned by us; see contact_intern() */
+    GHashTable *strings;
+
     /* aliasing */
-    gchar *alias;
+    const gchar *alias;
 
     /* avatars */
-    gchar *avatar_token;
+    const gchar *avatar_token;
     GFile *avatar_file;
-    gchar *avatar_mime_type;
+    const gchar *avatar_mime_type;
+    /* if TRUE, the next avatar request goes to the head of the queue */
+    gboolean avatar_request_urgent;
 
     /* presence */
     TpConnectionPresenceType presence_type;
-    gchar *presence_status;
-    gchar *presence_message;
-
-    /* location */
-    GHashTable *location;
+    const gchar *presence_status;
+    const gchar *presence_message;
 
-    /* client types */
-    gchar **client_types;
+    /* location, client types, contact info, or NULL if we have none of
+     * them */
+    ContactExtras *extras;
 
     /* capabilities */
     TpCapabilities *capabilities;
 
-    /* a list of TpContactInfoField */
-    GList *contact_info;
-
     /* Subscribe/Publish states */
     TpSubscriptionState subscribe;
     TpSubscriptionState publish;
-    gchar *publish_request;
+    const gchar *publish_request;
 
     /* ContactGroups */
-    /* array of dupped strings */
+    /* array of interned strings */
     GPtrArray *contact_groups;
 
     /* ContactBlocking */
     gboolean is_blocked;
 };
 
+/* A string in a connection's pool, shared by all the contacts that use it:
+ * thousands of contacts can have the same presence status, groups, client
+ * types and so on. The pool maps the string to this structure. */
+typedef struct {
+    guint refcount;
+    gchar str[1];
+} InternedString;
+
+/* Returns a reference to a string equal to @str in @self's pool, which must
+ * be released with contact_release() */
+static const gchar *
+contact_intern (TpContact *self,
+    const gchar *str)
+{
+  InternedString *interned;
+
+  if (str == NULL)
+    return NULL;
+
+  interned = g_hash_table_lookup (self->priv->strings, str);
+
+  if (interned == NULL)
+    {
+      gsize len = strlen (str);
+
+      interned = g_malloc (G_STRUCT_OFFSET (InternedString, str) + len + 1);
+      interned->refcount = 0;
+      memcpy (interned->str, str, len + 1);
+      g_hash_table_insert (self->priv->strings, interned->str, interned);
+    }
+
+  interned->refcount++;
+  return interned->str;
+}
+
+static void
+contact_release (TpContact *self,
+    const gchar *str)
+{
+  InternedString *interned;
+
+  if (str == NULL)
+    return;
+
+  interned = g_hash_table_lookup (self->priv->strings, str);
+  g_return_if_fail (interned != NULL && interned->str == str);
+
+  if (--interned->refcount == 0)
+    g_hash_table_remove (self->priv->strings, str);
+}
+
+static void
+contact_set_interned (TpContact *self,
+    const gchar **field,
+    const gchar *str)
+{
+  const gchar *old = *field;
+
+  /* intern first, in case @str is @old */
+  *field = contact_intern (self, str);
+  contact_release (self, old);
+}
+
+static void
+contact_ensure_extras (TpContact *self)
+{
+  if (self->priv->extras == NULL)
+    self->priv->extras = g_slice_new0 (ContactExtras);
+}
+
+static void
+contact_clear_client_types (TpContact *self)
+{
+  const gchar **types = self->priv->extras->client_types;
+  guint i;
+
+  if (types == NULL)
+    return;
+
+  for (i = 0; types[i] != NULL; i++)
+    contact_release (self, types[i]);
+
+  g_free (types);
+  self->priv->extras->client_types = NULL;
+}
+
+static void
+contact_clear_groups (TpContact *self)
+{
+  guint i;
+
+  if (self->priv->contact_groups == NULL)
+    return;
+
+  /* this includes the terminating NULL, which is ignored */
+  for (i = 0; i < self->priv->contact_groups->len; i++)
+    contact_release (self, g_ptr_array_index (self->priv->contact_groups, i));
+
+  tp_clear_pointer (&self->priv->contact_groups, g_ptr_array_unref);
+}
+
+/* Starts recording changes to contacts of @connection. Changes recorded by
+ * contact_changed() until the matching _tp_contact_changes_end() are announced
+ * together, by a single emission of TpConnection::contacts-changed. */
+void
+_tp_contact_changes_begin (TpConnection *connection)
+{
+  if (connection->priv->contact_changes_depth++ > 0)
+    return;
+
+  connection->priv->contact_changes_batched =
+    tp_simple_client_factory_get_batch_contact_changes (
+        tp_proxy_get_factory (connection));
+  connection->priv->changed_contacts = g_ptr_array_new_with_free_func (
+      g_object_unref);
+  connection->priv->contact_change_flags = g_array_new (FALSE, FALSE,
+      sizeof (TpContactChangeFlags));
+  connection->priv->changed_contacts_index = g_hash_table_new (NULL, NULL);
+}
+
+void
+_tp_contact_changes_end (TpConnection *connection)
+{
+  GPtrArray *contacts;
+  GArray *flags;
+
+  g_return_if_fail (connection->priv->contact_changes_depth > 0);
+
+  if (--connection->priv->contact_changes_depth > 0)
+    return;
+
+  contacts = connection->priv->changed_contacts;
+  flags = connection->priv->contact_change_flags;
+  connection->priv->changed_contacts = NULL;
+  connection->priv->contact_change_flags = NULL;
+  tp_clear_pointer (&connection->priv->changed_contacts_index,
+      g_hash_table_unref);
+
+  if (contacts->len > 0)
+    g_signal_emit_by_name (connection, "contacts-changed", contacts, flags);
+
+  g_ptr_array_unref (contacts);
+  g_array_unref (flags);
+}
+
+/* Records that @self changed in the way described by @flag. Returns FALSE if
+ * that change will only be announced by TpConnection::contacts-changed, so
+ * the caller must not emit GObject::notify or other signals on @self. */
+static gboolean
+contact_changed (TpContact *self,
+    TpContactChangeFlags flag)
+{
+  TpConnection *connection = self->priv->connection;
+  gpointer idx;
+
+  if (connection == NULL || connection->priv->contact_changes_depth == 0)
+    return TRUE;
+
+  if (g_hash_table_lookup_extended (connection->priv->changed_contacts_index,
+        self, NULL, &idx))
+    {
+      g_array_index (connection->priv->contact_change_flags,
+          TpContactChangeFlags, GPOINTER_TO_UINT (idx)) |= flag;
+    }
+  else
+    {
+      g_hash_table_insert (connection->priv->changed_contacts_index, self,
+          GUINT_TO_POINTER (connection->priv->changed_contacts->len));
+      g_ptr_array_add (connection->priv->changed_contacts,
+          g_object_ref (self));
+      g_array_append_val (connection->priv->contact_change_flags, flag);
+    }
+
+  return !connection->priv->contact_changes_batched;
+}
+
 
 /**
  * tp_contact_get_account:
@@ -562,7 +790,10 @@ tp_contact_get_location (TpContact *self)
 {
   g_return_val_if_fail (self != NULL, NULL);
 
-  return self->priv->location;
+  if (self->priv->extras == NULL)
+    return NULL;
+
+  return self->priv->extras->location;
 }
 
 /**
@@ -585,10 +816,10 @@ tp_contact_dup_location (TpContact *self)
 {
   g_return_val_if_fail (self != NULL, NULL);
 
-  if (self->priv->location == NULL)
+  if (tp_contact_get_location (self) == NULL)
     return NULL;
 
-  return _tp_asv_to_vardict (self->priv->location);
+  return _tp_asv_to_vardict (self->priv->extras->location);
 }
 
 /**
@@ -608,7 +839,10 @@ tp_contact_get_client_types (TpContact *self)
 {
   g_return_val_if_fail (self != NULL, NULL);
 
-  return (const gchar * const *) self->priv->client_types;
+  if (self->priv->extras == NULL)
+    return NULL;
+
+  return (const gchar * const *) self->priv->extras->client_types;
 }
 
 /**
@@ -655,7 +889,10 @@ tp_contact_get_contact_info (TpContact *self)
 {
   g_return_val_if_fail (TP_IS_CONTACT (self), NULL);
 
-  return g_list_copy (self->priv->contact_info);
+  if (self->priv->extras == NULL)
+    return NULL;
+
+  return g_list_copy (self->priv->extras->contact_info);
 }
 
 /**
@@ -677,7 +914,10 @@ tp_contact_dup_contact_info (TpContact *self)
 {
   g_return_val_if_fail (TP_IS_CONTACT (self), NULL);
 
-  return _tp_g_list_copy_deep (self->priv->contact_info,
+  if (self->priv->extras == NULL)
+    return NULL;
+
+  return _tp_g_list_copy_deep (self->priv->extras->contact_info,
       (GCopyFunc) tp_contact_info_field_copy, NULL);
 }
 
@@ -901,10 +1141,12 @@ tp_contact_dispose (GObject *object)
     }
 
   tp_clear_object (&self->priv->connection);
-  tp_clear_pointer (&self->priv->location, g_hash_table_unref);
   tp_clear_object (&self->priv->capabilities);
   tp_clear_object (&self->priv->avatar_file);
-  tp_clear_pointer (&self->priv->contact_groups, g_ptr_array_unref);
+  contact_clear_groups (self);
+
+  if (self->priv->extras != NULL)
+    tp_clear_pointer (&self->priv->extras->location, g_hash_table_unref);
 
   ((GObjectClass *) tp_contact_parent_class)->dispose (object);
 }
@@ -916,14 +1158,21 @@ tp_contact_finalize (GObject *object)
   TpContact *self = TP_CONTACT (object);
 
   g_free (self->priv->identifier);
-  g_free (self->priv->alias);
-  g_free (self->priv->avatar_token);
-  g_free (self->priv->avatar_mime_type);
-  g_free (self->priv->presence_status);
-  g_free (self->priv->presence_message);
-  g_strfreev (self->priv->client_types);
-  tp_contact_info_list_free (self->priv->contact_info);
-  g_free (self->priv->publish_request);
+  contact_set_interned (self, &self->priv->alias, NULL);
+  contact_set_interned (self, &self->priv->avatar_token, NULL);
+  contact_set_interned (self, &self->priv->avatar_mime_type, NULL);
+  contact_set_interned (self, &self->priv->presence_status, NULL);
+  contact_set_interned (self, &self->priv->presence_message, NULL);
+  contact_set_interned (self, &self->priv->publish_request, NULL);
+
+  if (self->priv->extras != NULL)
+    {
+      contact_clear_client_types (self);
+      tp_contact_info_list_free (self->priv->extras->contact_info);
+      g_slice_free (ContactExtras, self->priv->extras);
+    }
+
+  tp_clear_pointer (&self->priv->strings, g_hash_table_unref);
 
   ((GObjectClass *) tp_contact_parent_class)->finalize (object);
 }
@@ -995,7 +1244,8 @@ tp_contact_get_property (GObject *object,
       break;
 
     case PROP_CONTACT_INFO:
-      g_value_set_boxed (value, self->priv->contact_info);
+      g_value_set_boxed (value, self->priv->extras == NULL ? NULL :
+          self->priv->extras->contact_info);
       break;
 
     case PROP_CLIENT_TYPES:
@@ -1505,6 +1755,12 @@ _tp_contact_new (TpConnection *connection,
   TpContact *self = TP_CONTACT (g_object_new (TP_TYPE_CONTACT, NULL));
 
   self->priv->connection = g_object_ref (connection);
+
+  if (connection->priv->contact_strings == NULL)
+    connection->priv->contact_strings = g_hash_table_new_full (g_str_hash,
+        g_str_equal, NULL, g_free);
+
+  self->priv->strings = g_hash_table_ref (connection->priv->contact_strings);
   self->priv->handle = handle;
   self->priv->identifier = g_strdup (identifier);
 
@@ -1624,8 +1880,6 @@ tp_contact_init (TpContact *self)
 {
   self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self, TP_TYPE_CONTACT,
       TpContactPrivate);
-
-  self->priv->client_types = NULL;
 }
 
 
@@ -2310,9 +2564,9 @@ contacts_requested_aliases (TpConnection *connection,
           const gchar *alias = aliases[i];
 
           contact->priv->has_features |= CONTACT_FEATURE_FLAG_ALIAS;
-          g_free (contact->priv->alias);
-          contact->priv->alias = g_strdup (alias);
-          g_object_notify ((GObject *) contact, "alias");
+          contact_set_interned (contact, &contact->priv->alias, alias);
+          if (contact_changed (contact, TP_CONTACT_CHANGE_ALIAS))
+            g_object_notify ((GObject *) contact, "alias");
         }
     }
   else
@@ -2346,20 +2600,16 @@ contacts_got_aliases (TpConnection *connection,
               GUINT_TO_POINTER (contact->priv->handle));
 
           contact->priv->has_features |= CONTACT_FEATURE_FLAG_ALIAS;
-          g_free (contact->priv->alias);
-          contact->priv->alias = NULL;
+          contact_set_interned (contact, &contact->priv->alias, alias);
 
-          if (alias != NULL)
-            {
-              contact->priv->alias = g_strdup (alias);
-            }
-          else
+          if (alias == NULL)
             {
               WARNING ("No alias returned for %u, will use ID instead",
                   contact->priv->handle);
             }
 
-          g_object_notify ((GObject *) contact, "alias");
+          if (contact_changed (contact, TP_CONTACT_CHANGE_ALIAS))
+            g_object_notify ((GObject *) contact, "alias");
         }
     }
   else if ((error->domain == TP_ERROR &&
@@ -2393,6 +2643,8 @@ contacts_aliases_changed (TpConnection *connection,
 {
   guint i;
 
+  _tp_contact_changes_begin (connection);
+
   for (i = 0; i < alias_structs->len; i++)
     {
       GValueArray *pair = g_ptr_array_index (alias_structs, i);
@@ -2405,11 +2657,13 @@ contacts_aliases_changed (TpConnection *connection,
           contact->priv->has_features |= CONTACT_FEATURE_FLAG_ALIAS;
           DEBUG ("Contact \"%s\" alias changed from \"%s\" to \"%s\"",
               contact->priv->identifier, contact->priv->alias, alias);
-          g_free (contact->priv->alias);
-          contact->priv->alias = g_strdup (alias);
-          g_object_notify ((GObject *) contact, "alias");
+          contact_set_interned (contact, &contact->priv->alias, alias);
+          if (contact_changed (contact, TP_CONTACT_CHANGE_ALIAS))
+            g_object_notify ((GObject *) contact, "alias");
         }
     }
+
+  _tp_contact_changes_end (connection);
 }
 
 
@@ -2473,11 +2727,11 @@ contact_maybe_set_simple_presence (TpContact *contact,
 
   contact->priv->presence_type = type;
 
-  g_free (contact->priv->presence_status);
-  contact->priv->presence_status = g_strdup (status);
+  contact_set_interned (contact, &contact->priv->presence_status, status);
+  contact_set_interned (contact, &contact->priv->presence_message, message);
 
-  g_free (contact->priv->presence_message);
-  contact->priv->presence_message = g_strdup (message);
+  if (!contact_changed (contact, TP_CONTACT_CHANGE_PRESENCE))
+    return;
 
   g_object_notify ((GObject *) contact, "presence-type");
   g_object_notify ((GObject *) contact, "presence-status");
@@ -2496,8 +2750,10 @@ contact_maybe_set_location (TpContact *self,
   if (self == NULL)
     return;
 
-  if (self->priv->location != NULL)
-    g_hash_table_unref (self->priv->location);
+  contact_ensure_extras (self);
+
+  if (self->priv->extras->location != NULL)
+    g_hash_table_unref (self->priv->extras->location);
 
   /* We guarantee that, if we've fetched a location for a contact, the
    * :location property is non-NULL. This is mainly because Empathy assumed
@@ -2509,9 +2765,13 @@ contact_maybe_set_location (TpContact *self,
     g_hash_table_ref (location);
 
   self->priv->has_features |= CONTACT_FEATURE_FLAG_LOCATION;
-  self->priv->location = location;
-  g_object_notify ((GObject *) self, "location");
-  g_object_notify ((GObject *) self, "location-vardict");
+  self->priv->extras->location = location;
+
+  if (contact_changed (self, TP_CONTACT_CHANGE_LOCATION))
+    {
+      g_object_notify ((GObject *) self, "location");
+      g_object_notify ((GObject *) self, "location-vardict");
+    }
 }
 
 static void
@@ -2522,7 +2782,9 @@ contact_set_capabilities (TpContact *self,
 
   self->priv->has_features |= CONTACT_FEATURE_FLAG_CAPABILITIES;
   self->priv->capabilities = g_object_ref (capabilities);
-  g_object_notify ((GObject *) self, "capabilities");
+
+  if (contact_changed (self, TP_CONTACT_CHANGE_CAPABILITIES))
+    g_object_notify ((GObject *) self, "capabilities");
 }
 
 static void
@@ -2549,6 +2811,8 @@ contacts_presences_changed (TpConnection *connection,
   GHashTableIter iter;
   gpointer key, value;
 
+  _tp_contact_changes_begin (connection);
+
   g_hash_table_iter_init (&iter, presences);
 
   while (g_hash_table_iter_next (&iter, &key, &value))
@@ -2558,6 +2822,8 @@ contacts_presences_changed (TpConnection *connection,
 
       contact_maybe_set_simple_presence (contact, value);
     }
+
+  _tp_contact_changes_end (connection);
 }
 
 
@@ -2634,7 +2900,9 @@ contacts_location_updated (TpConnection *connection,
   TpContact *contact = _tp_connection_lookup_contact (connection,
           GPOINTER_TO_UINT (handle));
 
+  _tp_contact_changes_begin (connection);
   contact_maybe_set_location (contact, location);
+  _tp_contact_changes_end (connection);
 }
 
 static void
@@ -2656,15 +2924,48 @@ static void
 contact_maybe_set_client_types (TpContact *self,
     const gchar * const *types)
 {
+  const gchar **old_types;
+  guint i, n;
+
   if (self == NULL)
     return;
 
-  if (self->priv->client_types != NULL)
-    g_strfreev (self->priv->client_types);
+  if (types != NULL)
+    contact_ensure_extras (self);
+
+  if (self->priv->extras != NULL)
+    {
+      old_types = self->priv->extras->client_types;
+      self->priv->extras->client_types = NULL;
+    }
+  else
+    {
+      old_types = NULL;
+    }
+
+  if (types != NULL)
+    {
+      n = g_strv_length ((gchar **) types);
+      self->priv->extras->client_types = g_new0 (const gchar *, n + 1);
+
+      for (i = 0; i < n; i++)
+        self->priv->extras->client_types[i] = contact_intern (self, types[i]);
+    }
+
+  /* release the old types after interning the new ones, so that unchanged
+   * types are not freed and copied again */
+  if (old_types != NULL)
+    {
+      for (i = 0; old_types[i] != NULL; i++)
+        contact_release (self, old_types[i]);
+
+      g_free (old_types);
+    }
 
   self->priv->has_features |= CONTACT_FEATURE_FLAG_CLIENT_TYPES;
-  self->priv->client_types = g_strdupv ((gchar **) types);
-  g_object_notify ((GObject *) self, "client-types");
+
+  if (contact_changed (self, TP_CONTACT_CHANGE_CLIENT_TYPES))
+    g_object_notify ((GObject *) self, "client-types");
 }
 
 static void
@@ -2677,7 +2978,9 @@ contacts_client_types_updated (TpConnection *connection,
   TpContact *contact = _tp_connection_lookup_contact (connection,
           GPOINTER_TO_UINT (handle));
 
+  _tp_contact_changes_begin (connection);
   contact_maybe_set_client_types (contact, types);
+  _tp_contact_changes_end (connection);
 }
 
 static void
@@ -2754,6 +3057,8 @@ contacts_capabilities_updated (TpConnection *connection,
   GHashTableIter iter;
   gpointer handle, value;
 
+  _tp_contact_changes_begin (connection);
+
   g_hash_table_iter_init (&iter, capabilities);
   while (g_hash_table_iter_next (&iter, &handle, &value))
     {
@@ -2762,6 +3067,8 @@ contacts_capabilities_updated (TpConnection *connection,
 
       contact_maybe_set_capabilities (contact, value);
     }
+
+  _tp_contact_changes_end (connection);
 }
 
 static void
@@ -2776,172 +3083,121 @@ contacts_bind_to_capabilities_updated (TpConnection *connection)
     }
 }
 
-static gboolean
-build_avatar_filename (TpConnection *connection,
-    const gchar *avatar_token,
-    gboolean create_dir,
-    gchar **ret_filename,
-    gchar **ret_mime_filename)
-{
-  gchar *dir;
-  gchar *token_escaped;
-  gboolean success = TRUE;
-
-  token_escaped = tp_escape_as_identifier (avatar_token);
-  dir = g_build_filename (g_get_user_cache_dir (),
-      "telepathy", "avatars",
-      tp_connection_get_cm_name (connection),
-      tp_connection_get_protocol_name (connection),
-      NULL);
-
-  if (create_dir)
-    {
-      if (g_mkdir_with_parents (dir, 0700) == -1)
-        {
-          DEBUG ("Error creating avatar cache dir: %s", g_strerror (errno));
-          success = FALSE;
-          goto out;
-        }
-    }
-
-  if (ret_filename != NULL)
-    *ret_filename = g_strconcat (dir, G_DIR_SEPARATOR_S, token_escaped, NULL);
-
-  if (ret_mime_filename != NULL)
-    *ret_mime_filename = g_strconcat (dir, G_DIR_SEPARATOR_S, token_escaped,
-        ".mime", NULL);
-
-out:
-
-  g_free (dir);
-  g_free (token_escaped);
-
-  return success;
-}
-
 static void contact_set_avatar_token (TpContact *self, const gchar *new_token,
     gboolean request);
 
 typedef struct {
     GWeakRef contact;
-    TpConnection *connection;
     gchar *token;
-    GFile *file;
-    GBytes *data;
-    GFile *mime_file;
-    gchar *mime_type;
-} WriteAvatarData;
+} AvatarData;
 
-static void
-write_avatar_data_free (WriteAvatarData *avatar_data)
+static AvatarData *
+avatar_data_new (TpContact *contact,
+    const gchar *token)
 {
-  g_weak_ref_clear (&avatar_data->contact);
-  g_clear_object (&avatar_data->connection);
-  tp_clear_pointer (&avatar_data->token, g_free);
-  g_clear_object (&avatar_data->file);
-  tp_clear_pointer (&avatar_data->data, g_bytes_unref);
-  g_clear_object (&avatar_data->mime_file);
-  tp_clear_pointer (&avatar_data->mime_type, g_free);
+  AvatarData *avatar_data = g_slice_new0 (AvatarData);
 
-  g_slice_free (WriteAvatarData, avatar_data);
+  g_weak_ref_init (&avatar_data->contact, contact);
+  avatar_data->token = g_strdup (token);
+  return avatar_data;
 }
 
 static void
-mime_file_written (GObject *source_object,
-    GAsyncResult *res,
-    gpointer user_data)
+avatar_data_free (AvatarData *avatar_data)
 {
-  GError *error = NULL;
-  WriteAvatarData *avatar_data = user_data;
-  GFile *file = G_FILE (source_object);
-  TpContact *self;
-  gchar *path = g_file_get_path (file);
-
-  g_assert (file == avatar_data->mime_file);
-
-  if (!g_file_replace_contents_finish (file, res, NULL, &error))
-    {
-      DEBUG ("Failed to store MIME type in cache (%s): %s", path,
-          error->message);
-      g_clear_error (&error);
-    }
-  else
-    {
-      DEBUG ("Contact avatar MIME type stored in cache: %s", path);
-    }
-
-  g_free (path);
+  g_weak_ref_clear (&avatar_data->contact);
+  g_free (avatar_data->token);
+  g_slice_free (AvatarData, avatar_data);
+}
 
-  self = g_weak_ref_get (&avatar_data->contact);
+/* Returns a new reference to the contact that @avatar_data was for, if it
+ * still exists and still has the same avatar token */
+static TpContact *
+avatar_data_dup_contact (AvatarData *avatar_data)
+{
+  TpContact *self = g_weak_ref_get (&avatar_data->contact);
 
   if (self == NULL)
     {
       DEBUG ("No relevant TpContact");
+      return NULL;
     }
-  else if (tp_strdiff (avatar_data->token, self->priv->avatar_token))
+
+  if (tp_strdiff (avatar_data->token, self->priv->avatar_token))
     {
       DEBUG ("Contact's avatar token has changed from %s to %s, "
           "this avatar is no longer relevant",
           avatar_data->token, nonnull (self->priv->avatar_token));
+      g_object_unref (self);
+      return NULL;
     }
-  else
-    {
-      gchar *data_path = g_file_get_path (avatar_data->file);
 
-      DEBUG ("Saved avatar '%s' of MIME type '%s' still used by '%s' to '%s'",
-          avatar_data->token, avatar_data->mime_type,
-          self->priv->identifier, data_path);
-      g_clear_object (&self->priv->avatar_file);
-      self->priv->avatar_file = g_object_ref (avatar_data->file);
+  return self;
+}
 
-      g_free (self->priv->avatar_mime_type);
-      self->priv->avatar_mime_type = g_strdup (avatar_data->mime_type);
+static void
+contact_set_avatar_file (TpContact *self,
+    GFile *file,
+    const gchar *mime_type)
+{
+  g_clear_object (&self->priv->avatar_file);
+  self->priv->avatar_file = g_object_ref (file);
 
-      /* Notify both property changes together once both files have been
-       * written */
-      g_object_notify ((GObject *) self, "avatar-mime-type");
-      g_object_notify ((GObject *) self, "avatar-file");
+  contact_set_interned (self, &self->priv->avatar_mime_type, mime_type);
 
-      g_object_unref (self);
-      g_free (data_path);
-    }
+  if (!contact_changed (self, TP_CONTACT_CHANGE_AVATAR_DATA))
+    return;
 
-  write_avatar_data_free (avatar_data);
+  /* Notify both property changes together */
+  g_object_notify ((GObject *) self, "avatar-mime-type");
+  g_object_notify ((GObject *) self, "avatar-file");
 }
 
 static void
-avatar_file_written (GObject *source_object,
-    GAsyncResult *res,
+avatar_stored_cb (GObject *source_object,
+    GAsyncResult *result,
     gpointer user_data)
 {
+  AvatarData *avatar_data = user_data;
+  TpContact *self;
   GError *error = NULL;
-  WriteAvatarData *avatar_data = user_data;
-  GFile *file = G_FILE (source_object);
-  gchar *path = g_file_get_path (file);
+  gchar *mime_type = NULL;
+  GFile *file;
 
-  g_assert (file == avatar_data->file);
+  file = _tp_avatar_cache_store_finish (result, &mime_type, &error);
 
-  if (!g_file_replace_contents_finish (file, res, NULL, &error))
+  if (file == NULL)
     {
-      DEBUG ("Failed to store avatar in cache (%s): %s",
-          path, error->message);
-      DEBUG ("Storing the MIME type anyway");
+      DEBUG ("Failed to store avatar in cache: %s", error->message);
       g_clear_error (&error);
+      goto finally;
     }
-  else
+
+  self = avatar_data_dup_contact (avatar_data);
+
+  if (self != NULL)
     {
-      DEBUG ("Contact avatar stored in cache: %s",
-          path);
+      gchar *path = g_file_get_path (file);
+
+      DEBUG ("Saved avatar '%s' of MIME type '%s' still used by '%s' to '%s'",
+          avatar_data->token, mime_type, self->priv->identifier, path);
+
+      contact_set_avatar_file (self, file, mime_type);
+
+      g_object_unref (self);
+      g_free (path);
     }
 
-  g_file_replace_contents_async (avatar_data->mime_file,
-      avatar_data->mime_type, strlen (avatar_data->mime_type),
-      NULL, FALSE, G_FILE_CREATE_PRIVATE|G_FILE_CREATE_REPLACE_DESTINATION,
-      NULL, mime_file_written, avatar_data);
+  g_object_unref (file);
 
-  g_free (path);
+finally:
+  g_free (mime_type);
+  avatar_data_free (avatar_data);
 }
 
+static void connection_avatar_request_done (TpConnection *connection,
+    TpHandle handle);
+
 static void
 contact_avatar_retrieved (TpConnection *connection,
     guint handle,
@@ -2952,9 +3208,6 @@ contact_avatar_retrieved (TpConnection *connection,
     GObject *weak_object G_GNUC_UNUSED)
 {
   TpContact *self = _tp_connection_lookup_contact (connection, handle);
-  gchar *filename;
-  gchar *mime_filename;
-  WriteAvatarData *avatar_data;
 
   DEBUG ("token '%s', %u bytes, MIME type '%s'",
       token, avatar->len, mime_type);
@@ -2965,6 +3218,8 @@ contact_avatar_retrieved (TpConnection *connection,
     DEBUG ("used by contact #%u '%s'", handle,
         tp_contact_get_identifier (self));
 
+  connection_avatar_request_done (connection, handle);
+
   if (self != NULL)
     {
       /* Update the avatar token if a newer one is given
@@ -2972,132 +3227,489 @@ contact_avatar_retrieved (TpConnection *connection,
       contact_set_avatar_token (self, token, FALSE);
     }
 
-  if (!build_avatar_filename (connection, token, TRUE, &filename,
-      &mime_filename))
-    {
-      DEBUG ("failed to set up cache");
-      return;
-    }
-
   /* Save avatar in cache, even if the contact is unknown, to avoid as much as
    * possible future avatar requests */
-  avatar_data = g_slice_new0 (WriteAvatarData);
-  avatar_data->connection = g_object_ref (connection);
-  g_weak_ref_set (&avatar_data->contact, self);
-  avatar_data->token = g_strdup (token);
-  avatar_data->file = g_file_new_for_path (filename);
-  /* g_file_replace_contents_async() doesn't copy its argument, see
-   * <https://bugzilla.gnome.org/show_bug.cgi?id=690525>, so we have
-   * to keep a copy around */
-  avatar_data->data = g_bytes_new (avatar->data, avatar->len);
-  avatar_data->mime_file = g_file_new_for_path (mime_filename);
-  avatar_data->mime_type = g_strdup (mime_type);
+  _tp_avatar_cache_store_async (connection, token, avatar, mime_type,
+      avatar_stored_cb, avatar_data_new (self, token));
+}
 
-  g_file_replace_contents_async (avatar_data->file,
-      g_bytes_get_data (avatar_data->data, NULL), avatar->len,
-      NULL, FALSE, G_FILE_CREATE_PRIVATE|G_FILE_CREATE_REPLACE_DESTINATION,
-      NULL, avatar_file_written, avatar_data);
+/* RequestAvatars calls which have not been answered by AvatarRetrieved
+ * after this many seconds are assumed to have failed */
+#define AVATAR_REQUEST_TIMEOUT 60
 
-  g_free (filename);
-  g_free (mime_filename);
-}
+typedef struct {
+    /* monotonic time at which the request was queued */
+    gint64 queued;
+    /* our link in avatar_request_queue, or NULL once RequestAvatars has
+     * been called */
+    GList *link;
+} AvatarRequest;
 
-static gboolean
-connection_avatar_request_idle_cb (gpointer user_data)
+static void connection_schedule_avatar_requests (TpConnection *connection);
+
+static void
+connection_avatar_request_done (TpConnection *connection,
+    TpHandle handle)
 {
-  TpConnection *connection = user_data;
+  AvatarRequest *req;
 
-  DEBUG ("Request %d avatars", connection->priv->avatar_request_queue->len);
+  if (connection->priv->avatar_requests == NULL)
+    return;
 
-  tp_cli_connection_interface_avatars_call_request_avatars (connection, -1,
-      connection->priv->avatar_request_queue, NULL, NULL, NULL, NULL);
+  req = g_hash_table_lookup (connection->priv->avatar_requests,
+      GUINT_TO_POINTER (handle));
 
-  g_array_unref (connection->priv->avatar_request_queue);
-  connection->priv->avatar_request_queue = NULL;
-  connection->priv->avatar_request_idle_id = 0;
+  if (req == NULL)
+    return;
 
-  return FALSE;
+  if (req->link != NULL)
+    {
+      /* someone else asked for this avatar before we got round to it */
+      g_queue_delete_link (&connection->priv->avatar_request_queue,
+          req->link);
+    }
+  else
+    {
+      guint64 latency = g_get_monotonic_time () - req->queued;
+
+      connection->priv->avatar_requests_completed++;
+      connection->priv->avatar_request_total_latency += latency;
+      connection->priv->avatar_request_max_latency = MAX (latency,
+          connection->priv->avatar_request_max_latency);
+    }
+
+  g_hash_table_remove (connection->priv->avatar_requests,
+      GUINT_TO_POINTER (handle));
 }
 
 static void
-contact_update_avatar_data (TpContact *self)
+request_avatars_cb (TpConnection *connection,
+    const GError *error,
+    gpointer user_data,
+    GObject *weak_object G_GNUC_UNUSED)
 {
-  TpConnection *connection;
-  gchar *filename = NULL;
-  gchar *mime_filename = NULL;
+  GArray *handles = user_data;
+  guint i;
 
-  /* If token is NULL, it means that CM doesn't know the token. In that case we
-   * have to request the avatar data to get the token. This happens with XMPP
-   * for offline contacts. We don't want to bypass the avatar cache, so we won't
-   * update avatar. */
-  if (self->priv->avatar_token == NULL)
+  if (error == NULL)
     return;
 
-   /* If token is empty (""), it means the contact has no avatar. */
-  if (tp_str_empty (self->priv->avatar_token))
+  DEBUG ("RequestAvatars failed: %s", error->message);
+
+  /* AvatarRetrieved will not be emitted for these; forget about them, unless
+   * they have been queued again in the meantime */
+  for (i = 0; i < handles->len; i++)
     {
-      tp_clear_object (&self->priv->avatar_file);
+      TpHandle handle = g_array_index (handles, TpHandle, i);
+      AvatarRequest *req = g_hash_table_lookup (
+          connection->priv->avatar_requests, GUINT_TO_POINTER (handle));
 
-      g_free (self->priv->avatar_mime_type);
-      self->priv->avatar_mime_type = NULL;
+      if (req != NULL && req->link == NULL)
+        g_hash_table_remove (connection->priv->avatar_requests,
+            GUINT_TO_POINTER (handle));
+    }
+}
 
-      DEBUG ("contact#%u has no avatar", self->priv->handle);
+static void
+connection_expire_avatar_requests (TpConnection *connection,
+    gint64 now)
+{
+  GHashTableIter iter;
+  gpointer value;
 
-      g_object_notify ((GObject *) self, "avatar-file");
-      g_object_notify ((GObject *) self, "avatar-mime-type");
+  g_hash_table_iter_init (&iter, connection->priv->avatar_requests);
 
-      return;
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      AvatarRequest *req = value;
+
+      if (req->link == NULL &&
+          now - req->queued > AVATAR_REQUEST_TIMEOUT * G_USEC_PER_SEC)
+        g_hash_table_iter_remove (&iter);
     }
+}
 
-  /* We have a token, search in cache... */
-  if (build_avatar_filename (self->priv->connection, self->priv->avatar_token,
-          FALSE, &filename, &mime_filename))
+static gboolean
+connection_avatar_request_cb (gpointer user_data)
+{
+  TpConnection *connection = user_data;
+  guint batch_size = tp_simple_client_factory_get_avatar_request_batch_size (
+      tp_proxy_get_factory (connection));
+  gint64 now = g_get_monotonic_time ();
+  GArray *handles;
+  gpointer h;
+
+  connection->priv->avatar_request_source_id = 0;
+
+  if (g_hash_table_size (connection->priv->avatar_requests) >
+      g_queue_get_length (&connection->priv->avatar_request_queue))
+    connection_expire_avatar_requests (connection, now);
+
+  handles = g_array_new (FALSE, FALSE, sizeof (TpHandle));
+
+  while ((batch_size == 0 || handles->len < batch_size) &&
+      (h = g_queue_pop_head (&connection->priv->avatar_request_queue)) != NULL)
     {
-      if (g_file_test (filename, G_FILE_TEST_EXISTS))
+      TpHandle handle = GPOINTER_TO_UINT (h);
+      AvatarRequest *req = g_hash_table_lookup (
+          connection->priv->avatar_requests, h);
+
+      /* don't bother fetching avatars nobody is interested in any more */
+      if (_tp_connection_lookup_contact (connection, handle) == NULL)
         {
-          GError *error = NULL;
+          g_hash_table_remove (connection->priv->avatar_requests, h);
+          continue;
+        }
 
-          tp_clear_object (&self->priv->avatar_file);
-          self->priv->avatar_file = g_file_new_for_path (filename);
+      req->link = NULL;
+      g_array_append_val (handles, handle);
+    }
 
-          g_free (self->priv->avatar_mime_type);
-          if (!g_file_get_contents (mime_filename, &self->priv->avatar_mime_type,
-              NULL, &error))
-            {
-              DEBUG ("Error reading avatar MIME type (%s): %s", mime_filename,
-                  error ? error->message : "No error message");
-              self->priv->avatar_mime_type = NULL;
-              g_clear_error (&error);
-            }
+  if (handles->len > 0)
+    {
+      DEBUG ("Request %u avatars, %u still queued", handles->len,
+          g_queue_get_length (&connection->priv->avatar_request_queue));
 
-          DEBUG ("contact#%u avatar found in cache: %s, %s",
-              self->priv->handle, filename, self->priv->avatar_mime_type);
+      connection->priv->avatar_request_last_sent = now;
 
-          g_object_notify ((GObject *) self, "avatar-file");
-          g_object_notify ((GObject *) self, "avatar-mime_type");
+      tp_cli_connection_interface_avatars_call_request_avatars (connection, -1,
+          handles, request_avatars_cb, g_array_ref (handles),
+          (GDestroyNotify) g_array_unref, NULL);
+    }
+
+  g_array_unref (handles);
+
+  connection_schedule_avatar_requests (connection);
+  return FALSE;
+}
+
+static void
+connection_schedule_avatar_requests (TpConnection *connection)
+{
+  gint64 interval, elapsed;
+
+  if (connection->priv->avatar_request_source_id != 0 ||
+      g_queue_is_empty (&connection->priv->avatar_request_queue))
+    return;
+
+  interval = tp_simple_client_factory_get_avatar_request_interval (
+      tp_proxy_get_factory (connection));
+  elapsed = (g_get_monotonic_time () -
+      connection->priv->avatar_request_last_sent) / 1000;
+
+  /* We wait for an idle to group contacts for the RequestAvatars call, and
+   * leave at least the configured interval between calls */
+  if (connection->priv->avatar_request_last_sent == 0 || elapsed >= interval)
+    connection->priv->avatar_request_source_id = g_idle_add (
+        connection_avatar_request_cb, connection);
+  else
+    connection->priv->avatar_request_source_id = g_timeout_add (
+        interval - elapsed, connection_avatar_request_cb, connection);
+}
+
+static void
+contact_queue_avatar_request (TpContact *self)
+{
+  TpConnection *connection = self->priv->connection;
+  gpointer h = GUINT_TO_POINTER (self->priv->handle);
+  AvatarRequest *req;
+
+  if (connection->priv->avatar_requests == NULL)
+    connection->priv->avatar_requests = g_hash_table_new_full (NULL, NULL,
+        NULL, g_free);
+
+  req = g_hash_table_lookup (connection->priv->avatar_requests, h);
+
+  /* Already queued: it will fetch whatever the current avatar is. If it was
+   * already sent, the answer might be for an older token, so ask again. */
+  if (req != NULL && req->link != NULL)
+    return;
+
+  req = g_new0 (AvatarRequest, 1);
+  req->queued = g_get_monotonic_time ();
+
+  if (self->priv->avatar_request_urgent)
+    {
+      g_queue_push_head (&connection->priv->avatar_request_queue, h);
+      req->link = connection->priv->avatar_request_queue.head;
+      self->priv->avatar_request_urgent = FALSE;
+    }
+  else
+    {
+      g_queue_push_tail (&connection->priv->avatar_request_queue, h);
+      req->link = connection->priv->avatar_request_queue.tail;
+    }
 
-          goto out;
+  g_hash_table_insert (connection->priv->avatar_requests, h, req);
+
+  connection_schedule_avatar_requests (connection);
+}
+
+/**
+ * tp_connection_prioritize_avatar_requests:
+ * @self: a #TpConnection
+ * @n_contacts: the number of contacts in @contacts
+ * @contacts: (array length=n_contacts): an array of #TpContact objects
+ *  associated with @self, most important first
+ *
+ * Requests the avatars of @contacts, if they need to be downloaded for
+ * %TP_CONTACT_FEATURE_AVATAR_DATA, before those of any other contacts.
+ * This is intended to be called with the contacts that are currently
+ * visible in a user interface, or were recently used.
+ *
+ * Avatars are requested from the connection manager a batch at a time,
+ * as configured by tp_simple_client_factory_set_avatar_request_batch_size()
+ * and tp_simple_client_factory_set_avatar_request_interval(); this only
+ * changes the order in which they are requested. If a contact's avatar is
+ * not waiting to be requested yet, it will be put at the front of the queue
+ * when it is.
+ *
+ * Since: 0.UNRELEASED
+ */
+void
+tp_connection_prioritize_avatar_requests (TpConnection *self,
+    guint n_contacts,
+    TpContact * const *contacts)
+{
+  guint i;
+
+  g_return_if_fail (TP_IS_CONNECTION (self));
+  g_return_if_fail (n_contacts == 0 || contacts != NULL);
+
+  for (i = 0; i < n_contacts; i++)
+    {
+      g_return_if_fail (TP_IS_CONTACT (contacts[i]));
+      g_return_if_fail (contacts[i]->priv->connection == self);
+    }
+
+  /* go backwards, so that contacts[0] ends up at the head of the queue */
+  for (i = n_contacts; i > 0; i--)
+    {
+      TpContact *contact = contacts[i - 1];
+      AvatarRequest *req = NULL;
+
+      if (self->priv->avatar_requests != NULL)
+        req = g_hash_table_lookup (self->priv->avatar_requests,
+            GUINT_TO_POINTER (contact->priv->handle));
+
+      if (req == NULL)
+        {
+          contact->priv->avatar_request_urgent = TRUE;
+        }
+      else if (req->link != NULL)
+        {
+          g_queue_unlink (&self->priv->avatar_request_queue, req->link);
+          g_queue_push_head_link (&self->priv->avatar_request_queue,
+              req->link);
         }
     }
+}
+
+/**
+ * tp_connection_get_avatar_request_stats:
+ * @self: a #TpConnection
+ * @queued: (out) (allow-none): used to return the number of avatars waiting
+ *  to be requested from the connection manager
+ * @in_flight: (out) (allow-none): used to return the number of avatars that
+ *  have been requested but not yet received
+ * @completed: (out) (allow-none): used to return the number of avatars
+ *  received in response to our requests so far
+ * @mean_latency: (out) (allow-none): used to return the average time, in
+ *  microseconds, between deciding to request an avatar and receiving it
+ * @max_latency: (out) (allow-none): used to return the longest such time,
+ *  in microseconds
+ *
+ * Returns statistics about the avatars requested for
+ * %TP_CONTACT_FEATURE_AVATAR_DATA on @self, to help tune
+ * tp_simple_client_factory_set_avatar_request_batch_size() and
+ * tp_simple_client_factory_set_avatar_request_interval().
+ *
+ * Since: 0.UNRELEASED
+ */
+void
+tp_connection_get_avatar_request_stats (TpConnection *self,
+    guint *queued,
+    guint *in_flight,
+    guint64 *completed,
+    guint64 *mean_latency,
+    guint64 *max_latency)
+{
+  guint n_queued, n_requests = 0;
+
+  g_return_if_fail (TP_IS_CONNECTION (self));
+
+  n_queued = g_queue_get_length (&self->priv->avatar_request_queue);
 
-  /* Not found in cache, queue this contact. We do this to group contacts
-   * for the AvatarRequest call */
-  connection = self->priv->connection;
-  if (connection->priv->avatar_request_queue == NULL)
-    connection->priv->avatar_request_queue = g_array_new (FALSE, FALSE,
-        sizeof (TpHandle));
+  if (self->priv->avatar_requests != NULL)
+    n_requests = g_hash_table_size (self->priv->avatar_requests);
 
-  g_array_append_val (connection->priv->avatar_request_queue,
-      self->priv->handle);
+  if (queued != NULL)
+    *queued = n_queued;
 
-  if (connection->priv->avatar_request_idle_id == 0)
-    connection->priv->avatar_request_idle_id = g_idle_add (
-        connection_avatar_request_idle_cb, connection);
+  if (in_flight != NULL)
+    *in_flight = n_requests - n_queued;
 
-out:
+  if (completed != NULL)
+    *completed = self->priv->avatar_requests_completed;
 
-  g_free (filename);
-  g_free (mime_filename);
+  if (mean_latency != NULL)
+    {
+      if (self->priv->avatar_requests_completed == 0)
+        *mean_latency = 0;
+      else
+        *mean_latency = self->priv->avatar_request_total_latency /
+          self->priv->avatar_requests_completed;
+    }
+
+  if (max_latency != NULL)
+    *max_latency = self->priv->avatar_request_max_latency;
+}
+
+/* AvatarData for contacts whose avatars were wanted before the avatar
+ * cache's index was loaded */
+static GQueue avatar_lookups_pending = G_QUEUE_INIT;
+
+static void
+avatar_verified_cb (GObject *source_object,
+    GAsyncResult *result,
+    gpointer user_data)
+{
+  AvatarData *avatar_data = user_data;
+  TpContact *self;
+
+  if (_tp_avatar_cache_verify_finish (result))
+    goto finally;
+
+  self = avatar_data_dup_contact (avatar_data);
+
+  if (self != NULL)
+    {
+      DEBUG ("contact#%u avatar was removed from the cache, requesting it "
+          "again", self->priv->handle);
+      contact_queue_avatar_request (self);
+      g_object_unref (self);
+    }
+
+finally:
+  avatar_data_free (avatar_data);
+}
+
+/* the avatar cache must be loaded */
+static void
+contact_resolve_avatar (TpContact *self)
+{
+  gchar *mime_type = NULL;
+  GFile *file = _tp_avatar_cache_lookup (self->priv->connection,
+      self->priv->avatar_token, &mime_type);
+
+  if (file != NULL)
+    {
+      gchar *path = g_file_get_path (file);
+
+      DEBUG ("contact#%u avatar found in cache: %s, %s",
+          self->priv->handle, path, mime_type);
+
+      contact_set_avatar_file (self, file, mime_type);
+      g_object_unref (file);
+      g_free (path);
+
+      /* another process might have removed it from the cache since we read
+       * the index; if so, we'll download it again */
+      _tp_avatar_cache_verify_async (self->priv->connection,
+          self->priv->avatar_token, avatar_verified_cb,
+          avatar_data_new (self, self->priv->avatar_token));
+    }
+  else
+    {
+      /* Not found in cache, queue this contact */
+      contact_queue_avatar_request (self);
+    }
+
+  g_free (mime_type);
+}
+
+static void
+avatar_cache_loaded_cb (GObject *source_object,
+    GAsyncResult *result,
+    gpointer user_data)
+{
+  AvatarData *avatar_data;
+  GPtrArray *connections = g_ptr_array_new_with_free_func (g_object_unref);
+  guint n = 0;
+  guint i;
+
+  /* answer all the lookups made while we were waiting at once, with one
+   * TpConnection::contacts-changed per connection */
+  while ((avatar_data = g_queue_pop_head (&avatar_lookups_pending)) != NULL)
+    {
+      TpContact *self = avatar_data_dup_contact (avatar_data);
+
+      if (self != NULL)
+        {
+          TpConnection *connection = self->priv->connection;
+
+          if (!tp_g_ptr_array_contains (connections, connection))
+            {
+              g_ptr_array_add (connections, g_object_ref (connection));
+              _tp_contact_changes_begin (connection);
+            }
+
+          contact_resolve_avatar (self);
+          g_object_unref (self);
+          n++;
+        }
+
+      avatar_data_free (avatar_data);
+    }
+
+  for (i = 0; i < connections->len; i++)
+    _tp_contact_changes_end (g_ptr_array_index (connections, i));
+
+  g_ptr_array_unref (connections);
+
+  DEBUG ("answered %u pending avatar lookups", n);
+}
+
+static void
+contact_update_avatar_data (TpContact *self)
+{
+  /* If token is NULL, it means that CM doesn't know the token. In that case we
+   * have to request the avatar data to get the token. This happens with XMPP
+   * for offline contacts. We don't want to bypass the avatar cache, so we won't
+   * update avatar. */
+  if (self->priv->avatar_token == NULL)
+    return;
+
+   /* If token is empty (""), it means the contact has no avatar. */
+  if (tp_str_empty (self->priv->avatar_token))
+    {
+      tp_clear_object (&self->priv->avatar_file);
+
+      contact_set_interned (self, &self->priv->avatar_mime_type, NULL);
+
+      DEBUG ("contact#%u has no avatar", self->priv->handle);
+
+      if (contact_changed (self, TP_CONTACT_CHANGE_AVATAR_DATA))
+        {
+          g_object_notify ((GObject *) self, "avatar-file");
+          g_object_notify ((GObject *) self, "avatar-mime-type");
+        }
+
+      return;
+    }
+
+  /* We have a token, search in cache... */
+  if (_tp_avatar_cache_is_loaded ())
+    {
+      contact_resolve_avatar (self);
+      return;
+    }
+
+  if (g_queue_is_empty (&avatar_lookups_pending))
+    _tp_avatar_cache_load_async (avatar_cache_loaded_cb, NULL);
+
+  g_queue_push_tail (&avatar_lookups_pending,
+      avatar_data_new (self, self->priv->avatar_token));
 }
 
 static void
@@ -3153,9 +3765,10 @@ contact_set_avatar_token (TpContact *self, const gchar *new_token,
   DEBUG ("contact#%u token is %s", self->priv->handle, new_token);
 
   self->priv->has_features |= CONTACT_FEATURE_FLAG_AVATAR_TOKEN;
-  g_free (self->priv->avatar_token);
-  self->priv->avatar_token = g_strdup (new_token);
-  g_object_notify ((GObject *) self, "avatar-token");
+  contact_set_interned (self, &self->priv->avatar_token, new_token);
+
+  if (contact_changed (self, TP_CONTACT_CHANGE_AVATAR_TOKEN))
+    g_object_notify ((GObject *) self, "avatar-token");
 
   if (request && tp_contact_has_feature (self, TP_CONTACT_FEATURE_AVATAR_DATA))
     contact_update_avatar_data (self);
@@ -3171,7 +3784,11 @@ contacts_avatar_updated (TpConnection *connection,
   TpContact *contact = _tp_connection_lookup_contact (connection, handle);
 
   if (contact != NULL)
-    contact_set_avatar_token (contact, new_token, TRUE);
+    {
+      _tp_contact_changes_begin (connection);
+      contact_set_avatar_token (contact, new_token, TRUE);
+      _tp_contact_changes_end (connection);
+    }
 }
 
 
@@ -3188,6 +3805,7 @@ contacts_got_known_avatar_tokens (TpConnection *connection,
 
   if (error == NULL)
     {
+      _tp_contact_changes_begin (connection);
       g_hash_table_iter_init (&iter, handle_to_token);
 
       while (g_hash_table_iter_next (&iter, &key, &value))
@@ -3196,6 +3814,8 @@ contacts_got_known_avatar_tokens (TpConnection *connection,
               NULL, NULL);
         }
 
+      _tp_contact_changes_end (connection);
+
     }
   /* FIXME: perhaps we could fall back to GetAvatarTokens (which should have
    * been called RequestAvatarTokens, because it blocks on network traffic)
@@ -3261,13 +3881,17 @@ contact_maybe_set_info (TpContact *self,
   if (self == NULL)
     return;
 
-  tp_contact_info_list_free (self->priv->contact_info);
-  self->priv->contact_info = NULL;
-
   self->priv->has_features |= CONTACT_FEATURE_FLAG_CONTACT_INFO;
 
-  if (contact_info != NULL)
+  if (self->priv->extras != NULL)
+    tp_clear_pointer (&self->priv->extras->contact_info,
+        tp_contact_info_list_free);
+
+  /* an empty list is the same as no list, so needs no extras */
+  if (contact_info != NULL && contact_info->len > 0)
     {
+      contact_ensure_extras (self);
+
       for (i = contact_info->len; i > 0; i--)
         {
           GValueArray *va = g_ptr_array_index (contact_info, i - 1);
@@ -3276,13 +3900,41 @@ contact_maybe_set_info (TpContact *self,
           GStrv field_value;
 
           tp_value_array_unpack (va, 3, &field_name, &parameters, &field_value);
-          self->priv->contact_info = g_list_prepend (self->priv->contact_info,
+          self->priv->extras->contact_info = g_list_prepend (
+              self->priv->extras->contact_info,
               tp_contact_info_field_new (field_name, parameters, field_value));
         }
     }
   /* else we don't know, but an empty list is perfectly valid. */
 
-  g_object_notify ((GObject *) self, "contact-info");
+  if (contact_changed (self, TP_CONTACT_CHANGE_CONTACT_INFO))
+    g_object_notify ((GObject *) self, "contact-info");
+}
+
+/* Contacts' information which was received from the network less than this
+ * many seconds ago is not requested again */
+#define CONTACT_INFO_MAX_AGE 60
+
+static void
+contact_mark_info_fetched (TpContact *self)
+{
+  if (self == NULL)
+    return;
+
+  contact_ensure_extras (self);
+  self->priv->extras->contact_info_fetched = g_get_monotonic_time ();
+}
+
+static gboolean
+contact_info_is_fresh (TpContact *self)
+{
+  if ((self->priv->has_features & CONTACT_FEATURE_FLAG_CONTACT_INFO) == 0 ||
+      self->priv->extras == NULL ||
+      self->priv->extras->contact_info_fetched == 0)
+    return FALSE;
+
+  return (g_get_monotonic_time () - self->priv->extras->contact_info_fetched <
+      CONTACT_INFO_MAX_AGE * G_USEC_PER_SEC);
 }
 
 static void
@@ -3294,7 +3946,10 @@ contact_info_changed (TpConnection *connection,
 {
   TpContact *self = _tp_connection_lookup_contact (connection, handle);
 
+  _tp_contact_changes_begin (connection);
   contact_maybe_set_info (self, contact_info);
+  contact_mark_info_fetched (self);
+  _tp_contact_changes_end (connection);
 }
 
 static void
@@ -3316,12 +3971,17 @@ contacts_got_contact_info (TpConnection *connection,
       GHashTableIter iter;
       gpointer key, value;
 
+      /* GetContactInfo only returns what the connection manager has cached,
+       * so this doesn't make the information fresh */
+      _tp_contact_changes_begin (connection);
       g_hash_table_iter_init (&iter, info);
       while (g_hash_table_iter_next (&iter, &key, &value))
         {
-          contact_info_changed (connection, GPOINTER_TO_UINT (key),
-              value, NULL, NULL);
+          contact_maybe_set_info (_tp_connection_lookup_contact (connection,
+                GPOINTER_TO_UINT (key)), value);
         }
+
+      _tp_contact_changes_end (connection);
     }
 
   contacts_context_continue (c);
@@ -3365,15 +4025,46 @@ contacts_get_contact_info (ContactsContext *c)
   contacts_context_continue (c);
 }
 
+typedef struct _ContactInfoRequest ContactInfoRequest;
+
 typedef struct
 {
   TpContact *contact;
   GSimpleAsyncResult *result;
-  TpProxyPendingCall *call;
+  /* the request we are waiting for, or NULL */
+  ContactInfoRequest *request;
   GCancellable *cancellable;
   gulong cancelled_id;
 } ContactInfoRequestData;
 
+/* A contact whose information is to be fetched from the network */
+struct _ContactInfoRequest
+{
+  TpHandle handle;
+  /* our link in contact_info_request_queue, or NULL once the request has
+   * been sent */
+  GList *link;
+  /* TRUE if tp_connection_refresh_contact_info() asked for this contact */
+  gboolean refresh;
+  /* borrowed ContactInfoRequestData, completed when we get the information;
+   * if not empty, RequestContactInfo is used rather than RefreshContactInfo */
+  GList *waiters;
+  /* the RequestContactInfo call, once sent */
+  TpProxyPendingCall *call;
+};
+
+static void connection_schedule_contact_info_requests (
+    TpConnection *connection);
+
+static void
+contact_info_request_free (ContactInfoRequest *req)
+{
+  /* waiters keep the connection alive, so there can't be any left */
+  g_assert (req->waiters == NULL);
+
+  g_slice_free (ContactInfoRequest, req);
+}
+
 static void
 contact_info_request_data_free (ContactInfoRequestData *data)
 {
@@ -3388,44 +4079,219 @@ contact_info_request_data_free (ContactInfoRequestData *data)
     }
 }
 
+static void
+contact_info_request_data_complete (ContactInfoRequestData *data,
+    const GError *error)
+{
+  if (data->cancellable != NULL && data->cancelled_id != 0)
+    {
+      /* At this point it's too late to cancel the operation. */
+      g_cancellable_disconnect (data->cancellable, data->cancelled_id);
+      data->cancelled_id = 0;
+    }
+
+  if (error != NULL)
+    g_simple_async_result_set_from_error (data->result, error);
+
+  g_simple_async_result_complete_in_idle (data->result);
+  contact_info_request_data_free (data);
+}
+
+static void
+connection_drop_contact_info_request (TpConnection *connection,
+    ContactInfoRequest *req)
+{
+  if (req->link != NULL)
+    g_queue_delete_link (&connection->priv->contact_info_request_queue,
+        req->link);
+
+  if (req->call != NULL)
+    {
+      tp_proxy_pending_call_cancel (req->call);
+      req->call = NULL;
+    }
+
+  g_hash_table_remove (connection->priv->contact_info_requests,
+      GUINT_TO_POINTER (req->handle));
+}
+
+/* Forget about @req, and complete everyone who was waiting for it */
+static void
+connection_finish_contact_info_request (TpConnection *connection,
+    ContactInfoRequest *req,
+    const GError *error)
+{
+  GList *waiters = req->waiters;
+  GList *l;
+
+  req->waiters = NULL;
+  connection_drop_contact_info_request (connection, req);
+
+  for (l = waiters; l != NULL; l = l->next)
+    {
+      ContactInfoRequestData *data = l->data;
+
+      data->request = NULL;
+      contact_info_request_data_complete (data, error);
+    }
+
+  g_list_free (waiters);
+}
+
 static void
 contact_info_request_cb (TpConnection *connection,
     const GPtrArray *contact_info,
     const GError *error,
     gpointer user_data,
-    GObject *weak_object)
+    GObject *weak_object G_GNUC_UNUSED)
 {
-  ContactInfoRequestData *data = user_data;
-  TpContact *self = data->contact;
-
-  if (data->cancellable != NULL)
-    {
-      /* At this point it's too late to cancel the operation. This will block
-       * until the signal handler has finished if it's already running, so
-       * we're guaranteed to never be in a partially-cancelled state after
-       * this call. */
-      g_cancellable_disconnect (data->cancellable, data->cancelled_id);
+  ContactInfoRequest *req = g_hash_table_lookup (
+      connection->priv->contact_info_requests, user_data);
+  TpContact *self;
 
-      /* If this is true, the cancelled callback has already run and completed the
-       * async result, so just bail. */
-      if (data->cancelled_id == 0)
-        return;
+  g_return_if_fail (req != NULL);
 
-      data->cancelled_id = 0;
-    }
+  /* the call has finished, so there is nothing to cancel */
+  req->call = NULL;
 
   if (error != NULL)
     {
       DEBUG ("Failed to request ContactInfo: %s", error->message);
-      g_simple_async_result_set_from_error (data->result, error);
     }
   else
     {
+      self = _tp_connection_lookup_contact (connection, req->handle);
       contact_maybe_set_info (self, contact_info);
+      contact_mark_info_fetched (self);
     }
 
-  g_simple_async_result_complete_in_idle (data->result);
-  data->call = NULL;
+  connection_finish_contact_info_request (connection, req, error);
+}
+
+static gboolean
+connection_contact_info_request_cb (gpointer user_data)
+{
+  TpConnection *connection = user_data;
+  guint batch_size =
+      tp_simple_client_factory_get_contact_info_request_batch_size (
+          tp_proxy_get_factory (connection));
+  GArray *handles;
+  guint sent = 0;
+  gpointer h;
+
+  connection->priv->contact_info_request_source_id = 0;
+
+  handles = g_array_new (FALSE, FALSE, sizeof (TpHandle));
+
+  while ((batch_size == 0 || sent < batch_size) &&
+      (h = g_queue_pop_head (&connection->priv->contact_info_request_queue))
+          != NULL)
+    {
+      ContactInfoRequest *req = g_hash_table_lookup (
+          connection->priv->contact_info_requests, h);
+      TpContact *contact = _tp_connection_lookup_contact (connection,
+          req->handle);
+
+      req->link = NULL;
+
+      /* Nobody is interested in contacts that have gone away, and the
+       * information might have arrived while the request was queued */
+      if (contact == NULL || contact_info_is_fresh (contact))
+        {
+          connection_finish_contact_info_request (connection, req, NULL);
+          continue;
+        }
+
+      if (req->waiters != NULL)
+        {
+          /* Note that the timeout on this call is set to 1 hour, because the
+           * connection manager might have to fetch the vCard from the
+           * network */
+          req->call =
+              tp_cli_connection_interface_contact_info_call_request_contact_info (
+                  connection, 60*60*1000, req->handle, contact_info_request_cb,
+                  h, NULL, NULL);
+        }
+      else
+        {
+          g_array_append_val (handles, req->handle);
+          g_hash_table_remove (connection->priv->contact_info_requests, h);
+        }
+
+      sent++;
+    }
+
+  if (handles->len > 0)
+    {
+      DEBUG ("Refresh information for %u contacts, %u still queued",
+          handles->len,
+          g_queue_get_length (&connection->priv->contact_info_request_queue));
+
+      tp_cli_connection_interface_contact_info_call_refresh_contact_info (
+          connection, -1, handles, NULL, NULL, NULL, NULL);
+    }
+
+  if (sent > 0)
+    connection->priv->contact_info_request_last_sent = g_get_monotonic_time ();
+
+  g_array_unref (handles);
+
+  connection_schedule_contact_info_requests (connection);
+  return FALSE;
+}
+
+static void
+connection_schedule_contact_info_requests (TpConnection *connection)
+{
+  gint64 interval, elapsed;
+
+  if (connection->priv->contact_info_request_source_id != 0 ||
+      g_queue_is_empty (&connection->priv->contact_info_request_queue))
+    return;
+
+  interval = tp_simple_client_factory_get_contact_info_request_interval (
+      tp_proxy_get_factory (connection));
+  elapsed = (g_get_monotonic_time () -
+      connection->priv->contact_info_request_last_sent) / 1000;
+
+  /* As for avatars, wait for an idle to group contacts, and leave at least
+   * the configured interval between batches */
+  if (connection->priv->contact_info_request_last_sent == 0 ||
+      elapsed >= interval)
+    connection->priv->contact_info_request_source_id = g_idle_add (
+        connection_contact_info_request_cb, connection);
+  else
+    connection->priv->contact_info_request_source_id = g_timeout_add (
+        interval - elapsed, connection_contact_info_request_cb, connection);
+}
+
+/* Returns the request for @handle, queueing a new one if there isn't one
+ * already queued or in flight */
+static ContactInfoRequest *
+connection_queue_contact_info_request (TpConnection *connection,
+    TpHandle handle)
+{
+  gpointer h = GUINT_TO_POINTER (handle);
+  ContactInfoRequest *req;
+
+  if (connection->priv->contact_info_requests == NULL)
+    connection->priv->contact_info_requests = g_hash_table_new_full (NULL,
+        NULL, NULL, (GDestroyNotify) contact_info_request_free);
+
+  req = g_hash_table_lookup (connection->priv->contact_info_requests, h);
+
+  if (req != NULL)
+    return req;
+
+  req = g_slice_new0 (ContactInfoRequest);
+  req->handle = handle;
+
+  g_queue_push_tail (&connection->priv->contact_info_request_queue, h);
+  req->link = connection->priv->contact_info_request_queue.tail;
+  g_hash_table_insert (connection->priv->contact_info_requests, h, req);
+
+  connection_schedule_contact_info_requests (connection);
+  return req;
 }
 
 static void
@@ -3437,9 +4303,7 @@ contact_info_request_cancelled_cb (GCancellable *cancellable,
 
   /* We disconnect from the signal manually; since we're in the cancelled
    * callback, we hold the cancellable's lock so calling this instead of
-   * g_cancellable_disconnect() is fine. We do this here so that
-   * g_cancellable_disconnect() isn't called by contact_info_request_data_free()
-   * which is called by tp_proxy_pending_call_cancel().
+   * g_cancellable_disconnect() is fine.
    * cancelled_id might already be 0 if the cancellable was cancelled before
    * we connected to it. */
   if (data->cancelled_id != 0)
@@ -3456,8 +4320,21 @@ contact_info_request_cancelled_cb (GCancellable *cancellable,
   g_simple_async_result_complete_in_idle (data->result);
   g_clear_error (&error);
 
-  if (data->call != NULL)
-    tp_proxy_pending_call_cancel (data->call);
+  /* If we were cancelled before being queued,
+   * tp_contact_request_contact_info_async() frees @data */
+  if (data->request != NULL)
+    {
+      ContactInfoRequest *req = data->request;
+
+      req->waiters = g_list_remove (req->waiters, data);
+
+      /* Don't bother asking if nobody else is interested */
+      if (req->waiters == NULL && !req->refresh)
+        connection_drop_contact_info_request (data->contact->priv->connection,
+            req);
+
+      contact_info_request_data_free (data);
+    }
 }
 
 /**
@@ -3481,6 +4358,12 @@ contact_info_request_cancelled_cb (GCancellable *cancellable,
  * cancelled to free resources used in the D-Bus call if the caller is no longer
  * interested in the vCard.
  *
+ * Since 0.UNRELEASED, requests are queued and sent to the connection manager
+ * in batches, as described for tp_connection_refresh_contact_info().
+ * Concurrent requests for the same contact share a single D-Bus call, and if
+ * @self's information was received from the network very recently, the
+ * operation succeeds without asking again.
+ *
  * If %TP_CONTACT_FEATURE_CONTACT_INFO is not yet set on @self, it will be
  * set before its property gets updated and @callback is called.
  *
@@ -3504,6 +4387,14 @@ tp_contact_request_contact_info_async (TpContact *self,
   data->result = g_simple_async_result_new (G_OBJECT (self), callback,
       user_data, tp_contact_request_contact_info_finish);
 
+  if (contact_info_is_fresh (self))
+    {
+      DEBUG ("Information for %s is fresh, not requesting it again",
+          self->priv->identifier);
+      contact_info_request_data_complete (data, NULL);
+      return;
+    }
+
   if (cancellable != NULL)
     {
       data->cancellable = g_object_ref (cancellable);
@@ -3512,14 +4403,15 @@ tp_contact_request_contact_info_async (TpContact *self,
 
       /* Return early if the cancellable has already been cancelled */
       if (data->cancelled_id == 0)
-        return;
+        {
+          contact_info_request_data_free (data);
+          return;
+        }
     }
 
-  data->call = tp_cli_connection_interface_contact_info_call_request_contact_info (
-      self->priv->connection, 60*60*1000, self->priv->handle,
-      contact_info_request_cb,
-      data, (GDestroyNotify) contact_info_request_data_free,
-      NULL);
+  data->request = connection_queue_contact_info_request (
+      self->priv->connection, self->priv->handle);
+  data->request->waiters = g_list_prepend (data->request->waiters, data);
 }
 
 /**
@@ -3555,6 +4447,14 @@ tp_contact_request_contact_info_finish (TpContact *self,
  * cached locally. "notify::contact-info" will be emitted when the contact's
  * information are updated.
  *
+ * Since 0.UNRELEASED, the contacts are queued, and the connection manager is
+ * asked for the information of at most
+ * tp_simple_client_factory_get_contact_info_request_batch_size() contacts at
+ * a time, waiting tp_simple_client_factory_get_contact_info_request_interval()
+ * between batches. Contacts which are already queued, and contacts whose
+ * information was received from the network very recently, are not requested
+ * again.
+ *
  * If %TP_CONTACT_FEATURE_CONTACT_INFO is not yet set on a contact, it will be
  * set before its property gets updated.
  *
@@ -3565,7 +4465,6 @@ tp_connection_refresh_contact_info (TpConnection *self,
     guint n_contacts,
     TpContact * const *contacts)
 {
-  GArray *handles;
   guint i;
 
   g_return_if_fail (TP_IS_CONNECTION (self));
@@ -3580,14 +4479,17 @@ tp_connection_refresh_contact_info (TpConnection *self,
 
   contacts_bind_to_contact_info_changed (self);
 
-  handles = g_array_sized_new (FALSE, FALSE, sizeof (TpHandle), n_contacts);
   for (i = 0; i < n_contacts; i++)
-    g_array_append_val (handles, contacts[i]->priv->handle);
+    {
+      ContactInfoRequest *req;
 
-  tp_cli_connection_interface_contact_info_call_refresh_contact_info (self, -1,
-      handles, NULL, NULL, NULL, NULL);
+      if (contact_info_is_fresh (contacts[i]))
+        continue;
 
-  g_array_unref (handles);
+      req = connection_queue_contact_info_request (self,
+          contacts[i]->priv->handle);
+      req->refresh = TRUE;
+    }
 }
 
 static void
@@ -3607,11 +4509,12 @@ contact_set_subscription_states (TpContact *self,
 
   self->priv->has_features |= CONTACT_FEATURE_FLAG_STATES;
 
-  g_free (self->priv->publish_request);
-
   self->priv->subscribe = subscribe;
   self->priv->publish = publish;
-  self->priv->publish_request = g_strdup (publish_request);
+  contact_set_interned (self, &self->priv->publish_request, publish_request);
+
+  if (!contact_changed (self, TP_CONTACT_CHANGE_SUBSCRIPTION_STATES))
+    return;
 
   g_object_notify ((GObject *) self, "subscribe-state");
   g_object_notify ((GObject *) self, "publish-state");
@@ -3646,6 +4549,8 @@ contacts_changed_cb (TpConnection *connection,
   gpointer key, value;
   guint i;
 
+  _tp_contact_changes_begin (connection);
+
   g_hash_table_iter_init (&iter, changes);
   while (g_hash_table_iter_next (&iter, &key, &value))
     {
@@ -3667,6 +4572,8 @@ contacts_changed_cb (TpConnection *connection,
       contact_set_subscription_states (contact, TP_SUBSCRIPTION_STATE_NO,
           TP_SUBSCRIPTION_STATE_NO, NULL);
     }
+
+  _tp_contact_changes_end (connection);
 }
 
 static void
@@ -3692,15 +4599,17 @@ contact_maybe_set_contact_groups (TpContact *self,
 
   self->priv->has_features |= CONTACT_FEATURE_FLAG_CONTACT_GROUPS;
 
-  tp_clear_pointer (&self->priv->contact_groups, g_ptr_array_unref);
-  self->priv->contact_groups = g_ptr_array_new_full (
-      g_strv_length (contact_groups) + 1, g_free);
+  contact_clear_groups (self);
+  self->priv->contact_groups = g_ptr_array_sized_new (
+      g_strv_length (contact_groups) + 1);
 
   for (iter = contact_groups; *iter != NULL; iter++)
-    g_ptr_array_add (self->priv->contact_groups, g_strdup (*iter));
+    g_ptr_array_add (self->priv->contact_groups,
+        (gchar *) contact_intern (self, *iter));
   g_ptr_array_add (self->priv->contact_groups, NULL);
 
-  g_object_notify ((GObject *) self, "contact-groups");
+  if (contact_changed (self, TP_CONTACT_CHANGE_CONTACT_GROUPS))
+    g_object_notify ((GObject *) self, "contact-groups");
 }
 
 static void
@@ -3713,6 +4622,8 @@ contact_groups_changed_cb (TpConnection *connection,
 {
   guint i;
 
+  _tp_contact_changes_begin (connection);
+
   for (i = 0; i < contacts->len; i++)
     {
       TpHandle handle = g_array_index (contacts, TpHandle, i);
@@ -3738,6 +4649,7 @@ contact_groups_changed_cb (TpConnection *connection,
               if (!tp_strdiff (str, *iter))
                 {
                   g_ptr_array_remove_index_fast (contact->priv->contact_groups, j);
+                  contact_release (contact, str);
                   break;
                 }
             }
@@ -3745,15 +4657,21 @@ contact_groups_changed_cb (TpConnection *connection,
 
       /* Add new groups */
       for (iter = added; *iter != NULL; iter++)
-        g_ptr_array_add (contact->priv->contact_groups, g_strdup (*iter));
+        g_ptr_array_add (contact->priv->contact_groups,
+            (gchar *) contact_intern (contact, *iter));
 
       /* Add back the ending NULL */
       g_ptr_array_add (contact->priv->contact_groups, NULL);
 
-      g_object_notify ((GObject *) contact, "contact-groups");
-      g_signal_emit (contact, signals[SIGNAL_CONTACT_GROUPS_CHANGED], 0,
-          added, removed);
+      if (contact_changed (contact, TP_CONTACT_CHANGE_CONTACT_GROUPS))
+        {
+          g_object_notify ((GObject *) contact, "contact-groups");
+          g_signal_emit (contact, signals[SIGNAL_CONTACT_GROUPS_CHANGED], 0,
+              added, removed);
+        }
     }
+
+  _tp_contact_changes_end (connection);
 }
 
 static void
@@ -3961,9 +4879,9 @@ tp_contact_set_attributes (TpContact *contact,
       else
         {
           contact->priv->has_features |= CONTACT_FEATURE_FLAG_ALIAS;
-          g_free (contact->priv->alias);
-          contact->priv->alias = g_strdup (s);
-          g_object_notify ((GObject *) contact, "alias");
+          contact_set_interned (contact, &contact->priv->alias, s);
+          if (contact_changed (contact, TP_CONTACT_CHANGE_ALIAS))
+            g_object_notify ((GObject *) contact, "alias");
         }
     }
 
@@ -4371,11 +5289,107 @@ _tp_contacts_bind_to_signals (TpConnection *connection,
   return contacts_bind_to_signals (connection, feature_flags, NULL);
 }
 
+/* ContactsContext merged into one GetContactAttributes call */
+typedef struct {
+    GPtrArray *contexts;
+} ContactAttributesBatch;
+
+static void
+contact_attributes_batch_free (gpointer p)
+{
+  ContactAttributesBatch *batch = p;
+
+  g_ptr_array_foreach (batch->contexts, (GFunc) contacts_context_unref, NULL);
+  g_ptr_array_unref (batch->contexts);
+  g_slice_free (ContactAttributesBatch, batch);
+}
+
+static void
+contacts_batch_got_attributes (TpConnection *connection,
+    GHashTable *attributes,
+    const GError *error,
+    gpointer user_data,
+    GObject *weak_object)
+{
+  ContactAttributesBatch *batch = user_data;
+  guint i;
+
+  for (i = 0; i < batch->contexts->len; i++)
+    {
+      ContactsContext *c = g_ptr_array_index (batch->contexts, i);
+
+      /* the call would not have been made on behalf of this context alone,
+       * so we have to check its weak object ourselves */
+      if (c->no_purpose_in_life)
+        {
+          DEBUG ("%p: no purpose in life", c);
+          continue;
+        }
+
+      contacts_got_attributes (connection, attributes, error, c, NULL);
+    }
+}
+
+static gboolean
+contacts_batch_idle_cb (gpointer user_data)
+{
+  TpConnection *connection = user_data;
+  ContactAttributesBatch *batch = g_slice_new0 (ContactAttributesBatch);
+  ContactFeatureFlags wanted = 0;
+  gboolean hold = FALSE;
+  TpIntset *seen = tp_intset_new ();
+  GArray *handles = g_array_new (FALSE, FALSE, sizeof (TpHandle));
+  const gchar **supported_interfaces;
+  guint i, j;
+
+  batch->contexts = connection->priv->contact_attributes_batch;
+  connection->priv->contact_attributes_batch = NULL;
+  connection->priv->contact_attributes_batch_idle_id = 0;
+
+  for (i = 0; i < batch->contexts->len; i++)
+    {
+      ContactsContext *c = g_ptr_array_index (batch->contexts, i);
+
+      wanted |= c->wanted;
+
+      if (c->signature == CB_BY_HANDLE && c->contacts->len == 0)
+        hold = TRUE;
+
+      for (j = 0; j < c->handles->len; j++)
+        {
+          TpHandle handle = g_array_index (c->handles, TpHandle, j);
+
+          if (!tp_intset_is_member (seen, handle))
+            {
+              tp_intset_add (seen, handle);
+              g_array_append_val (handles, handle);
+            }
+        }
+    }
+
+  supported_interfaces = contacts_bind_to_signals (connection, wanted, NULL);
+
+  DEBUG ("calling GetContactAttributes for %u handles on behalf of %u "
+      "requests", handles->len, batch->contexts->len);
+
+  for (i = 0; supported_interfaces[i] != NULL; i++)
+    DEBUG ("- %s", supported_interfaces[i]);
+
+  tp_cli_connection_interface_contacts_call_get_contact_attributes (
+      connection, -1, handles, supported_interfaces, hold,
+      contacts_batch_got_attributes, batch, contact_attributes_batch_free,
+      NULL);
+
+  g_free (supported_interfaces);
+  g_array_unref (handles);
+  tp_intset_destroy (seen);
+  return FALSE;
+}
+
 static void
 contacts_get_attributes (ContactsContext *context)
 {
   const gchar **supported_interfaces;
-  guint i;
 
   /* tp_connection_get_contact_attributes insists that you have at least one
    * handle; skip it if we don't (can only happen if we started from IDs) */
@@ -4400,20 +5414,25 @@ contacts_get_attributes (ContactsContext *context)
       return;
     }
 
-  /* The Hold parameter is only true if we started from handles, and we don't
-   * already have all the contacts we need. */
+  g_free (supported_interfaces);
+
+  /* Requests made during the same main loop iteration are merged into a
+   * single GetContactAttributes call for the union of their handles and
+   * interfaces. The Hold parameter is only true if one of them started from
+   * handles, and doesn't already have all the contacts it needs. */
   context->refcount++;
-  DEBUG ("calling GetContactAttributes");
+  DEBUG ("%p: queueing GetContactAttributes", context);
 
-  for (i = 0; supported_interfaces[i] != NULL; i++)
-    DEBUG ("- %s", supported_interfaces[i]);
+  if (context->connection->priv->contact_attributes_batch == NULL)
+    context->connection->priv->contact_attributes_batch =
+      g_ptr_array_new ();
 
-  tp_cli_connection_interface_contacts_call_get_contact_attributes (
-      context->connection, -1, context->handles, supported_interfaces,
-      (context->signature == CB_BY_HANDLE && context->contacts->len == 0),
-      contacts_got_attributes,
-      context, contacts_context_unref, context->weak_object);
-  g_free (supported_interfaces);
+  g_ptr_array_add (context->connection->priv->contact_attributes_batch,
+      context);
+
+  if (context->connection->priv->contact_attributes_batch_idle_id == 0)
+    context->connection->priv->contact_attributes_batch_idle_id =
+      g_idle_add (contacts_batch_idle_cb, context->connection);
 }
 
 /*
@@ -5158,7 +6177,8 @@ _tp_contact_set_is_blocked (TpContact *self,
 
   self->priv->is_blocked = is_blocked;
 
-  g_object_notify ((GObject *) self, "is-blocked");
+  if (contact_changed (self, TP_CONTACT_CHANGE_CONTACT_BLOCKING))
+    g_object_notify ((GObject *) self, "is-blocked");
 }
 
 /**
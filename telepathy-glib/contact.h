@@ -76,6 +76,20 @@ typedef enum {
 #define NUM_TP_CONTACT_FEATURES TP_NUM_CONTACT_FEATURES
 #define TP_CONTACT_FEATURE_INVALID ((TpContactFeature) -1)
 
+typedef enum /*< flags >*/ {
+    TP_CONTACT_CHANGE_ALIAS = 1 << 0,
+    TP_CONTACT_CHANGE_AVATAR_TOKEN = 1 << 1,
+    TP_CONTACT_CHANGE_PRESENCE = 1 << 2,
+    TP_CONTACT_CHANGE_LOCATION = 1 << 3,
+    TP_CONTACT_CHANGE_CAPABILITIES = 1 << 4,
+    TP_CONTACT_CHANGE_AVATAR_DATA = 1 << 5,
+    TP_CONTACT_CHANGE_CONTACT_INFO = 1 << 6,
+    TP_CONTACT_CHANGE_CLIENT_TYPES = 1 << 7,
+    TP_CONTACT_CHANGE_SUBSCRIPTION_STATES = 1 << 8,
+    TP_CONTACT_CHANGE_CONTACT_GROUPS = 1 << 9,
+    TP_CONTACT_CHANGE_CONTACT_BLOCKING = 1 << 10,
+} TpContactChangeFlags;
+
 /* Basic functionality, always available */
 _TP_AVAILABLE_IN_0_20
 TpAccount *tp_contact_get_account (TpContact *self);
@@ -212,11 +226,39 @@ gboolean tp_connection_upgrade_contacts_finish (TpConnection *self,
     GPtrArray **contacts,
     GError **error);
 
+_TP_AVAILABLE_IN_UNRELEASED
+void tp_connection_prioritize_avatar_requests (TpConnection *self,
+    guint n_contacts, TpContact * const *contacts);
+_TP_AVAILABLE_IN_UNRELEASED
+void tp_connection_get_avatar_request_stats (TpConnection *self,
+    guint *queued,
+    guint *in_flight,
+    guint64 *completed,
+    guint64 *mean_latency,
+    guint64 *max_latency);
+
 /* TP_CONTACT_FEATURE_CONTACT_BLOCKING */
 
 _TP_AVAILABLE_IN_0_18
 gboolean tp_contact_is_blocked (TpContact *self);
 
+/* avatar-cache.c */
+
+_TP_AVAILABLE_IN_UNRELEASED
+void tp_contact_avatar_cache_set_quota (guint64 max_bytes);
+_TP_AVAILABLE_IN_UNRELEASED
+guint64 tp_contact_avatar_cache_get_quota (void);
+_TP_AVAILABLE_IN_UNRELEASED
+gboolean tp_contact_avatar_cache_get_usage (guint64 *bytes,
+    guint *n_images);
+_TP_AVAILABLE_IN_UNRELEASED
+void tp_contact_avatar_cache_compact_async (GAsyncReadyCallback callback,
+    gpointer user_data);
+_TP_AVAILABLE_IN_UNRELEASED
+gboolean tp_contact_avatar_cache_compact_finish (GAsyncResult *result,
+    guint64 *bytes_freed,
+    GError **error);
+
 G_END_DECLS
 
 #endif
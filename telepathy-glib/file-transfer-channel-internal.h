@@ -0,0 +1,37 @@
+/*<private_header>*/
+/*
+ * TpFileTransferChannel - proxy for a file transfer channel (internals)
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef TP_FILE_TRANSFER_CHANNEL_INTERNAL_H
+#define TP_FILE_TRANSFER_CHANNEL_INTERNAL_H
+
+#include <telepathy-glib/file-transfer-channel.h>
+
+G_BEGIN_DECLS
+
+/* for the tests: make sendfile() and splice() fail with errsv, or 0 to
+ * really call them */
+void _tp_file_transfer_channel_set_zero_copy_error (
+    TpFileTransferChannel *self,
+    int errsv);
+
+G_END_DECLS
+
+#endif
@@ -94,6 +94,11 @@
  * Since: 0.15.5
  */
 
+#ifndef _GNU_SOURCE
+/* for splice() */
+#define _GNU_SOURCE
+#endif
+
 #include "config.h"
 
 #include "telepathy-glib/file-transfer-channel.h"
@@ -111,16 +116,47 @@
 #include "telepathy-glib/automatic-client-factory-internal.h"
 #include "telepathy-glib/channel-internal.h"
 #include "telepathy-glib/debug-internal.h"
+#include "telepathy-glib/file-transfer-channel-internal.h"
 
+#include <errno.h>
 #include <stdio.h>
 #include <glib.h>
 #include <glib/gstdio.h>
 
 #ifdef HAVE_GIO_UNIX
+#include <gio/gfiledescriptorbased.h>
 #include <gio/gunixsocketaddress.h>
 #include <gio/gunixconnection.h>
+#include <glib-unix.h>
+#include <unistd.h>
 #endif /* HAVE_GIO_UNIX */
 
+#if defined(HAVE_GIO_UNIX) && defined(HAVE_SYS_SENDFILE_H) && \
+    defined(HAVE_SENDFILE)
+#include <sys/sendfile.h>
+#define ZERO_COPY_SEND
+#endif
+
+#if defined(HAVE_GIO_UNIX) && defined(HAVE_SPLICE)
+#include <fcntl.h>
+#define ZERO_COPY_RECEIVE
+#endif
+
+/* how much to move in one go when the kernel copies the data for us */
+#define DEFAULT_BUFFER_SIZE (256 * 1024)
+
+/* The throughput is averaged over the last N_PROGRESS_SAMPLES samples,
+ * taken at least PROGRESS_SAMPLE_SPACING microseconds apart, i.e. over
+ * the last few seconds */
+#define N_PROGRESS_SAMPLES 20
+#define PROGRESS_SAMPLE_SPACING (G_USEC_PER_SEC / 4)
+
+typedef struct {
+    /* monotonic */
+    gint64 time;
+    guint64 count;
+} ProgressSample;
+
 G_DEFINE_TYPE (TpFileTransferChannel, tp_file_transfer_channel, TP_TYPE_CHANNEL)
 
 struct _TpFileTransferChannelPrivate
@@ -162,6 +198,27 @@ struct _TpFileTransferChannelPrivate
 
     GSimpleAsyncResult *result;
     GCancellable *cancellable;
+
+    /* 0 for DEFAULT_BUFFER_SIZE */
+    gsize buffer_size;
+    /* for splice(): socket -> pipe -> file */
+    int pipe_fds[2];
+    /* whether any data has been moved by sendfile() or splice() yet */
+    gboolean zero_copy_started;
+    /* if not 0, what sendfile() and splice() pretend to fail with */
+    int zero_copy_error;
+
+    /* in milliseconds; 0 to notify every change */
+    guint progress_interval;
+    /* monotonic time of the last notify::transferred-bytes, or 0 */
+    gint64 progress_notified_at;
+    guint progress_notify_id;
+    /* ring buffer, oldest at (next_sample - n_samples) */
+    ProgressSample samples[N_PROGRESS_SAMPLES];
+    guint n_samples;
+    guint next_sample;
+    /* bytes per second */
+    guint64 throughput;
 };
 
 enum /* properties */
@@ -177,6 +234,8 @@ enum /* properties */
   PROP_INITIAL_OFFSET,
   PROP_SERVICE_NAME,
   PROP_METADATA,
+  PROP_THROUGHPUT,
+  PROP_ESTIMATED_TIME_REMAINING,
   N_PROPS
 };
 
@@ -231,6 +290,287 @@ splice_stream_ready_cb (GObject *output,
   g_object_unref (self);
 }
 
+static void
+start_splice (TpFileTransferChannel *self)
+{
+  if (tp_channel_get_requested (TP_CHANNEL (self)))
+    {
+      GOutputStream *stream;
+
+      stream = g_io_stream_get_output_stream (self->priv->stream);
+
+      g_output_stream_splice_async (stream, self->priv->in_stream,
+          G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE |
+          G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+          G_PRIORITY_DEFAULT, self->priv->cancellable,
+          splice_stream_ready_cb, g_object_ref (self));
+    }
+  else
+    {
+      GInputStream *stream;
+
+      stream = g_io_stream_get_input_stream (self->priv->stream);
+
+      g_output_stream_splice_async (self->priv->out_stream, stream,
+          G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE |
+          G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+          G_PRIORITY_DEFAULT, self->priv->cancellable,
+          splice_stream_ready_cb, g_object_ref (self));
+    }
+}
+
+#if defined(ZERO_COPY_SEND) || defined(ZERO_COPY_RECEIVE)
+
+/* Does what the CLOSE_SOURCE and CLOSE_TARGET flags passed to
+ * g_output_stream_splice_async() do for start_splice() */
+static void
+zero_copy_finished (TpFileTransferChannel *self,
+    const gchar *what,
+    int errsv)
+{
+  GError *error = NULL;
+
+  if (errsv != 0 && errsv != ECANCELED)
+    DEBUG ("%s failed: %s", what, g_strerror (errsv));
+
+  if (self->priv->pipe_fds[0] >= 0)
+    {
+      close (self->priv->pipe_fds[0]);
+      close (self->priv->pipe_fds[1]);
+      self->priv->pipe_fds[0] = self->priv->pipe_fds[1] = -1;
+    }
+
+  if (self->priv->in_stream != NULL &&
+      !g_input_stream_close (self->priv->in_stream, NULL, &error))
+    {
+      DEBUG ("Failed to close file: %s", error->message);
+      g_clear_error (&error);
+    }
+
+  if (self->priv->out_stream != NULL &&
+      !g_output_stream_close (self->priv->out_stream, NULL, &error))
+    {
+      DEBUG ("Failed to close file: %s", error->message);
+      g_clear_error (&error);
+    }
+
+  if (self->priv->stream != NULL)
+    g_io_stream_close_async (self->priv->stream, G_PRIORITY_DEFAULT,
+        NULL, stream_close_cb, g_object_ref (self));
+}
+
+/* If the kernel turns down the first attempt, e.g. because the file
+ * system doesn't support it, fall back to copying the data ourselves */
+static gboolean
+zero_copy_unsupported (TpFileTransferChannel *self,
+    int errsv)
+{
+  if (self->priv->zero_copy_started ||
+      (errsv != EINVAL && errsv != ENOSYS))
+    return FALSE;
+
+  DEBUG ("zero-copy transfer not supported here, falling back: %s",
+      g_strerror (errsv));
+
+  if (self->priv->pipe_fds[0] >= 0)
+    {
+      close (self->priv->pipe_fds[0]);
+      close (self->priv->pipe_fds[1]);
+      self->priv->pipe_fds[0] = self->priv->pipe_fds[1] = -1;
+    }
+
+  start_splice (self);
+  return TRUE;
+}
+
+static void
+watch_socket (TpFileTransferChannel *self,
+    GIOCondition condition,
+    GSocketSourceFunc callback)
+{
+  GSource *source;
+
+  source = g_socket_create_source (self->priv->client_socket, condition,
+      self->priv->cancellable);
+  g_source_set_callback (source, (GSourceFunc) callback,
+      g_object_ref (self), g_object_unref);
+  g_source_attach (source, g_main_context_get_thread_default ());
+  g_source_unref (source);
+}
+
+#endif /* ZERO_COPY_SEND || ZERO_COPY_RECEIVE */
+
+#ifdef ZERO_COPY_SEND
+
+static gboolean
+sendfile_cb (GSocket *socket,
+    GIOCondition condition,
+    gpointer user_data)
+{
+  TpFileTransferChannel *self = user_data;
+  int in_fd = g_file_descriptor_based_get_fd (
+      G_FILE_DESCRIPTOR_BASED (self->priv->in_stream));
+  gssize n;
+
+  /* self->priv->cancellable and stream are cleared when disposed */
+  if (self->priv->stream == NULL ||
+      g_cancellable_is_cancelled (self->priv->cancellable))
+    {
+      zero_copy_finished (self, "sendfile", ECANCELED);
+      return FALSE;
+    }
+
+  if (self->priv->zero_copy_error != 0)
+    {
+      n = -1;
+      errno = self->priv->zero_copy_error;
+    }
+  else
+    {
+      /* from the file's current position, which it advances */
+      do
+        n = sendfile (g_socket_get_fd (socket), in_fd, NULL,
+            tp_file_transfer_channel_get_buffer_size (self));
+      while (n < 0 && errno == EINTR);
+    }
+
+  if (n > 0)
+    {
+      self->priv->zero_copy_started = TRUE;
+      return TRUE;
+    }
+
+  if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    return TRUE;
+
+  if (n < 0 && zero_copy_unsupported (self, errno))
+    return FALSE;
+
+  zero_copy_finished (self, "sendfile", n < 0 ? errno : 0);
+  return FALSE;
+}
+
+#endif /* ZERO_COPY_SEND */
+
+#ifdef ZERO_COPY_RECEIVE
+
+static gboolean
+splice_cb (GSocket *socket,
+    GIOCondition condition,
+    gpointer user_data)
+{
+  TpFileTransferChannel *self = user_data;
+  int out_fd = g_file_descriptor_based_get_fd (
+      G_FILE_DESCRIPTOR_BASED (self->priv->out_stream));
+  gssize n;
+
+  /* self->priv->cancellable and stream are cleared when disposed */
+  if (self->priv->stream == NULL ||
+      g_cancellable_is_cancelled (self->priv->cancellable))
+    {
+      zero_copy_finished (self, "splice", ECANCELED);
+      return FALSE;
+    }
+
+  if (self->priv->zero_copy_error != 0)
+    {
+      n = -1;
+      errno = self->priv->zero_copy_error;
+    }
+  else
+    {
+      do
+        n = splice (g_socket_get_fd (socket), NULL, self->priv->pipe_fds[1],
+            NULL, tp_file_transfer_channel_get_buffer_size (self),
+            SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+      while (n < 0 && errno == EINTR);
+    }
+
+  if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    return TRUE;
+
+  if (n < 0 && zero_copy_unsupported (self, errno))
+    return FALSE;
+
+  if (n <= 0)
+    {
+      zero_copy_finished (self, "splice", n < 0 ? errno : 0);
+      return FALSE;
+    }
+
+  self->priv->zero_copy_started = TRUE;
+
+  /* The file is a regular file, so draining the pipe into it doesn't wait
+   * for anyone else */
+  while (n > 0)
+    {
+      gssize written = splice (self->priv->pipe_fds[0], NULL, out_fd, NULL,
+          n, SPLICE_F_MOVE);
+
+      if (written < 0 && errno == EINTR)
+        continue;
+
+      if (written <= 0)
+        {
+          zero_copy_finished (self, "splice", written < 0 ? errno : EIO);
+          return FALSE;
+        }
+
+      n -= written;
+    }
+
+  return TRUE;
+}
+
+#endif /* ZERO_COPY_RECEIVE */
+
+/* Let the kernel move the data between a local file and the socket,
+ * without copying it through userspace */
+static gboolean
+start_zero_copy (TpFileTransferChannel *self)
+{
+  if (tp_channel_get_requested (TP_CHANNEL (self)))
+    {
+#ifdef ZERO_COPY_SEND
+      if (G_IS_FILE_DESCRIPTOR_BASED (self->priv->in_stream))
+        {
+          DEBUG ("sending with sendfile()");
+          watch_socket (self, G_IO_OUT, sendfile_cb);
+          return TRUE;
+        }
+#endif
+    }
+  else
+    {
+#ifdef ZERO_COPY_RECEIVE
+      GError *error = NULL;
+
+      if (!G_IS_FILE_DESCRIPTOR_BASED (self->priv->out_stream))
+        return FALSE;
+
+      if (!g_unix_open_pipe (self->priv->pipe_fds, FD_CLOEXEC, &error))
+        {
+          DEBUG ("Failed to create a pipe: %s", error->message);
+          g_clear_error (&error);
+          self->priv->pipe_fds[0] = self->priv->pipe_fds[1] = -1;
+          return FALSE;
+        }
+
+#ifdef F_SETPIPE_SZ
+      /* best effort: the pipe is the most that can be moved at a time */
+      fcntl (self->priv->pipe_fds[1], F_SETPIPE_SZ, (int) MIN (
+            tp_file_transfer_channel_get_buffer_size (self), G_MAXINT));
+#endif
+
+      DEBUG ("receiving with splice()");
+      watch_socket (self, G_IO_IN, splice_cb);
+      return TRUE;
+#endif
+    }
+
+  return FALSE;
+}
+
 static void
 client_socket_connected (TpFileTransferChannel *self)
 {
@@ -268,30 +608,8 @@ client_socket_connected (TpFileTransferChannel *self)
 
   self->priv->stream = G_IO_STREAM (conn);
 
-  if (tp_channel_get_requested (TP_CHANNEL (self)))
-    {
-      GOutputStream *stream;
-
-      stream = g_io_stream_get_output_stream (G_IO_STREAM (conn));
-
-      g_output_stream_splice_async (stream, self->priv->in_stream,
-          G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE |
-          G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
-          G_PRIORITY_DEFAULT, self->priv->cancellable,
-          splice_stream_ready_cb, g_object_ref (self));
-    }
-  else
-    {
-      GInputStream *stream;
-
-      stream = g_io_stream_get_input_stream (G_IO_STREAM (conn));
-
-      g_output_stream_splice_async (self->priv->out_stream, stream,
-          G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE |
-          G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
-          G_PRIORITY_DEFAULT, self->priv->cancellable,
-          splice_stream_ready_cb, g_object_ref (self));
-    }
+  if (!start_zero_copy (self))
+    start_splice (self);
 }
 
 static gboolean
@@ -317,6 +635,7 @@ client_socket_cb (GSocket *socket,
 /* Callbacks */
 
 static void start_transfer (TpFileTransferChannel *self);
+static void notify_progress (TpFileTransferChannel *self);
 
 static void
 tp_file_transfer_channel_state_changed_cb (TpChannel *proxy,
@@ -341,6 +660,13 @@ tp_file_transfer_channel_state_changed_cb (TpChannel *proxy,
   self->priv->state = state;
   self->priv->state_reason = reason;
 
+  if (state == TP_FILE_TRANSFER_STATE_OPEN)
+    self->priv->n_samples = 0;
+
+  /* so the last progress is seen before the transfer is over */
+  if (self->priv->progress_notify_id != 0)
+    notify_progress (self);
+
   /* If the channel is open AND we have the socket path, we can start the
    * transfer. The socket path could be NULL if we are not doing the actual
    * data transfer but are just an observer for the channel. */
@@ -365,6 +691,72 @@ tp_file_transfer_channel_initial_offset_defined_cb (TpChannel *proxy,
   g_object_notify (G_OBJECT (self), "initial-offset");
 }
 
+static void
+notify_progress (TpFileTransferChannel *self)
+{
+  if (self->priv->progress_notify_id != 0)
+    {
+      g_source_remove (self->priv->progress_notify_id);
+      self->priv->progress_notify_id = 0;
+    }
+
+  self->priv->progress_notified_at = g_get_monotonic_time ();
+
+  g_object_freeze_notify (G_OBJECT (self));
+  g_object_notify (G_OBJECT (self), "transferred-bytes");
+  g_object_notify (G_OBJECT (self), "throughput");
+  g_object_notify (G_OBJECT (self), "estimated-time-remaining");
+  g_object_thaw_notify (G_OBJECT (self));
+}
+
+static gboolean
+notify_progress_cb (gpointer user_data)
+{
+  TpFileTransferChannel *self = user_data;
+
+  self->priv->progress_notify_id = 0;
+  notify_progress (self);
+  return FALSE;
+}
+
+static void
+update_throughput (TpFileTransferChannel *self,
+    guint64 count)
+{
+  gint64 now = g_get_monotonic_time ();
+  ProgressSample *oldest, *newest = NULL;
+
+  if (self->priv->n_samples > 0)
+    {
+      newest = &self->priv->samples[(self->priv->next_sample +
+          N_PROGRESS_SAMPLES - 1) % N_PROGRESS_SAMPLES];
+
+      /* the transfer restarted from an earlier offset? start again */
+      if (count < newest->count)
+        self->priv->n_samples = 0;
+    }
+
+  if (self->priv->n_samples == 0 ||
+      now - newest->time >= PROGRESS_SAMPLE_SPACING)
+    {
+      self->priv->samples[self->priv->next_sample].time = now;
+      self->priv->samples[self->priv->next_sample].count = count;
+      self->priv->next_sample =
+        (self->priv->next_sample + 1) % N_PROGRESS_SAMPLES;
+      self->priv->n_samples = MIN (self->priv->n_samples + 1,
+          N_PROGRESS_SAMPLES);
+    }
+
+  oldest = &self->priv->samples[(self->priv->next_sample +
+      N_PROGRESS_SAMPLES - self->priv->n_samples) % N_PROGRESS_SAMPLES];
+
+  if (now > oldest->time)
+    self->priv->throughput = (count - oldest->count) * G_USEC_PER_SEC /
+        (now - oldest->time);
+  else if (self->priv->n_samples == 1)
+    self->priv->throughput = 0;
+}
+
 static void
 tp_file_transfer_channel_transferred_bytes_changed_cb (TpChannel *proxy,
     guint64 count,
@@ -372,9 +764,27 @@ tp_file_transfer_channel_transferred_bytes_changed_cb (TpChannel *proxy,
     GObject *weak_object)
 {
   TpFileTransferChannel *self = (TpFileTransferChannel *) proxy;
+  gint64 elapsed;
 
   self->priv->transferred_bytes = count;
-  g_object_notify (G_OBJECT (self), "transferred-bytes");
+  update_throughput (self, count);
+
+  elapsed = g_get_monotonic_time () - self->priv->progress_notified_at;
+
+  if (self->priv->progress_interval == 0 ||
+      elapsed >= (gint64) self->priv->progress_interval * 1000)
+    {
+      notify_progress (self);
+    }
+  else if (self->priv->progress_notify_id == 0)
+    {
+      /* round up, so we don't wake up just too early */
+      guint remaining = ((gint64) self->priv->progress_interval * 1000 -
+          elapsed + 999) / 1000;
+
+      self->priv->progress_notify_id = g_timeout_add (remaining,
+          notify_progress_cb, self);
+    }
 }
 
 static void
@@ -674,6 +1084,15 @@ tp_file_transfer_channel_get_property (GObject *object,
         g_value_set_boxed (value, self->priv->metadata);
         break;
 
+      case PROP_THROUGHPUT:
+        g_value_set_uint64 (value, self->priv->throughput);
+        break;
+
+      case PROP_ESTIMATED_TIME_REMAINING:
+        g_value_set_int64 (value,
+            tp_file_transfer_channel_get_estimated_time_remaining (self));
+        break;
+
       default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
         break;
@@ -710,6 +1129,12 @@ tp_file_transfer_channel_dispose (GObject *obj)
 {
   TpFileTransferChannel *self = (TpFileTransferChannel *) obj;
 
+  if (self->priv->progress_notify_id != 0)
+    {
+      g_source_remove (self->priv->progress_notify_id);
+      self->priv->progress_notify_id = 0;
+    }
+
   tp_clear_pointer (&self->priv->date, g_date_time_unref);
   g_clear_object (&self->priv->file);
   tp_clear_pointer (&self->priv->metadata, g_hash_table_unref);
@@ -1003,6 +1428,47 @@ tp_file_transfer_channel_class_init (TpFileTransferChannelClass *klass)
   g_object_class_install_property (object_class, PROP_METADATA,
       param_spec);
 
+  /**
+   * TpFileTransferChannel:throughput:
+   *
+   * The rate at which the file has been transferred over the last few
+   * seconds, in bytes per second, or 0 if not known yet. This is computed
+   * from #TpFileTransferChannel:transferred-bytes, and changes with it.
+   *
+   * The %TP_FILE_TRANSFER_CHANNEL_FEATURE_CORE feature has to be
+   * prepared for this property to be meaningful and kept up to date.
+   *
+   * Since: 0.UNRELEASED
+   */
+  param_spec = g_param_spec_uint64 ("throughput",
+      "Throughput",
+      "Recent transfer rate in bytes per second",
+      0, G_MAXUINT64, 0,
+      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+  g_object_class_install_property (object_class, PROP_THROUGHPUT,
+      param_spec);
+
+  /**
+   * TpFileTransferChannel:estimated-time-remaining:
+   *
+   * The estimated number of seconds until the transfer completes, at the
+   * current #TpFileTransferChannel:throughput, or -1 if this can't be
+   * estimated yet. This changes with
+   * #TpFileTransferChannel:transferred-bytes.
+   *
+   * The %TP_FILE_TRANSFER_CHANNEL_FEATURE_CORE feature has to be
+   * prepared for this property to be meaningful and kept up to date.
+   *
+   * Since: 0.UNRELEASED
+   */
+  param_spec = g_param_spec_int64 ("estimated-time-remaining",
+      "Estimated time remaining",
+      "Estimated number of seconds until the transfer completes, or -1",
+      -1, G_MAXINT64, -1,
+      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+  g_object_class_install_property (object_class,
+      PROP_ESTIMATED_TIME_REMAINING, param_spec);
+
   g_type_class_add_private (object_class, sizeof
       (TpFileTransferChannelPrivate));
 }
@@ -1012,6 +1478,8 @@ tp_file_transfer_channel_init (TpFileTransferChannel *self)
 {
   self->priv = G_TYPE_INSTANCE_GET_PRIVATE ((self),
       TP_TYPE_FILE_TRANSFER_CHANNEL, TpFileTransferChannelPrivate);
+
+  self->priv->pipe_fds[0] = self->priv->pipe_fds[1] = -1;
 }
 
 /**
@@ -1504,6 +1972,64 @@ tp_file_transfer_channel_provide_file_finish (TpFileTransferChannel *self,
   _tp_implement_finish_void (self, tp_file_transfer_channel_provide_file_async)
 }
 
+/**
+ * tp_file_transfer_channel_set_buffer_size:
+ * @self: a #TpFileTransferChannel
+ * @buffer_size: the largest number of bytes to move at a time, or 0 for
+ *  the default
+ *
+ * When the file given to tp_file_transfer_channel_accept_file_async() or
+ * tp_file_transfer_channel_provide_file_async() is a local file, and the
+ * platform supports it, the data is moved between the file and the socket
+ * by the kernel, with sendfile() or splice(), without being copied through
+ * this process. @buffer_size bounds how much is moved by each of those
+ * calls: larger sizes mean fewer wakeups, smaller sizes keep the main loop
+ * more responsive.
+ *
+ * This has no effect on other files, whose data is copied through
+ * g_output_stream_splice_async() as before, nor on a transfer which has
+ * already started.
+ *
+ * Since: 0.UNRELEASED
+ */
+void
+tp_file_transfer_channel_set_buffer_size (TpFileTransferChannel *self,
+    gsize buffer_size)
+{
+  g_return_if_fail (TP_IS_FILE_TRANSFER_CHANNEL (self));
+
+  self->priv->buffer_size = buffer_size;
+}
+
+/**
+ * tp_file_transfer_channel_get_buffer_size:
+ * @self: a #TpFileTransferChannel
+ *
+ * Return the value set by tp_file_transfer_channel_set_buffer_size(),
+ * or the default if it has not been set.
+ *
+ * Returns: the largest number of bytes moved at a time by a zero-copy
+ *  transfer
+ * Since: 0.UNRELEASED
+ */
+gsize
+tp_file_transfer_channel_get_buffer_size (TpFileTransferChannel *self)
+{
+  g_return_val_if_fail (TP_IS_FILE_TRANSFER_CHANNEL (self), 0);
+
+  if (self->priv->buffer_size == 0)
+    return DEFAULT_BUFFER_SIZE;
+
+  return self->priv->buffer_size;
+}
+
+void
+_tp_file_transfer_channel_set_zero_copy_error (TpFileTransferChannel *self,
+    int errsv)
+{
+  self->priv->zero_copy_error = errsv;
+}
+
 
 /* Property accessors */
 
@@ -1646,6 +2172,109 @@ tp_file_transfer_channel_get_transferred_bytes (TpFileTransferChannel *self)
   return self->priv->transferred_bytes;
 }
 
+/**
+ * tp_file_transfer_channel_set_progress_interval:
+ * @self: a #TpFileTransferChannel
+ * @interval_ms: the minimum time between two notifications, in
+ *  milliseconds, or 0 to notify every change
+ *
+ * Limit how often #GObject::notify is emitted for
+ * #TpFileTransferChannel:transferred-bytes,
+ * #TpFileTransferChannel:throughput and
+ * #TpFileTransferChannel:estimated-time-remaining, which otherwise
+ * happens every time the connection manager reports progress. Changes
+ * within an interval are coalesced into a single notification of the
+ * latest values at the end of the interval; the getters always return the
+ * latest values. Any pending notification is emitted before
+ * #TpFileTransferChannel:state changes.
+ *
+ * Since: 0.UNRELEASED
+ */
+void
+tp_file_transfer_channel_set_progress_interval (TpFileTransferChannel *self,
+    guint interval_ms)
+{
+  g_return_if_fail (TP_IS_FILE_TRANSFER_CHANNEL (self));
+
+  self->priv->progress_interval = interval_ms;
+
+  /* whatever was held back is due by now */
+  if (interval_ms == 0 && self->priv->progress_notify_id != 0)
+    notify_progress (self);
+}
+
+/**
+ * tp_file_transfer_channel_get_progress_interval:
+ * @self: a #TpFileTransferChannel
+ *
+ * Return the value set by tp_file_transfer_channel_set_progress_interval().
+ *
+ * Returns: the minimum time between progress notifications, in
+ *  milliseconds
+ * Since: 0.UNRELEASED
+ */
+guint
+tp_file_transfer_channel_get_progress_interval (TpFileTransferChannel *self)
+{
+  g_return_val_if_fail (TP_IS_FILE_TRANSFER_CHANNEL (self), 0);
+
+  return self->priv->progress_interval;
+}
+
+/**
+ * tp_file_transfer_channel_get_throughput:
+ * @self: a #TpFileTransferChannel
+ *
+ * Return the #TpFileTransferChannel:throughput property
+ *
+ * Returns: the value of the #TpFileTransferChannel:throughput property
+ *
+ * Since: 0.UNRELEASED
+ */
+guint64
+tp_file_transfer_channel_get_throughput (TpFileTransferChannel *self)
+{
+  g_return_val_if_fail (TP_IS_FILE_TRANSFER_CHANNEL (self), 0);
+
+  return self->priv->throughput;
+}
+
+/**
+ * tp_file_transfer_channel_get_estimated_time_remaining:
+ * @self: a #TpFileTransferChannel
+ *
+ * Return the #TpFileTransferChannel:estimated-time-remaining property
+ *
+ * Returns: the value of the
+ *  #TpFileTransferChannel:estimated-time-remaining property
+ *
+ * Since: 0.UNRELEASED
+ */
+gint64
+tp_file_transfer_channel_get_estimated_time_remaining (
+    TpFileTransferChannel *self)
+{
+  guint64 remaining;
+
+  g_return_val_if_fail (TP_IS_FILE_TRANSFER_CHANNEL (self), -1);
+
+  /* G_MAXUINT64 means the size is unknown */
+  if (self->priv->size == G_MAXUINT64)
+    return -1;
+
+  if (self->priv->transferred_bytes >= self->priv->size)
+    return 0;
+
+  if (self->priv->throughput == 0)
+    return -1;
+
+  remaining = self->priv->size - self->priv->transferred_bytes;
+
+  /* round up: "0 seconds left" should mean done */
+  return MIN ((remaining + self->priv->throughput - 1) /
+      self->priv->throughput, (guint64) G_MAXINT64);
+}
+
 /**
  * tp_file_transfer_channel_get_service_name:
  * @self: a #TpFileTransferChannel
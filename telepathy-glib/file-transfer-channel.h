@@ -99,6 +99,13 @@ gboolean tp_file_transfer_channel_provide_file_finish (
     GAsyncResult *result,
     GError **error);
 
+_TP_AVAILABLE_IN_UNRELEASED
+void tp_file_transfer_channel_set_buffer_size (TpFileTransferChannel *self,
+    gsize buffer_size);
+
+_TP_AVAILABLE_IN_UNRELEASED
+gsize tp_file_transfer_channel_get_buffer_size (TpFileTransferChannel *self);
+
 /* Property accessors */
 
 _TP_AVAILABLE_IN_0_16
@@ -128,6 +135,22 @@ _TP_AVAILABLE_IN_0_16
 guint64 tp_file_transfer_channel_get_transferred_bytes (
     TpFileTransferChannel *self);
 
+_TP_AVAILABLE_IN_UNRELEASED
+void tp_file_transfer_channel_set_progress_interval (
+    TpFileTransferChannel *self,
+    guint interval_ms);
+
+_TP_AVAILABLE_IN_UNRELEASED
+guint tp_file_transfer_channel_get_progress_interval (
+    TpFileTransferChannel *self);
+
+_TP_AVAILABLE_IN_UNRELEASED
+guint64 tp_file_transfer_channel_get_throughput (TpFileTransferChannel *self);
+
+_TP_AVAILABLE_IN_UNRELEASED
+gint64 tp_file_transfer_channel_get_estimated_time_remaining (
+    TpFileTransferChannel *self);
+
 /* Metadata */
 
 _TP_AVAILABLE_IN_0_18
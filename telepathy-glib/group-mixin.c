@@ -149,8 +149,15 @@ struct _TpGroupMixinPrivate {
     GHashTable *handle_owners;
     GHashTable *local_pending_info;
     GPtrArray *externals;
+    /* see tp_group_mixin_enable_large_room_mode() */
+    gboolean large_room;
+    guint batch_size;
 };
 
+/* In large-room mode, at most this many handles from each array are
+ * included in the debug output for a membership change */
+#define LARGE_ROOM_DEBUG_HANDLES 10
+
 /**
  * TP_HAS_GROUP_MIXIN:
  * @o: a #GObject instance
@@ -390,6 +397,47 @@ tp_group_mixin_finalize (GObject *obj)
   tp_handle_set_destroy (mixin->remote_pending);
 }
 
+/**
+ * tp_group_mixin_enable_large_room_mode: (skip)
+ * @obj: An object implementing the group interface using this mixin
+ * @batch_size: The maximum number of handles mentioned by each
+ *  MembersChangedDetailed signal, or 0 to never split changes
+ *
+ * Configure the mixin for groups which may have a very large number of
+ * members, such as busy IRC or XMPP chat rooms. In this mode:
+ *
+ * <itemizedlist>
+ * <listitem>only MembersChangedDetailed is emitted, and not the deprecated
+ *  MembersChanged signal (clients which see
+ *  %TP_CHANNEL_GROUP_FLAG_MEMBERS_CHANGED_DETAILED ignore the latter);
+ *  </listitem>
+ * <listitem>if @batch_size is non-zero, a change involving more than
+ *  @batch_size handles is emitted as several signals, each carrying at most
+ *  @batch_size handles and the "contact-ids" of only those handles;
+ *  </listitem>
+ * <listitem>debug output only lists the first few handles of each
+ *  change.</listitem>
+ * </itemizedlist>
+ *
+ * This function should be called just after tp_group_mixin_init(), before
+ * any members are added. The group must not have had
+ * %TP_CHANNEL_GROUP_FLAG_MEMBERS_CHANGED_DETAILED removed.
+ *
+ * Since: 0.UNRELEASED
+ */
+void
+tp_group_mixin_enable_large_room_mode (GObject *obj,
+    guint batch_size)
+{
+  TpGroupMixin *mixin = TP_GROUP_MIXIN (obj);
+
+  g_return_if_fail (
+      mixin->group_flags & TP_CHANNEL_GROUP_FLAG_MEMBERS_CHANGED_DETAILED);
+
+  mixin->priv->large_room = TRUE;
+  mixin->priv->batch_size = batch_size;
+}
+
 /**
  * tp_group_mixin_get_self_handle: (skip)
  * @obj: An object implementing the group mixin using this interface
@@ -1276,7 +1324,8 @@ tp_group_mixin_change_flags (GObject *obj,
 
 static gchar *
 member_array_to_string (TpHandleRepoIface *repo,
-                        const GArray *array)
+                        const GArray *array,
+                        guint limit)
 {
   GString *str;
   guint i;
@@ -1288,6 +1337,13 @@ member_array_to_string (TpHandleRepoIface *repo,
       TpHandle handle;
       const gchar *handle_str;
 
+      if (limit > 0 && i == limit)
+        {
+          g_string_append_printf (str, "\n                   (%u more)",
+              array->len - limit);
+          break;
+        }
+
       handle = g_array_index (array, guint, i);
       handle_str = tp_handle_inspect (repo, handle);
 
@@ -1306,57 +1362,6 @@ member_array_to_string (TpHandleRepoIface *repo,
 static GArray *remove_handle_owners_if_exist (GObject *obj,
     GArray *array) G_GNUC_WARN_UNUSED_RESULT;
 
-typedef struct {
-    TpGroupMixin *mixin;
-    LocalPendingInfo *info;
-} _mixin_and_info;
-
-static void
-local_pending_added_foreach (guint i,
-                             gpointer userdata)
-{
-  _mixin_and_info *data = userdata;
-  TpGroupMixinPrivate *priv = data->mixin->priv;
-
-  g_hash_table_insert (priv->local_pending_info,
-      GUINT_TO_POINTER (i),
-      local_pending_info_new (data->mixin->handle_repo,
-      data->info->actor, data->info->reason, data->info->message));
-}
-
-static void
-local_pending_added (TpGroupMixin *mixin,
-    const TpIntset *added,
-    TpHandle actor,
-    guint reason,
-    const gchar *message)
-{
-  LocalPendingInfo info;
-  _mixin_and_info data = { mixin, &info };
-  info.actor = actor;
-  info.reason = reason;
-  info.message = message;
-
-  tp_intset_foreach (added, local_pending_added_foreach, &data);
-}
-
-static void
-local_pending_remove_foreach (guint i,
-                             gpointer userdata)
-{
-  TpGroupMixin *mixin = (TpGroupMixin *) userdata;
-  TpGroupMixinPrivate *priv = mixin->priv;
-
-  g_hash_table_remove (priv->local_pending_info, GUINT_TO_POINTER(i));
-}
-
-static void
-local_pending_remove (TpGroupMixin *mixin,
-                     TpIntset *removed)
-{
-  tp_intset_foreach (removed, local_pending_remove_foreach, mixin);
-}
-
 
 static void
 add_members_in_array (GHashTable *contact_ids,
@@ -1446,11 +1451,14 @@ emit_members_changed_signals (GObject *channel,
   if (DEBUGGING)
     {
       gchar *add_str, *rem_str, *local_str, *remote_str;
+      guint limit = mixin->priv->large_room ? LARGE_ROOM_DEBUG_HANDLES : 0;
 
-      add_str = member_array_to_string (mixin->handle_repo, add);
-      rem_str = member_array_to_string (mixin->handle_repo, del);
-      local_str = member_array_to_string (mixin->handle_repo, local_pending);
-      remote_str = member_array_to_string (mixin->handle_repo, remote_pending);
+      add_str = member_array_to_string (mixin->handle_repo, add, limit);
+      rem_str = member_array_to_string (mixin->handle_repo, del, limit);
+      local_str = member_array_to_string (mixin->handle_repo, local_pending,
+          limit);
+      remote_str = member_array_to_string (mixin->handle_repo, remote_pending,
+          limit);
 
       DEBUG ("emitting members changed\n"
               "  message       : \"%s\"\n"
@@ -1472,8 +1480,12 @@ emit_members_changed_signals (GObject *channel,
   added_contact_ids = maybe_add_contact_ids (mixin, add, local_pending,
       remote_pending, actor, details_);
 
-  tp_svc_channel_interface_group_emit_members_changed (channel, message,
-      add, del, local_pending, remote_pending, actor, reason);
+  /* in large-room mode, only the Detailed signal is emitted: the flag
+   * MEMBERS_CHANGED_DETAILED tells clients to ignore the other one anyway */
+  if (!mixin->priv->large_room)
+    tp_svc_channel_interface_group_emit_members_changed (channel, message,
+        add, del, local_pending, remote_pending, actor, reason);
+
   tp_svc_channel_interface_group_emit_members_changed_detailed (channel,
       add, del, local_pending, remote_pending, details_);
 
@@ -1485,8 +1497,11 @@ emit_members_changed_signals (GObject *channel,
         {
           GObject *external = g_ptr_array_index (mixin->priv->externals, i);
 
-          tp_svc_channel_interface_group_emit_members_changed (external,
-              message, add, del, local_pending, remote_pending, actor, reason);
+          if (!mixin->priv->large_room)
+            tp_svc_channel_interface_group_emit_members_changed (external,
+                message, add, del, local_pending, remote_pending, actor,
+                reason);
+
           tp_svc_channel_interface_group_emit_members_changed_detailed (
               external, add, del, local_pending, remote_pending, details_);
         }
@@ -1497,6 +1512,77 @@ emit_members_changed_signals (GObject *channel,
 }
 
 
+/* Emit the membership change in several pairs of signals, each of which
+ * mentions at most batch_size handles in total. */
+static void
+emit_members_changed_in_batches (GObject *channel,
+                                 const gchar *message,
+                                 const GArray *add,
+                                 const GArray *del,
+                                 const GArray *local_pending,
+                                 const GArray *remote_pending,
+                                 TpHandle actor,
+                                 TpChannelGroupChangeReason reason,
+                                 const GHashTable *details,
+                                 guint batch_size)
+{
+  const GArray *arrays[4] = { add, del, local_pending, remote_pending };
+  guint offsets[4] = { 0, 0, 0, 0 };
+
+  g_assert (batch_size > 0);
+
+  while (TRUE)
+    {
+      GArray *batch[4];
+      guint room = batch_size;
+      guint j;
+
+      for (j = 0; j < 4; j++)
+        {
+          guint n = MIN (room, arrays[j]->len - offsets[j]);
+
+          batch[j] = g_array_sized_new (FALSE, FALSE, sizeof (TpHandle), n);
+
+          if (n > 0)
+            g_array_append_vals (batch[j],
+                &g_array_index (arrays[j], TpHandle, offsets[j]), n);
+
+          offsets[j] += n;
+          room -= n;
+        }
+
+      if (room < batch_size)
+        emit_members_changed_signals (channel, message, batch[0], batch[1],
+            batch[2], batch[3], actor, reason, details);
+
+      for (j = 0; j < 4; j++)
+        g_array_unref (batch[j]);
+
+      if (room > 0)
+        break;
+    }
+}
+
+static void
+local_pending_info_set (TpGroupMixin *mixin,
+    TpHandle handle,
+    TpHandle actor,
+    guint reason,
+    const gchar *message)
+{
+  g_hash_table_insert (mixin->priv->local_pending_info,
+      GUINT_TO_POINTER (handle),
+      local_pending_info_new (mixin->handle_repo, actor, reason, message));
+}
+
+static void
+local_pending_info_unset (TpGroupMixin *mixin,
+    TpHandle handle)
+{
+  g_hash_table_remove (mixin->priv->local_pending_info,
+      GUINT_TO_POINTER (handle));
+}
+
 static gboolean
 change_members (GObject *obj,
                 const gchar *message,
@@ -1509,93 +1595,112 @@ change_members (GObject *obj,
                 const GHashTable *details)
 {
   TpGroupMixin *mixin = TP_GROUP_MIXIN (obj);
-  TpIntset *new_add, *new_remove, *new_local_pending,
-           *new_remote_pending, *tmp, *tmp2, *empty;
+  TpIntset *new_add, *new_remove, *new_local_pending, *new_remote_pending;
+  TpIntsetFastIter iter;
+  TpHandle handle;
   gboolean ret;
 
-  empty = tp_intset_new ();
-
   if (message == NULL)
     message = "";
 
-  if (add == NULL)
-    add = empty;
-
-  if (del == NULL)
-    del = empty;
-
-  if (add_local_pending == NULL)
-    add_local_pending = empty;
-
-  if (add_remote_pending == NULL)
-    add_remote_pending = empty;
-
   /* remember the actor handle before any handle unreffing happens */
   if (actor)
     {
       tp_handle_set_add (mixin->priv->actors, actor);
     }
 
-  /* members + add */
-  new_add = tp_handle_set_update (mixin->members, add);
+  /* Work out what actually changed by visiting each handle in the
+   * arguments once, moving it between the members, local-pending and
+   * remote-pending sets; this is proportional to the size of the change,
+   * however many members the group already has. */
+  new_add = tp_intset_new ();
+  new_remove = tp_intset_new ();
+  new_local_pending = tp_intset_new ();
+  new_remote_pending = tp_intset_new ();
 
-  /* members - del */
-  new_remove = tp_handle_set_difference_update (mixin->members, del);
+  if (add != NULL)
+    {
+      tp_intset_fast_iter_init (&iter, add);
 
-  /* members - add_local_pending */
-  tmp = tp_handle_set_difference_update (mixin->members, add_local_pending);
-  tp_intset_destroy (tmp);
+      while (tp_intset_fast_iter_next (&iter, &handle))
+        {
+          if (!tp_handle_set_is_member (mixin->members, handle))
+            {
+              tp_handle_set_add (mixin->members, handle);
+              tp_intset_add (new_add, handle);
+            }
 
-  /* members - add_remote_pending */
-  tmp = tp_handle_set_difference_update (mixin->members, add_remote_pending);
-  tp_intset_destroy (tmp);
+          if (tp_handle_set_remove (mixin->local_pending, handle))
+            local_pending_info_unset (mixin, handle);
 
+          tp_handle_set_remove (mixin->remote_pending, handle);
+        }
+    }
 
-  /* local pending + add_local_pending */
-  new_local_pending = tp_handle_set_update (mixin->local_pending,
-      add_local_pending);
-  local_pending_added (mixin, add_local_pending, actor, reason, message);
+  if (del != NULL)
+    {
+      tp_intset_fast_iter_init (&iter, del);
 
-  /* local pending - add */
-  tmp = tp_handle_set_difference_update (mixin->local_pending, add);
-  local_pending_remove (mixin, tmp);
-  tp_intset_destroy (tmp);
+      while (tp_intset_fast_iter_next (&iter, &handle))
+        {
+          gboolean removed = FALSE;
 
-  /* local pending - del */
-  tmp = tp_handle_set_difference_update (mixin->local_pending, del);
-  local_pending_remove (mixin, tmp);
+          if (tp_handle_set_remove (mixin->members, handle))
+            removed = TRUE;
 
-  tmp2 = tp_intset_union (new_remove, tmp);
-  tp_intset_destroy (new_remove);
-  tp_intset_destroy (tmp);
-  new_remove = tmp2;
+          if (tp_handle_set_remove (mixin->local_pending, handle))
+            {
+              local_pending_info_unset (mixin, handle);
+              removed = TRUE;
+            }
 
-  /* local pending - add_remote_pending */
-  tmp = tp_handle_set_difference_update (mixin->local_pending,
-      add_remote_pending);
-  local_pending_remove (mixin, tmp);
-  tp_intset_destroy (tmp);
+          if (tp_handle_set_remove (mixin->remote_pending, handle))
+            removed = TRUE;
 
+          if (removed)
+            tp_intset_add (new_remove, handle);
+        }
+    }
 
-  /* remote pending + add_remote_pending */
-  new_remote_pending = tp_handle_set_update (mixin->remote_pending,
-      add_remote_pending);
+  if (add_local_pending != NULL)
+    {
+      tp_intset_fast_iter_init (&iter, add_local_pending);
 
-  /* remote pending - add */
-  tmp = tp_handle_set_difference_update (mixin->remote_pending, add);
-  tp_intset_destroy (tmp);
+      while (tp_intset_fast_iter_next (&iter, &handle))
+        {
+          tp_handle_set_remove (mixin->members, handle);
+          tp_handle_set_remove (mixin->remote_pending, handle);
 
-  /* remote pending - del */
-  tmp = tp_handle_set_difference_update (mixin->remote_pending, del);
-  tmp2 = tp_intset_union (new_remove, tmp);
-  tp_intset_destroy (new_remove);
-  tp_intset_destroy (tmp);
-  new_remove = tmp2;
+          if (!tp_handle_set_is_member (mixin->local_pending, handle))
+            {
+              tp_handle_set_add (mixin->local_pending, handle);
+              tp_intset_add (new_local_pending, handle);
+            }
 
-  /* remote pending - local_pending */
-  tmp = tp_handle_set_difference_update (mixin->remote_pending,
-      add_local_pending);
-  tp_intset_destroy (tmp);
+          /* the details are updated even if the contact was already
+           * local-pending */
+          local_pending_info_set (mixin, handle, actor, reason, message);
+        }
+    }
+
+  if (add_remote_pending != NULL)
+    {
+      tp_intset_fast_iter_init (&iter, add_remote_pending);
+
+      while (tp_intset_fast_iter_next (&iter, &handle))
+        {
+          tp_handle_set_remove (mixin->members, handle);
+
+          if (tp_handle_set_remove (mixin->local_pending, handle))
+            local_pending_info_unset (mixin, handle);
+
+          if (!tp_handle_set_is_member (mixin->remote_pending, handle))
+            {
+              tp_handle_set_add (mixin->remote_pending, handle);
+              tp_intset_add (new_remote_pending, handle);
+            }
+        }
+    }
 
   if (tp_intset_size (new_add) > 0 ||
       tp_intset_size (new_remove) > 0 ||
@@ -1615,8 +1720,15 @@ change_members (GObject *obj,
       arr_owners_removed = remove_handle_owners_if_exist (obj, arr_remove);
 
       /* emit signals */
-      emit_members_changed_signals (obj, message, arr_add, arr_remove,
-          arr_local, arr_remote, actor, reason, details);
+      if (mixin->priv->batch_size > 0 &&
+          arr_add->len + arr_remove->len + arr_local->len + arr_remote->len >
+              mixin->priv->batch_size)
+        emit_members_changed_in_batches (obj, message, arr_add, arr_remove,
+            arr_local, arr_remote, actor, reason, details,
+            mixin->priv->batch_size);
+      else
+        emit_members_changed_signals (obj, message, arr_add, arr_remove,
+            arr_local, arr_remote, actor, reason, details);
 
       if (arr_owners_removed->len > 0)
         {
@@ -1666,7 +1778,6 @@ change_members (GObject *obj,
   tp_intset_destroy (new_remove);
   tp_intset_destroy (new_local_pending);
   tp_intset_destroy (new_remote_pending);
-  tp_intset_destroy (empty);
 
   return ret;
 }
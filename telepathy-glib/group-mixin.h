@@ -177,6 +177,9 @@ void tp_group_mixin_init (GObject *obj, glong offset,
     TpHandleRepoIface *handle_repo, TpHandle self_handle);
 void tp_group_mixin_finalize (GObject *obj);
 
+_TP_AVAILABLE_IN_UNRELEASED
+void tp_group_mixin_enable_large_room_mode (GObject *obj, guint batch_size);
+
 gboolean tp_group_mixin_get_self_handle (GObject *obj,
     guint *ret, GError **error);
 gboolean tp_group_mixin_get_group_flags (GObject *obj,
@@ -49,6 +49,13 @@
  * tp_message_mixin_implement_sending() in the constructor function. If you do
  * not, any attempt to send a message will fail with NotImplemented.
  *
+ * Channels used only by clients of the Messages interface can avoid
+ * emitting the legacy Text.Received signal for each incoming message by
+ * calling tp_message_mixin_set_legacy_signals().
+ *
+ * To stop a large backlog of unacknowledged messages from using unbounded
+ * memory, call tp_message_mixin_set_max_pending_in_memory().
+ *
  * To support chat state, you must call
  * tp_message_mixin_implement_send_chat_state() in the constructor function, and
  * include the following in the fourth argument of G_DEFINE_TYPE_WITH_CODE():
@@ -69,6 +76,7 @@
 #include <dbus/dbus-glib-lowlevel.h>
 #include <string.h>
 
+#include <telepathy-glib/base-connection-internal.h>
 #include <telepathy-glib/cm-message.h>
 #include <telepathy-glib/cm-message-internal.h>
 #include <telepathy-glib/dbus.h>
@@ -78,6 +86,7 @@
 #include <telepathy-glib/gtypes.h>
 #include <telepathy-glib/interfaces.h>
 #include <telepathy-glib/message-internal.h>
+#include <telepathy-glib/variant-util-internal.h>
 
 #define DEBUG_FLAG TP_DEBUG_IM
 
@@ -107,13 +116,39 @@ struct _TpMessageMixinPrivate
 
   /* Receiving */
   guint recv_id;
+  /* PendingItem, oldest first */
   GQueue *pending;
+  /* incoming_id => borrowed GList link in pending */
+  GHashTable *pending_index;
+  TpMessageMixinLegacySignals legacy_signals;
+  /* 0 if unlimited */
+  guint max_pending_in_memory;
+  guint n_pending_in_memory;
+  guint n_pending_spilled;
+  /* append-only log of spilled pending messages, created when first needed */
+  GFile *spill_file;
+  GFileIOStream *spill_stream;
+  goffset spill_end;
+  /* how much of the log is taken up by messages that are still pending */
+  goffset spill_live;
+  guint spill_source_id;
 
   /* ChatState */
 
   /* TpHandle -> TpChannelChatState */
   GHashTable *chat_states;
   TpMessageMixinSendChatStateImpl send_chat_state;
+  /* 0 if changes are passed on immediately */
+  guint chat_state_interval;
+  /* TpHandle -> owned ChatStateThrottle */
+  GHashTable *chat_state_throttles;
+  guint chat_state_flush_id;
+  /* when we last called send_chat_state, and the state we sent */
+  gint64 chat_state_last_sent;
+  TpChannelChatState chat_state_sent;
+  /* our latest state, to be sent when chat_state_send_id fires */
+  TpChannelChatState chat_state_held;
+  guint chat_state_send_id;
   /* FALSE unless at least one chat state notification has been sent; <gone/>
    * will only be sent when the channel closes if this is TRUE. This prevents
    * opening a channel and closing it immediately sending a spurious <gone/> to
@@ -199,17 +234,384 @@ tp_message_mixin_get_offset_quark (void)
 }
 
 
+typedef struct {
+    guint32 id;
+    /* owned; NULL if the message has been spilled to the backlog file */
+    TpMessage *msg;
+    /* the rest are only meaningful while msg is NULL */
+    goffset offset;
+    gsize size;
+    TpHandle sender;
+    gboolean rescued;
+} PendingItem;
+
+static void
+pending_push_tail (TpMessageMixin *mixin,
+                   TpMessage *msg)
+{
+  TpCMMessage *cm_msg = (TpCMMessage *) msg;
+  PendingItem *item = g_slice_new0 (PendingItem);
+
+  item->id = cm_msg->incoming_id;
+  item->msg = msg;
+  mixin->priv->n_pending_in_memory++;
+
+  g_queue_push_tail (mixin->priv->pending, item);
+  g_hash_table_insert (mixin->priv->pending_index,
+      GUINT_TO_POINTER (item->id),
+      g_queue_peek_tail_link (mixin->priv->pending));
+}
+
+static GList *
+pending_find (TpMessageMixin *mixin,
+              guint id)
+{
+  return g_hash_table_lookup (mixin->priv->pending_index,
+      GUINT_TO_POINTER (id));
+}
+
+static void
+pending_item_free (TpMessageMixin *mixin,
+                   PendingItem *item)
+{
+  if (item->msg != NULL)
+    {
+      tp_message_destroy (item->msg);
+      mixin->priv->n_pending_in_memory--;
+    }
+  else
+    {
+      mixin->priv->n_pending_spilled--;
+      mixin->priv->spill_live -= item->size;
+    }
+
+  g_slice_free (PendingItem, item);
+}
+
+/* the backlog is not compacted until it is at least this big */
+#define SPILL_COMPACT_MIN_SIZE (64 * 1024)
+
 static gint
-pending_item_id_equals_data (gconstpointer item,
-                             gconstpointer data)
+compare_items_by_offset (gconstpointer a,
+    gconstpointer b)
 {
-  const TpCMMessage *self = item;
-  guint id = GPOINTER_TO_UINT (data);
+  const PendingItem *ia = *(PendingItem * const *) a;
+  const PendingItem *ib = *(PendingItem * const *) b;
 
-  /* The sense of this comparison is correct: the callback passed to
-   * g_queue_find_custom() should return 0 when the desired item is found.
-   */
-  return (self->incoming_id != id);
+  if (ia->offset == ib->offset)
+    return 0;
+
+  return (ia->offset < ib->offset) ? -1 : 1;
+}
+
+/* Moves the records of the messages still in the backlog to its start, in
+ * the order they were written, and cuts off the rest. Each record only ever
+ * moves towards the start of the file, so it cannot overwrite one that has
+ * not been moved yet. */
+static void
+spill_compact (TpMessageMixin *mixin)
+{
+  GSeekable *seekable = G_SEEKABLE (mixin->priv->spill_stream);
+  GInputStream *input = g_io_stream_get_input_stream (
+      G_IO_STREAM (mixin->priv->spill_stream));
+  GOutputStream *output = g_io_stream_get_output_stream (
+      G_IO_STREAM (mixin->priv->spill_stream));
+  GPtrArray *items = g_ptr_array_sized_new (mixin->priv->n_pending_spilled);
+  goffset old_end = mixin->priv->spill_end;
+  goffset end = 0;
+  GError *error = NULL;
+  GList *l;
+  guint i;
+
+  for (l = g_queue_peek_head_link (mixin->priv->pending);
+       l != NULL;
+       l = l->next)
+    {
+      PendingItem *item = l->data;
+
+      if (item->msg == NULL)
+        g_ptr_array_add (items, item);
+    }
+
+  g_ptr_array_sort (items, compare_items_by_offset);
+
+  for (i = 0; i < items->len; i++)
+    {
+      PendingItem *item = g_ptr_array_index (items, i);
+      gchar *data;
+      gsize bytes_read;
+
+      if (item->offset == end)
+        {
+          end += item->size;
+          continue;
+        }
+
+      data = g_malloc (item->size);
+
+      if (g_seekable_seek (seekable, item->offset, G_SEEK_SET, NULL,
+              &error) &&
+          g_input_stream_read_all (input, data, item->size, &bytes_read,
+              NULL, &error) &&
+          bytes_read != item->size)
+        g_set_error (&error, TP_ERROR, TP_ERROR_NOT_AVAILABLE,
+            "pending message %u is truncated in the backlog", item->id);
+
+      if (error == NULL &&
+          g_seekable_seek (seekable, end, G_SEEK_SET, NULL, &error))
+        g_output_stream_write_all (output, data, item->size, NULL, NULL,
+            &error);
+
+      if (error != NULL)
+        {
+          /* the records moved so far are consistent, and the rest are
+           * where they were */
+          DEBUG ("failed to compact pending message backlog: %s",
+              error->message);
+          g_clear_error (&error);
+          g_free (data);
+          goto finally;
+        }
+
+      g_free (data);
+      item->offset = end;
+      end += item->size;
+    }
+
+  if (!g_seekable_truncate (seekable, end, NULL, &error))
+    {
+      DEBUG ("failed to truncate pending message backlog: %s",
+          error->message);
+      g_clear_error (&error);
+      goto finally;
+    }
+
+  mixin->priv->spill_end = end;
+  DEBUG ("compacted pending message backlog from %" G_GOFFSET_FORMAT
+      " to %" G_GOFFSET_FORMAT " bytes", old_end, end);
+
+finally:
+  g_ptr_array_unref (items);
+}
+
+/* Once no pending message lives in the backlog, start it again from
+ * scratch rather than letting it grow for as long as the channel exists;
+ * if only a few old messages are keeping it alive, squeeze out the
+ * acknowledged ones instead */
+static void
+spill_maybe_reset (TpMessageMixin *mixin)
+{
+  GError *error = NULL;
+
+  if (mixin->priv->spill_end == 0)
+    return;
+
+  if (mixin->priv->n_pending_spilled > 0)
+    {
+      if (mixin->priv->spill_end >= SPILL_COMPACT_MIN_SIZE &&
+          mixin->priv->spill_live < mixin->priv->spill_end / 2)
+        spill_compact (mixin);
+
+      return;
+    }
+
+  if (!g_seekable_truncate (G_SEEKABLE (mixin->priv->spill_stream), 0, NULL,
+          &error))
+    {
+      DEBUG ("failed to truncate pending message backlog: %s",
+          error->message);
+      g_clear_error (&error);
+      return;
+    }
+
+  mixin->priv->spill_end = 0;
+}
+
+/* Removes @link_ from the pending queue and frees its message */
+static void
+pending_delete_link (TpMessageMixin *mixin,
+                     GList *link_)
+{
+  PendingItem *item = link_->data;
+
+  g_hash_table_remove (mixin->priv->pending_index,
+      GUINT_TO_POINTER (item->id));
+  g_queue_delete_link (mixin->priv->pending, link_);
+  pending_item_free (mixin, item);
+  spill_maybe_reset (mixin);
+}
+
+/* Appends @item's message to the backlog file and drops it from memory. If
+ * that fails, the message just stays in memory. */
+static gboolean
+pending_spill (TpMessageMixin *mixin,
+               PendingItem *item)
+{
+  GVariantBuilder builder;
+  GVariant *variant;
+  GOutputStream *output;
+  GError *error = NULL;
+  guint i;
+
+  g_assert (item->msg != NULL);
+
+  if (mixin->priv->spill_stream == NULL)
+    {
+      mixin->priv->spill_file = g_file_new_tmp ("tp-pending-messages-XXXXXX",
+          &mixin->priv->spill_stream, &error);
+
+      if (mixin->priv->spill_file == NULL)
+        {
+          WARNING ("unable to create a backlog for pending messages, keeping "
+              "them all in memory: %s", error->message);
+          g_clear_error (&error);
+          mixin->priv->max_pending_in_memory = 0;
+          return FALSE;
+        }
+    }
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("aa{sv}"));
+
+  for (i = 0; i < item->msg->parts->len; i++)
+    {
+      GVariant *part = tp_message_dup_part (item->msg, i);
+
+      g_variant_builder_add_value (&builder, part);
+      g_variant_unref (part);
+    }
+
+  variant = g_variant_ref_sink (g_variant_builder_end (&builder));
+  output = g_io_stream_get_output_stream (
+      G_IO_STREAM (mixin->priv->spill_stream));
+
+  if (!g_seekable_seek (G_SEEKABLE (mixin->priv->spill_stream),
+          mixin->priv->spill_end, G_SEEK_SET, NULL, &error) ||
+      !g_output_stream_write_all (output, g_variant_get_data (variant),
+          g_variant_get_size (variant), NULL, NULL, &error))
+    {
+      WARNING ("unable to write pending message %u to the backlog, keeping "
+          "it in memory: %s", item->id, error->message);
+      g_clear_error (&error);
+      g_variant_unref (variant);
+      return FALSE;
+    }
+
+  item->offset = mixin->priv->spill_end;
+  item->size = g_variant_get_size (variant);
+  item->sender = tp_asv_get_uint32 (tp_message_peek (item->msg, 0),
+      "message-sender", NULL);
+  mixin->priv->spill_end += item->size;
+  mixin->priv->spill_live += item->size;
+
+  tp_message_destroy (item->msg);
+  item->msg = NULL;
+  mixin->priv->n_pending_in_memory--;
+  mixin->priv->n_pending_spilled++;
+
+  g_variant_unref (variant);
+  return TRUE;
+}
+
+static gboolean
+spill_excess_cb (gpointer user_data)
+{
+  TpMessageMixin *mixin = TP_MESSAGE_MIXIN (user_data);
+  GList *cur;
+
+  mixin->priv->spill_source_id = 0;
+
+  /* Keep the oldest messages, which are the next to be acknowledged; the
+   * ones that arrived since we last ran are at the end */
+  for (cur = g_queue_peek_tail_link (mixin->priv->pending);
+       cur != NULL &&
+       mixin->priv->max_pending_in_memory > 0 &&
+       mixin->priv->n_pending_in_memory > mixin->priv->max_pending_in_memory;
+       cur = cur->prev)
+    {
+      PendingItem *item = cur->data;
+
+      if (item->msg != NULL && !pending_spill (mixin, item))
+        break;
+    }
+
+  return FALSE;
+}
+
+/* Messages are only spilled from an idle, because whoever gave them to
+ * us may still be looking at them until then */
+static void
+spill_excess_soon (GObject *object)
+{
+  TpMessageMixin *mixin = TP_MESSAGE_MIXIN (object);
+
+  if (mixin->priv->max_pending_in_memory > 0 &&
+      mixin->priv->n_pending_in_memory > mixin->priv->max_pending_in_memory &&
+      mixin->priv->spill_source_id == 0)
+    mixin->priv->spill_source_id = g_idle_add (spill_excess_cb, object);
+}
+
+/* Returns a new reference to @item's message, reading it back from the
+ * backlog if it was spilled, or %NULL if that fails */
+static TpMessage *
+pending_item_dup_message (TpMessageMixin *mixin,
+                          PendingItem *item,
+                          GError **error)
+{
+  GInputStream *input;
+  gchar *data;
+  gsize bytes_read;
+  GVariant *variant;
+  GPtrArray *parts;
+  TpMessage *msg;
+  gsize i;
+
+  if (item->msg != NULL)
+    return g_object_ref (item->msg);
+
+  input = g_io_stream_get_input_stream (
+      G_IO_STREAM (mixin->priv->spill_stream));
+  data = g_malloc (item->size);
+
+  if (!g_seekable_seek (G_SEEKABLE (mixin->priv->spill_stream),
+          item->offset, G_SEEK_SET, NULL, error) ||
+      !g_input_stream_read_all (input, data, item->size, &bytes_read, NULL,
+          error))
+    {
+      g_free (data);
+      return NULL;
+    }
+
+  variant = g_variant_ref_sink (g_variant_new_from_data (
+        G_VARIANT_TYPE ("aa{sv}"), data, bytes_read, FALSE, g_free, data));
+
+  if (bytes_read != item->size || g_variant_n_children (variant) == 0)
+    {
+      g_set_error (error, TP_ERROR, TP_ERROR_NOT_AVAILABLE,
+          "pending message %u is corrupt in the backlog", item->id);
+      g_variant_unref (variant);
+      return NULL;
+    }
+
+  parts = g_ptr_array_new_with_free_func (
+      (GDestroyNotify) g_hash_table_unref);
+
+  for (i = 0; i < g_variant_n_children (variant); i++)
+    {
+      GVariant *part = g_variant_get_child_value (variant, i);
+
+      g_ptr_array_add (parts, _tp_asv_from_vardict (part));
+      g_variant_unref (part);
+    }
+
+  msg = _tp_cm_message_new_from_parts (mixin->priv->connection, parts);
+  ((TpCMMessage *) msg)->incoming_id = item->id;
+
+  if (item->rescued)
+    tp_message_set_boolean (msg, 0, "rescued", TRUE);
+
+  g_ptr_array_unref (parts);
+  g_variant_unref (variant);
+  return msg;
 }
 
 static gchar *
@@ -315,6 +717,204 @@ tp_message_mixin_implement_sending (GObject *object,
       (gchar **) supported_content_types);
 }
 
+typedef struct {
+    /* when ChatStateChanged was last emitted for this contact, and with
+     * which state */
+    gint64 last_emitted;
+    TpChannelChatState emitted;
+    /* if TRUE, the contact has changed to @held since then */
+    gboolean is_held;
+    TpChannelChatState held;
+} ChatStateThrottle;
+
+static void
+chat_state_throttle_free (gpointer p)
+{
+  g_slice_free (ChatStateThrottle, p);
+}
+
+static gboolean flush_chat_states_cb (gpointer user_data);
+
+/* Round up, so that whatever was due has become due when the timeout
+ * fires */
+static guint
+us_to_ms (gint64 us)
+{
+  return (guint) ((us + 999) / 1000);
+}
+
+static void
+emit_chat_state_throttled (GObject *object,
+    TpHandle member,
+    TpChannelChatState state)
+{
+  TpMessageMixin *mixin = TP_MESSAGE_MIXIN (object);
+  gint64 interval = (gint64) mixin->priv->chat_state_interval * 1000;
+  gint64 now = g_get_monotonic_time ();
+  ChatStateThrottle *throttle;
+
+  throttle = g_hash_table_lookup (mixin->priv->chat_state_throttles,
+      GUINT_TO_POINTER (member));
+
+  if (throttle == NULL)
+    {
+      throttle = g_slice_new0 (ChatStateThrottle);
+      g_hash_table_insert (mixin->priv->chat_state_throttles,
+          GUINT_TO_POINTER (member), throttle);
+    }
+  else if (now - throttle->last_emitted < interval)
+    {
+      /* the latest state wins when the interval is up */
+      throttle->is_held = TRUE;
+      throttle->held = state;
+
+      if (mixin->priv->chat_state_flush_id == 0)
+        mixin->priv->chat_state_flush_id = g_timeout_add (
+            us_to_ms (throttle->last_emitted + interval - now),
+            flush_chat_states_cb, object);
+
+      return;
+    }
+
+  throttle->is_held = FALSE;
+  throttle->last_emitted = now;
+  throttle->emitted = state;
+
+  tp_svc_channel_interface_chat_state_emit_chat_state_changed (object,
+      member, state);
+}
+
+static gboolean
+flush_chat_states_cb (gpointer user_data)
+{
+  GObject *object = user_data;
+  TpMessageMixin *mixin = TP_MESSAGE_MIXIN (object);
+  gint64 interval = (gint64) mixin->priv->chat_state_interval * 1000;
+  gint64 now = g_get_monotonic_time ();
+  gint64 next_due = G_MAXINT64;
+  GHashTableIter iter;
+  gpointer key, value;
+
+  mixin->priv->chat_state_flush_id = 0;
+
+  g_hash_table_iter_init (&iter, mixin->priv->chat_state_throttles);
+
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      ChatStateThrottle *throttle = value;
+      gint64 due = throttle->last_emitted + interval;
+
+      if (due > now)
+        {
+          if (throttle->is_held)
+            next_due = MIN (next_due, due);
+
+          continue;
+        }
+
+      /* the contact has been quiet for a whole interval, so its next change
+       * can be emitted immediately: forget about it */
+      if (!throttle->is_held)
+        {
+          g_hash_table_iter_remove (&iter);
+          continue;
+        }
+
+      throttle->is_held = FALSE;
+
+      /* e.g. composing -> paused -> composing within one interval */
+      if (throttle->held == throttle->emitted)
+        continue;
+
+      throttle->last_emitted = now;
+      throttle->emitted = throttle->held;
+
+      tp_svc_channel_interface_chat_state_emit_chat_state_changed (object,
+          GPOINTER_TO_UINT (key), throttle->held);
+    }
+
+  if (next_due != G_MAXINT64)
+    mixin->priv->chat_state_flush_id = g_timeout_add (
+        us_to_ms (next_due - now), flush_chat_states_cb, object);
+
+  return FALSE;
+}
+
+static gboolean
+send_held_chat_state_cb (gpointer user_data)
+{
+  GObject *object = user_data;
+  TpMessageMixin *mixin = TP_MESSAGE_MIXIN (object);
+  GError *error = NULL;
+
+  mixin->priv->chat_state_send_id = 0;
+
+  if (mixin->priv->chat_state_held == mixin->priv->chat_state_sent)
+    return FALSE;
+
+  mixin->priv->chat_state_last_sent = g_get_monotonic_time ();
+  DEBUG ("sending held chat state %u", mixin->priv->chat_state_held);
+
+  if (mixin->priv->send_chat_state (object, mixin->priv->chat_state_held,
+        &error))
+    {
+      mixin->priv->chat_state_sent = mixin->priv->chat_state_held;
+    }
+  else
+    {
+      DEBUG ("failed to send chat state %u: %s",
+          mixin->priv->chat_state_held, error->message);
+      g_clear_error (&error);
+    }
+
+  return FALSE;
+}
+
+/**
+ * tp_message_mixin_set_chat_state_interval:
+ * @object: an instance of the implementation that uses this mixin
+ * @interval_ms: the minimum time between chat state changes for each
+ *  contact, in milliseconds, or 0 to pass every change on immediately (the
+ *  default)
+ *
+ * Limit how often chat state changes are passed on, which is worthwhile in
+ * large chatrooms where typing notifications from many members would
+ * otherwise keep D-Bus busy.
+ *
+ * After ChatStateChanged has been emitted for a member, further changes
+ * made with tp_message_mixin_change_chat_state() within @interval_ms are
+ * merged, and only the latest state is emitted when the interval is up; the
+ * ChatStates property is always up to date. Similarly, after our own chat
+ * state has been sent with the #TpMessageMixinSendChatStateImpl, only the
+ * latest state requested with SetChatState within @interval_ms is sent when
+ * the interval is up; if sending it fails, the error is only logged.
+ *
+ * Since: 0.UNRELEASED
+ */
+void
+tp_message_mixin_set_chat_state_interval (GObject *object,
+    guint interval_ms)
+{
+  TpMessageMixin *mixin = TP_MESSAGE_MIXIN (object);
+
+  mixin->priv->chat_state_interval = interval_ms;
+
+  /* pass on anything that was being held back */
+  if (mixin->priv->chat_state_flush_id != 0)
+    {
+      g_source_remove (mixin->priv->chat_state_flush_id);
+      mixin->priv->chat_state_flush_id = 0;
+      flush_chat_states_cb (object);
+    }
+
+  if (mixin->priv->chat_state_send_id != 0)
+    {
+      g_source_remove (mixin->priv->chat_state_send_id);
+      mixin->priv->chat_state_send_id = 0;
+      send_held_chat_state_cb (object);
+    }
+}
+
 static TpChannelChatState
 lookup_current_chat_state (TpMessageMixin *mixin,
     TpHandle member)
@@ -366,8 +966,11 @@ tp_message_mixin_change_chat_state (GObject *object,
           GUINT_TO_POINTER (state));
     }
 
-  tp_svc_channel_interface_chat_state_emit_chat_state_changed (object,
-      member, state);
+  if (mixin->priv->chat_state_interval == 0)
+    tp_svc_channel_interface_chat_state_emit_chat_state_changed (object,
+        member, state);
+  else
+    emit_chat_state_throttled (object, member, state);
 }
 
 /**
@@ -419,6 +1022,13 @@ tp_message_mixin_maybe_send_gone (GObject *object)
 {
   TpMessageMixin *mixin = TP_MESSAGE_MIXIN (object);
 
+  /* we're leaving, so whatever we were about to send is moot */
+  if (mixin->priv->chat_state_send_id != 0)
+    {
+      g_source_remove (mixin->priv->chat_state_send_id);
+      mixin->priv->chat_state_send_id = 0;
+    }
+
   if (mixin->priv->send_gone && !TP_HAS_GROUP_MIXIN (object) &&
       mixin->priv->send_chat_state != NULL)
     {
@@ -481,9 +1091,43 @@ tp_message_mixin_set_chat_state_async (TpSvcChannelInterfaceChatState *iface,
       goto error;
     }
 
+  if (mixin->priv->chat_state_interval > 0)
+    {
+      gint64 due = mixin->priv->chat_state_last_sent +
+          (gint64) mixin->priv->chat_state_interval * 1000;
+      gint64 now = g_get_monotonic_time ();
+
+      if (now < due)
+        {
+          mixin->priv->chat_state_held = state;
+
+          if (mixin->priv->chat_state_send_id == 0)
+            mixin->priv->chat_state_send_id = g_timeout_add (
+                us_to_ms (due - now), send_held_chat_state_cb, object);
+
+          goto done;
+        }
+
+      /* this supersedes any state still held back, which must not be sent
+       * after it */
+      if (mixin->priv->chat_state_send_id != 0)
+        {
+          g_source_remove (mixin->priv->chat_state_send_id);
+          mixin->priv->chat_state_send_id = 0;
+        }
+
+      mixin->priv->chat_state_held = state;
+      mixin->priv->chat_state_last_sent = now;
+    }
+
+  DEBUG ("sending chat state %u", state);
+
   if (!mixin->priv->send_chat_state (object, state, &error))
     goto error;
 
+  mixin->priv->chat_state_sent = state;
+
+done:
   mixin->priv->send_gone = TRUE;
   tp_message_mixin_change_chat_state (object, get_self_handle (object), state);
 
@@ -530,6 +1174,7 @@ tp_message_mixin_init (GObject *obj,
   mixin->priv = g_slice_new0 (TpMessageMixinPrivate);
 
   mixin->priv->pending = g_queue_new ();
+  mixin->priv->pending_index = g_hash_table_new (NULL, NULL);
   mixin->priv->recv_id = 0;
   mixin->priv->msg_types = g_array_sized_new (FALSE, FALSE, sizeof (guint),
       TP_NUM_CHANNEL_TEXT_MESSAGE_TYPES);
@@ -538,6 +1183,8 @@ tp_message_mixin_init (GObject *obj,
   mixin->priv->supported_content_types = g_new0 (gchar *, 1);
 
   mixin->priv->chat_states = g_hash_table_new (NULL, NULL);
+  mixin->priv->chat_state_throttles = g_hash_table_new_full (NULL, NULL,
+      NULL, chat_state_throttle_free);
 }
 
 
@@ -552,12 +1199,17 @@ void
 tp_message_mixin_clear (GObject *obj)
 {
   TpMessageMixin *mixin = TP_MESSAGE_MIXIN (obj);
-  TpMessage *item;
+  PendingItem *item;
+
+  g_hash_table_remove_all (mixin->priv->pending_index);
 
   while ((item = g_queue_pop_head (mixin->priv->pending)) != NULL)
     {
-      tp_message_destroy (item);
+      pending_item_free (mixin, item);
     }
+
+  if (mixin->priv->spill_stream != NULL)
+    spill_maybe_reset (mixin);
 }
 
 
@@ -579,12 +1231,32 @@ tp_message_mixin_finalize (GObject *obj)
   tp_message_mixin_clear (obj);
   g_assert (g_queue_is_empty (mixin->priv->pending));
   g_queue_free (mixin->priv->pending);
+  g_hash_table_unref (mixin->priv->pending_index);
+
+  if (mixin->priv->spill_source_id != 0)
+    g_source_remove (mixin->priv->spill_source_id);
+
+  if (mixin->priv->spill_file != NULL)
+    {
+      g_io_stream_close (G_IO_STREAM (mixin->priv->spill_stream), NULL, NULL);
+      g_file_delete (mixin->priv->spill_file, NULL, NULL);
+      g_object_unref (mixin->priv->spill_stream);
+      g_object_unref (mixin->priv->spill_file);
+    }
+
   g_array_unref (mixin->priv->msg_types);
   g_strfreev (mixin->priv->supported_content_types);
 
   g_object_unref (mixin->priv->connection);
 
   g_hash_table_unref (mixin->priv->chat_states);
+  g_hash_table_unref (mixin->priv->chat_state_throttles);
+
+  if (mixin->priv->chat_state_flush_id != 0)
+    g_source_remove (mixin->priv->chat_state_flush_id);
+
+  if (mixin->priv->chat_state_send_id != 0)
+    g_source_remove (mixin->priv->chat_state_send_id);
 
   g_slice_free (TpMessageMixinPrivate, mixin->priv);
 }
@@ -616,8 +1288,7 @@ tp_message_mixin_acknowledge_pending_messages_async (
         }
 
       tp_intset_add (seen, id);
-      link_ = g_queue_find_custom (mixin->priv->pending,
-          GUINT_TO_POINTER (id), pending_item_id_equals_data);
+      link_ = pending_find (mixin, id);
 
       if (link_ == NULL)
         {
@@ -642,13 +1313,11 @@ tp_message_mixin_acknowledge_pending_messages_async (
   for (i = 0; i < links->len; i++)
     {
       GList *link_ = g_ptr_array_index (links, i);
-      TpMessage *item = link_->data;
-      TpCMMessage *cm_msg = link_->data;
+      PendingItem *item = link_->data;
 
-      DEBUG ("acknowledging message id %u", cm_msg->incoming_id);
+      DEBUG ("acknowledging message id %u", item->id);
 
-      g_queue_delete_link (mixin->priv->pending, link_);
-      tp_message_destroy (item);
+      pending_delete_link (mixin, link_);
     }
 
   g_ptr_array_unref (links);
@@ -675,22 +1344,34 @@ tp_message_mixin_list_pending_messages_async (TpSvcChannelTypeText *iface,
        cur != NULL;
        cur = cur->next)
     {
-      TpMessage *msg = cur->data;
-      TpCMMessage *cm_msg = cur->data;
+      PendingItem *item = cur->data;
+      TpMessage *msg;
       GValue val = { 0, };
       gchar *text;
       TpChannelTextMessageFlags flags;
       TpChannelTextMessageType type;
       TpHandle sender;
       guint timestamp;
+      GError *error = NULL;
+
+      msg = pending_item_dup_message (mixin, item, &error);
+
+      if (msg == NULL)
+        {
+          WARNING ("omitting pending message %u: %s", item->id,
+              error->message);
+          g_clear_error (&error);
+          continue;
+        }
 
       text = parts_to_text (msg, &flags, &type, &sender, &timestamp);
+      g_object_unref (msg);
 
       g_value_init (&val, pending_type);
       g_value_take_boxed (&val,
           dbus_g_type_specialized_construct (pending_type));
       dbus_g_type_struct_set (&val,
-          0, cm_msg->incoming_id,
+          0, item->id,
           1, timestamp,
           2, sender,
           3, type,
@@ -714,14 +1395,12 @@ tp_message_mixin_list_pending_messages_async (TpSvcChannelTypeText *iface,
 
       while (cur != NULL)
         {
-          TpMessage *msg = cur->data;
-          TpCMMessage *cm_msg = cur->data;
+          PendingItem *item = cur->data;
           GList *next = cur->next;
 
-          i = cm_msg->incoming_id;
+          i = item->id;
           g_array_append_val (ids, i);
-          g_queue_delete_link (mixin->priv->pending, cur);
-          tp_message_destroy (msg);
+          pending_delete_link (mixin, cur);
 
           cur = next;
         }
@@ -751,10 +1430,10 @@ tp_message_mixin_get_pending_message_content_async (
   GList *node;
   TpMessage *item;
   GHashTable *ret;
+  GError *load_error = NULL;
   guint i;
 
-  node = g_queue_find_custom (mixin->priv->pending,
-      GUINT_TO_POINTER (message_id), pending_item_id_equals_data);
+  node = pending_find (mixin, message_id);
 
   if (node == NULL)
     {
@@ -767,7 +1446,15 @@ tp_message_mixin_get_pending_message_content_async (
       return;
     }
 
-  item = node->data;
+  item = pending_item_dup_message (mixin, node->data, &load_error);
+
+  if (item == NULL)
+    {
+      DEBUG ("%s", load_error->message);
+      dbus_g_method_return_error (context, load_error);
+      g_error_free (load_error);
+      return;
+    }
 
   for (i = 0; i < part_numbers->len; i++)
     {
@@ -781,6 +1468,7 @@ tp_message_mixin_get_pending_message_content_async (
           DEBUG ("%s", error->message);
           dbus_g_method_return_error (context, error);
           g_error_free (error);
+          g_object_unref (item);
           return;
         }
     }
@@ -818,6 +1506,7 @@ tp_message_mixin_get_pending_message_content_async (
       context, ret);
 
   g_hash_table_unref (ret);
+  g_object_unref (item);
 }
 
 static void
@@ -832,7 +1521,7 @@ tp_message_mixin_get_message_types_async (TpSvcChannelTypeText *iface,
 
 
 static void
-queue_pending (GObject *object, TpMessage *pending)
+queue_pending (GObject *object, TpMessage *pending, gboolean legacy)
 {
   TpMessageMixin *mixin = TP_MESSAGE_MIXIN (object);
   TpChannelTextMessageFlags flags;
@@ -844,16 +1533,22 @@ queue_pending (GObject *object, TpMessage *pending)
   TpDeliveryStatus delivery_status;
   TpCMMessage *cm_message = (TpCMMessage *) pending;
 
-  g_queue_push_tail (mixin->priv->pending, pending);
+  pending_push_tail (mixin, pending);
 
-  text = parts_to_text (pending, &flags, &type, &sender, &timestamp);
-  tp_svc_channel_type_text_emit_received (object, cm_message->incoming_id,
-      timestamp, sender, type, flags, text);
-  g_free (text);
+  if (legacy)
+    {
+      text = parts_to_text (pending, &flags, &type, &sender, &timestamp);
+      tp_svc_channel_type_text_emit_received (object, cm_message->incoming_id,
+          timestamp, sender, type, flags, text);
+      g_free (text);
+    }
 
   tp_svc_channel_interface_messages_emit_message_received (object,
       pending->parts);
 
+  /* SendError is part of the legacy Text interface too */
+  if (!legacy)
+    return;
 
   /* Check if it's a failed delivery report; if so, emit SendError too. */
   header = tp_message_peek (pending, 0);
@@ -909,34 +1604,136 @@ queue_pending (GObject *object, TpMessage *pending)
 
 
 /**
- * tp_message_mixin_take_received:
+ * TpMessageMixinLegacySignals:
+ * @TP_MESSAGE_MIXIN_LEGACY_SIGNALS_ALWAYS: always emit the legacy signals
+ *  (the default)
+ * @TP_MESSAGE_MIXIN_LEGACY_SIGNALS_IF_INTERESTED: only emit the legacy
+ *  signals while at least one client has called AddClientInterest on the
+ *  connection with %TP_IFACE_CHANNEL_TYPE_TEXT; for this to work, the
+ *  connection must call tp_base_connection_add_possible_client_interest()
+ *  with %TP_IFACE_QUARK_CHANNEL_TYPE_TEXT when it is constructed
+ * @TP_MESSAGE_MIXIN_LEGACY_SIGNALS_NEVER: never emit the legacy signals
+ *
+ * Whether a channel with this mixin emits the Received signal of the Text
+ * interface for incoming messages, and its SendError signal for incoming
+ * failed delivery reports, in addition to the MessageReceived signal of the
+ * Messages interface.
+ *
+ * Clients using the Messages interface do not need the legacy signals, and
+ * not emitting them saves converting each message to plain text and sending
+ * it over D-Bus twice.
+ *
+ * Since: 0.UNRELEASED
+ */
+
+/**
+ * TP_TYPE_MESSAGE_MIXIN_LEGACY_SIGNALS:
+ *
+ * The #GEnumClass type of a #TpMessageMixinLegacySignals.
+ *
+ * Since: 0.UNRELEASED
+ */
+
+/**
+ * tp_message_mixin_set_legacy_signals:
  * @object: a channel with this mixin
- * @message: the message. Its ownership is claimed by the message
- *  mixin, so it must no longer be modified or freed
+ * @mode: when to emit the legacy Text signals for incoming messages
  *
- * Receive a message into the pending messages queue, where it will stay
- * until acknowledged, and emit the Received and ReceivedMessage signals. Also
- * emit the SendError signal if the message is a failed delivery report.
+ * Set whether @object emits the legacy Received and SendError signals of
+ * the Text interface for incoming messages. Connection managers that know
+ * their clients only use the Messages interface can call this for each
+ * channel they create.
  *
- * Returns: the message ID
+ * Since: 0.UNRELEASED
+ */
+void
+tp_message_mixin_set_legacy_signals (GObject *object,
+    TpMessageMixinLegacySignals mode)
+{
+  TpMessageMixin *mixin = TP_MESSAGE_MIXIN (object);
+
+  g_return_if_fail (mode <= TP_MESSAGE_MIXIN_LEGACY_SIGNALS_NEVER);
+
+  mixin->priv->legacy_signals = mode;
+}
+
+/**
+ * tp_message_mixin_set_max_pending_in_memory:
+ * @object: a channel with this mixin
+ * @max_messages: the number of pending messages to keep in memory, or 0
+ *  for no limit (the default)
  *
- * Since: 0.7.21
+ * Bound the memory used by messages which have been received but not
+ * acknowledged, for instance because the handler has crashed or cannot keep
+ * up with a busy chatroom.
+ *
+ * Once there are more than @max_messages pending messages, the excess is
+ * written to an append-only temporary file shortly after being signalled,
+ * and read back from it whenever a client lists the pending messages or
+ * asks for their content. When most of the file is taken up by messages
+ * that have since been acknowledged, the rest are moved to its start. The
+ * file is deleted when @object is finalized.
+ *
+ * This only bounds the memory used between requests: answering
+ * ListPendingMessages or a request for the PendingMessages property reads
+ * every spilled message back, one at a time, but the reply holds all of
+ * them. The temporary file is read and written synchronously, from the main
+ * loop, so it should be on local storage.
+ *
+ * Since: 0.UNRELEASED
  */
-guint
-tp_message_mixin_take_received (GObject *object,
-                                TpMessage *message)
+void
+tp_message_mixin_set_max_pending_in_memory (GObject *object,
+    guint max_messages)
 {
   TpMessageMixin *mixin = TP_MESSAGE_MIXIN (object);
+
+  mixin->priv->max_pending_in_memory = max_messages;
+  spill_excess_soon (object);
+}
+
+static gboolean
+wants_legacy_signals (TpMessageMixin *mixin)
+{
+  switch (mixin->priv->legacy_signals)
+    {
+      case TP_MESSAGE_MIXIN_LEGACY_SIGNALS_NEVER:
+        return FALSE;
+
+      case TP_MESSAGE_MIXIN_LEGACY_SIGNALS_IF_INTERESTED:
+        return _tp_base_connection_has_client_interest (
+            mixin->priv->connection, TP_IFACE_QUARK_CHANNEL_TYPE_TEXT);
+
+      default:
+        return TRUE;
+    }
+}
+
+static gboolean
+check_received (TpMessage *message)
+{
   TpCMMessage *cm_msg = (TpCMMessage *) message;
   GHashTable *header;
 
-  g_return_val_if_fail (cm_msg->incoming_id == G_MAXUINT32, 0);
-  g_return_val_if_fail (message->parts->len >= 1, 0);
+  g_return_val_if_fail (cm_msg->incoming_id == G_MAXUINT32, FALSE);
+  g_return_val_if_fail (message->parts->len >= 1, FALSE);
 
   header = g_ptr_array_index (message->parts, 0);
 
   g_return_val_if_fail (g_hash_table_lookup (header, "pending-message-id")
-      == NULL, 0);
+      == NULL, FALSE);
+
+  return TRUE;
+}
+
+static guint
+take_received (GObject *object,
+    TpMessage *message,
+    gboolean legacy)
+{
+  TpMessageMixin *mixin = TP_MESSAGE_MIXIN (object);
+  TpCMMessage *cm_msg = (TpCMMessage *) message;
+  GHashTable *header = g_ptr_array_index (message->parts, 0);
 
   /* FIXME: we don't check for overflow, so in highly pathological cases we
    * might end up with multiple messages with the same ID */
@@ -955,11 +1752,83 @@ tp_message_mixin_take_received (GObject *object,
    * to the relevant signals) has access to, so there isn't actually a race
    * between putting the message into the queue and making its ID available.
    */
-  queue_pending (object, message);
+  queue_pending (object, message, legacy);
+  spill_excess_soon (object);
 
   return cm_msg->incoming_id;
 }
 
+/**
+ * tp_message_mixin_take_received:
+ * @object: a channel with this mixin
+ * @message: the message. Its ownership is claimed by the message
+ *  mixin, so it must no longer be modified or freed
+ *
+ * Receive a message into the pending messages queue, where it will stay
+ * until acknowledged, and emit the Received and ReceivedMessage signals. Also
+ * emit the SendError signal if the message is a failed delivery report.
+ * See tp_message_mixin_set_legacy_signals() for when Received and SendError
+ * are emitted.
+ *
+ * Returns: the message ID
+ *
+ * Since: 0.7.21
+ */
+guint
+tp_message_mixin_take_received (GObject *object,
+                                TpMessage *message)
+{
+  TpMessageMixin *mixin = TP_MESSAGE_MIXIN (object);
+
+  if (!check_received (message))
+    return 0;
+
+  return take_received (object, message, wants_legacy_signals (mixin));
+}
+
+/**
+ * tp_message_mixin_take_received_batch:
+ * @object: a channel with this mixin
+ * @n_messages: the number of messages in @messages
+ * @messages: (array length=n_messages): the messages, oldest first. Their
+ *  ownership is claimed by the message mixin, so they must no longer be
+ *  modified or freed; the array itself still belongs to the caller
+ *
+ * Receive several messages into the pending messages queue, in order, as if
+ * by calling tp_message_mixin_take_received() for each of them. This is
+ * cheaper for connection managers that receive many messages at once, such
+ * as the history of a chat room which is replayed when joining it.
+ *
+ * The ID of each message can be found in its "pending-message-id" header.
+ *
+ * Since: 0.UNRELEASED
+ */
+void
+tp_message_mixin_take_received_batch (GObject *object,
+    guint n_messages,
+    TpMessage * const *messages)
+{
+  TpMessageMixin *mixin = TP_MESSAGE_MIXIN (object);
+  gboolean legacy;
+  guint i;
+
+  g_return_if_fail (n_messages == 0 || messages != NULL);
+
+  /* don't take any of the messages if one of them is wrong */
+  for (i = 0; i < n_messages; i++)
+    {
+      if (!check_received (messages[i]))
+        return;
+    }
+
+  legacy = wants_legacy_signals (mixin);
+
+  DEBUG ("receiving %u messages", n_messages);
+
+  for (i = 0; i < n_messages; i++)
+    take_received (object, messages[i], legacy);
+}
+
 
 /**
  * tp_message_mixin_has_pending_messages:
@@ -978,11 +1847,15 @@ tp_message_mixin_has_pending_messages (GObject *object,
                                        TpHandle *first_sender)
 {
   TpMessageMixin *mixin = TP_MESSAGE_MIXIN (object);
-  TpMessage *msg = g_queue_peek_head (mixin->priv->pending);
+  PendingItem *item = g_queue_peek_head (mixin->priv->pending);
 
-  if (msg != NULL && first_sender != NULL)
+  if (item != NULL && item->msg == NULL && first_sender != NULL)
+    {
+      *first_sender = item->sender;
+    }
+  else if (item != NULL && first_sender != NULL)
     {
-      const GHashTable *header = tp_message_peek (msg, 0);
+      const GHashTable *header = tp_message_peek (item->msg, 0);
       gboolean valid = TRUE;
       TpHandle h = tp_asv_get_uint32 (header, "message-sender", &valid);
 
@@ -992,7 +1865,7 @@ tp_message_mixin_has_pending_messages (GObject *object,
         WARNING ("oldest message's message-sender is mistyped");
     }
 
-  return (msg != NULL);
+  return (item != NULL);
 }
 
 
@@ -1013,9 +1886,12 @@ tp_message_mixin_set_rescued (GObject *obj)
        cur != NULL;
        cur = cur->next)
     {
-      TpMessage *msg = cur->data;
+      PendingItem *item = cur->data;
 
-      tp_message_set_boolean (msg, 0, "rescued", TRUE);
+      if (item->msg != NULL)
+        tp_message_set_boolean (item->msg, 0, "rescued", TRUE);
+      else
+        item->rescued = TRUE;
     }
 }
 
@@ -1377,6 +2253,8 @@ tp_message_mixin_get_dbus_property (GObject *object,
 
   if (name == q_pending_messages)
     {
+      /* this has to hold every pending message, including those spilled to
+       * the backlog; see tp_message_mixin_set_max_pending_in_memory() */
       GPtrArray *arrays = g_ptr_array_sized_new (g_queue_get_length (
             mixin->priv->pending));
       GList *l;
@@ -1387,9 +2265,22 @@ tp_message_mixin_get_dbus_property (GObject *object,
            l != NULL;
            l = g_list_next (l))
         {
-          TpMessage *msg = l->data;
+          PendingItem *item = l->data;
+          TpMessage *msg;
+          GError *error = NULL;
+
+          msg = pending_item_dup_message (mixin, item, &error);
+
+          if (msg == NULL)
+            {
+              WARNING ("omitting pending message %u: %s", item->id,
+                  error->message);
+              g_clear_error (&error);
+              continue;
+            }
 
           g_ptr_array_add (arrays, g_boxed_copy (type, msg->parts));
+          g_object_unref (msg);
         }
 
       g_value_take_boxed (value, arrays);
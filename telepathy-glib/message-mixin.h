@@ -49,6 +49,25 @@ void tp_message_mixin_get_dbus_property (GObject *object, GQuark interface,
 
 guint tp_message_mixin_take_received (GObject *object, TpMessage *message);
 
+_TP_AVAILABLE_IN_UNRELEASED
+void tp_message_mixin_take_received_batch (GObject *object,
+    guint n_messages,
+    TpMessage * const *messages);
+
+typedef enum {
+    TP_MESSAGE_MIXIN_LEGACY_SIGNALS_ALWAYS = 0,
+    TP_MESSAGE_MIXIN_LEGACY_SIGNALS_IF_INTERESTED,
+    TP_MESSAGE_MIXIN_LEGACY_SIGNALS_NEVER
+} TpMessageMixinLegacySignals;
+
+_TP_AVAILABLE_IN_UNRELEASED
+void tp_message_mixin_set_legacy_signals (GObject *object,
+    TpMessageMixinLegacySignals mode);
+
+_TP_AVAILABLE_IN_UNRELEASED
+void tp_message_mixin_set_max_pending_in_memory (GObject *object,
+    guint max_messages);
+
 gboolean tp_message_mixin_has_pending_messages (GObject *object,
     TpHandle *first_sender);
 
@@ -90,6 +109,10 @@ void tp_message_mixin_implement_send_chat_state (GObject *object,
 _TP_AVAILABLE_IN_0_20
 void tp_message_mixin_maybe_send_gone (GObject *object);
 
+_TP_AVAILABLE_IN_UNRELEASED
+void tp_message_mixin_set_chat_state_interval (GObject *object,
+    guint interval_ms);
+
 /* Initialization */
 void tp_message_mixin_text_iface_init (gpointer g_iface, gpointer iface_data);
 void tp_message_mixin_messages_iface_init (gpointer g_iface,
@@ -223,6 +223,59 @@ tp_message_dup_part (TpMessage *self,
   return _tp_asv_to_vardict (g_ptr_array_index (self->parts, part));
 }
 
+/**
+ * tp_message_dup_bytes:
+ * @self: a message
+ * @part: a part number
+ * @key: a key in the mapping representing the part
+ *
+ * Return the byte-array value of @key in part @part of @self, as set by
+ * tp_message_set_bytes() or tp_message_take_bytes(), or received from the
+ * connection manager.
+ *
+ * If @self can no longer be modified (see tp_message_is_mutable()), as is
+ * the case for every #TpSignalledMessage, the returned #GBytes shares the
+ * message's storage and keeps @self alive until it is released, so large
+ * payloads such as file attachments are not duplicated. Otherwise, the
+ * bytes are copied.
+ *
+ * Returns: (transfer full): the contents of @key, or %NULL if the part
+ *  number is out of range, or @key is absent or is not a byte-array
+ *
+ * Since: 0.UNRELEASED
+ */
+GBytes *
+tp_message_dup_bytes (TpMessage *self,
+    guint part,
+    const gchar *key)
+{
+  GValue *value;
+  GArray *array;
+
+  g_return_val_if_fail (TP_IS_MESSAGE (self), NULL);
+  g_return_val_if_fail (key != NULL, NULL);
+
+  if (part >= self->parts->len)
+    return NULL;
+
+  value = g_hash_table_lookup (g_ptr_array_index (self->parts, part), key);
+
+  if (value == NULL || !G_VALUE_HOLDS (value, DBUS_TYPE_G_UCHAR_ARRAY))
+    return NULL;
+
+  array = g_value_get_boxed (value);
+
+  if (array == NULL)
+    return NULL;
+
+  /* nobody can replace or delete the value while we hold a ref */
+  if (!self->priv->mutable)
+    return g_bytes_new_with_free_func (array->data, array->len,
+        g_object_unref, g_object_ref (self));
+
+  return g_bytes_new (array->data, array->len);
+}
+
 
 /**
  * tp_message_append_part:
@@ -608,6 +661,46 @@ tp_message_set_bytes (TpMessage *self,
 }
 
 
+/**
+ * tp_message_take_bytes:
+ * @self: a message
+ * @part: a part number, which must be strictly less than the number
+ *  returned by tp_message_count_parts()
+ * @key: a key in the mapping representing the part
+ * @bytes: (transfer full): the bytes
+ *
+ * Set @key in part @part of @self to have @bytes as a byte-array value,
+ * taking ownership of @bytes.
+ *
+ * Unlike tp_message_set_bytes(), if the caller held the only reference to
+ * @bytes, its data is adopted by @self without being copied; this is
+ * worthwhile for large payloads.
+ *
+ * Since: 0.UNRELEASED
+ */
+void
+tp_message_take_bytes (TpMessage *self,
+    guint part,
+    const gchar *key,
+    GBytes *bytes)
+{
+  GByteArray *array;
+
+  g_return_if_fail (part < self->parts->len);
+  g_return_if_fail (key != NULL);
+  g_return_if_fail (bytes != NULL);
+  g_return_if_fail (self->priv->mutable);
+
+  /* A GByteArray is a GArray of guint8 with a different name, which is
+   * what dbus-glib uses for DBUS_TYPE_G_UCHAR_ARRAY */
+  array = g_bytes_unref_to_array (bytes);
+
+  g_hash_table_insert (g_ptr_array_index (self->parts, part),
+      g_strdup (key),
+      tp_g_value_slice_new_take_boxed (DBUS_TYPE_G_UCHAR_ARRAY, array));
+}
+
+
 /**
  * tp_message_set:
  * @self: a message
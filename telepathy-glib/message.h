@@ -48,6 +48,8 @@ guint tp_message_count_parts (TpMessage *self);
 const GHashTable *tp_message_peek (TpMessage *self, guint part);
 _TP_AVAILABLE_IN_0_20
 GVariant *tp_message_dup_part (TpMessage *self, guint part);
+_TP_AVAILABLE_IN_UNRELEASED
+GBytes *tp_message_dup_bytes (TpMessage *self, guint part, const gchar *key);
 guint tp_message_append_part (TpMessage *self);
 void tp_message_delete_part (TpMessage *self, guint part);
 
@@ -72,6 +74,9 @@ void tp_message_set_string_printf (TpMessage *self, guint part,
     const gchar *key, const gchar *fmt, ...) G_GNUC_PRINTF (4, 5);
 void tp_message_set_bytes (TpMessage *self, guint part, const gchar *key,
     guint len, gconstpointer bytes);
+_TP_AVAILABLE_IN_UNRELEASED
+void tp_message_take_bytes (TpMessage *self, guint part, const gchar *key,
+    GBytes *bytes);
 void tp_message_set (TpMessage *self, guint part, const gchar *key,
     const GValue *source);
 _TP_AVAILABLE_IN_0_20
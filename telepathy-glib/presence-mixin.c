@@ -305,6 +305,28 @@
 
 #include "debug-internal.h"
 
+typedef struct {
+    /* the status message; the text is owned by the hash table it lives in */
+    gchar *text;
+    guint refs;
+} InternedMessage;
+
+typedef struct {
+    /* index into TpPresenceMixinClass.statuses, plus one: 0 means that
+     * nothing is cached for this handle */
+    guint index_plus_one;
+    /* borrowed from TpPresenceMixinPrivate.messages, or NULL if there is
+     * no message */
+    const gchar *message;
+} CachedPresence;
+
+struct _TpPresenceMixinPrivate {
+    /* array of CachedPresence, indexed by TpHandle */
+    GArray *cache;
+    /* borrowed gchar * (InternedMessage.text) => owned InternedMessage */
+    GHashTable *messages;
+};
+
 
 static GHashTable *construct_simple_presence_hash (
   const TpPresenceStatusSpec *supported_statuses,
@@ -328,6 +350,122 @@ deep_copy_hashtable (GHashTable *hash_table)
   return g_value_dup_boxed (&value);
 }
 
+static const gchar *
+presence_status_get_message (const TpPresenceStatus *status)
+{
+  GValue *val;
+
+  if (status->optional_arguments == NULL)
+    return NULL;
+
+  val = g_hash_table_lookup (status->optional_arguments, "message");
+
+  if (val == NULL || !G_VALUE_HOLDS_STRING (val))
+    return NULL;
+
+  return g_value_get_string (val);
+}
+
+static void
+interned_message_free (InternedMessage *im)
+{
+  g_free (im->text);
+  g_slice_free (InternedMessage, im);
+}
+
+/* Returns a string equal to @message that remains valid until a matching
+ * call to release_message(). Many contacts share the same message (and most
+ * have none at all), so each distinct message is only stored once. */
+static const gchar *
+intern_message (TpPresenceMixinPrivate *priv,
+    const gchar *message)
+{
+  InternedMessage *im;
+
+  if (tp_str_empty (message))
+    return NULL;
+
+  im = g_hash_table_lookup (priv->messages, message);
+
+  if (im == NULL)
+    {
+      im = g_slice_new (InternedMessage);
+      im->text = g_strdup (message);
+      im->refs = 0;
+      g_hash_table_insert (priv->messages, im->text, im);
+    }
+
+  im->refs++;
+  return im->text;
+}
+
+static void
+release_message (TpPresenceMixinPrivate *priv,
+    const gchar *message)
+{
+  InternedMessage *im;
+
+  if (message == NULL)
+    return;
+
+  im = g_hash_table_lookup (priv->messages, message);
+  g_return_if_fail (im != NULL);
+
+  if (--im->refs == 0)
+    g_hash_table_remove (priv->messages, message);
+}
+
+static const CachedPresence *
+cache_lookup (TpPresenceMixinPrivate *priv,
+    TpHandle handle)
+{
+  const CachedPresence *cached;
+
+  if (handle >= priv->cache->len)
+    return NULL;
+
+  cached = &g_array_index (priv->cache, CachedPresence, handle);
+
+  if (cached->index_plus_one == 0)
+    return NULL;
+
+  return cached;
+}
+
+static void
+cache_store (TpPresenceMixinPrivate *priv,
+    TpHandle handle,
+    const TpPresenceStatus *status)
+{
+  CachedPresence *cached;
+  const gchar *message;
+
+  if (handle >= priv->cache->len)
+    g_array_set_size (priv->cache, handle + 1);
+
+  cached = &g_array_index (priv->cache, CachedPresence, handle);
+
+  /* intern the new message before releasing the old one, so that an
+   * unchanged message is not freed and copied again */
+  message = intern_message (priv, presence_status_get_message (status));
+  release_message (priv, cached->message);
+
+  cached->index_plus_one = status->index + 1;
+  cached->message = message;
+}
+
+static void
+cache_store_all (TpPresenceMixinPrivate *priv,
+    GHashTable *contact_statuses)
+{
+  GHashTableIter iter;
+  gpointer key, value;
+
+  g_hash_table_iter_init (&iter, contact_statuses);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    cache_store (priv, GPOINTER_TO_UINT (key), value);
+}
+
 
 /**
  * tp_presence_status_new: (skip)
@@ -515,6 +653,47 @@ tp_presence_mixin_init (GObject *obj,
   g_type_set_qdata (G_OBJECT_TYPE (obj),
                     TP_PRESENCE_MIXIN_OFFSET_QUARK,
                     GINT_TO_POINTER (offset));
+
+  TP_PRESENCE_MIXIN (obj)->priv = NULL;
+}
+
+/**
+ * tp_presence_mixin_enable_cache: (skip)
+ * @obj: An object with this mixin
+ *
+ * Make the mixin remember the presence of every contact passed to
+ * tp_presence_mixin_emit_presence_update() or returned by the
+ * #TpPresenceMixinGetContactStatusesFunc, in a compact table indexed by
+ * handle. Each distinct status message is only stored once per connection.
+ *
+ * The SimplePresence contact attributes and the replies to GetPresences are
+ * then filled in from that table, without calling
+ * #TpPresenceMixinClass.get_contact_statuses for contacts whose presence is
+ * already known, which is considerably cheaper for connections with very
+ * large rosters.
+ *
+ * Only call this function if the connection manager calls
+ * tp_presence_mixin_emit_presence_update() every time a contact's presence
+ * changes, otherwise out-of-date presences would be returned. It should be
+ * called once, after tp_presence_mixin_init(), and the connection must call
+ * tp_presence_mixin_finalize() to free the table.
+ *
+ * Since: 0.UNRELEASED
+ */
+void
+tp_presence_mixin_enable_cache (GObject *obj)
+{
+  TpPresenceMixin *mixin = TP_PRESENCE_MIXIN (obj);
+
+  g_return_if_fail (G_IS_OBJECT (obj));
+
+  if (mixin->priv != NULL)
+    return;
+
+  mixin->priv = g_slice_new0 (TpPresenceMixinPrivate);
+  mixin->priv->cache = g_array_new (FALSE, TRUE, sizeof (CachedPresence));
+  mixin->priv->messages = g_hash_table_new_full (g_str_hash, g_str_equal,
+      NULL, (GDestroyNotify) interned_message_free);
 }
 
 /**
@@ -526,9 +705,18 @@ tp_presence_mixin_init (GObject *obj,
 void
 tp_presence_mixin_finalize (GObject *obj)
 {
+  TpPresenceMixin *mixin = TP_PRESENCE_MIXIN (obj);
+
   DEBUG ("%p", obj);
 
   /* free any data held directly by the object here */
+  if (mixin->priv != NULL)
+    {
+      g_array_unref (mixin->priv->cache);
+      g_hash_table_unref (mixin->priv->messages);
+      g_slice_free (TpPresenceMixinPrivate, mixin->priv);
+      mixin->priv = NULL;
+    }
 }
 
 static void
@@ -599,10 +787,14 @@ tp_presence_mixin_emit_presence_update (GObject *obj,
 {
   TpPresenceMixinClass *mixin_cls =
     TP_PRESENCE_MIXIN_CLASS (G_OBJECT_GET_CLASS (obj));
+  TpPresenceMixin *mixin = TP_PRESENCE_MIXIN (obj);
   GHashTable *presence_hash;
 
   DEBUG ("called.");
 
+  if (mixin->priv != NULL)
+    cache_store_all (mixin->priv, contact_statuses);
+
   if (g_type_interface_peek (G_OBJECT_GET_CLASS (obj),
       TP_TYPE_SVC_CONNECTION_INTERFACE_PRESENCE) != NULL)
     {
@@ -1376,35 +1568,19 @@ out:
 }
 
 static GValueArray *
-construct_simple_presence_value_array (TpPresenceStatus *status,
-    const TpPresenceStatusSpec *supported_statuses)
+construct_simple_presence_value_array (
+    const TpPresenceStatusSpec *supported_statuses,
+    guint index,
+    const gchar *message)
 {
-  TpConnectionPresenceType status_type;
-  const gchar *status_name;
-  const gchar *message = NULL;
-  GValueArray *presence;
-
-  status_name = supported_statuses[status->index].name;
-  status_type = supported_statuses[status->index].presence_type;
-
-  if (status->optional_arguments != NULL)
-    {
-      GValue *val;
-      val = g_hash_table_lookup (status->optional_arguments, "message");
-      if (val != NULL)
-        message = g_value_get_string (val);
-    }
-
   if (message == NULL)
     message = "";
 
-  presence = tp_value_array_build (3,
-      G_TYPE_UINT, status_type,
-      G_TYPE_STRING, status_name,
+  return tp_value_array_build (3,
+      G_TYPE_UINT, supported_statuses[index].presence_type,
+      G_TYPE_STRING, supported_statuses[index].name,
       G_TYPE_STRING, message,
       G_TYPE_INVALID);
-
-  return presence;
 }
 
 static void
@@ -1416,7 +1592,8 @@ construct_simple_presence_hash_foreach (
 {
   GValueArray *presence;
 
-  presence = construct_simple_presence_value_array (status, supported_statuses);
+  presence = construct_simple_presence_value_array (supported_statuses,
+      status->index, presence_status_get_message (status));
   g_hash_table_insert (presence_hash, GUINT_TO_POINTER (handle), presence);
 }
 
@@ -1457,6 +1634,8 @@ tp_presence_mixin_simple_presence_get_presences (
       TP_HANDLE_TYPE_CONTACT);
   TpPresenceMixinClass *mixin_cls =
     TP_PRESENCE_MIXIN_CLASS (G_OBJECT_GET_CLASS (obj));
+  TpPresenceMixin *mixin = TP_PRESENCE_MIXIN (obj);
+  GArray *uncached = NULL;
   GHashTable *contact_statuses;
   GHashTable *presence_hash;
   GError *error = NULL;
@@ -1481,21 +1660,72 @@ tp_presence_mixin_simple_presence_get_presences (
       return;
     }
 
-  contact_statuses = mixin_cls->get_contact_statuses (obj, contacts, &error);
+  presence_hash = g_hash_table_new_full (NULL, NULL, NULL,
+      (GDestroyNotify) tp_value_array_free);
 
-  if (!contact_statuses)
+  if (mixin->priv != NULL)
     {
-      dbus_g_method_return_error (context, error);
-      g_error_free (error);
-      return;
+      guint i;
+
+      for (i = 0; i < contacts->len; i++)
+        {
+          TpHandle handle = g_array_index (contacts, TpHandle, i);
+          const CachedPresence *cached = cache_lookup (mixin->priv, handle);
+
+          if (cached != NULL)
+            {
+              g_hash_table_insert (presence_hash, GUINT_TO_POINTER (handle),
+                  construct_simple_presence_value_array (mixin_cls->statuses,
+                    cached->index_plus_one - 1, cached->message));
+            }
+          else
+            {
+              if (uncached == NULL)
+                uncached = g_array_new (FALSE, FALSE, sizeof (TpHandle));
+
+              g_array_append_val (uncached, handle);
+            }
+        }
+
+      DEBUG ("%u of %u contacts cached",
+          contacts->len - (uncached == NULL ? 0 : uncached->len),
+          contacts->len);
+    }
+
+  if (mixin->priv == NULL || uncached != NULL)
+    {
+      GHashTableIter iter;
+      gpointer key, value;
+
+      contact_statuses = mixin_cls->get_contact_statuses (obj,
+          uncached != NULL ? uncached : contacts, &error);
+
+      if (!contact_statuses)
+        {
+          dbus_g_method_return_error (context, error);
+          g_error_free (error);
+          goto out;
+        }
+
+      if (mixin->priv != NULL)
+        cache_store_all (mixin->priv, contact_statuses);
+
+      g_hash_table_iter_init (&iter, contact_statuses);
+      while (g_hash_table_iter_next (&iter, &key, &value))
+        construct_simple_presence_hash_foreach (presence_hash,
+            mixin_cls->statuses, GPOINTER_TO_UINT (key), value);
+
+      g_hash_table_unref (contact_statuses);
     }
 
-  presence_hash = construct_simple_presence_hash (mixin_cls->statuses,
-      contact_statuses);
   tp_svc_connection_interface_simple_presence_return_from_get_presences (
       context, presence_hash);
+
+out:
   g_hash_table_unref (presence_hash);
-  g_hash_table_unref (contact_statuses);
+
+  if (uncached != NULL)
+    g_array_unref (uncached);
 }
 
 /**
@@ -1523,15 +1753,65 @@ tp_presence_mixin_simple_presence_iface_init (gpointer g_iface,
 #undef IMPLEMENT
 }
 
+static void
+set_simple_presence_attribute (GHashTable *attributes_hash,
+    TpHandle handle,
+    const TpPresenceStatusSpec *supported_statuses,
+    guint index,
+    const gchar *message)
+{
+  GValueArray *presence = construct_simple_presence_value_array (
+      supported_statuses, index, message);
+  G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+  GType type = G_TYPE_VALUE_ARRAY;
+  G_GNUC_END_IGNORE_DEPRECATIONS
+
+  tp_contacts_mixin_set_contact_attribute (attributes_hash, handle,
+      TP_TOKEN_CONNECTION_INTERFACE_SIMPLE_PRESENCE_PRESENCE,
+      tp_g_value_slice_new_take_boxed (type, presence));
+}
+
 static void
 tp_presence_mixin_simple_presence_fill_contact_attributes (GObject *obj,
   const GArray *contacts, GHashTable *attributes_hash)
 {
   TpPresenceMixinClass *mixin_cls =
     TP_PRESENCE_MIXIN_CLASS (G_OBJECT_GET_CLASS (obj));
+  TpPresenceMixin *mixin = TP_PRESENCE_MIXIN (obj);
+  GArray *uncached = NULL;
   GHashTable *contact_statuses;
   GError *error = NULL;
 
+  if (mixin->priv != NULL)
+    {
+      guint i;
+
+      for (i = 0; i < contacts->len; i++)
+        {
+          TpHandle handle = g_array_index (contacts, TpHandle, i);
+          const CachedPresence *cached = cache_lookup (mixin->priv, handle);
+
+          if (cached != NULL)
+            {
+              set_simple_presence_attribute (attributes_hash, handle,
+                  mixin_cls->statuses, cached->index_plus_one - 1,
+                  cached->message);
+            }
+          else
+            {
+              if (uncached == NULL)
+                uncached = g_array_new (FALSE, FALSE, sizeof (TpHandle));
+
+              g_array_append_val (uncached, handle);
+            }
+        }
+
+      if (uncached == NULL)
+        return;
+
+      contacts = uncached;
+    }
+
   contact_statuses = mixin_cls->get_contact_statuses (obj, contacts, &error);
 
   if (contact_statuses == NULL)
@@ -1543,25 +1823,25 @@ tp_presence_mixin_simple_presence_fill_contact_attributes (GObject *obj,
     {
       GHashTableIter iter;
       gpointer key, value;
-      G_GNUC_BEGIN_IGNORE_DEPRECATIONS
-      GType type = G_TYPE_VALUE_ARRAY;
-      G_GNUC_END_IGNORE_DEPRECATIONS
+
+      if (mixin->priv != NULL)
+        cache_store_all (mixin->priv, contact_statuses);
 
       g_hash_table_iter_init (&iter, contact_statuses);
       while (g_hash_table_iter_next (&iter, &key, &value))
         {
-          TpHandle handle = GPOINTER_TO_UINT (key);
           TpPresenceStatus *status = value;
-          GValueArray *presence = construct_simple_presence_value_array (
-              status, mixin_cls->statuses);
 
-          tp_contacts_mixin_set_contact_attribute (attributes_hash, handle,
-              TP_TOKEN_CONNECTION_INTERFACE_SIMPLE_PRESENCE_PRESENCE,
-              tp_g_value_slice_new_take_boxed (type, presence));
+          set_simple_presence_attribute (attributes_hash,
+              GPOINTER_TO_UINT (key), mixin_cls->statuses, status->index,
+              presence_status_get_message (status));
         }
 
       g_hash_table_unref (contact_statuses);
     }
+
+  if (uncached != NULL)
+    g_array_unref (uncached);
 }
 
 /**
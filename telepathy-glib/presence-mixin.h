@@ -172,6 +172,9 @@ void tp_presence_mixin_class_init (GObjectClass *obj_cls, glong offset,
 void tp_presence_mixin_init (GObject *obj, glong offset);
 void tp_presence_mixin_finalize (GObject *obj);
 
+_TP_AVAILABLE_IN_UNRELEASED
+void tp_presence_mixin_enable_cache (GObject *obj);
+
 void tp_presence_mixin_emit_presence_update (GObject *obj,
     GHashTable *contact_presences);
 void tp_presence_mixin_emit_one_presence_update (GObject *obj,
@@ -48,6 +48,11 @@ struct _TpSignalledMessage {
 TpMessage * _tp_signalled_message_new (const GPtrArray *parts,
     TpContact *sender);
 
+TpMessage * _tp_signalled_message_new_without_sender (
+    const GPtrArray *parts);
+void _tp_signalled_message_set_sender (TpMessage *message,
+    TpContact *sender);
+
 
 guint _tp_signalled_message_get_pending_message_id (TpMessage *message,
     gboolean *valid);
@@ -155,32 +155,25 @@ tp_signalled_message_init (TpSignalledMessage *self)
 }
 
 /*
- * Create a new TpSignalledMessage.
+ * Create a new TpSignalledMessage whose sender is not known yet, copying
+ * @parts.
  *
- * Any message-sender and message-sender-id in parts[0] will be ignored
- * completely: the caller is responsible for interpreting those fields
- * and providing a suitable @sender.
- *
- * The message-sender will be removed from the header, and the
- * message-sender-id will be set to match the #TpContact:identifier of @sender.
- *
- * @sender may be %NULL, which means the message wasn't sent by a contact
- * (this could be used for administrative messages from a chatroom or the
- * server) or we have no idea who sent it.
+ * The message must not be used until _tp_signalled_message_set_sender() has
+ * been called. This lets the caller drop @parts (typically owned by
+ * dbus-glib) as soon as it has been received, rather than keeping a
+ * second copy of a potentially large message alive while the sender is
+ * being prepared.
  */
 TpMessage *
-_tp_signalled_message_new (const GPtrArray *parts,
-    TpContact *sender)
+_tp_signalled_message_new_without_sender (const GPtrArray *parts)
 {
   TpMessage *self;
   guint i;
 
   g_return_val_if_fail (parts != NULL, NULL);
   g_return_val_if_fail (parts->len > 0, NULL);
-  g_return_val_if_fail (sender == NULL || TP_IS_CONTACT (sender), NULL);
 
   self = g_object_new (TP_TYPE_SIGNALLED_MESSAGE,
-      "sender", sender,
       NULL);
 
   for (i = 0; i < parts->len; i++)
@@ -199,18 +192,71 @@ _tp_signalled_message_new (const GPtrArray *parts,
    * directly */
   tp_message_delete_key (self, 0, "message-sender");
 
+  return self;
+}
+
+/*
+ * Finish a message created by _tp_signalled_message_new_without_sender(),
+ * which becomes immutable.
+ *
+ * The message-sender-id will be set to match the #TpContact:identifier of
+ * @sender, which may be %NULL as for _tp_signalled_message_new().
+ */
+void
+_tp_signalled_message_set_sender (TpMessage *message,
+    TpContact *sender)
+{
+  TpSignalledMessage *self = (TpSignalledMessage *) message;
+
+  g_return_if_fail (TP_IS_SIGNALLED_MESSAGE (message));
+  g_return_if_fail (tp_message_is_mutable (message));
+  g_return_if_fail (sender == NULL || TP_IS_CONTACT (sender));
+
+  g_assert (self->priv->sender == NULL);
+
+  if (sender != NULL)
+    self->priv->sender = g_object_ref (sender);
+
   /* override any message-sender-id that the message might have had */
   if (sender == NULL)
     {
-      tp_message_delete_key (self, 0, "message-sender-id");
+      tp_message_delete_key (message, 0, "message-sender-id");
     }
   else
     {
-      tp_message_set_string (self, 0, "message-sender-id",
+      tp_message_set_string (message, 0, "message-sender-id",
           tp_contact_get_identifier (sender));
     }
 
-  _tp_message_set_immutable (self);
+  _tp_message_set_immutable (message);
+}
+
+/*
+ * Create a new TpSignalledMessage.
+ *
+ * Any message-sender and message-sender-id in parts[0] will be ignored
+ * completely: the caller is responsible for interpreting those fields
+ * and providing a suitable @sender.
+ *
+ * The message-sender will be removed from the header, and the
+ * message-sender-id will be set to match the #TpContact:identifier of @sender.
+ *
+ * @sender may be %NULL, which means the message wasn't sent by a contact
+ * (this could be used for administrative messages from a chatroom or the
+ * server) or we have no idea who sent it.
+ */
+TpMessage *
+_tp_signalled_message_new (const GPtrArray *parts,
+    TpContact *sender)
+{
+  TpMessage *self;
+
+  g_return_val_if_fail (sender == NULL || TP_IS_CONTACT (sender), NULL);
+
+  self = _tp_signalled_message_new_without_sender (parts);
+
+  if (self != NULL)
+    _tp_signalled_message_set_sender (self, sender);
 
   return self;
 }
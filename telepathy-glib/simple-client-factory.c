@@ -135,8 +135,21 @@ struct _TpSimpleClientFactoryPrivate
   GArray *desired_connection_features;
   GArray *desired_channel_features;
   GArray *desired_contact_features;
+  guint group_members_batch_size;
+  gboolean lazy_group_members;
+  guint contact_list_page_size;
+  guint avatar_request_batch_size;
+  guint avatar_request_interval;
+  gboolean batch_contact_changes;
+  guint contact_info_request_batch_size;
+  guint contact_info_request_interval;
 };
 
+#define DEFAULT_AVATAR_REQUEST_BATCH_SIZE 50
+#define DEFAULT_AVATAR_REQUEST_INTERVAL 500
+#define DEFAULT_CONTACT_INFO_REQUEST_BATCH_SIZE 20
+#define DEFAULT_CONTACT_INFO_REQUEST_INTERVAL 1000
+
 enum
 {
   PROP_DBUS_DAEMON = 1,
@@ -341,6 +354,12 @@ tp_simple_client_factory_init (TpSimpleClientFactory *self)
       TpSimpleClientFactoryPrivate);
 
   self->priv->proxy_cache = g_hash_table_new (g_str_hash, g_str_equal);
+  self->priv->avatar_request_batch_size = DEFAULT_AVATAR_REQUEST_BATCH_SIZE;
+  self->priv->avatar_request_interval = DEFAULT_AVATAR_REQUEST_INTERVAL;
+  self->priv->contact_info_request_batch_size =
+      DEFAULT_CONTACT_INFO_REQUEST_BATCH_SIZE;
+  self->priv->contact_info_request_interval =
+      DEFAULT_CONTACT_INFO_REQUEST_INTERVAL;
 
   self->priv->desired_account_features = g_array_new (TRUE, FALSE,
       sizeof (GQuark));
@@ -823,6 +842,412 @@ tp_simple_client_factory_add_channel_features_varargs (
   va_end (var_args);
 }
 
+/**
+ * tp_simple_client_factory_set_group_members_batch_size:
+ * @self: a #TpSimpleClientFactory object
+ * @batch_size: the maximum number of members to report at a time,
+ *  or 0 to report all members at once
+ *
+ * Ask #TpChannel objects created by this factory, or using connections
+ * created by this factory, to report the members of very large groups
+ * (such as busy chat rooms) a few at a time.
+ *
+ * If @batch_size is non-zero and a group has more than @batch_size members
+ * when %TP_CHANNEL_FEATURE_GROUP is prepared, the channel becomes ready as
+ * soon as it knows about the first @batch_size members (and, if prepared,
+ * %TP_CHANNEL_FEATURE_CONTACTS only creates #TpContact objects for those).
+ * The remaining members are then added from idle callbacks, at most
+ * @batch_size at a time, as if the connection manager had announced them
+ * with a series of MembersChanged signals: #TpChannel::group-members-changed,
+ * #TpChannel::group-members-changed-detailed and
+ * #TpChannel::group-contacts-changed are emitted for each batch.
+ *
+ * Until all members have been reported, tp_channel_group_get_members() and
+ * tp_channel_group_dup_members_contacts() only return the members reported
+ * so far. The local user is always reported in the first batch.
+ *
+ * This only affects channels whose group properties have not been retrieved
+ * yet.
+ *
+ * Since: 0.UNRELEASED
+ */
+void
+tp_simple_client_factory_set_group_members_batch_size (
+    TpSimpleClientFactory *self,
+    guint batch_size)
+{
+  g_return_if_fail (TP_IS_SIMPLE_CLIENT_FACTORY (self));
+
+  self->priv->group_members_batch_size = batch_size;
+}
+
+/**
+ * tp_simple_client_factory_get_group_members_batch_size:
+ * @self: a #TpSimpleClientFactory object
+ *
+ * <!-- -->
+ *
+ * Returns: the value passed to
+ *  tp_simple_client_factory_set_group_members_batch_size(), or 0 if members
+ *  of groups are reported all at once
+ *
+ * Since: 0.UNRELEASED
+ */
+guint
+tp_simple_client_factory_get_group_members_batch_size (
+    TpSimpleClientFactory *self)
+{
+  g_return_val_if_fail (TP_IS_SIMPLE_CLIENT_FACTORY (self), 0);
+
+  return self->priv->group_members_batch_size;
+}
+
+/**
+ * tp_simple_client_factory_set_lazy_group_members:
+ * @self: a #TpSimpleClientFactory object
+ * @lazy: %TRUE if #TpContact objects for group members should only be
+ *  created when they are needed
+ *
+ * Ask #TpChannel objects created by this factory, or using connections
+ * created by this factory, not to create a #TpContact for each member of
+ * a group when %TP_CHANNEL_FEATURE_CONTACTS is prepared. This is intended
+ * for clients, such as bots, which are in many large chat rooms but rarely
+ * need to know anything about most of the members.
+ *
+ * If @lazy is %TRUE, members are only remembered as a handle and an
+ * identifier until a #TpContact is requested with
+ * tp_channel_group_dup_member_contact_by_handle() or
+ * tp_channel_group_dup_members_contacts(). Contacts created in this way do
+ * not have the features from tp_simple_client_factory_dup_contact_features()
+ * prepared yet; they are prepared in the background, one batch per main
+ * loop iteration, and the usual #GObject::notify signals are emitted when
+ * they are.
+ *
+ * The added and removed arrays in #TpChannel::group-contacts-changed only
+ * contain members for which a #TpContact has already been created; use
+ * #TpChannel::group-members-changed to track the others. Local-pending and
+ * remote-pending contacts, the local user and handle owners are not
+ * affected.
+ *
+ * This only affects channels for which %TP_CHANNEL_FEATURE_GROUP has not
+ * been prepared yet.
+ *
+ * Since: 0.UNRELEASED
+ */
+void
+tp_simple_client_factory_set_lazy_group_members (TpSimpleClientFactory *self,
+    gboolean lazy)
+{
+  g_return_if_fail (TP_IS_SIMPLE_CLIENT_FACTORY (self));
+
+  self->priv->lazy_group_members = lazy;
+}
+
+/**
+ * tp_simple_client_factory_get_lazy_group_members:
+ * @self: a #TpSimpleClientFactory object
+ *
+ * <!-- -->
+ *
+ * Returns: the value passed to
+ *  tp_simple_client_factory_set_lazy_group_members(), %FALSE by default
+ *
+ * Since: 0.UNRELEASED
+ */
+gboolean
+tp_simple_client_factory_get_lazy_group_members (TpSimpleClientFactory *self)
+{
+  g_return_val_if_fail (TP_IS_SIMPLE_CLIENT_FACTORY (self), FALSE);
+
+  return self->priv->lazy_group_members;
+}
+
+/**
+ * tp_simple_client_factory_set_contact_list_page_size:
+ * @self: a #TpSimpleClientFactory object
+ * @page_size: the maximum number of contacts to prepare at a time when
+ *  retrieving the contact list, or 0 to retrieve it all at once
+ *
+ * Ask #TpConnection objects created by this factory to retrieve very large
+ * contact lists a page at a time when %TP_CONNECTION_FEATURE_CONTACT_LIST is
+ * prepared.
+ *
+ * If @page_size is non-zero, the connection first retrieves only the
+ * identifiers and subscription states of the contacts in the contact list,
+ * which is much cheaper than retrieving all the features from
+ * tp_simple_client_factory_dup_contact_features(). The
+ * #TpConnection:contact-list-state then changes to
+ * %TP_CONTACT_LIST_STATE_SUCCESS straight away, with an initially empty
+ * contact list. The remaining features are retrieved for @page_size contacts
+ * at a time, and #TpConnection::contact-list-changed is emitted as each page
+ * of contacts is added to the contact list, so that user interfaces can
+ * start displaying the contact list before all of it has been retrieved.
+ *
+ * Since: 0.UNRELEASED
+ */
+void
+tp_simple_client_factory_set_contact_list_page_size (
+    TpSimpleClientFactory *self,
+    guint page_size)
+{
+  g_return_if_fail (TP_IS_SIMPLE_CLIENT_FACTORY (self));
+
+  self->priv->contact_list_page_size = page_size;
+}
+
+/**
+ * tp_simple_client_factory_get_contact_list_page_size:
+ * @self: a #TpSimpleClientFactory object
+ *
+ * <!-- -->
+ *
+ * Returns: the value passed to
+ *  tp_simple_client_factory_set_contact_list_page_size(), or 0 if contact
+ *  lists are retrieved all at once
+ *
+ * Since: 0.UNRELEASED
+ */
+guint
+tp_simple_client_factory_get_contact_list_page_size (
+    TpSimpleClientFactory *self)
+{
+  g_return_val_if_fail (TP_IS_SIMPLE_CLIENT_FACTORY (self), 0);
+
+  return self->priv->contact_list_page_size;
+}
+
+/**
+ * tp_simple_client_factory_set_avatar_request_batch_size:
+ * @self: a #TpSimpleClientFactory object
+ * @batch_size: the maximum number of avatars to request from the connection
+ *  manager at a time, or 0 to request all the avatars that are needed at once
+ *
+ * Limit the number of avatars that #TpConnection objects created by this
+ * factory request at a time for %TP_CONTACT_FEATURE_AVATAR_DATA. Requesting
+ * the avatars of a large contact list all at once can cause some servers to
+ * throttle or disconnect the connection manager.
+ *
+ * The default is 50.
+ *
+ * Since: 0.UNRELEASED
+ */
+void
+tp_simple_client_factory_set_avatar_request_batch_size (
+    TpSimpleClientFactory *self,
+    guint batch_size)
+{
+  g_return_if_fail (TP_IS_SIMPLE_CLIENT_FACTORY (self));
+
+  self->priv->avatar_request_batch_size = batch_size;
+}
+
+/**
+ * tp_simple_client_factory_get_avatar_request_batch_size:
+ * @self: a #TpSimpleClientFactory object
+ *
+ * <!-- -->
+ *
+ * Returns: the value passed to
+ *  tp_simple_client_factory_set_avatar_request_batch_size()
+ *
+ * Since: 0.UNRELEASED
+ */
+guint
+tp_simple_client_factory_get_avatar_request_batch_size (
+    TpSimpleClientFactory *self)
+{
+  g_return_val_if_fail (TP_IS_SIMPLE_CLIENT_FACTORY (self), 0);
+
+  return self->priv->avatar_request_batch_size;
+}
+
+/**
+ * tp_simple_client_factory_set_avatar_request_interval:
+ * @self: a #TpSimpleClientFactory object
+ * @interval: the minimum time in milliseconds between two requests for
+ *  avatars, or 0 to request avatars as soon as they are needed
+ *
+ * Ask #TpConnection objects created by this factory to wait at least
+ * @interval milliseconds after requesting a batch of avatars for
+ * %TP_CONTACT_FEATURE_AVATAR_DATA before requesting the next batch.
+ * See tp_simple_client_factory_set_avatar_request_batch_size().
+ *
+ * The default is 500 milliseconds.
+ *
+ * Since: 0.UNRELEASED
+ */
+void
+tp_simple_client_factory_set_avatar_request_interval (
+    TpSimpleClientFactory *self,
+    guint interval)
+{
+  g_return_if_fail (TP_IS_SIMPLE_CLIENT_FACTORY (self));
+
+  self->priv->avatar_request_interval = interval;
+}
+
+/**
+ * tp_simple_client_factory_get_avatar_request_interval:
+ * @self: a #TpSimpleClientFactory object
+ *
+ * <!-- -->
+ *
+ * Returns: the value passed to
+ *  tp_simple_client_factory_set_avatar_request_interval()
+ *
+ * Since: 0.UNRELEASED
+ */
+guint
+tp_simple_client_factory_get_avatar_request_interval (
+    TpSimpleClientFactory *self)
+{
+  g_return_val_if_fail (TP_IS_SIMPLE_CLIENT_FACTORY (self), 0);
+
+  return self->priv->avatar_request_interval;
+}
+
+/**
+ * tp_simple_client_factory_set_batch_contact_changes:
+ * @self: a #TpSimpleClientFactory object
+ * @batch: %TRUE if changes to contacts should only be signalled by
+ *  #TpConnection::contacts-changed
+ *
+ * If @batch is %TRUE, #TpContact objects of connections created by this
+ * factory do not emit #GObject::notify, #TpContact::presence-changed,
+ * #TpContact::subscription-states-changed or
+ * #TpContact::contact-groups-changed when the connection manager signals
+ * changes to them; those changes are only signalled by
+ * #TpConnection::contacts-changed, once per change notification from the
+ * connection manager.
+ *
+ * This is much cheaper for clients which keep track of thousands of
+ * contacts, but all the code using those contacts must use
+ * #TpConnection::contacts-changed.
+ *
+ * Since: 0.UNRELEASED
+ */
+void
+tp_simple_client_factory_set_batch_contact_changes (
+    TpSimpleClientFactory *self,
+    gboolean batch)
+{
+  g_return_if_fail (TP_IS_SIMPLE_CLIENT_FACTORY (self));
+
+  self->priv->batch_contact_changes = batch;
+}
+
+/**
+ * tp_simple_client_factory_get_batch_contact_changes:
+ * @self: a #TpSimpleClientFactory object
+ *
+ * <!-- -->
+ *
+ * Returns: the value passed to
+ *  tp_simple_client_factory_set_batch_contact_changes(), %FALSE by default
+ *
+ * Since: 0.UNRELEASED
+ */
+gboolean
+tp_simple_client_factory_get_batch_contact_changes (
+    TpSimpleClientFactory *self)
+{
+  g_return_val_if_fail (TP_IS_SIMPLE_CLIENT_FACTORY (self), FALSE);
+
+  return self->priv->batch_contact_changes;
+}
+
+/**
+ * tp_simple_client_factory_set_contact_info_request_batch_size:
+ * @self: a #TpSimpleClientFactory object
+ * @batch_size: the maximum number of contacts whose information is requested
+ *  from the connection manager at a time, or 0 for no limit
+ *
+ * Limit the number of contacts for which #TpConnection objects created by
+ * this factory request #TpContact:contact-info at a time, for
+ * tp_connection_refresh_contact_info() and
+ * tp_contact_request_contact_info_async(). Fetching the vCards of a large
+ * contact list all at once can cause some servers to throttle or disconnect
+ * the connection manager.
+ *
+ * The default is 20.
+ *
+ * Since: 0.UNRELEASED
+ */
+void
+tp_simple_client_factory_set_contact_info_request_batch_size (
+    TpSimpleClientFactory *self,
+    guint batch_size)
+{
+  g_return_if_fail (TP_IS_SIMPLE_CLIENT_FACTORY (self));
+
+  self->priv->contact_info_request_batch_size = batch_size;
+}
+
+/**
+ * tp_simple_client_factory_get_contact_info_request_batch_size:
+ * @self: a #TpSimpleClientFactory object
+ *
+ * <!-- -->
+ *
+ * Returns: the value passed to
+ *  tp_simple_client_factory_set_contact_info_request_batch_size()
+ *
+ * Since: 0.UNRELEASED
+ */
+guint
+tp_simple_client_factory_get_contact_info_request_batch_size (
+    TpSimpleClientFactory *self)
+{
+  g_return_val_if_fail (TP_IS_SIMPLE_CLIENT_FACTORY (self), 0);
+
+  return self->priv->contact_info_request_batch_size;
+}
+
+/**
+ * tp_simple_client_factory_set_contact_info_request_interval:
+ * @self: a #TpSimpleClientFactory object
+ * @interval: the minimum time in milliseconds between two requests for
+ *  contact information, or 0 to send requests as soon as they are made
+ *
+ * Ask #TpConnection objects created by this factory to wait at least
+ * @interval milliseconds after requesting a batch of contacts' information
+ * before requesting the next batch.
+ * See tp_simple_client_factory_set_contact_info_request_batch_size().
+ *
+ * The default is 1000 milliseconds.
+ *
+ * Since: 0.UNRELEASED
+ */
+void
+tp_simple_client_factory_set_contact_info_request_interval (
+    TpSimpleClientFactory *self,
+    guint interval)
+{
+  g_return_if_fail (TP_IS_SIMPLE_CLIENT_FACTORY (self));
+
+  self->priv->contact_info_request_interval = interval;
+}
+
+/**
+ * tp_simple_client_factory_get_contact_info_request_interval:
+ * @self: a #TpSimpleClientFactory object
+ *
+ * <!-- -->
+ *
+ * Returns: the value passed to
+ *  tp_simple_client_factory_set_contact_info_request_interval()
+ *
+ * Since: 0.UNRELEASED
+ */
+guint
+tp_simple_client_factory_get_contact_info_request_interval (
+    TpSimpleClientFactory *self)
+{
+  g_return_val_if_fail (TP_IS_SIMPLE_CLIENT_FACTORY (self), 0);
+
+  return self->priv->contact_info_request_interval;
+}
+
 /**
  * tp_simple_client_factory_ensure_contact:
  * @self: a #TpSimpleClientFactory object
@@ -173,6 +173,63 @@ void tp_simple_client_factory_add_channel_features_varargs (
     GQuark feature,
     ...);
 
+_TP_AVAILABLE_IN_UNRELEASED
+void tp_simple_client_factory_set_group_members_batch_size (
+    TpSimpleClientFactory *self,
+    guint batch_size);
+_TP_AVAILABLE_IN_UNRELEASED
+guint tp_simple_client_factory_get_group_members_batch_size (
+    TpSimpleClientFactory *self);
+_TP_AVAILABLE_IN_UNRELEASED
+void tp_simple_client_factory_set_lazy_group_members (
+    TpSimpleClientFactory *self,
+    gboolean lazy);
+_TP_AVAILABLE_IN_UNRELEASED
+gboolean tp_simple_client_factory_get_lazy_group_members (
+    TpSimpleClientFactory *self);
+_TP_AVAILABLE_IN_UNRELEASED
+void tp_simple_client_factory_set_contact_list_page_size (
+    TpSimpleClientFactory *self,
+    guint page_size);
+_TP_AVAILABLE_IN_UNRELEASED
+guint tp_simple_client_factory_get_contact_list_page_size (
+    TpSimpleClientFactory *self);
+_TP_AVAILABLE_IN_UNRELEASED
+void tp_simple_client_factory_set_avatar_request_batch_size (
+    TpSimpleClientFactory *self,
+    guint batch_size);
+_TP_AVAILABLE_IN_UNRELEASED
+guint tp_simple_client_factory_get_avatar_request_batch_size (
+    TpSimpleClientFactory *self);
+_TP_AVAILABLE_IN_UNRELEASED
+void tp_simple_client_factory_set_avatar_request_interval (
+    TpSimpleClientFactory *self,
+    guint interval);
+_TP_AVAILABLE_IN_UNRELEASED
+guint tp_simple_client_factory_get_avatar_request_interval (
+    TpSimpleClientFactory *self);
+_TP_AVAILABLE_IN_UNRELEASED
+void tp_simple_client_factory_set_batch_contact_changes (
+    TpSimpleClientFactory *self,
+    gboolean batch);
+_TP_AVAILABLE_IN_UNRELEASED
+gboolean tp_simple_client_factory_get_batch_contact_changes (
+    TpSimpleClientFactory *self);
+_TP_AVAILABLE_IN_UNRELEASED
+void tp_simple_client_factory_set_contact_info_request_batch_size (
+    TpSimpleClientFactory *self,
+    guint batch_size);
+_TP_AVAILABLE_IN_UNRELEASED
+guint tp_simple_client_factory_get_contact_info_request_batch_size (
+    TpSimpleClientFactory *self);
+_TP_AVAILABLE_IN_UNRELEASED
+void tp_simple_client_factory_set_contact_info_request_interval (
+    TpSimpleClientFactory *self,
+    guint interval);
+_TP_AVAILABLE_IN_UNRELEASED
+guint tp_simple_client_factory_get_contact_info_request_interval (
+    TpSimpleClientFactory *self);
+
 /* TpContact */
 _TP_AVAILABLE_IN_0_16
 TpContact *tp_simple_client_factory_ensure_contact (TpSimpleClientFactory *self,
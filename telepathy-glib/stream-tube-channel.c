@@ -76,10 +76,117 @@
 
 G_DEFINE_TYPE (TpStreamTubeChannel, tp_stream_tube_channel, TP_TYPE_CHANNEL)
 
+/* Common part of SigWaitingConn and ConnWaitingSig. Both are indexed by the
+ * key identifying the connection: its port or the byte sent with its
+ * credentials, depending on the access control in use, or 0 if connections
+ * can't be told apart. */
+typedef struct
+{
+  guint key;
+  /* monotonic time at which we started waiting */
+  gint64 since;
+  /* our links in the WaitingIndex's queues */
+  GList *key_link;
+  GList *age_link;
+} Waiting;
+
+typedef struct
+{
+  /* guint key => owned GQueue of borrowed Waiting, oldest first */
+  GHashTable *by_key;
+  /* owned Waiting, oldest first */
+  GQueue by_age;
+  GDestroyNotify free_func;
+} WaitingIndex;
+
+static void
+waiting_index_init (WaitingIndex *index,
+    GDestroyNotify free_func)
+{
+  index->by_key = g_hash_table_new_full (NULL, NULL, NULL,
+      (GDestroyNotify) g_queue_free);
+  g_queue_init (&index->by_age);
+  index->free_func = free_func;
+}
+
+static void
+waiting_index_clear (WaitingIndex *index)
+{
+  g_hash_table_remove_all (index->by_key);
+
+  while (!g_queue_is_empty (&index->by_age))
+    index->free_func (g_queue_pop_head (&index->by_age));
+}
+
+static void
+waiting_index_destroy (WaitingIndex *index)
+{
+  waiting_index_clear (index);
+  tp_clear_pointer (&index->by_key, g_hash_table_unref);
+}
+
+/* Pass ownership of @w to @index */
+static void
+waiting_index_add (WaitingIndex *index,
+    Waiting *w)
+{
+  GQueue *queue;
+
+  queue = g_hash_table_lookup (index->by_key, GUINT_TO_POINTER (w->key));
+  if (queue == NULL)
+    {
+      queue = g_queue_new ();
+      g_hash_table_insert (index->by_key, GUINT_TO_POINTER (w->key), queue);
+    }
+
+  w->since = g_get_monotonic_time ();
+
+  g_queue_push_tail (queue, w);
+  w->key_link = g_queue_peek_tail_link (queue);
+
+  g_queue_push_tail (&index->by_age, w);
+  w->age_link = g_queue_peek_tail_link (&index->by_age);
+}
+
+/* Take @w back from @index, which no longer owns it */
+static void
+waiting_index_remove (WaitingIndex *index,
+    Waiting *w)
+{
+  GQueue *queue;
+
+  queue = g_hash_table_lookup (index->by_key, GUINT_TO_POINTER (w->key));
+  g_assert (queue != NULL);
+
+  g_queue_delete_link (queue, w->key_link);
+  if (g_queue_is_empty (queue))
+    g_hash_table_remove (index->by_key, GUINT_TO_POINTER (w->key));
+
+  g_queue_delete_link (&index->by_age, w->age_link);
+  w->key_link = NULL;
+  w->age_link = NULL;
+}
+
+/* Return the oldest item waiting with @key, or NULL */
+static gpointer
+waiting_index_lookup (WaitingIndex *index,
+    guint key)
+{
+  GQueue *queue;
+
+  queue = g_hash_table_lookup (index->by_key, GUINT_TO_POINTER (key));
+  if (queue == NULL)
+    return NULL;
+
+  return g_queue_peek_head (queue);
+}
+
 /* Used to store the data of a NewRemoteConnection signal while we are waiting
  * for the TCP connection identified by this signal */
 typedef struct
 {
+  /* must be first */
+  Waiting waiting;
   TpHandle handle;
   GValue *param;
   guint connection_id;
@@ -87,13 +194,15 @@ typedef struct
 } SigWaitingConn;
 
 static SigWaitingConn *
-sig_waiting_conn_new (TpHandle handle,
+sig_waiting_conn_new (guint key,
+    TpHandle handle,
     const GValue *param,
     guint connection_id,
     gboolean rejected)
 {
   SigWaitingConn *ret = g_slice_new0 (SigWaitingConn);
 
+  ret->waiting.key = key;
   ret->handle = handle;
   ret->param = tp_g_value_slice_dup (param);
   ret->connection_id = connection_id;
@@ -112,20 +221,19 @@ sig_waiting_conn_free (SigWaitingConn *sig)
 
 typedef struct
 {
+  /* must be first */
+  Waiting waiting;
   GSocketConnection *conn;
-  /* Used only with TP_SOCKET_ACCESS_CONTROL_CREDENTIALS to store the byte
-   * read with the credentials. */
-  guchar byte;
 } ConnWaitingSig;
 
 static ConnWaitingSig *
-conn_waiting_sig_new (GSocketConnection *conn,
-    guchar byte)
+conn_waiting_sig_new (guint key,
+    GSocketConnection *conn)
 {
   ConnWaitingSig *ret = g_slice_new0 (ConnWaitingSig);
 
+  ret->waiting.key = key;
   ret->conn = g_object_ref (conn);
-  ret->byte = byte;
   return ret;
 }
 
@@ -147,11 +255,18 @@ struct _TpStreamTubeChannelPrivate
   GSocketAddress *address;
   gchar *unix_tmpdir;
   /* GSocketConnection we have accepted but are still waiting a
-   * NewRemoteConnection to identify them. Owned ConnWaitingSig. */
-  GSList *conn_waiting_sig;
+   * NewRemoteConnection to identify them. ConnWaitingSig. */
+  WaitingIndex conn_waiting_sig;
   /* NewRemoteConnection signals we have received but didn't accept their TCP
-   * connection yet. Owned SigWaitingConn. */
-  GSList *sig_waiting_conn;
+   * connection yet. SigWaitingConn. */
+  WaitingIndex sig_waiting_conn;
+  /* in milliseconds; 0 to wait forever */
+  guint match_timeout;
+  guint match_timeout_id;
+  guint n_timed_out_connections;
+  guint n_timed_out_signals;
+  /* 0 for GSocketListener's default */
+  gint accept_backlog;
 
   /* Accepting side */
   GSocket *client_socket;
@@ -174,6 +289,8 @@ struct _TpStreamTubeChannelPrivate
 
   /* (guint) connection ID => weakly reffed TpStreamTubeConnection */
   GHashTable *tube_connections;
+  /* the other way round */
+  GHashTable *tube_connection_ids;
 };
 
 enum
@@ -197,20 +314,30 @@ remote_connection_destroyed_cb (gpointer user_data,
 {
   /* The GSocketConnection has been destroyed, removing it from the hash */
   TpStreamTubeChannel *self = user_data;
-  GHashTableIter iter;
-  gpointer value;
+  gpointer id;
 
-  g_hash_table_iter_init (&iter, self->priv->tube_connections);
-  while (g_hash_table_iter_next (&iter, NULL, &value))
+  if (g_hash_table_lookup_extended (self->priv->tube_connection_ids, conn,
+        NULL, &id))
     {
-      if (value == conn)
-        {
-          g_hash_table_iter_remove (&iter);
-          break;
-        }
+      g_hash_table_remove (self->priv->tube_connections, id);
+      g_hash_table_remove (self->priv->tube_connection_ids, conn);
     }
 }
 
+static void
+add_tube_connection (TpStreamTubeChannel *self,
+    TpStreamTubeConnection *tube_conn,
+    guint connection_id)
+{
+  g_hash_table_insert (self->priv->tube_connections,
+      GUINT_TO_POINTER (connection_id), tube_conn);
+  g_hash_table_insert (self->priv->tube_connection_ids, tube_conn,
+      GUINT_TO_POINTER (connection_id));
+
+  g_object_weak_ref (G_OBJECT (tube_conn), remote_connection_destroyed_cb,
+      self);
+}
+
 static void
 tp_stream_tube_channel_dispose (GObject *obj)
 {
@@ -226,13 +353,14 @@ tp_stream_tube_channel_dispose (GObject *obj)
   tp_clear_object (&self->priv->result);
   tp_clear_pointer (&self->priv->parameters, g_hash_table_unref);
 
-  g_slist_foreach (self->priv->conn_waiting_sig, (GFunc) conn_waiting_sig_free,
-      NULL);
-  tp_clear_pointer (&self->priv->conn_waiting_sig, g_slist_free);
+  if (self->priv->match_timeout_id != 0)
+    {
+      g_source_remove (self->priv->match_timeout_id);
+      self->priv->match_timeout_id = 0;
+    }
 
-  g_slist_foreach (self->priv->sig_waiting_conn, (GFunc) sig_waiting_conn_free,
-      NULL);
-  tp_clear_pointer (&self->priv->sig_waiting_conn, g_slist_free);
+  waiting_index_clear (&self->priv->conn_waiting_sig);
+  waiting_index_clear (&self->priv->sig_waiting_conn);
 
   if (self->priv->tube_connections != NULL)
     {
@@ -249,6 +377,8 @@ tp_stream_tube_channel_dispose (GObject *obj)
       self->priv->tube_connections = NULL;
     }
 
+  tp_clear_pointer (&self->priv->tube_connection_ids, g_hash_table_unref);
+
   if (self->priv->address != NULL)
     {
 #ifdef HAVE_GIO_UNIX
@@ -281,6 +411,17 @@ tp_stream_tube_channel_dispose (GObject *obj)
   G_OBJECT_CLASS (tp_stream_tube_channel_parent_class)->dispose (obj);
 }
 
+static void
+tp_stream_tube_channel_finalize (GObject *obj)
+{
+  TpStreamTubeChannel *self = (TpStreamTubeChannel *) obj;
+
+  waiting_index_destroy (&self->priv->conn_waiting_sig);
+  waiting_index_destroy (&self->priv->sig_waiting_conn);
+
+  G_OBJECT_CLASS (tp_stream_tube_channel_parent_class)->finalize (obj);
+}
+
 static void
 tp_stream_tube_channel_get_property (GObject *object,
     guint property_id,
@@ -425,6 +566,7 @@ tp_stream_tube_channel_class_init (TpStreamTubeChannelClass *klass)
   gobject_class->constructed = tp_stream_tube_channel_constructed;
   gobject_class->get_property = tp_stream_tube_channel_get_property;
   gobject_class->dispose = tp_stream_tube_channel_dispose;
+  gobject_class->finalize = tp_stream_tube_channel_finalize;
 
   /**
    * TpStreamTubeChannel:service:
@@ -503,6 +645,12 @@ tp_stream_tube_channel_init (TpStreamTubeChannel *self)
       TpStreamTubeChannelPrivate);
 
   self->priv->tube_connections = g_hash_table_new (NULL, NULL);
+  self->priv->tube_connection_ids = g_hash_table_new (NULL, NULL);
+
+  waiting_index_init (&self->priv->conn_waiting_sig,
+      (GDestroyNotify) conn_waiting_sig_free);
+  waiting_index_init (&self->priv->sig_waiting_conn,
+      (GDestroyNotify) sig_waiting_conn_free);
 }
 
 
@@ -629,11 +777,7 @@ new_local_connection_identified (TpStreamTubeChannel *self,
 
   tube_conn = _tp_stream_tube_connection_new (conn, self);
 
-  g_hash_table_insert (self->priv->tube_connections,
-      GUINT_TO_POINTER (connection_id), tube_conn);
-
-  g_object_weak_ref (G_OBJECT (tube_conn), remote_connection_destroyed_cb,
-      self);
+  add_tube_connection (self, tube_conn, connection_id);
 
   /* We are accepting a tube so the contact of the connection is the
    * initiator of the tube */
@@ -1015,19 +1159,43 @@ _new_remote_connection_with_contact (TpConnection *conn,
   /* anyone receiving the signal is required to hold their own reference */
 }
 
-static gboolean
-sig_match_conn (TpStreamTubeChannel *self,
-    SigWaitingConn *sig,
-    ConnWaitingSig *c)
+static guint
+sig_get_key (TpStreamTubeChannel *self,
+    const GValue *param)
 {
   if (self->priv->access_control == TP_SOCKET_ACCESS_CONTROL_PORT)
     {
       /* Use the port to identify the connection */
       guint port;
+
+      dbus_g_type_struct_get (param, 1, &port, G_MAXINT);
+      return port;
+    }
+  else if (self->priv->access_control == TP_SOCKET_ACCESS_CONTROL_CREDENTIALS)
+    {
+      return g_value_get_uchar (param);
+    }
+
+  DEBUG ("Can't properly identify connection as we are using "
+      "access control %u. Assume it's the oldest one",
+      self->priv->access_control);
+
+  return 0;
+}
+
+static gboolean
+conn_get_key (TpStreamTubeChannel *self,
+    GSocketConnection *conn,
+    guchar byte,
+    guint *key)
+{
+  if (self->priv->access_control == TP_SOCKET_ACCESS_CONTROL_PORT)
+    {
+      /* Use the port to identify the connection */
       GSocketAddress *address;
       GError *error = NULL;
 
-      address = g_socket_connection_get_remote_address (c->conn, &error);
+      address = g_socket_connection_get_remote_address (conn, &error);
       if (address == NULL)
         {
           DEBUG ("Failed to get connection address: %s", error->message);
@@ -1036,38 +1204,19 @@ sig_match_conn (TpStreamTubeChannel *self,
           return FALSE;
         }
 
-      dbus_g_type_struct_get (sig->param, 1, &port, G_MAXINT);
-
-      if (port == g_inet_socket_address_get_port (
-            G_INET_SOCKET_ADDRESS (address)))
-        {
-          DEBUG ("Identified connection %u using port %u",
-              port, sig->connection_id);
-
-          g_object_unref (address);
-          return TRUE;
-        }
+      *key = g_inet_socket_address_get_port (G_INET_SOCKET_ADDRESS (address));
 
       g_object_unref (address);
+      return TRUE;
     }
   else if (self->priv->access_control == TP_SOCKET_ACCESS_CONTROL_CREDENTIALS)
     {
-      guchar byte;
-
-      byte = g_value_get_uchar (sig->param);
-
-      return byte == c->byte;
-    }
-  else
-    {
-      DEBUG ("Can't properly identify connection as we are using "
-          "access control %u. Assume it's the head of the list",
-          self->priv->access_control);
-
+      *key = byte;
       return TRUE;
     }
 
-  return FALSE;
+  *key = 0;
+  return TRUE;
 }
 
 static gboolean
@@ -1101,11 +1250,7 @@ connection_identified (TpStreamTubeChannel *self,
 
   tube_conn = _tp_stream_tube_connection_new (conn, self);
 
-  g_hash_table_insert (self->priv->tube_connections,
-      GUINT_TO_POINTER (connection_id), tube_conn);
-
-  g_object_weak_ref (G_OBJECT (tube_conn), remote_connection_destroyed_cb,
-      self);
+  add_tube_connection (self, tube_conn, connection_id);
 
   if (can_identify_contact (self))
     {
@@ -1164,6 +1309,84 @@ connection_rejected (TpStreamTubeChannel *self,
       stream_tube_connection_closed_cb, self);
 }
 
+static gboolean match_timeout_cb (gpointer user_data);
+
+static void
+schedule_match_timeout (TpStreamTubeChannel *self)
+{
+  Waiting *conn, *sig;
+  gint64 oldest, remaining;
+
+  /* nothing to do if we're not offering, or have been disposed */
+  if (self->priv->service == NULL ||
+      self->priv->match_timeout == 0 || self->priv->match_timeout_id != 0)
+    return;
+
+  conn = g_queue_peek_head (&self->priv->conn_waiting_sig.by_age);
+  sig = g_queue_peek_head (&self->priv->sig_waiting_conn.by_age);
+
+  if (conn == NULL && sig == NULL)
+    return;
+  else if (sig == NULL)
+    oldest = conn->since;
+  else if (conn == NULL)
+    oldest = sig->since;
+  else
+    oldest = MIN (conn->since, sig->since);
+
+  remaining = oldest + (gint64) self->priv->match_timeout * 1000 -
+    g_get_monotonic_time ();
+
+  /* round up, so we don't wake up just too early */
+  self->priv->match_timeout_id = g_timeout_add (
+      remaining > 0 ? (remaining + 999) / 1000 : 0,
+      match_timeout_cb, self);
+}
+
+static gboolean
+match_timeout_cb (gpointer user_data)
+{
+  TpStreamTubeChannel *self = user_data;
+  gint64 deadline;
+  ConnWaitingSig *c;
+  SigWaitingConn *sig;
+
+  self->priv->match_timeout_id = 0;
+
+  /* anything which started waiting before this has waited too long */
+  deadline = g_get_monotonic_time () -
+    (gint64) self->priv->match_timeout * 1000;
+
+  while ((c = g_queue_peek_head (&self->priv->conn_waiting_sig.by_age))
+      != NULL && c->waiting.since <= deadline)
+    {
+      DEBUG ("No NewRemoteConnection identified a connection in time; "
+          "closing it");
+
+      waiting_index_remove (&self->priv->conn_waiting_sig, &c->waiting);
+      self->priv->n_timed_out_connections++;
+
+      g_io_stream_close_async (G_IO_STREAM (c->conn), G_PRIORITY_DEFAULT,
+          NULL, stream_tube_connection_closed_cb, self);
+      conn_waiting_sig_free (c);
+    }
+
+  while ((sig = g_queue_peek_head (&self->priv->sig_waiting_conn.by_age))
+      != NULL && sig->waiting.since <= deadline)
+    {
+      DEBUG ("Connection %u never arrived; forgetting it",
+          sig->connection_id);
+
+      waiting_index_remove (&self->priv->sig_waiting_conn, &sig->waiting);
+      self->priv->n_timed_out_signals++;
+
+      sig_waiting_conn_free (sig);
+    }
+
+  schedule_match_timeout (self);
+  return FALSE;
+}
+
 static void
 _new_remote_connection (TpChannel *channel,
     guint handle,
@@ -1173,12 +1396,12 @@ _new_remote_connection (TpChannel *channel,
     GObject *obj)
 {
   TpStreamTubeChannel *self = (TpStreamTubeChannel *) obj;
-  GSList *l;
-  ConnWaitingSig *found_conn = NULL;
+  ConnWaitingSig *found_conn;
   SigWaitingConn *sig;
   TpHandle chan_handle;
   TpHandleType handle_type;
   gboolean rejected = FALSE;
+  guint key;
 
   chan_handle = tp_channel_get_handle (channel, &handle_type);
   if (handle_type == TP_HANDLE_TYPE_CONTACT &&
@@ -1191,39 +1414,33 @@ _new_remote_connection (TpChannel *channel,
       rejected = TRUE;
     }
 
-  sig = sig_waiting_conn_new (handle, param, connection_id, rejected);
-
-  for (l = self->priv->conn_waiting_sig; l != NULL && found_conn == NULL;
-      l = g_slist_next (l))
-    {
-      ConnWaitingSig *conn = l->data;
-
-      if (sig_match_conn (self, sig, conn))
-        found_conn = conn;
-
-    }
+  key = sig_get_key (self, param);
+  found_conn = waiting_index_lookup (&self->priv->conn_waiting_sig, key);
 
   if (found_conn == NULL)
     {
       DEBUG ("Didn't find any connection for %u. Waiting for more",
           connection_id);
 
-      /* Pass ownership of sig to the list */
-      self->priv->sig_waiting_conn = g_slist_append (
-          self->priv->sig_waiting_conn, sig);
+      sig = sig_waiting_conn_new (key, handle, param, connection_id,
+          rejected);
+
+      /* Pass ownership of sig to the index */
+      waiting_index_add (&self->priv->sig_waiting_conn, &sig->waiting);
+      schedule_match_timeout (self);
       return;
     }
 
+  DEBUG ("Identified connection %u using key %u", connection_id, key);
+
   /* We found a connection */
-  self->priv->conn_waiting_sig = g_slist_remove (
-      self->priv->conn_waiting_sig, found_conn);
+  waiting_index_remove (&self->priv->conn_waiting_sig, &found_conn->waiting);
 
   if (rejected)
     connection_rejected (self, found_conn->conn, handle, connection_id);
   else
     connection_identified (self, found_conn->conn, handle, connection_id);
 
-  sig_waiting_conn_free (sig);
   conn_waiting_sig_free (found_conn);
 }
 
@@ -1298,23 +1515,6 @@ finally:
     tp_g_value_slice_free (addressv);
 }
 
-static SigWaitingConn *
-find_sig_for_conn (TpStreamTubeChannel *self,
-    ConnWaitingSig *c)
-{
-  GSList *l;
-
-  for (l = self->priv->sig_waiting_conn; l != NULL; l = g_slist_next (l))
-    {
-      SigWaitingConn *sig = l->data;
-
-      if (sig_match_conn (self, sig, c))
-        return sig;
-    }
-
-  return NULL;
-}
-
 static void
 credentials_received (TpStreamTubeChannel *self,
     GSocketConnection *conn,
@@ -1322,24 +1522,33 @@ credentials_received (TpStreamTubeChannel *self,
 {
   SigWaitingConn *sig;
   ConnWaitingSig *c;
+  guint key;
 
-  c = conn_waiting_sig_new (conn, byte);
+  if (!conn_get_key (self, conn, byte, &key))
+    {
+      /* it could never be identified */
+      g_io_stream_close_async (G_IO_STREAM (conn), G_PRIORITY_DEFAULT, NULL,
+          stream_tube_connection_closed_cb, self);
+      return;
+    }
 
-  sig = find_sig_for_conn (self, c);
+  sig = waiting_index_lookup (&self->priv->sig_waiting_conn, key);
   if (sig == NULL)
     {
       DEBUG ("Can't identify the connection, wait for NewRemoteConnection sig");
 
-      /* Pass ownership to the list */
-      self->priv->conn_waiting_sig = g_slist_append (
-          self->priv->conn_waiting_sig, c);
+      c = conn_waiting_sig_new (key, conn);
 
+      /* Pass ownership to the index */
+      waiting_index_add (&self->priv->conn_waiting_sig, &c->waiting);
+      schedule_match_timeout (self);
       return;
     }
 
+  DEBUG ("Identified connection %u using key %u", sig->connection_id, key);
+
   /* Connection has been identified */
-  self->priv->sig_waiting_conn = g_slist_remove (self->priv->sig_waiting_conn,
-      sig);
+  waiting_index_remove (&self->priv->sig_waiting_conn, &sig->waiting);
 
   if (sig->rejected)
     connection_rejected (self, conn, sig->handle, sig->connection_id);
@@ -1347,7 +1556,6 @@ credentials_received (TpStreamTubeChannel *self,
     connection_identified (self, conn, sig->handle, sig->connection_id);
 
   sig_waiting_conn_free (sig);
-  conn_waiting_sig_free (c);
 }
 
 #ifdef HAVE_GIO_UNIX
@@ -1468,6 +1676,10 @@ tp_stream_tube_channel_offer_async (TpStreamTubeChannel *self,
 
   self->priv->service = g_socket_service_new ();
 
+  if (self->priv->accept_backlog > 0)
+    g_socket_listener_set_backlog (G_SOCKET_LISTENER (self->priv->service),
+        self->priv->accept_backlog);
+
   switch (self->priv->socket_type)
     {
 #ifdef HAVE_GIO_UNIX
@@ -1553,6 +1765,142 @@ tp_stream_tube_channel_offer_finish (TpStreamTubeChannel *self,
   _tp_implement_finish_void (self, tp_stream_tube_channel_offer_async)
 }
 
+/**
+ * tp_stream_tube_channel_set_accept_backlog:
+ * @self: an outgoing #TpStreamTubeChannel
+ * @backlog: the maximum number of pending connections, or 0 for the
+ *  default
+ *
+ * Set how many connections to the offered tube may be waiting to be
+ * accepted, as with g_socket_listener_set_backlog(). A tube whose
+ * clients connect in bursts may need more than the default.
+ *
+ * This must be called before tp_stream_tube_channel_offer_async().
+ *
+ * Since: 0.UNRELEASED
+ */
+void
+tp_stream_tube_channel_set_accept_backlog (TpStreamTubeChannel *self,
+    gint backlog)
+{
+  g_return_if_fail (TP_IS_STREAM_TUBE_CHANNEL (self));
+  g_return_if_fail (backlog >= 0);
+  g_return_if_fail (self->priv->service == NULL);
+
+  self->priv->accept_backlog = backlog;
+}
+
+/**
+ * tp_stream_tube_channel_get_accept_backlog:
+ * @self: a #TpStreamTubeChannel
+ *
+ * Return the value set by tp_stream_tube_channel_set_accept_backlog().
+ *
+ * Returns: the maximum number of pending connections, or 0 for the
+ *  default
+ *
+ * Since: 0.UNRELEASED
+ */
+gint
+tp_stream_tube_channel_get_accept_backlog (TpStreamTubeChannel *self)
+{
+  g_return_val_if_fail (TP_IS_STREAM_TUBE_CHANNEL (self), 0);
+
+  return self->priv->accept_backlog;
+}
+
+/**
+ * tp_stream_tube_channel_set_match_timeout:
+ * @self: an outgoing #TpStreamTubeChannel
+ * @timeout_ms: a time in milliseconds, or 0 to wait forever
+ *
+ * When a tube is offered, each connection to it is matched with the
+ * connection manager's announcement of which contact made it. Set how long
+ * either may wait for the other: connections which have not been
+ * identified in time are closed, and announcements which have not been
+ * matched in time are forgotten. This is counted by
+ * tp_stream_tube_channel_get_n_timed_out_connections() and
+ * tp_stream_tube_channel_get_n_timed_out_signals().
+ *
+ * By default, they wait until the channel is disposed.
+ *
+ * Since: 0.UNRELEASED
+ */
+void
+tp_stream_tube_channel_set_match_timeout (TpStreamTubeChannel *self,
+    guint timeout_ms)
+{
+  g_return_if_fail (TP_IS_STREAM_TUBE_CHANNEL (self));
+
+  self->priv->match_timeout = timeout_ms;
+
+  if (self->priv->match_timeout_id != 0)
+    {
+      g_source_remove (self->priv->match_timeout_id);
+      self->priv->match_timeout_id = 0;
+    }
+
+  schedule_match_timeout (self);
+}
+
+/**
+ * tp_stream_tube_channel_get_match_timeout:
+ * @self: a #TpStreamTubeChannel
+ *
+ * Return the value set by tp_stream_tube_channel_set_match_timeout().
+ *
+ * Returns: a time in milliseconds, or 0 if there is no timeout
+ *
+ * Since: 0.UNRELEASED
+ */
+guint
+tp_stream_tube_channel_get_match_timeout (TpStreamTubeChannel *self)
+{
+  g_return_val_if_fail (TP_IS_STREAM_TUBE_CHANNEL (self), 0);
+
+  return self->priv->match_timeout;
+}
+
+/**
+ * tp_stream_tube_channel_get_n_timed_out_connections:
+ * @self: an outgoing #TpStreamTubeChannel
+ *
+ * Return the number of connections to the offered tube which were closed
+ * because the connection manager did not identify them in time. See
+ * tp_stream_tube_channel_set_match_timeout().
+ *
+ * Returns: the number of connections which timed out
+ *
+ * Since: 0.UNRELEASED
+ */
+guint
+tp_stream_tube_channel_get_n_timed_out_connections (TpStreamTubeChannel *self)
+{
+  g_return_val_if_fail (TP_IS_STREAM_TUBE_CHANNEL (self), 0);
+
+  return self->priv->n_timed_out_connections;
+}
+
+/**
+ * tp_stream_tube_channel_get_n_timed_out_signals:
+ * @self: an outgoing #TpStreamTubeChannel
+ *
+ * Return the number of NewRemoteConnection signals which were forgotten
+ * because the connection they announced was not made in time. See
+ * tp_stream_tube_channel_set_match_timeout().
+ *
+ * Returns: the number of signals which timed out
+ *
+ * Since: 0.UNRELEASED
+ */
+guint
+tp_stream_tube_channel_get_n_timed_out_signals (TpStreamTubeChannel *self)
+{
+  g_return_val_if_fail (TP_IS_STREAM_TUBE_CHANNEL (self), 0);
+
+  return self->priv->n_timed_out_signals;
+}
+
 /**
  * tp_stream_tube_channel_get_service:
  * @self: a #TpStreamTubeChannel
@@ -95,6 +95,28 @@ gboolean tp_stream_tube_channel_offer_finish (TpStreamTubeChannel *self,
     GAsyncResult *result,
     GError **error);
 
+_TP_AVAILABLE_IN_UNRELEASED
+void tp_stream_tube_channel_set_accept_backlog (TpStreamTubeChannel *self,
+    gint backlog);
+
+_TP_AVAILABLE_IN_UNRELEASED
+gint tp_stream_tube_channel_get_accept_backlog (TpStreamTubeChannel *self);
+
+_TP_AVAILABLE_IN_UNRELEASED
+void tp_stream_tube_channel_set_match_timeout (TpStreamTubeChannel *self,
+    guint timeout_ms);
+
+_TP_AVAILABLE_IN_UNRELEASED
+guint tp_stream_tube_channel_get_match_timeout (TpStreamTubeChannel *self);
+
+_TP_AVAILABLE_IN_UNRELEASED
+guint tp_stream_tube_channel_get_n_timed_out_connections (
+    TpStreamTubeChannel *self);
+
+_TP_AVAILABLE_IN_UNRELEASED
+guint tp_stream_tube_channel_get_n_timed_out_signals (
+    TpStreamTubeChannel *self);
+
 G_END_DECLS
 
 #endif
@@ -112,6 +112,7 @@
 #include <telepathy-glib/text-channel.h>
 #include <telepathy-glib/text-mixin.h>
 #include <telepathy-glib/tls-certificate.h>
+#include <telepathy-glib/transferred-bytes-limiter.h>
 #include <telepathy-glib/variant-util.h>
 
 /* deprecated, gone in 1.0 */
@@ -82,10 +82,27 @@ struct _TpTextChannelPrivate
 
   /* queue of owned TpSignalledMessage */
   GQueue *pending_messages;
+  /* pending-message-id => borrowed GList link in pending_messages, of the
+   * oldest message with that id */
+  GHashTable *pending_messages_index;
+  /* number of messages in pending_messages whose id was already in use when
+   * they were received, and hence are not in pending_messages_index */
+  guint n_duplicate_pending_ids;
   gboolean got_initial_messages;
 
   gboolean is_sms_channel;
   gboolean sms_flash;
+
+  /* QueuedSend not yet passed to SendMessage, oldest first */
+  GQueue send_queue;
+  /* QueuedSend passed to SendMessage whose result has not been reported,
+   * oldest first; the results of batches and flushes are reported in this
+   * order */
+  GQueue sends_in_flight;
+  /* number of SendMessage calls awaiting a reply */
+  guint n_send_calls;
+  /* 0 if unlimited */
+  guint send_window;
 };
 
 enum
@@ -119,6 +136,7 @@ tp_text_channel_dispose (GObject *obj)
 
   g_queue_foreach (self->priv->pending_messages, (GFunc) g_object_unref, NULL);
   tp_clear_pointer (&self->priv->pending_messages, g_queue_free);
+  tp_clear_pointer (&self->priv->pending_messages_index, g_hash_table_unref);
 
   G_OBJECT_CLASS (tp_text_channel_parent_class)->dispose (obj);
 }
@@ -296,21 +314,10 @@ prepare_sender_finish (TpTextChannel *self,
   return sender;
 }
 
-static GPtrArray *
-copy_parts (const GPtrArray *parts)
-{
-  return g_boxed_copy (TP_ARRAY_TYPE_MESSAGE_PART_LIST, parts);
-}
-
-static void
-free_parts (GPtrArray *parts)
-{
-  g_boxed_free (TP_ARRAY_TYPE_MESSAGE_PART_LIST, parts);
-}
-
 typedef struct
 {
-  GPtrArray *parts;
+  /* not usable until the sender has been set */
+  TpMessage *msg;
   guint flags;
   gchar *token;
 } MessageSentData;
@@ -323,16 +330,14 @@ message_sent_sender_ready_cb (GObject *object,
   TpTextChannel *self = (TpTextChannel *) object;
   MessageSentData *data = user_data;
   TpContact *sender;
-  TpMessage *msg;
 
   sender = prepare_sender_finish (self, result, NULL);
-  msg = _tp_signalled_message_new (data->parts, sender);
+  _tp_signalled_message_set_sender (data->msg, sender);
 
-  g_signal_emit (self, signals[SIG_MESSAGE_SENT], 0, msg, data->flags,
+  g_signal_emit (self, signals[SIG_MESSAGE_SENT], 0, data->msg, data->flags,
       data->token);
 
-  g_object_unref (msg);
-  free_parts (data->parts);
+  g_object_unref (data->msg);
   g_free (data->token);
   g_slice_free (MessageSentData, data);
 }
@@ -351,7 +356,7 @@ message_sent_cb (TpChannel *channel,
   DEBUG ("New message sent");
 
   data = g_slice_new (MessageSentData);
-  data->parts = copy_parts (parts);
+  data->msg = _tp_signalled_message_new_without_sender (parts);
   data->flags = flags;
   data->token = tp_str_empty (token) ? NULL : g_strdup (token);
 
@@ -507,17 +512,36 @@ tp_text_channel_constructed (GObject *obj)
       TP_PROP_CHANNEL_INTERFACE_SMS_FLASH, NULL);
 }
 
+/* Takes ownership of @msg, which was created by
+ * _tp_signalled_message_new_without_sender() */
 static void
 add_message_received (TpTextChannel *self,
-    const GPtrArray *parts,
+    TpMessage *msg,
     TpContact *sender,
     gboolean fire_received)
 {
-  TpMessage *msg;
+  GList *link_;
+  guint id;
+  gboolean valid;
 
-  msg = _tp_signalled_message_new (parts, sender);
+  _tp_signalled_message_set_sender (msg, sender);
 
   g_queue_push_tail (self->priv->pending_messages, msg);
+  link_ = g_queue_peek_tail_link (self->priv->pending_messages);
+
+  id = _tp_signalled_message_get_pending_message_id (msg, &valid);
+
+  /* if a broken CM reuses an id, PendingMessagesRemoved refers to the
+   * oldest message; the others are indexed when it is removed */
+  if (valid)
+    {
+      if (g_hash_table_contains (self->priv->pending_messages_index,
+              GUINT_TO_POINTER (id)))
+        self->priv->n_duplicate_pending_ids++;
+      else
+        g_hash_table_insert (self->priv->pending_messages_index,
+            GUINT_TO_POINTER (id), link_);
+    }
 
   if (fire_received)
     g_signal_emit (self, signals[SIG_MESSAGE_RECEIVED], 0, msg);
@@ -529,13 +553,11 @@ message_received_sender_ready_cb (GObject *object,
     gpointer user_data)
 {
   TpTextChannel *self = (TpTextChannel *) object;
-  GPtrArray *parts = user_data;
+  TpMessage *msg = user_data;
   TpContact *sender;
 
   sender = prepare_sender_finish (self, result, NULL);
-  add_message_received (self, parts, sender, TRUE);
-
-  free_parts (parts);
+  add_message_received (self, msg, sender, TRUE);
 }
 
 static void
@@ -555,23 +577,29 @@ message_received_cb (TpChannel *proxy,
 
   prepare_sender_async (self, message, FALSE,
       message_received_sender_ready_cb,
-      copy_parts (message));
+      _tp_signalled_message_new_without_sender (message));
 }
 
-static gint
-find_msg_by_id (gconstpointer a,
-    gconstpointer b)
+/* Index the first message from @link_ onwards whose pending-message-id is
+ * @id, if any, now that the previous message with that id has gone */
+static void
+reindex_duplicate_pending_id (TpTextChannel *self,
+    GList *link_,
+    guint id)
 {
-  TpMessage *msg = TP_MESSAGE (a);
-  guint id = GPOINTER_TO_UINT (b);
-  gboolean valid;
-  guint msg_id;
-
-  msg_id = _tp_signalled_message_get_pending_message_id (msg, &valid);
-  if (!valid)
-    return 1;
+  for (; link_ != NULL; link_ = link_->next)
+    {
+      gboolean valid;
 
-  return msg_id != id;
+      if (_tp_signalled_message_get_pending_message_id (link_->data,
+              &valid) == id && valid)
+        {
+          g_hash_table_insert (self->priv->pending_messages_index,
+              GUINT_TO_POINTER (id), link_);
+          self->priv->n_duplicate_pending_ids--;
+          return;
+        }
+    }
 }
 
 static void
@@ -592,8 +620,8 @@ pending_messages_removed_ready_cb (GObject *object,
       GList *link_;
       TpMessage *msg;
 
-      link_ = g_queue_find_custom (self->priv->pending_messages,
-          GUINT_TO_POINTER (id), find_msg_by_id);
+      link_ = g_hash_table_lookup (self->priv->pending_messages_index,
+          GUINT_TO_POINTER (id));
 
       if (link_ == NULL)
         {
@@ -603,6 +631,12 @@ pending_messages_removed_ready_cb (GObject *object,
 
       msg = link_->data;
 
+      g_hash_table_remove (self->priv->pending_messages_index,
+          GUINT_TO_POINTER (id));
+
+      if (self->priv->n_duplicate_pending_ids > 0)
+        reindex_duplicate_pending_id (self, link_->next, id);
+
       g_queue_delete_link (self->priv->pending_messages, link_);
 
       g_signal_emit (self, signals[SIG_PENDING_MESSAGE_REMOVED], 0, msg);
@@ -640,11 +674,11 @@ pending_message_sender_ready_cb (GObject *object,
     gpointer user_data)
 {
   TpTextChannel *self = (TpTextChannel *) object;
-  GPtrArray *parts = user_data;
+  TpMessage *msg = user_data;
   TpContact *sender;
 
   sender = prepare_sender_finish (self, result, NULL);
-  add_message_received (self, parts, sender, FALSE);
+  add_message_received (self, msg, sender, FALSE);
 
   self->priv->n_preparing_pending_messages--;
   if (self->priv->n_preparing_pending_messages == 0)
@@ -652,8 +686,6 @@ pending_message_sender_ready_cb (GObject *object,
       g_simple_async_result_complete (self->priv->pending_messages_result);
       g_clear_object (&self->priv->pending_messages_result);
     }
-
-  free_parts (parts);
 }
 
 /* There is no TP_ARRAY_TYPE_PENDING_TEXT_MESSAGE_LIST_LIST (fdo #32433) */
@@ -715,7 +747,7 @@ get_pending_messages_cb (TpProxy *proxy,
 
       prepare_sender_async (self, parts, FALSE,
           pending_message_sender_ready_cb,
-          copy_parts (parts));
+          _tp_signalled_message_new_without_sender (parts));
     }
 }
 
@@ -1107,6 +1139,9 @@ tp_text_channel_init (TpTextChannel *self)
       TpTextChannelPrivate);
 
   self->priv->pending_messages = g_queue_new ();
+  self->priv->pending_messages_index = g_hash_table_new (NULL, NULL);
+  g_queue_init (&self->priv->send_queue);
+  g_queue_init (&self->priv->sends_in_flight);
 }
 
 
@@ -1294,6 +1329,119 @@ tp_text_channel_dup_pending_messages (TpTextChannel *self)
       (GCopyFunc) g_object_ref, NULL);
 }
 
+typedef struct
+{
+  /* the results of several messages being sent together */
+  GSimpleAsyncResult *result;
+  /* (element-type utf8) one per message */
+  GPtrArray *tokens;
+  guint n_unfinished;
+  GError *error;
+} SendBatch;
+
+typedef struct
+{
+  /* NULL if this is a flush marker */
+  TpMessage *message;
+  TpMessageSendingFlags flags;
+  /* exactly one of these is set; batch is set for a flush marker only when
+   * standing in for an empty batch */
+  GSimpleAsyncResult *result;
+  SendBatch *batch;
+  guint batch_index;
+
+  gboolean done;
+  gchar *token;
+  GError *error;
+} QueuedSend;
+
+static void send_queue_dispatch (TpTextChannel *self);
+
+static void
+send_batch_finished (SendBatch *batch,
+    QueuedSend *send)
+{
+  if (send->error != NULL && batch->error == NULL)
+    batch->error = g_error_copy (send->error);
+
+  /* an empty batch is represented by a flush marker */
+  if (send->message != NULL)
+    {
+      g_ptr_array_index (batch->tokens, send->batch_index) = send->token;
+      send->token = NULL;
+    }
+
+  if (--batch->n_unfinished > 0)
+    return;
+
+  if (batch->error != NULL)
+    g_simple_async_result_take_error (batch->result, batch->error);
+  else
+    g_simple_async_result_set_op_res_gpointer (batch->result,
+        g_ptr_array_ref (batch->tokens), (GDestroyNotify) g_ptr_array_unref);
+
+  g_simple_async_result_complete_in_idle (batch->result);
+  g_object_unref (batch->result);
+  g_ptr_array_unref (batch->tokens);
+  g_slice_free (SendBatch, batch);
+}
+
+static void
+send_report (QueuedSend *send)
+{
+  if (send->batch != NULL)
+    {
+      send_batch_finished (send->batch, send);
+    }
+  else
+    {
+      if (send->error != NULL)
+        g_simple_async_result_set_from_error (send->result, send->error);
+
+      /* a flush marker has no message, and no token */
+      g_simple_async_result_set_op_res_gpointer (send->result,
+          send->token, g_free);
+      send->token = NULL;
+
+      g_simple_async_result_complete_in_idle (send->result);
+      g_object_unref (send->result);
+    }
+
+  tp_clear_object (&send->message);
+  g_clear_error (&send->error);
+  g_slice_free (QueuedSend, send);
+}
+
+/* Report the results of the sends that have finished. Messages sent with
+ * tp_text_channel_send_message_async() are reported as soon as they have
+ * been accepted or rejected, as they always were; messages in a batch, and
+ * flush markers, wait until everything queued before them has been
+ * reported. */
+static void
+send_queue_report (TpTextChannel *self)
+{
+  GList *l = g_queue_peek_head_link (&self->priv->sends_in_flight);
+  gboolean blocked = FALSE;
+
+  while (l != NULL)
+    {
+      QueuedSend *send = l->data;
+      GList *next = l->next;
+
+      if (!send->done)
+        {
+          blocked = TRUE;
+        }
+      else if (!blocked || (send->batch == NULL && send->message != NULL))
+        {
+          g_queue_delete_link (&self->priv->sends_in_flight, l);
+          send_report (send);
+        }
+
+      l = next;
+    }
+}
+
 static void
 send_message_cb (TpChannel *proxy,
     const gchar *token,
@@ -1301,20 +1449,83 @@ send_message_cb (TpChannel *proxy,
     gpointer user_data,
     GObject *weak_object)
 {
-  GSimpleAsyncResult *result = user_data;
+  TpTextChannel *self = (TpTextChannel *) proxy;
+  QueuedSend *send = user_data;
 
   if (error != NULL)
     {
       DEBUG ("Failed to send message: %s", error->message);
 
-      g_simple_async_result_set_from_error (result, error);
+      send->error = g_error_copy (error);
+
+      /* don't submit the rest of the batch, even if its earlier messages
+       * have not been reported yet */
+      if (send->batch != NULL && send->batch->error == NULL)
+        send->batch->error = g_error_copy (error);
     }
 
-  g_simple_async_result_set_op_res_gpointer (result,
-      tp_str_empty (token) ? NULL : g_strdup (token), g_free);
+  send->token = tp_str_empty (token) ? NULL : g_strdup (token);
+  send->done = TRUE;
 
-  g_simple_async_result_complete_in_idle (result);
-  g_object_unref (result);
+  self->priv->n_send_calls--;
+
+  send_queue_report (self);
+  send_queue_dispatch (self);
+}
+
+/* D-Bus preserves the order of method calls, so everything in the window
+ * reaches the connection manager in the order it was queued */
+static void
+send_queue_dispatch (TpTextChannel *self)
+{
+  while (!g_queue_is_empty (&self->priv->send_queue) &&
+      (self->priv->send_window == 0 ||
+       self->priv->n_send_calls < self->priv->send_window))
+    {
+      QueuedSend *send = g_queue_pop_head (&self->priv->send_queue);
+
+      g_queue_push_tail (&self->priv->sends_in_flight, send);
+
+      if (send->message == NULL)
+        {
+          send->done = TRUE;
+        }
+      else if (send->batch != NULL && send->batch->error != NULL)
+        {
+          /* an earlier message in this batch failed: don't send the rest */
+          send->error = g_error_new_literal (TP_ERROR, TP_ERROR_CANCELLED,
+              "An earlier message in the batch could not be sent");
+          send->done = TRUE;
+        }
+      else
+        {
+          self->priv->n_send_calls++;
+          tp_cli_channel_interface_messages_call_send_message (
+              TP_CHANNEL (self), -1, send->message->parts, send->flags,
+              send_message_cb, send, NULL, NULL);
+        }
+    }
+
+  send_queue_report (self);
+}
+
+static void
+send_queue_push (TpTextChannel *self,
+    TpMessage *message,
+    TpMessageSendingFlags flags,
+    GSimpleAsyncResult *result,
+    SendBatch *batch,
+    guint batch_index)
+{
+  QueuedSend *send = g_slice_new0 (QueuedSend);
+
+  send->message = message != NULL ? g_object_ref (message) : NULL;
+  send->flags = flags;
+  send->result = result;
+  send->batch = batch;
+  send->batch_index = batch_index;
+
+  g_queue_push_tail (&self->priv->send_queue, send);
 }
 
 /**
@@ -1330,6 +1541,14 @@ send_message_cb (TpChannel *proxy,
  * submitted to the sever, @callback will be called. You can then call
  * tp_text_channel_send_message_finish() to get the result of the operation.
  *
+ * Messages are submitted in the order in which they are passed to this
+ * function or to tp_text_channel_send_messages_async(), subject to the
+ * limit set by tp_text_channel_set_send_window(). @callback is called as
+ * soon as the server has accepted or rejected @message, which might be
+ * before the callbacks for messages submitted earlier; use
+ * tp_text_channel_send_messages_async() if the results must be reported
+ * in order. @message must not be modified afterwards.
+ *
  * Since: 0.13.10
  */
 void
@@ -1347,8 +1566,8 @@ tp_text_channel_send_message_async (TpTextChannel *self,
   result = g_simple_async_result_new (G_OBJECT (self), callback,
       user_data, tp_text_channel_send_message_async);
 
-  tp_cli_channel_interface_messages_call_send_message (TP_CHANNEL (self),
-    -1, message->parts, flags, send_message_cb, result, NULL, NULL);
+  send_queue_push (self, message, flags, result, NULL, 0);
+  send_queue_dispatch (self);
 }
 
 /**
@@ -1381,6 +1600,194 @@ tp_text_channel_send_message_finish (TpTextChannel *self,
       g_strdup, token);
 }
 
+/**
+ * tp_text_channel_send_messages_async:
+ * @self: a #TpTextChannel
+ * @n_messages: the number of messages in @messages
+ * @messages: (array length=n_messages): #TpClientMessage<!-- -->s, which
+ *  must not be modified afterwards
+ * @flags: flags affecting how the messages are sent
+ * @callback: a callback to call when all the messages have been submitted
+ *  to the server
+ * @user_data: data to pass to @callback
+ *
+ * Submit several messages to the server for sending, in order, without
+ * waiting for each one to be accepted before submitting the next, as if
+ * tp_text_channel_send_message_async() had been called for each of them.
+ * This is suitable for bridges and bots which send a lot of messages.
+ *
+ * @callback is called once every message has been accepted or rejected,
+ * and after the callbacks for any batches or flushes queued earlier.
+ *
+ * Sending stops at the first failure that is reported, but messages are
+ * submitted without waiting for earlier ones to be accepted, so those that
+ * were already submitted by then are not recalled: with no send window,
+ * all of them might have been. Use tp_text_channel_set_send_window() with
+ * a window of 1 to submit each message only after the previous one has
+ * been accepted. You can then call tp_text_channel_send_messages_finish()
+ * to get the result of the operation.
+ *
+ * Since: 0.UNRELEASED
+ */
+void
+tp_text_channel_send_messages_async (TpTextChannel *self,
+    guint n_messages,
+    TpMessage * const *messages,
+    TpMessageSendingFlags flags,
+    GAsyncReadyCallback callback,
+    gpointer user_data)
+{
+  SendBatch *batch;
+  guint i;
+
+  g_return_if_fail (TP_IS_TEXT_CHANNEL (self));
+  g_return_if_fail (n_messages == 0 || messages != NULL);
+
+  for (i = 0; i < n_messages; i++)
+    g_return_if_fail (TP_IS_CLIENT_MESSAGE (messages[i]));
+
+  batch = g_slice_new0 (SendBatch);
+  batch->result = g_simple_async_result_new (G_OBJECT (self), callback,
+      user_data, tp_text_channel_send_messages_async);
+  batch->tokens = g_ptr_array_new_full (n_messages, g_free);
+  g_ptr_array_set_size (batch->tokens, n_messages);
+  batch->n_unfinished = MAX (n_messages, 1);
+
+  /* even with nothing to send, report the result in order with the
+   * messages queued before */
+  if (n_messages == 0)
+    send_queue_push (self, NULL, 0, NULL, batch, 0);
+
+  for (i = 0; i < n_messages; i++)
+    send_queue_push (self, messages[i], flags, NULL, batch, i);
+
+  send_queue_dispatch (self);
+}
+
+/**
+ * tp_text_channel_send_messages_finish:
+ * @self: a #TpTextChannel
+ * @result: a #GAsyncResult passed to the callback for
+ *  tp_text_channel_send_messages_async()
+ * @tokens: (out) (transfer full) (element-type utf8) (allow-none): if
+ *  not %NULL, used to return the token of each message, in the order they
+ *  were given; as for tp_text_channel_send_message_finish(), the token of
+ *  a message is %NULL if the protocol cannot identify it later. The array
+ *  owns its tokens; free it with g_ptr_array_unref().
+ * @error: a #GError to fill
+ *
+ * Completes a call to tp_text_channel_send_messages_async().
+ *
+ * Returns: %TRUE if all the messages have been submitted to the server,
+ *  %FALSE otherwise
+ *
+ * Since: 0.UNRELEASED
+ */
+gboolean
+tp_text_channel_send_messages_finish (TpTextChannel *self,
+    GAsyncResult *result,
+    GPtrArray **tokens,
+    GError **error)
+{
+  _tp_implement_finish_copy_pointer (self,
+      tp_text_channel_send_messages_async, g_ptr_array_ref, tokens);
+}
+
+/**
+ * tp_text_channel_flush_send_queue_async:
+ * @self: a #TpTextChannel
+ * @callback: a callback to call when every message previously passed to
+ *  tp_text_channel_send_message_async() or
+ *  tp_text_channel_send_messages_async() has been dealt with
+ * @user_data: data to pass to @callback
+ *
+ * Wait for all messages queued for sending so far to have been either
+ * submitted to the server or rejected, for instance before closing the
+ * channel. You can then call tp_text_channel_flush_send_queue_finish() to
+ * get the result of the operation.
+ *
+ * Since: 0.UNRELEASED
+ */
+void
+tp_text_channel_flush_send_queue_async (TpTextChannel *self,
+    GAsyncReadyCallback callback,
+    gpointer user_data)
+{
+  GSimpleAsyncResult *result;
+
+  g_return_if_fail (TP_IS_TEXT_CHANNEL (self));
+
+  result = g_simple_async_result_new (G_OBJECT (self), callback,
+      user_data, tp_text_channel_flush_send_queue_async);
+
+  send_queue_push (self, NULL, 0, result, NULL, 0);
+  send_queue_dispatch (self);
+}
+
+/**
+ * tp_text_channel_flush_send_queue_finish:
+ * @self: a #TpTextChannel
+ * @result: a #GAsyncResult passed to the callback for
+ *  tp_text_channel_flush_send_queue_async()
+ * @error: a #GError to fill
+ *
+ * Completes a call to tp_text_channel_flush_send_queue_async(). The
+ * success or failure of the individual messages is reported to their own
+ * callbacks.
+ *
+ * Returns: %TRUE
+ *
+ * Since: 0.UNRELEASED
+ */
+gboolean
+tp_text_channel_flush_send_queue_finish (TpTextChannel *self,
+    GAsyncResult *result,
+    GError **error)
+{
+  _tp_implement_finish_void (self, tp_text_channel_flush_send_queue_async);
+}
+
+/**
+ * tp_text_channel_set_send_window:
+ * @self: a #TpTextChannel
+ * @window: the maximum number of messages submitted to the server at the
+ *  same time, or 0 for no limit (the default)
+ *
+ * Limit how many messages passed to tp_text_channel_send_message_async() or
+ * tp_text_channel_send_messages_async() may be awaiting the server's
+ * acknowledgement at once. Further messages are queued, in order, until
+ * earlier ones have been accepted or rejected.
+ *
+ * Since: 0.UNRELEASED
+ */
+void
+tp_text_channel_set_send_window (TpTextChannel *self,
+    guint window)
+{
+  g_return_if_fail (TP_IS_TEXT_CHANNEL (self));
+
+  self->priv->send_window = window;
+  send_queue_dispatch (self);
+}
+
+/**
+ * tp_text_channel_get_send_window:
+ * @self: a #TpTextChannel
+ *
+ * <!-- -->
+ *
+ * Returns: the limit set by tp_text_channel_set_send_window()
+ *
+ * Since: 0.UNRELEASED
+ */
+guint
+tp_text_channel_get_send_window (TpTextChannel *self)
+{
+  g_return_val_if_fail (TP_IS_TEXT_CHANNEL (self), 0);
+
+  return self->priv->send_window;
+}
+
 static void
 acknowledge_pending_messages_ready_cb (GObject *object,
     GAsyncResult *res,
@@ -104,6 +104,37 @@ gboolean tp_text_channel_send_message_finish (TpTextChannel *self,
     gchar **token,
     GError **error);
 
+_TP_AVAILABLE_IN_UNRELEASED
+void tp_text_channel_send_messages_async (TpTextChannel *self,
+    guint n_messages,
+    TpMessage * const *messages,
+    TpMessageSendingFlags flags,
+    GAsyncReadyCallback callback,
+    gpointer user_data);
+
+_TP_AVAILABLE_IN_UNRELEASED
+gboolean tp_text_channel_send_messages_finish (TpTextChannel *self,
+    GAsyncResult *result,
+    GPtrArray **tokens,
+    GError **error);
+
+_TP_AVAILABLE_IN_UNRELEASED
+void tp_text_channel_flush_send_queue_async (TpTextChannel *self,
+    GAsyncReadyCallback callback,
+    gpointer user_data);
+
+_TP_AVAILABLE_IN_UNRELEASED
+gboolean tp_text_channel_flush_send_queue_finish (TpTextChannel *self,
+    GAsyncResult *result,
+    GError **error);
+
+_TP_AVAILABLE_IN_UNRELEASED
+void tp_text_channel_set_send_window (TpTextChannel *self,
+    guint window);
+
+_TP_AVAILABLE_IN_UNRELEASED
+guint tp_text_channel_get_send_window (TpTextChannel *self);
+
 void tp_text_channel_ack_messages_async (TpTextChannel *self,
     const GList *messages,
     GAsyncReadyCallback callback,
@@ -0,0 +1,224 @@
+/*
+ * transferred-bytes-limiter.c - rate-limit TransferredBytesChanged
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/**
+ * SECTION:transferred-bytes-limiter
+ * @title: TpTransferredBytesLimiter
+ * @short_description: rate-limit the TransferredBytesChanged signal
+ *
+ * Connection managers implementing the FileTransfer channel type are
+ * expected to emit TransferredBytesChanged as data is transferred. A local
+ * transfer can easily make progress thousands of times a second, and
+ * emitting the signal each time floods the bus with messages which no user
+ * interface needs.
+ *
+ * A #TpTransferredBytesLimiter emits the signal at most once per interval:
+ * the connection manager passes it every new byte count with
+ * tp_transferred_bytes_limiter_update(), and the latest count is emitted
+ * when the interval has elapsed. Before moving the channel to the Completed
+ * or Cancelled state, call tp_transferred_bytes_limiter_flush() so that the
+ * final count is emitted before the state change.
+ *
+ * Since: 0.UNRELEASED
+ */
+
+#include "config.h"
+
+#include <telepathy-glib/transferred-bytes-limiter.h>
+
+#include <telepathy-glib/svc-channel.h>
+
+/**
+ * TpTransferredBytesLimiter:
+ *
+ * Structure representing the rate limiter. All fields are private.
+ *
+ * Since: 0.UNRELEASED
+ */
+struct _TpTransferredBytesLimiter
+{
+  /* not reffed: the channel owns us */
+  GObject *channel;
+  /* in milliseconds */
+  guint interval;
+
+  guint64 count;
+  guint64 emitted_count;
+  /* whether count has not been emitted yet */
+  gboolean pending;
+  /* monotonic time of the last emission, or 0 */
+  gint64 emitted_at;
+  guint timeout_id;
+};
+
+/**
+ * tp_transferred_bytes_limiter_new:
+ * @channel: an object implementing #TpSvcChannelTypeFileTransfer
+ * @interval_ms: the minimum time between two emissions of
+ *  TransferredBytesChanged, in milliseconds, or 0 to emit every update
+ *  straight away
+ *
+ * Create a new rate limiter for @channel. The limiter does not take a
+ * reference to @channel; it should be destroyed with
+ * tp_transferred_bytes_limiter_destroy(), at the latest in @channel's
+ * #GObjectClass.dispose implementation.
+ *
+ * Returns: a new rate limiter
+ * Since: 0.UNRELEASED
+ */
+TpTransferredBytesLimiter *
+tp_transferred_bytes_limiter_new (GObject *channel,
+    guint interval_ms)
+{
+  TpTransferredBytesLimiter *self;
+
+  g_return_val_if_fail (TP_IS_SVC_CHANNEL_TYPE_FILE_TRANSFER (channel),
+      NULL);
+
+  self = g_slice_new0 (TpTransferredBytesLimiter);
+  self->channel = channel;
+  self->interval = interval_ms;
+
+  return self;
+}
+
+/**
+ * tp_transferred_bytes_limiter_destroy:
+ * @self: a rate limiter
+ *
+ * Free @self. If the latest count passed to
+ * tp_transferred_bytes_limiter_update() has not been emitted yet, it is
+ * discarded; call tp_transferred_bytes_limiter_flush() first if it matters.
+ *
+ * Since: 0.UNRELEASED
+ */
+void
+tp_transferred_bytes_limiter_destroy (TpTransferredBytesLimiter *self)
+{
+  g_return_if_fail (self != NULL);
+
+  if (self->timeout_id != 0)
+    g_source_remove (self->timeout_id);
+
+  g_slice_free (TpTransferredBytesLimiter, self);
+}
+
+static void
+transferred_bytes_limiter_emit (TpTransferredBytesLimiter *self)
+{
+  if (self->timeout_id != 0)
+    {
+      g_source_remove (self->timeout_id);
+      self->timeout_id = 0;
+    }
+
+  self->pending = FALSE;
+  self->emitted_count = self->count;
+  self->emitted_at = g_get_monotonic_time ();
+
+  tp_svc_channel_type_file_transfer_emit_transferred_bytes_changed (
+      self->channel, self->count);
+}
+
+static gboolean
+transferred_bytes_limiter_timeout_cb (gpointer data)
+{
+  TpTransferredBytesLimiter *self = data;
+
+  self->timeout_id = 0;
+  transferred_bytes_limiter_emit (self);
+  return FALSE;
+}
+
+/**
+ * tp_transferred_bytes_limiter_update:
+ * @self: a rate limiter
+ * @count: the number of bytes transferred so far
+ *
+ * Record that @count bytes have been transferred. If no
+ * TransferredBytesChanged signal has been emitted in the last interval,
+ * it is emitted now; otherwise it will be emitted, with the latest count,
+ * as soon as the interval has elapsed.
+ *
+ * Since: 0.UNRELEASED
+ */
+void
+tp_transferred_bytes_limiter_update (TpTransferredBytesLimiter *self,
+    guint64 count)
+{
+  gint64 elapsed;
+
+  g_return_if_fail (self != NULL);
+
+  self->count = count;
+
+  if (count == self->emitted_count && self->emitted_at != 0)
+    {
+      /* back to what the client already knows */
+      self->pending = FALSE;
+
+      if (self->timeout_id != 0)
+        {
+          g_source_remove (self->timeout_id);
+          self->timeout_id = 0;
+        }
+
+      return;
+    }
+
+  self->pending = TRUE;
+
+  elapsed = g_get_monotonic_time () - self->emitted_at;
+
+  if (self->interval == 0 || self->emitted_at == 0 ||
+      elapsed >= (gint64) self->interval * 1000)
+    {
+      transferred_bytes_limiter_emit (self);
+    }
+  else if (self->timeout_id == 0)
+    {
+      /* round up, so we don't wake up just too early */
+      guint remaining = ((gint64) self->interval * 1000 - elapsed + 999) /
+          1000;
+
+      self->timeout_id = g_timeout_add (remaining,
+          transferred_bytes_limiter_timeout_cb, self);
+    }
+}
+
+/**
+ * tp_transferred_bytes_limiter_flush:
+ * @self: a rate limiter
+ *
+ * If the latest count passed to tp_transferred_bytes_limiter_update() has
+ * not been emitted yet, emit it now, regardless of the interval. This
+ * should be called before the channel's state changes to Completed or
+ * Cancelled.
+ *
+ * Since: 0.UNRELEASED
+ */
+void
+tp_transferred_bytes_limiter_flush (TpTransferredBytesLimiter *self)
+{
+  g_return_if_fail (self != NULL);
+
+  if (self->pending)
+    transferred_bytes_limiter_emit (self);
+}
@@ -0,0 +1,51 @@
+/*
+ * transferred-bytes-limiter.h - rate-limit TransferredBytesChanged
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#if defined (TP_DISABLE_SINGLE_INCLUDE) && !defined (_TP_IN_META_HEADER) && !defined (_TP_COMPILATION)
+#error "Only <telepathy-glib/telepathy-glib.h> and <telepathy-glib/telepathy-glib-dbus.h> can be included directly."
+#endif
+
+#ifndef __TP_TRANSFERRED_BYTES_LIMITER_H__
+#define __TP_TRANSFERRED_BYTES_LIMITER_H__
+
+#include <glib-object.h>
+
+#include <telepathy-glib/defs.h>
+
+G_BEGIN_DECLS
+
+typedef struct _TpTransferredBytesLimiter TpTransferredBytesLimiter;
+
+_TP_AVAILABLE_IN_UNRELEASED
+TpTransferredBytesLimiter *tp_transferred_bytes_limiter_new (
+    GObject *channel,
+    guint interval_ms) G_GNUC_WARN_UNUSED_RESULT;
+_TP_AVAILABLE_IN_UNRELEASED
+void tp_transferred_bytes_limiter_destroy (TpTransferredBytesLimiter *self);
+
+_TP_AVAILABLE_IN_UNRELEASED
+void tp_transferred_bytes_limiter_update (TpTransferredBytesLimiter *self,
+    guint64 count);
+_TP_AVAILABLE_IN_UNRELEASED
+void tp_transferred_bytes_limiter_flush (TpTransferredBytesLimiter *self);
+
+G_END_DECLS
+
+#endif
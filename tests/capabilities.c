@@ -1187,6 +1187,54 @@ test_classes_variant (Test *test,
   g_object_unref (caps);
 }
 
+static void
+test_dedup (Test *test,
+    gconstpointer data G_GNUC_UNUSED)
+{
+  TpCapabilities *caps, *same, *other;
+  GPtrArray *classes, *classes2;
+
+  classes = g_ptr_array_sized_new (2);
+  add_text_chat_class (classes, TP_HANDLE_TYPE_CONTACT);
+  add_ft_class (classes, NULL);
+
+  classes2 = g_ptr_array_sized_new (2);
+  add_text_chat_class (classes2, TP_HANDLE_TYPE_CONTACT);
+  add_ft_class (classes2, NULL);
+
+  /* equal channel classes share one object */
+  caps = _tp_capabilities_new (classes, TRUE);
+  same = _tp_capabilities_new (classes2, TRUE);
+  g_assert (caps == same);
+  g_assert (tp_capabilities_supports_text_chats (caps));
+  g_assert (tp_capabilities_supports_file_transfer (caps));
+  g_assert (!tp_capabilities_supports_text_chatrooms (caps));
+
+  /* ... but not if contact-specific differs */
+  other = _tp_capabilities_new (classes, FALSE);
+  g_assert (other != caps);
+  g_assert (!tp_capabilities_is_specific_to_contact (other));
+  g_object_unref (other);
+
+  /* the object stays shared while anyone holds a ref */
+  g_object_unref (same);
+  same = _tp_capabilities_new (classes2, TRUE);
+  g_assert (caps == same);
+  g_object_unref (same);
+  g_object_unref (caps);
+
+  /* empty classes are shared too */
+  caps = _tp_capabilities_new (NULL, TRUE);
+  same = _tp_capabilities_new (NULL, TRUE);
+  g_assert (caps == same);
+  g_assert (!tp_capabilities_supports_text_chats (caps));
+  g_object_unref (same);
+  g_object_unref (caps);
+
+  g_boxed_free (TP_ARRAY_TYPE_REQUESTABLE_CHANNEL_CLASS_LIST, classes);
+  g_boxed_free (TP_ARRAY_TYPE_REQUESTABLE_CHANNEL_CLASS_LIST, classes2);
+}
+
 int
 main (int argc,
     char **argv)
@@ -1212,6 +1260,8 @@ main (int argc,
       test_supports_call, NULL);
   g_test_add (TEST_PREFIX "classes-variant", Test, NULL, setup,
       test_classes_variant, NULL);
+  g_test_add (TEST_PREFIX "dedup", Test, NULL, setup,
+      test_dedup, NULL);
 
   return g_test_run ();
 }
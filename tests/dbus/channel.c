@@ -590,6 +590,23 @@ group_contacts_changed_cb (TpChannel *self,
     g_main_loop_quit (test->mainloop);
 }
 
+static void
+lazy_group_contacts_changed_cb (TpChannel *self,
+    GPtrArray *added,
+    GPtrArray *removed,
+    GPtrArray *local_pending,
+    GPtrArray *remote_pending,
+    TpContact *actor,
+    GHashTable *details,
+    Test *test)
+{
+  /* nobody has asked for the new member's TpContact yet */
+  g_assert_cmpuint (added->len, ==, 0);
+
+  group_contacts_changed_cb (self, added, removed, local_pending,
+      remote_pending, actor, details, test);
+}
+
 static void
 test_contacts (Test *test,
     gconstpointer data G_GNUC_UNUSED)
@@ -663,6 +680,343 @@ test_contacts (Test *test,
   g_assert_cmpstr (tp_contact_get_alias (contact), ==, alias2);
 }
 
+static void
+test_contacts_lazy (Test *test,
+    gconstpointer data G_GNUC_UNUSED)
+{
+  TpSimpleClientFactory *factory;
+  const gchar *id = "badger";
+  const gchar *alias = "Alias";
+  GQuark channel_features[] = { TP_CHANNEL_FEATURE_CONTACTS, 0 };
+  TpHandle handle;
+  GArray *handles;
+  TpContact *contact;
+  GPtrArray *contacts;
+  GAsyncResult *result = NULL;
+  guint i;
+
+  /* Members of the room only get a TpContact when asked for */
+  factory = tp_proxy_get_factory (test->connection);
+  tp_simple_client_factory_add_contact_features_varargs (factory,
+      TP_CONTACT_FEATURE_ALIAS,
+      TP_CONTACT_FEATURE_INVALID);
+  tp_simple_client_factory_set_lazy_group_members (factory, TRUE);
+
+  tp_tests_proxy_run_until_prepared (test->channel_room, channel_features);
+
+  contact = tp_channel_group_get_self_contact (test->channel_room);
+  g_assert_cmpstr (tp_contact_get_identifier (contact), ==, "me@test.com");
+
+  handle = tp_handle_ensure (test->contact_repo, id, NULL, NULL);
+  tp_tests_contacts_connection_change_aliases (
+      TP_TESTS_CONTACTS_CONNECTION (test->base_connection),
+      1, &handle, &alias);
+
+  g_signal_connect (test->channel_room, "group-contacts-changed",
+      G_CALLBACK (lazy_group_contacts_changed_cb), test);
+
+  handles = g_array_new (FALSE, FALSE, sizeof (TpHandle));
+  g_array_append_val (handles, handle);
+  tp_cli_channel_interface_group_call_add_members (test->channel_room, -1,
+      handles, "hello", NULL, NULL, NULL, NULL);
+  g_array_unref (handles);
+
+  g_main_loop_run (test->mainloop);
+
+  /* Not a member: no contact */
+  g_assert (tp_channel_group_dup_member_contact_by_handle (test->channel_room,
+        handle + 1000) == NULL);
+
+  /* The contact is created on demand, and prepared in the background */
+  contact = tp_channel_group_dup_member_contact_by_handle (test->channel_room,
+      handle);
+  g_assert (contact != NULL);
+  g_assert_cmpstr (tp_contact_get_identifier (contact), ==, id);
+  g_assert (!tp_contact_has_feature (contact, TP_CONTACT_FEATURE_ALIAS));
+
+  while (!tp_contact_has_feature (contact, TP_CONTACT_FEATURE_ALIAS))
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert_cmpstr (tp_contact_get_alias (contact), ==, alias);
+
+  /* All members are still returned */
+  contacts = tp_channel_group_dup_members_contacts (test->channel_room);
+  g_assert (contacts != NULL);
+  g_assert_cmpuint (contacts->len, ==, 2);
+  g_ptr_array_unref (contacts);
+
+  g_object_unref (contact);
+
+  /* A member we haven't asked about yet is not prepared either, until we
+   * wait for it */
+  handle = tp_handle_ensure (test->contact_repo, "mushroom", NULL, NULL);
+  handles = g_array_new (FALSE, FALSE, sizeof (TpHandle));
+  g_array_append_val (handles, handle);
+  tp_cli_channel_interface_group_call_add_members (test->channel_room, -1,
+      handles, "hello", NULL, NULL, NULL, NULL);
+  g_array_unref (handles);
+
+  test->wait = 1;
+  g_main_loop_run (test->mainloop);
+
+  contacts = tp_channel_group_dup_members_contacts (test->channel_room);
+  g_assert (contacts != NULL);
+  g_assert_cmpuint (contacts->len, ==, 3);
+
+  contact = tp_channel_group_dup_member_contact_by_handle (test->channel_room,
+      handle);
+  g_assert (contact != NULL);
+  g_assert (!tp_contact_has_feature (contact, TP_CONTACT_FEATURE_ALIAS));
+  g_object_unref (contact);
+
+  tp_simple_client_factory_upgrade_contacts_async (factory, test->connection,
+      contacts->len, (TpContact * const *) contacts->pdata,
+      tp_tests_result_ready_cb, &result);
+  tp_tests_run_until_result (&result);
+  tp_simple_client_factory_upgrade_contacts_finish (factory, result, NULL,
+      &test->error);
+  g_assert_no_error (test->error);
+
+  for (i = 0; i < contacts->len; i++)
+    g_assert (tp_contact_has_feature (g_ptr_array_index (contacts, i),
+          TP_CONTACT_FEATURE_ALIAS));
+
+  g_ptr_array_unref (contacts);
+  g_object_unref (result);
+}
+
+#define N_MEMBERS 10
+#define BATCH_SIZE 3
+
+typedef struct {
+    /* members reported by group-members-changed, in the order they were
+     * reported, and whether the channel was prepared at the time */
+    GArray *added;
+    GArray *prepared;
+    GArray *removed;
+    guint n_batches;
+} BatchLog;
+
+static void
+batch_members_changed_cb (TpChannel *channel,
+    const gchar *message,
+    GArray *added,
+    GArray *removed,
+    GArray *local_pending,
+    GArray *remote_pending,
+    guint actor,
+    guint reason,
+    BatchLog *log)
+{
+  gboolean prepared = tp_proxy_is_prepared (channel, TP_CHANNEL_FEATURE_GROUP);
+  guint i;
+
+  g_array_append_vals (log->removed, removed->data, removed->len);
+
+  if (added->len == 0)
+    return;
+
+  log->n_batches++;
+
+  for (i = 0; i < added->len; i++)
+    {
+      g_array_append_val (log->added, g_array_index (added, TpHandle, i));
+      g_array_append_val (log->prepared, prepared);
+    }
+}
+
+static void
+test_members_batched (Test *test,
+    gconstpointer data G_GNUC_UNUSED)
+{
+  GQuark features[] = { TP_CHANNEL_FEATURE_GROUP, 0 };
+  TpHandle self_handle = tp_base_connection_get_self_handle (
+      test->base_connection);
+  TpHandle herd[N_MEMBERS];
+  TpIntset *add;
+  BatchLog log = { NULL, NULL, NULL, 0 };
+  TpHandle last = 0;
+  guint n_initial = 0;
+  guint i;
+
+  tp_simple_client_factory_set_group_members_batch_size (
+      tp_proxy_get_factory (test->connection), BATCH_SIZE);
+
+  add = tp_intset_new ();
+
+  for (i = 0; i < N_MEMBERS; i++)
+    {
+      gchar *id = g_strdup_printf ("member%02u", i);
+
+      herd[i] = tp_handle_ensure (test->contact_repo, id, NULL, NULL);
+      tp_intset_add (add, herd[i]);
+      g_free (id);
+    }
+
+  tp_group_mixin_change_members ((GObject *) test->chan_room_service, "",
+      add, NULL, NULL, NULL, 0, TP_CHANNEL_GROUP_CHANGE_REASON_NONE);
+  tp_intset_destroy (add);
+
+  log.added = g_array_new (FALSE, FALSE, sizeof (TpHandle));
+  log.prepared = g_array_new (FALSE, FALSE, sizeof (gboolean));
+  log.removed = g_array_new (FALSE, FALSE, sizeof (TpHandle));
+  g_signal_connect (test->channel_room, "group-members-changed",
+      G_CALLBACK (batch_members_changed_cb), &log);
+
+  tp_tests_proxy_run_until_prepared (test->channel_room, features);
+
+  /* the channel is ready with the first batch and ourselves... */
+  g_assert_cmpuint (
+      tp_intset_size (tp_channel_group_get_members (test->channel_room)), ==,
+      BATCH_SIZE + 1);
+  g_assert (tp_intset_is_member (
+        tp_channel_group_get_members (test->channel_room), self_handle));
+
+  /* ... and the rest follow, a batch at a time */
+  while (tp_intset_size (tp_channel_group_get_members (test->channel_room))
+      < N_MEMBERS + 1)
+    g_main_context_iteration (NULL, TRUE);
+
+  tp_tests_proxy_run_until_dbus_queue_processed (test->connection);
+
+  g_assert_cmpuint (log.added->len, ==, N_MEMBERS + 1);
+  g_assert_cmpuint (log.removed->len, ==, 0);
+  /* one initial batch, then ceil ((N_MEMBERS - BATCH_SIZE) / BATCH_SIZE) */
+  g_assert_cmpuint (log.n_batches, ==,
+      1 + (N_MEMBERS - BATCH_SIZE + BATCH_SIZE - 1) / BATCH_SIZE);
+
+  /* every member was reported exactly once, in ascending order apart from
+   * ourselves; only the first batch was reported before the channel was
+   * prepared */
+  for (i = 0; i < log.added->len; i++)
+    {
+      TpHandle handle = g_array_index (log.added, TpHandle, i);
+      gboolean prepared = g_array_index (log.prepared, gboolean, i);
+
+      if (handle == self_handle)
+        {
+          g_assert (!prepared);
+          continue;
+        }
+
+      g_assert_cmpuint (handle, >, last);
+      last = handle;
+
+      if (n_initial < BATCH_SIZE)
+        {
+          g_assert (!prepared);
+          n_initial++;
+        }
+      else
+        {
+          g_assert (prepared);
+        }
+    }
+
+  for (i = 0; i < N_MEMBERS; i++)
+    g_assert (tp_intset_is_member (
+          tp_channel_group_get_members (test->channel_room), herd[i]));
+
+  g_array_unref (log.added);
+  g_array_unref (log.prepared);
+  g_array_unref (log.removed);
+}
+
+static gboolean
+hold_back_idles_cb (gpointer user_data)
+{
+  return TRUE;
+}
+
+static void
+test_members_batched_removed (Test *test,
+    gconstpointer data G_GNUC_UNUSED)
+{
+  GQuark features[] = { TP_CHANNEL_FEATURE_GROUP, 0 };
+  TpHandle herd[N_MEMBERS];
+  TpHandle reported, unreported;
+  TpIntset *add, *del;
+  BatchLog log = { NULL, NULL, NULL, 0 };
+  guint hold_back_id;
+  guint i;
+
+  tp_simple_client_factory_set_group_members_batch_size (
+      tp_proxy_get_factory (test->connection), BATCH_SIZE);
+
+  add = tp_intset_new ();
+
+  for (i = 0; i < N_MEMBERS; i++)
+    {
+      gchar *id = g_strdup_printf ("member%02u", i);
+
+      herd[i] = tp_handle_ensure (test->contact_repo, id, NULL, NULL);
+      tp_intset_add (add, herd[i]);
+      g_free (id);
+    }
+
+  tp_group_mixin_change_members ((GObject *) test->chan_room_service, "",
+      add, NULL, NULL, NULL, 0, TP_CHANNEL_GROUP_CHANGE_REASON_NONE);
+  tp_intset_destroy (add);
+
+  log.added = g_array_new (FALSE, FALSE, sizeof (TpHandle));
+  log.prepared = g_array_new (FALSE, FALSE, sizeof (gboolean));
+  log.removed = g_array_new (FALSE, FALSE, sizeof (TpHandle));
+  g_signal_connect (test->channel_room, "group-members-changed",
+      G_CALLBACK (batch_members_changed_cb), &log);
+
+  tp_tests_proxy_run_until_prepared (test->channel_room, features);
+
+  /* the lowest handles are reported first */
+  reported = herd[0];
+  unreported = herd[N_MEMBERS - 1];
+  g_assert (tp_intset_is_member (
+        tp_channel_group_get_members (test->channel_room), reported));
+  g_assert (!tp_intset_is_member (
+        tp_channel_group_get_members (test->channel_room), unreported));
+
+  /* The backlog is reported from an idle, so keep it back until the CM has
+   * removed one member we know about and one we haven't heard of yet */
+  hold_back_id = g_idle_add_full (G_PRIORITY_HIGH_IDLE, hold_back_idles_cb,
+      NULL, NULL);
+
+  del = tp_intset_new ();
+  tp_intset_add (del, reported);
+  tp_intset_add (del, unreported);
+  tp_group_mixin_change_members ((GObject *) test->chan_room_service, "",
+      NULL, del, NULL, NULL, 0, TP_CHANNEL_GROUP_CHANGE_REASON_NONE);
+  tp_intset_destroy (del);
+
+  tp_tests_proxy_run_until_dbus_queue_processed (test->connection);
+  g_source_remove (hold_back_id);
+
+  /* only the member we were told about is reported as removed */
+  g_assert_cmpuint (log.removed->len, ==, 1);
+  g_assert_cmpuint (g_array_index (log.removed, TpHandle, 0), ==, reported);
+
+  while (tp_intset_size (tp_channel_group_get_members (test->channel_room))
+      < N_MEMBERS - 1)
+    g_main_context_iteration (NULL, TRUE);
+
+  tp_tests_proxy_run_until_dbus_queue_processed (test->connection);
+
+  /* and the other one never appears at all */
+  g_assert_cmpuint (log.added->len, ==, N_MEMBERS);
+  g_assert_cmpuint (log.removed->len, ==, 1);
+
+  for (i = 0; i < log.added->len; i++)
+    g_assert_cmpuint (g_array_index (log.added, TpHandle, i), !=,
+        unreported);
+
+  g_assert (!tp_intset_is_member (
+        tp_channel_group_get_members (test->channel_room), reported));
+  g_assert (!tp_intset_is_member (
+        tp_channel_group_get_members (test->channel_room), unreported));
+
+  g_array_unref (log.added);
+  g_array_unref (log.prepared);
+  g_array_unref (log.removed);
+}
+
 int
 main (int argc,
       char **argv)
@@ -706,6 +1060,13 @@ main (int argc,
 
   g_test_add ("/channel/contacts", Test, NULL, setup,
       test_contacts, teardown);
+  g_test_add ("/channel/contacts/lazy", Test, NULL, setup,
+      test_contacts_lazy, teardown);
+
+  g_test_add ("/channel/group/members-batched", Test, NULL, setup,
+      test_members_batched, teardown);
+  g_test_add ("/channel/group/members-batched/removed", Test, NULL, setup,
+      test_members_batched_removed, teardown);
 
   return tp_tests_run_with_bus ();
 }
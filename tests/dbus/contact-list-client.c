@@ -35,6 +35,9 @@ typedef struct {
     GPtrArray *blocked_removed;
     TpContact *contact;
 
+    guint n_roster_pages;
+    guint n_roster_contacts;
+
     GError *error /* initialized where needed */;
     gint wait;
 } Test;
@@ -557,6 +560,91 @@ test_contact_list_properties (Test *test,
   g_ptr_array_unref (contacts);
 }
 
+static void
+roster_page_cb (TpConnection *connection,
+    GPtrArray *added,
+    GPtrArray *removed,
+    Test *test)
+{
+  g_assert_cmpuint (added->len, <=, 2);
+  g_assert_cmpuint (removed->len, ==, 0);
+
+  test->n_roster_pages++;
+}
+
+static void
+got_contact_list_attributes_cb (TpConnection *connection,
+    GHashTable *attributes,
+    const GError *error,
+    gpointer user_data,
+    GObject *weak_object)
+{
+  Test *test = user_data;
+
+  g_assert_no_error (error);
+  test->n_roster_contacts = g_hash_table_size (attributes);
+
+  test->wait--;
+  if (test->wait <= 0)
+    g_main_loop_quit (test->mainloop);
+}
+
+static void
+test_contact_list_paged (Test *test,
+    gconstpointer data G_GNUC_UNUSED)
+{
+  GQuark conn_features[] = { TP_CONNECTION_FEATURE_CONTACT_LIST, 0 };
+  const gchar *no_interfaces[] = { NULL };
+  GPtrArray *contacts;
+
+  tp_simple_client_factory_set_contact_list_page_size (
+      tp_proxy_get_factory (test->connection), 2);
+
+  g_signal_connect (test->connection, "contact-list-changed",
+      G_CALLBACK (roster_page_cb), test);
+
+  tp_proxy_prepare_async (test->connection, conn_features,
+      proxy_prepare_cb, test);
+
+  test->wait = 1;
+
+  if (tp_connection_get_contact_list_state (test->connection) !=
+      TP_CONTACT_LIST_STATE_SUCCESS)
+    {
+      g_signal_connect (test->connection, "notify::contact-list-state",
+          G_CALLBACK (contact_list_state_change_cb), test);
+
+      test->wait++;
+    }
+
+  g_main_loop_run (test->mainloop);
+  g_assert_no_error (test->error);
+
+  /* Find out how big the roster is */
+  tp_cli_connection_interface_contact_list_call_get_contact_list_attributes (
+      test->connection, -1, no_interfaces, FALSE,
+      got_contact_list_attributes_cb, test, NULL, NULL);
+
+  test->wait = 1;
+  g_main_loop_run (test->mainloop);
+  g_assert_cmpuint (test->n_roster_contacts, >, 2);
+
+  /* Contacts are added a page at a time */
+  contacts = tp_connection_dup_contact_list (test->connection);
+
+  while (contacts->len < test->n_roster_contacts)
+    {
+      g_ptr_array_unref (contacts);
+      g_main_context_iteration (NULL, TRUE);
+      contacts = tp_connection_dup_contact_list (test->connection);
+    }
+
+  g_assert_cmpuint (contacts->len, ==, test->n_roster_contacts);
+  g_assert_cmpuint (test->n_roster_pages, ==,
+      (test->n_roster_contacts + 1) / 2);
+  g_ptr_array_unref (contacts);
+}
+
 int
 main (int argc,
       char **argv)
@@ -579,6 +667,8 @@ main (int argc,
       GUINT_TO_POINTER (FALSE), setup, test_contact_list_properties, teardown);
   g_test_add ("/contact-list-client/contact-list/properties/props-only", Test,
       GUINT_TO_POINTER (TRUE), setup, test_contact_list_properties, teardown);
+  g_test_add ("/contact-list-client/contact-list/paged", Test, NULL,
+      setup, test_contact_list_paged, teardown);
 
   return tp_tests_run_with_bus ();
 }
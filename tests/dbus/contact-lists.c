@@ -10,6 +10,9 @@
 
 #include "config.h"
 
+#include <glib/gstdio.h>
+
+#include <telepathy-glib/base-contact-list.h>
 #include <telepathy-glib/connection.h>
 
 #include "examples/cm/contactlist/conn.h"
@@ -96,6 +99,10 @@ typedef struct {
     GAsyncResult *prepare_result;
     GHashTable *contact_attributes;
 
+    /* used by the "snapshot" tests */
+    gchar *snapshot_dir;
+    gchar *snapshot_file;
+
     GMainLoop *main_loop;
     GError *error /* = NULL */;
 } Test;
@@ -338,11 +345,20 @@ setup_pre_connect (
   else
     account = "me@example.com";
 
+  if (!tp_strdiff (data, "snapshot"))
+    {
+      test->snapshot_dir = g_dir_make_tmp ("tp-glib-tests-XXXXXX", &error);
+      g_assert_no_error (error);
+      test->snapshot_file = g_build_filename (test->snapshot_dir, "roster",
+          NULL);
+    }
+
   test->service_conn = tp_tests_object_new_static_class (
         EXAMPLE_TYPE_CONTACT_LIST_CONNECTION,
         "account", account,
         "simulation-delay", 0,
         "protocol", "example-contact-list",
+        "snapshot-file", test->snapshot_file,
         NULL);
   test->service_conn_as_base = TP_BASE_CONNECTION (test->service_conn);
   g_assert (test->service_conn != NULL);
@@ -450,6 +466,14 @@ teardown_pre_connect (
   tp_clear_object (&test->dbus);
   tp_clear_pointer (&test->main_loop, g_main_loop_unref);
   g_clear_error (&test->error);
+
+  if (test->snapshot_file != NULL)
+    {
+      g_unlink (test->snapshot_file);
+      g_rmdir (test->snapshot_dir);
+      tp_clear_pointer (&test->snapshot_file, g_free);
+      tp_clear_pointer (&test->snapshot_dir, g_free);
+    }
 }
 
 static void
@@ -477,15 +501,19 @@ teardown (Test *test,
   tp_clear_object (&test->group);
 
   /* make a new TpConnection just to disconnect the underlying Connection,
-   * so we don't leak it */
-  conn = tp_connection_new (test->dbus, test->conn_name, test->conn_path,
-      &error);
-  g_assert (conn != NULL);
-  g_assert_no_error (error);
-  tp_tests_connection_assert_disconnect_succeeds (conn);
-  g_assert (!tp_connection_run_until_ready (conn, FALSE, &error, NULL));
-  g_assert_error (error, TP_ERROR, TP_ERROR_CANCELLED);
-  g_clear_error (&error);
+   * so we don't leak it (unless the test already did) */
+  if (tp_base_connection_get_status (test->service_conn_as_base) !=
+      TP_CONNECTION_STATUS_DISCONNECTED)
+    {
+      conn = tp_connection_new (test->dbus, test->conn_name, test->conn_path,
+          &error);
+      g_assert (conn != NULL);
+      g_assert_no_error (error);
+      tp_tests_connection_assert_disconnect_succeeds (conn);
+      g_assert (!tp_connection_run_until_ready (conn, FALSE, &error, NULL));
+      g_assert_error (error, TP_ERROR, TP_ERROR_CANCELLED);
+      g_clear_error (&error);
+    }
 
   tp_clear_pointer (&test->contact_attributes, g_hash_table_unref);
 
@@ -2413,6 +2441,353 @@ test_rename_group_absent (Test *test,
   g_clear_error (&error);
 }
 
+static TpBaseContactList *
+get_service_contact_list (TpBaseConnection *service_conn)
+{
+  TpChannelManagerIter iter;
+  TpChannelManager *manager;
+
+  tp_base_connection_channel_manager_iter_init (&iter, service_conn);
+
+  while (tp_base_connection_channel_manager_iter_next (&iter, &manager))
+    {
+      if (TP_IS_BASE_CONTACT_LIST (manager))
+        return TP_BASE_CONTACT_LIST (manager);
+    }
+
+  g_assert_not_reached ();
+  return NULL;
+}
+
+/* Check that the base class's group membership index agrees with what the
+ * example contact list says when asked directly */
+static void
+test_assert_groups_index_consistent (Test *test)
+{
+  TpBaseContactList *list = get_service_contact_list (
+      test->service_conn_as_base);
+  TpContactGroupListInterface *iface =
+    TP_CONTACT_GROUP_LIST_GET_INTERFACE (list);
+  TpHandleSet *contacts;
+  TpIntsetFastIter iter;
+  TpHandle contact;
+  GStrv groups;
+  guint i;
+
+  contacts = tp_base_contact_list_dup_contacts (list);
+  tp_intset_fast_iter_init (&iter, tp_handle_set_peek (contacts));
+
+  while (tp_intset_fast_iter_next (&iter, &contact))
+    {
+      GStrv indexed = tp_base_contact_list_dup_contact_groups (list, contact);
+      GStrv uncached = iface->dup_contact_groups (list, contact);
+      guint n_uncached = (uncached == NULL ? 0 : g_strv_length (uncached));
+
+      g_assert (indexed != NULL);
+      g_assert_cmpuint (g_strv_length (indexed), ==, n_uncached);
+
+      for (i = 0; indexed[i] != NULL; i++)
+        g_assert (tp_strv_contains ((const gchar * const *) uncached,
+              indexed[i]));
+
+      g_strfreev (indexed);
+      g_strfreev (uncached);
+    }
+
+  tp_handle_set_destroy (contacts);
+
+  groups = iface->dup_groups (list);
+
+  for (i = 0; groups != NULL && groups[i] != NULL; i++)
+    {
+      TpHandleSet *indexed = tp_base_contact_list_dup_group_members (list,
+          groups[i]);
+      TpHandleSet *uncached = iface->dup_group_members (list, groups[i]);
+
+      g_assert (tp_intset_is_equal (tp_handle_set_peek (indexed),
+            tp_handle_set_peek (uncached)));
+
+      tp_handle_set_destroy (indexed);
+      tp_handle_set_destroy (uncached);
+    }
+
+  g_strfreev (groups);
+}
+
+static void
+test_groups_index (Test *test,
+    gconstpointer nil G_GNUC_UNUSED)
+{
+  TpBaseContactList *list = get_service_contact_list (
+      test->service_conn_as_base);
+  TpHandleSet *members;
+  GError *error = NULL;
+  GStrv groups;
+
+  test_assert_groups_index_consistent (test);
+
+  /* a new contact in an existing group */
+  g_array_append_val (test->arr, test->ninja);
+  tp_cli_connection_interface_contact_groups_run_add_to_group (test->conn,
+      -1, "Cambridge", test->arr, &error, NULL);
+  g_assert_no_error (error);
+  test_assert_groups_index_consistent (test);
+
+  /* an existing contact in a new group */
+  g_array_set_size (test->arr, 0);
+  g_array_append_val (test->arr, test->helen);
+  tp_cli_connection_interface_contact_groups_run_add_to_group (test->conn,
+      -1, "Badgers", test->arr, &error, NULL);
+  g_assert_no_error (error);
+  test_assert_groups_index_consistent (test);
+
+  /* leaving the only group; the contact is still in an (empty) array of
+   * groups, not in NULL */
+  g_array_set_size (test->arr, 0);
+  g_array_append_val (test->arr, test->sjoerd);
+  tp_cli_connection_interface_contact_groups_run_remove_from_group (
+      test->conn, -1, "Cambridge", test->arr, &error, NULL);
+  g_assert_no_error (error);
+  test_assert_groups_index_consistent (test);
+
+  groups = tp_base_contact_list_dup_contact_groups (list, test->sjoerd);
+  g_assert (groups != NULL);
+  g_assert_cmpstr (groups[0], ==, NULL);
+  g_strfreev (groups);
+
+  /* renaming moves every member */
+  tp_cli_connection_interface_contact_groups_run_rename_group (test->conn,
+      -1, "Cambridge", "Grantabrugge", &error, NULL);
+  g_assert_no_error (error);
+  test_assert_groups_index_consistent (test);
+
+  members = tp_base_contact_list_dup_group_members (list, "Cambridge");
+  g_assert (tp_handle_set_is_empty (members));
+  tp_handle_set_destroy (members);
+
+  members = tp_base_contact_list_dup_group_members (list, "Grantabrugge");
+  g_assert (tp_handle_set_is_member (members, test->ninja));
+  g_assert (!tp_handle_set_is_member (members, test->sjoerd));
+  tp_handle_set_destroy (members);
+
+  /* removing a non-empty group */
+  tp_cli_connection_interface_contact_groups_run_remove_group (test->conn,
+      -1, "Badgers", &error, NULL);
+  g_assert_no_error (error);
+  test_assert_groups_index_consistent (test);
+
+  groups = tp_base_contact_list_dup_contact_groups (list, test->helen);
+  g_assert (!tp_strv_contains ((const gchar * const *) groups, "Badgers"));
+  g_strfreev (groups);
+}
+
+static void
+test_snapshot (Test *test,
+    gconstpointer nil G_GNUC_UNUSED)
+{
+  GQuark features[] = { TP_CONNECTION_FEATURE_CONNECTED, 0 };
+  TpBaseContactList *list = get_service_contact_list (
+      test->service_conn_as_base);
+  TpBaseConnection *service_conn;
+  gchar *conn_name, *conn_path;
+  TpConnection *conn;
+  TpHandleRepoIface *contact_repo;
+  TpHandleSet *contacts, *members;
+  TpHandle sjoerd, helen, ninja;
+  GStrv groups;
+  GError *error = NULL;
+
+  /* the roster is saved as soon as it has been received */
+  while (tp_base_contact_list_get_state (list, NULL) !=
+      TP_CONTACT_LIST_STATE_SUCCESS)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert (g_file_test (test->snapshot_file, G_FILE_TEST_IS_REGULAR));
+
+  /* later changes are saved after a while, or when we disconnect */
+  g_array_append_val (test->arr, test->ninja);
+  tp_cli_connection_interface_contact_groups_run_add_to_group (test->conn,
+      -1, "Cambridge", test->arr, &error, NULL);
+  g_assert_no_error (error);
+
+  g_array_set_size (test->arr, 0);
+  g_array_append_val (test->arr, test->helen);
+  tp_cli_connection_interface_contact_groups_run_add_to_group (test->conn,
+      -1, "Badgers", test->arr, &error, NULL);
+  g_assert_no_error (error);
+
+  g_array_set_size (test->arr, 0);
+  g_array_append_val (test->arr, test->sjoerd);
+  tp_cli_connection_interface_contact_groups_run_remove_from_group (
+      test->conn, -1, "Cambridge", test->arr, &error, NULL);
+  g_assert_no_error (error);
+
+  tp_tests_connection_assert_disconnect_succeeds (test->conn);
+
+  /* reconnect, with a roster which won't be downloaded during the test */
+  service_conn = tp_tests_object_new_static_class (
+        EXAMPLE_TYPE_CONTACT_LIST_CONNECTION,
+        "account", "me@example.com",
+        "simulation-delay", 60 * 60 * 1000,
+        "protocol", "example-contact-list",
+        "snapshot-file", test->snapshot_file,
+        NULL);
+  g_assert (tp_base_connection_register (service_conn, "example",
+        &conn_name, &conn_path, &error));
+  g_assert_no_error (error);
+
+  conn = tp_connection_new (test->dbus, conn_name, conn_path, &error);
+  g_assert_no_error (error);
+
+  tp_cli_connection_call_connect (conn, -1, NULL, NULL, NULL, NULL);
+  tp_tests_proxy_run_until_prepared (conn, features);
+
+  /* the roster from the previous connection is available straight away */
+  list = get_service_contact_list (service_conn);
+  g_assert_cmpuint (tp_base_contact_list_get_state (list, NULL), ==,
+      TP_CONTACT_LIST_STATE_SUCCESS);
+
+  contact_repo = tp_base_connection_get_handles (service_conn,
+      TP_HANDLE_TYPE_CONTACT);
+  sjoerd = tp_handle_lookup (contact_repo, "sjoerd@example.com", NULL, NULL);
+  helen = tp_handle_lookup (contact_repo, "helen@example.com", NULL, NULL);
+  ninja = tp_handle_lookup (contact_repo, "ninja@example.com", NULL, NULL);
+  g_assert (sjoerd != 0);
+  g_assert (helen != 0);
+  g_assert (ninja != 0);
+
+  contacts = tp_base_contact_list_dup_contacts (list);
+  g_assert (tp_handle_set_is_member (contacts, sjoerd));
+  g_assert (tp_handle_set_is_member (contacts, helen));
+  g_assert (tp_handle_set_is_member (contacts, ninja));
+  tp_handle_set_destroy (contacts);
+
+  groups = tp_base_contact_list_dup_groups (list);
+  g_assert (tp_strv_contains ((const gchar * const *) groups, "Cambridge"));
+  g_assert (tp_strv_contains ((const gchar * const *) groups, "Badgers"));
+  g_strfreev (groups);
+
+  members = tp_base_contact_list_dup_group_members (list, "Cambridge");
+  g_assert (tp_handle_set_is_member (members, ninja));
+  g_assert (!tp_handle_set_is_member (members, sjoerd));
+  tp_handle_set_destroy (members);
+
+  members = tp_base_contact_list_dup_group_members (list, "Badgers");
+  g_assert_cmpuint (tp_handle_set_size (members), ==, 1);
+  g_assert (tp_handle_set_is_member (members, helen));
+  tp_handle_set_destroy (members);
+
+  groups = tp_base_contact_list_dup_contact_groups (list, helen);
+  g_assert (tp_strv_contains ((const gchar * const *) groups, "Badgers"));
+  g_strfreev (groups);
+
+  /* contacts in no groups have an empty list of them */
+  groups = tp_base_contact_list_dup_contact_groups (list, sjoerd);
+  g_assert (groups != NULL);
+  g_assert_cmpstr (groups[0], ==, NULL);
+  g_strfreev (groups);
+
+  tp_tests_connection_assert_disconnect_succeeds (conn);
+  g_object_unref (conn);
+  g_object_unref (service_conn);
+  g_free (conn_name);
+  g_free (conn_path);
+}
+
+#define MAX_PER_SIGNAL 3
+
+static void
+test_contacts_changed_chunked (Test *test,
+    gconstpointer nil G_GNUC_UNUSED)
+{
+  TpBaseContactList *list = get_service_contact_list (
+      test->service_conn_as_base);
+  TpHandleSet *changed, *removed;
+  TpHandle gone;
+  guint n_changed, n_removed, n_expected;
+  guint seen_changed = 0, seen_removed = 0;
+  guint i;
+
+  while (tp_base_contact_list_get_state (list, NULL) !=
+      TP_CONTACT_LIST_STATE_SUCCESS)
+    g_main_context_iteration (NULL, TRUE);
+
+  tp_tests_proxy_run_until_dbus_queue_processed (test->conn);
+  test_clear_log (test);
+
+  g_object_set (list,
+      "max-contacts-per-signal", MAX_PER_SIGNAL,
+      NULL);
+  g_assert_cmpuint (tp_base_contact_list_get_max_contacts_per_signal (list),
+      ==, MAX_PER_SIGNAL);
+
+  /* re-announce the whole roster, and remove a couple of strangers */
+  changed = tp_base_contact_list_dup_contacts (list);
+  removed = tp_handle_set_new (test->contact_repo);
+
+  gone = tp_handle_ensure (test->contact_repo, "gone@example.com", NULL, NULL);
+  tp_handle_set_add (removed, gone);
+  tp_handle_unref (test->contact_repo, gone);
+  gone = tp_handle_ensure (test->contact_repo, "lost@example.com", NULL, NULL);
+  tp_handle_set_add (removed, gone);
+  tp_handle_unref (test->contact_repo, gone);
+
+  n_changed = tp_handle_set_size (changed);
+  n_removed = tp_handle_set_size (removed);
+  n_expected = (n_changed + n_removed + MAX_PER_SIGNAL - 1) / MAX_PER_SIGNAL;
+
+  /* otherwise this isn't testing much */
+  g_assert_cmpuint (n_changed, >, MAX_PER_SIGNAL);
+
+  tp_base_contact_list_contacts_changed (list, changed, removed);
+  tp_tests_proxy_run_until_dbus_queue_processed (test->conn);
+
+  /* every signal is full, except perhaps the last; changes come before
+   * removals, which fill up the space left by the last changes */
+  g_assert_cmpuint (test->log->len, ==, n_expected);
+
+  for (i = 0; i < test->log->len; i++)
+    {
+      LogEntry *le = g_ptr_array_index (test->log, i);
+      guint size;
+
+      g_assert_cmpuint (le->type, ==, CONTACTS_CHANGED);
+
+      size = g_hash_table_size (le->contacts_changed) +
+          tp_intset_size (le->contacts_removed);
+
+      if (i + 1 < test->log->len)
+        g_assert_cmpuint (size, ==, MAX_PER_SIGNAL);
+      else
+        g_assert_cmpuint (size, ==,
+            (n_changed + n_removed - 1) % MAX_PER_SIGNAL + 1);
+
+      if (tp_intset_size (le->contacts_removed) > 0)
+        g_assert_cmpuint (seen_changed + g_hash_table_size (
+              le->contacts_changed), ==, n_changed);
+
+      seen_changed += g_hash_table_size (le->contacts_changed);
+      seen_removed += tp_intset_size (le->contacts_removed);
+    }
+
+  g_assert_cmpuint (seen_changed, ==, n_changed);
+  g_assert_cmpuint (seen_removed, ==, n_removed);
+
+  /* with no limit, it's all in one signal again */
+  test_clear_log (test);
+  g_object_set (list,
+      "max-contacts-per-signal", 0,
+      NULL);
+
+  tp_base_contact_list_contacts_changed (list, changed, removed);
+  tp_tests_proxy_run_until_dbus_queue_processed (test->conn);
+
+  g_assert_cmpuint (test->log->len, ==, 1);
+
+  tp_handle_set_destroy (changed);
+  tp_handle_set_destroy (removed);
+}
+
 /* Signature of a function which does something with test->arr */
 typedef void (*ManipulateContactsFunc) (
     Test *test,
@@ -2874,6 +3249,13 @@ main (int argc,
   g_test_add ("/contact-lists/rename_group/overwrite",
       Test, NULL, setup, test_rename_group_overwrite, teardown);
 
+  g_test_add ("/contact-lists/groups-index",
+      Test, NULL, setup, test_groups_index, teardown);
+  g_test_add ("/contact-lists/snapshot",
+      Test, "snapshot", setup, test_snapshot, teardown);
+  g_test_add ("/contact-lists/contacts-changed-chunked",
+      Test, NULL, setup, test_contacts_changed_chunked, teardown);
+
   g_test_add ("/contact-lists/add-to-deny",
       Test, NULL, setup, test_add_to_deny, teardown);
   g_test_add ("/contact-lists/add-to-deny/no-op",
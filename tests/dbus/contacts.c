@@ -484,6 +484,104 @@ test_contact_info (Fixture *f,
   tp_contact_info_list_free (info_list);
 }
 
+static void
+contact_info_count_cb (TpContact *contact,
+    GParamSpec *pspec,
+    guint *count)
+{
+  contact_info_verify (contact);
+  (*count)++;
+}
+
+static void
+test_contact_info_batched (Fixture *f,
+    gconstpointer unused G_GNUC_UNUSED)
+{
+  Result result = { g_main_loop_new (NULL, FALSE), NULL, NULL, NULL };
+  TpHandleRepoIface *service_repo = tp_base_connection_get_handles (
+      (TpBaseConnection *) f->service_conn, TP_HANDLE_TYPE_CONTACT);
+  TpSimpleClientFactory *factory = tp_proxy_get_factory (f->client_conn);
+  const gchar *field_value[] = { "Foo", NULL };
+  TpHandle handles[3];
+  guint counts[3] = { 0, 0, 0 };
+  GPtrArray *info;
+  guint i;
+
+  g_message (G_STRFUNC);
+
+  info = g_ptr_array_new_with_free_func ((GDestroyNotify) tp_value_array_free);
+  g_ptr_array_add (info, tp_value_array_build (3,
+      G_TYPE_STRING, "n",
+      G_TYPE_STRV, NULL,
+      G_TYPE_STRV, field_value,
+      G_TYPE_INVALID));
+  tp_tests_contacts_connection_set_default_contact_info (f->service_conn,
+      info);
+
+  /* two contacts per batch, without waiting between batches */
+  tp_simple_client_factory_set_contact_info_request_batch_size (factory, 2);
+  tp_simple_client_factory_set_contact_info_request_interval (factory, 0);
+
+  for (i = 0; i < G_N_ELEMENTS (handles); i++)
+    {
+      gchar *id = g_strdup_printf ("batched-info-%u", i);
+
+      handles[i] = tp_handle_ensure (service_repo, id, NULL, NULL);
+      g_free (id);
+    }
+
+  tp_connection_get_contacts_by_handle (f->client_conn,
+      G_N_ELEMENTS (handles), handles,
+      0, NULL,
+      by_handle_cb,
+      &result, finish, NULL);
+  g_main_loop_run (result.loop);
+  g_assert_no_error (result.error);
+  g_assert_cmpuint (result.contacts->len, ==, G_N_ELEMENTS (handles));
+
+  for (i = 0; i < G_N_ELEMENTS (handles); i++)
+    g_signal_connect (g_ptr_array_index (result.contacts, i),
+        "notify::contact-info", G_CALLBACK (contact_info_count_cb),
+        &counts[i]);
+
+  /* asking twice before anything is sent only fetches each vCard once */
+  tp_connection_refresh_contact_info (f->client_conn, result.contacts->len,
+      (TpContact * const *) result.contacts->pdata);
+  tp_connection_refresh_contact_info (f->client_conn, result.contacts->len,
+      (TpContact * const *) result.contacts->pdata);
+
+  for (i = 0; i < G_N_ELEMENTS (handles); i++)
+    {
+      while (counts[i] == 0)
+        g_main_context_iteration (NULL, TRUE);
+    }
+
+  /* the information is fresh now, so asking again is a no-op */
+  tp_connection_refresh_contact_info (f->client_conn, result.contacts->len,
+      (TpContact * const *) result.contacts->pdata);
+
+  tp_contact_request_contact_info_async (
+      g_ptr_array_index (result.contacts, 0), NULL, contact_info_request_cb,
+      &result);
+  g_main_loop_run (result.loop);
+  g_assert_no_error (result.error);
+
+  tp_tests_proxy_run_until_dbus_queue_processed (f->client_conn);
+
+  for (i = 0; i < G_N_ELEMENTS (handles); i++)
+    {
+      g_assert_cmpuint (counts[i], ==, 1);
+      g_signal_handlers_disconnect_by_func (
+          g_ptr_array_index (result.contacts, i), contact_info_count_cb,
+          &counts[i]);
+      tp_handle_unref (service_repo, handles[i]);
+    }
+
+  g_ptr_array_unref (info);
+  reset_result (&result);
+  g_main_loop_unref (result.loop);
+}
+
 static void
 prepare_avatar_requirements_cb (GObject *object,
     GAsyncResult *res,
@@ -738,6 +836,370 @@ test_avatar_data_after_token (Fixture *f,
   g_object_unref (contact2);
 }
 
+static void
+test_avatar_request_pacing (Fixture *f,
+    gconstpointer unused G_GNUC_UNUSED)
+{
+  Result result = { g_main_loop_new (NULL, FALSE), NULL, NULL, NULL };
+  TpHandleRepoIface *service_repo = tp_base_connection_get_handles (
+      (TpBaseConnection *) f->service_conn, TP_HANDLE_TYPE_CONTACT);
+  TpSimpleClientFactory *factory = tp_proxy_get_factory (f->client_conn);
+  TpContactFeature feature = TP_CONTACT_FEATURE_AVATAR_DATA;
+  TpHandle handles[3];
+  GArray *array;
+  guint queued, in_flight;
+  guint64 completed, mean_latency, max_latency;
+  guint i;
+
+  g_message (G_STRFUNC);
+
+  /* one avatar per RequestAvatars call, without waiting between calls */
+  tp_simple_client_factory_set_avatar_request_batch_size (factory, 1);
+  tp_simple_client_factory_set_avatar_request_interval (factory, 0);
+
+  array = g_array_new (FALSE, FALSE, sizeof (gchar));
+  g_array_append_vals (array, "paced", 6);
+
+  for (i = 0; i < G_N_ELEMENTS (handles); i++)
+    {
+      gchar *id = g_strdup_printf ("paced-avatar-%u", i);
+      gchar *token = g_strdup_printf ("paced-avatar-token-%u", i);
+
+      handles[i] = tp_handle_ensure (service_repo, id, NULL, NULL);
+      tp_tests_contacts_connection_change_avatar_data (f->service_conn,
+          handles[i], array, "image/x-paced", token);
+
+      g_free (id);
+      g_free (token);
+    }
+
+  tp_connection_get_contacts_by_handle (f->client_conn,
+      G_N_ELEMENTS (handles), handles,
+      1, &feature,
+      by_handle_cb,
+      &result, finish, NULL);
+  g_main_loop_run (result.loop);
+  g_assert_no_error (result.error);
+  g_assert_cmpuint (result.contacts->len, ==, G_N_ELEMENTS (handles));
+
+  /* the last contact is the one being looked at */
+  tp_connection_prioritize_avatar_requests (f->client_conn, 1,
+      (TpContact * const *) result.contacts->pdata + 2);
+
+  for (i = 0; i < G_N_ELEMENTS (handles); i++)
+    {
+      TpContact *contact = g_ptr_array_index (result.contacts, i);
+
+      while (tp_contact_get_avatar_file (contact) == NULL)
+        g_main_context_iteration (NULL, TRUE);
+
+      g_assert_cmpstr (tp_contact_get_avatar_mime_type (contact), ==,
+          "image/x-paced");
+    }
+
+  tp_connection_get_avatar_request_stats (f->client_conn, &queued,
+      &in_flight, &completed, &mean_latency, &max_latency);
+  g_assert_cmpuint (queued, ==, 0);
+  g_assert_cmpuint (in_flight, ==, 0);
+  g_assert_cmpuint (completed, ==, G_N_ELEMENTS (handles));
+  g_assert_cmpuint (mean_latency, <=, max_latency);
+
+  for (i = 0; i < G_N_ELEMENTS (handles); i++)
+    tp_handle_unref (service_repo, handles[i]);
+
+  g_array_unref (array);
+  reset_result (&result);
+  g_main_loop_unref (result.loop);
+}
+
+/* Fetch @data as the avatar of a new contact @id, whose token is @token,
+ * and return where it was cached */
+static GFile *
+get_cached_avatar (Fixture *f,
+    const gchar *id,
+    const gchar *token,
+    const gchar *data)
+{
+  Result result = { g_main_loop_new (NULL, FALSE), NULL, NULL, NULL };
+  TpHandleRepoIface *service_repo = tp_base_connection_get_handles (
+      (TpBaseConnection *) f->service_conn, TP_HANDLE_TYPE_CONTACT);
+  TpContactFeature feature = TP_CONTACT_FEATURE_AVATAR_DATA;
+  TpContact *contact;
+  TpHandle handle;
+  GArray *array;
+  GFile *file;
+
+  handle = tp_handle_ensure (service_repo, id, NULL, NULL);
+  array = g_array_new (FALSE, FALSE, sizeof (gchar));
+  g_array_append_vals (array, data, strlen (data) + 1);
+  tp_tests_contacts_connection_change_avatar_data (f->service_conn, handle,
+      array, "image/x-cached", token);
+
+  tp_connection_get_contacts_by_handle (f->client_conn,
+      1, &handle,
+      1, &feature,
+      by_handle_cb,
+      &result, finish, NULL);
+  g_main_loop_run (result.loop);
+  g_assert_no_error (result.error);
+
+  contact = g_ptr_array_index (result.contacts, 0);
+
+  while (tp_contact_get_avatar_file (contact) == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert_cmpstr (tp_contact_get_avatar_token (contact), ==, token);
+  file = g_object_ref (tp_contact_get_avatar_file (contact));
+
+  tp_handle_unref (service_repo, handle);
+  g_array_unref (array);
+  reset_result (&result);
+  g_main_loop_unref (result.loop);
+
+  return file;
+}
+
+/* Compact the avatar cache, which also writes its index back to disk, and
+ * return how many bytes were freed */
+static guint64
+compact_avatar_cache (void)
+{
+  GAsyncResult *result = NULL;
+  GError *error = NULL;
+  guint64 freed = G_MAXUINT64;
+
+  tp_contact_avatar_cache_compact_async (tp_tests_result_ready_cb, &result);
+  tp_tests_run_until_result (&result);
+  g_assert (tp_contact_avatar_cache_compact_finish (result, &freed, &error));
+  g_assert_no_error (error);
+  g_assert (freed != G_MAXUINT64);
+  g_object_unref (result);
+
+  return freed;
+}
+
+static gchar *
+build_avatar_cache_path (const gchar *name)
+{
+  return g_build_filename (g_get_user_cache_dir (), "telepathy", "avatars",
+      "store", name, NULL);
+}
+
+static GKeyFile *
+load_avatar_cache_index (void)
+{
+  GKeyFile *key_file = g_key_file_new ();
+  gchar *path = build_avatar_cache_path ("index");
+  GError *error = NULL;
+
+  g_key_file_load_from_file (key_file, path, G_KEY_FILE_NONE, &error);
+  g_assert_no_error (error);
+
+  g_free (path);
+  return key_file;
+}
+
+/* Pretend that @name was written to the cache @age seconds ago */
+static void
+write_avatar_cache_file (const gchar *name,
+    const gchar *contents,
+    guint64 age)
+{
+  gchar *path = build_avatar_cache_path (name);
+  GFile *file = g_file_new_for_path (path);
+  GError *error = NULL;
+
+  g_file_set_contents (path, contents, -1, &error);
+  g_assert_no_error (error);
+
+  g_file_set_attribute_uint64 (file, G_FILE_ATTRIBUTE_TIME_MODIFIED,
+      g_get_real_time () / G_USEC_PER_SEC - age, G_FILE_QUERY_INFO_NONE,
+      NULL, &error);
+  g_assert_no_error (error);
+
+  g_object_unref (file);
+  g_free (path);
+}
+
+static void
+test_avatar_cache_store_lookup (Fixture *f,
+    gconstpointer unused G_GNUC_UNUSED)
+{
+  const gchar data[] = "shared-avatar";
+  gboolean avatar_retrieved_called;
+  TpProxySignalConnection *signal_id;
+  GError *error = NULL;
+  GFile *file1, *file2, *file3;
+  guint64 bytes, bytes_before;
+  guint n_images, n_images_before;
+  GKeyFile *key_file;
+  gchar *hash;
+
+  g_message (G_STRFUNC);
+
+  compact_avatar_cache ();
+  g_assert (tp_contact_avatar_cache_get_usage (&bytes_before,
+        &n_images_before));
+
+  /* two tokens for the same image share one file */
+  file1 = get_cached_avatar (f, "shared-avatar-1", "shared-avatar-token-1",
+      data);
+  file2 = get_cached_avatar (f, "shared-avatar-2", "shared-avatar-token-2",
+      data);
+  g_assert (g_file_equal (file1, file2));
+
+  g_assert (tp_contact_avatar_cache_get_usage (&bytes, &n_images));
+  g_assert_cmpuint (n_images, ==, n_images_before + 1);
+  g_assert_cmpuint (bytes, ==, bytes_before + sizeof (data));
+
+  /* the index on disk knows about it */
+  compact_avatar_cache ();
+  hash = g_file_get_basename (file1);
+  key_file = load_avatar_cache_index ();
+  g_assert (g_key_file_has_key (key_file, "Images", hash, NULL));
+  g_key_file_free (key_file);
+
+  /* if another process evicts the image, it's fetched again */
+  g_file_delete (file1, NULL, &error);
+  g_assert_no_error (error);
+
+  signal_id = tp_cli_connection_interface_avatars_connect_to_avatar_retrieved (
+      f->client_conn, avatar_retrieved_cb, &avatar_retrieved_called, NULL,
+      NULL, &error);
+  g_assert_no_error (error);
+  avatar_retrieved_called = FALSE;
+
+  /* the index still says it's there, until it's checked in a thread */
+  file3 = get_cached_avatar (f, "shared-avatar-3", "shared-avatar-token-1",
+      data);
+  g_assert (g_file_equal (file1, file3));
+
+  while (!avatar_retrieved_called || !g_file_query_exists (file3, NULL))
+    g_main_context_iteration (NULL, TRUE);
+
+  tp_proxy_signal_connection_disconnect (signal_id);
+  g_free (hash);
+  g_object_unref (file1);
+  g_object_unref (file2);
+  g_object_unref (file3);
+}
+
+static void
+test_avatar_cache_eviction (Fixture *f,
+    gconstpointer unused G_GNUC_UNUSED)
+{
+  const gchar new_data[] = "new-avatar";
+  GFile *old_file, *new_file;
+  guint64 bytes;
+  guint n_images;
+
+  g_message (G_STRFUNC);
+
+  old_file = get_cached_avatar (f, "old-avatar", "old-avatar-token",
+      "old-avatar");
+  compact_avatar_cache ();
+
+  /* the avatar we've just stored is kept, everything else has to go */
+  new_file = get_cached_avatar (f, "new-avatar", "new-avatar-token",
+      new_data);
+  tp_contact_avatar_cache_set_quota (sizeof (new_data));
+  g_assert_cmpuint (tp_contact_avatar_cache_get_quota (), ==,
+      sizeof (new_data));
+  compact_avatar_cache ();
+
+  g_assert (!g_file_query_exists (old_file, NULL));
+  g_assert (g_file_query_exists (new_file, NULL));
+  g_assert (tp_contact_avatar_cache_get_usage (&bytes, &n_images));
+  g_assert_cmpuint (n_images, ==, 1);
+  g_assert_cmpuint (bytes, ==, sizeof (new_data));
+
+  tp_contact_avatar_cache_set_quota (64 * 1024 * 1024);
+  g_object_unref (old_file);
+  g_object_unref (new_file);
+}
+
+static void
+test_avatar_cache_compaction (Fixture *f,
+    gconstpointer unused G_GNUC_UNUSED)
+{
+  const gchar * const foreign_token[] = { "foreign-avatar", "image/png",
+      NULL };
+  GFile *file;
+  GKeyFile *key_file;
+  gchar *index_path = build_avatar_cache_path ("index");
+  gchar *path;
+  gchar *hash;
+  gchar *contents;
+  gsize len;
+  GError *error = NULL;
+  guint64 bytes;
+  guint n_images, n_images_before;
+
+  g_message (G_STRFUNC);
+
+  file = get_cached_avatar (f, "compacted-avatar", "compacted-avatar-token",
+      "compacted-avatar");
+  hash = g_file_get_basename (file);
+  compact_avatar_cache ();
+  g_assert (tp_contact_avatar_cache_get_usage (NULL, &n_images_before));
+
+  /* another process stores an avatar and an image nobody refers to, and
+   * has since exited without saving a third */
+  write_avatar_cache_file ("foreign-avatar", "foreign", 2 * 60 * 60);
+  write_avatar_cache_file ("orphan-avatar", "orphan", 2 * 60 * 60);
+  write_avatar_cache_file ("stray-avatar", "stray", 2 * 60 * 60);
+  /* ... and is in the middle of storing a fourth */
+  write_avatar_cache_file ("recent-avatar", "recent", 0);
+
+  key_file = load_avatar_cache_index ();
+  g_key_file_set_int64 (key_file, "Images", "foreign-avatar",
+      g_get_real_time () / G_USEC_PER_SEC);
+  g_key_file_set_int64 (key_file, "Images", "orphan-avatar", 0);
+  g_key_file_set_string_list (key_file, "Tokens",
+      "other-cm/other-protocol/foreign_2davatar_2dtoken", foreign_token, 2);
+  contents = g_key_file_to_data (key_file, &len, NULL);
+  g_file_set_contents (index_path, contents, len, &error);
+  g_assert_no_error (error);
+  g_free (contents);
+  g_key_file_free (key_file);
+
+  g_assert_cmpuint (compact_avatar_cache (), ==,
+      sizeof ("orphan") - 1 + sizeof ("stray") - 1);
+
+  /* the other process's avatar survives, and so does ours */
+  g_assert (g_file_query_exists (file, NULL));
+  path = build_avatar_cache_path ("foreign-avatar");
+  g_assert (g_file_test (path, G_FILE_TEST_EXISTS));
+  g_free (path);
+
+  key_file = load_avatar_cache_index ();
+  g_assert (g_key_file_has_key (key_file, "Images", hash, NULL));
+  g_assert (g_key_file_has_key (key_file, "Images", "foreign-avatar", NULL));
+  g_assert (g_key_file_has_key (key_file, "Tokens",
+        "other-cm/other-protocol/foreign_2davatar_2dtoken", NULL));
+  g_assert (!g_key_file_has_key (key_file, "Images", "orphan-avatar", NULL));
+  g_key_file_free (key_file);
+
+  g_assert (tp_contact_avatar_cache_get_usage (&bytes, &n_images));
+  g_assert_cmpuint (n_images, ==, n_images_before + 1);
+
+  /* unreferenced and stray files are gone, apart from the recent one */
+  path = build_avatar_cache_path ("orphan-avatar");
+  g_assert (!g_file_test (path, G_FILE_TEST_EXISTS));
+  g_free (path);
+  path = build_avatar_cache_path ("stray-avatar");
+  g_assert (!g_file_test (path, G_FILE_TEST_EXISTS));
+  g_free (path);
+  path = build_avatar_cache_path ("recent-avatar");
+  g_assert (g_file_test (path, G_FILE_TEST_EXISTS));
+  g_unlink (path);
+  g_free (path);
+
+  g_free (hash);
+  g_free (index_path);
+  g_object_unref (file);
+}
+
 static void
 test_by_handle (Fixture *f,
     gconstpointer unused G_GNUC_UNUSED)
@@ -1002,6 +1464,71 @@ test_by_handle_again (Fixture *f,
   g_main_loop_unref (result.loop);
 }
 
+static void
+test_by_handle_batched (Fixture *f,
+    gconstpointer unused G_GNUC_UNUSED)
+{
+  GMainLoop *loop = g_main_loop_new (NULL, FALSE);
+  Result results[2] = { { loop, NULL, NULL, NULL }, { loop, NULL, NULL, NULL } };
+  TpHandle handles[3];
+  TpContactFeature alias_feature = TP_CONTACT_FEATURE_ALIAS;
+  TpContactFeature presence_feature = TP_CONTACT_FEATURE_PRESENCE;
+  TpContact *bob;
+  guint i;
+
+  handles[0] = get_handle_with_no_caps (f, "alice");
+  handles[1] = get_handle_with_no_caps (f, "bob");
+  handles[2] = get_handle_with_no_caps (f, "chris");
+
+  /* two overlapping requests, made in the same main loop iteration, for
+   * different features: they're merged into one D-Bus call, but each must
+   * get its own contacts, with the features it asked for */
+  tp_connection_get_contacts_by_handle (f->client_conn,
+      2, handles, 1, &alias_feature,
+      by_handle_cb, &results[0], NULL, NULL);
+  tp_connection_get_contacts_by_handle (f->client_conn,
+      2, handles + 1, 1, &presence_feature,
+      by_handle_cb, &results[1], NULL, NULL);
+
+  /* by_handle_cb doesn't quit the loop, so poll for completion */
+  while (results[0].contacts == NULL || results[1].contacts == NULL)
+    {
+      g_assert_no_error (results[0].error);
+      g_assert_no_error (results[1].error);
+      g_main_context_iteration (NULL, TRUE);
+    }
+
+  g_assert_cmpuint (results[0].contacts->len, ==, 2);
+  g_assert_cmpuint (results[0].invalid->len, ==, 0);
+  g_assert_cmpuint (results[1].contacts->len, ==, 2);
+  g_assert_cmpuint (results[1].invalid->len, ==, 0);
+
+  for (i = 0; i < 2; i++)
+    {
+      TpContact *contact = g_ptr_array_index (results[0].contacts, i);
+
+      g_assert_cmpuint (tp_contact_get_handle (contact), ==, handles[i]);
+      g_assert (tp_contact_has_feature (contact, TP_CONTACT_FEATURE_ALIAS));
+
+      contact = g_ptr_array_index (results[1].contacts, i);
+
+      g_assert_cmpuint (tp_contact_get_handle (contact), ==, handles[i + 1]);
+      g_assert (tp_contact_has_feature (contact,
+            TP_CONTACT_FEATURE_PRESENCE));
+    }
+
+  /* bob was in both requests, and is the same object */
+  bob = g_ptr_array_index (results[0].contacts, 1);
+  g_assert (bob == g_ptr_array_index (results[1].contacts, 0));
+  g_assert (tp_contact_has_feature (bob, TP_CONTACT_FEATURE_ALIAS));
+  g_assert (tp_contact_has_feature (bob, TP_CONTACT_FEATURE_PRESENCE));
+
+  reset_result (&results[0]);
+  reset_result (&results[1]);
+  tp_tests_proxy_run_until_dbus_queue_processed (f->client_conn);
+  g_main_loop_unref (loop);
+}
+
 static void
 test_by_handle_upgrade (Fixture *f,
     gconstpointer unused G_GNUC_UNUSED)
@@ -1466,6 +1993,200 @@ test_upgrade (Fixture *f,
   g_main_loop_unref (result.loop);
 }
 
+static void
+test_shared_strings (Fixture *f,
+    gconstpointer unused G_GNUC_UNUSED)
+{
+  Result result = { g_main_loop_new (NULL, FALSE), NULL, NULL, NULL };
+  TpHandleRepoIface *service_repo = tp_base_connection_get_handles (
+      (TpBaseConnection *) f->service_conn, TP_HANDLE_TYPE_CONTACT);
+  TpHandle handles[] = { 0, 0 };
+  static const gchar * const ids[] = { "shared-1", "shared-2" };
+  static TpTestsContactsConnectionPresenceStatusIndex statuses[] = {
+      TP_TESTS_CONTACTS_CONNECTION_STATUS_AWAY,
+      TP_TESTS_CONTACTS_CONNECTION_STATUS_AWAY };
+  static const gchar * const messages[] = { "At lunch", "At lunch" };
+  static TpTestsContactsConnectionPresenceStatusIndex new_status =
+      TP_TESTS_CONTACTS_CONNECTION_STATUS_BUSY;
+  static const gchar * const new_message = "Back to work";
+  TpContactFeature feature = TP_CONTACT_FEATURE_PRESENCE;
+  TpContact *contacts[2];
+  guint i;
+
+  g_message (G_STRFUNC);
+
+  for (i = 0; i < 2; i++)
+    handles[i] = tp_handle_ensure (service_repo, ids[i], NULL, NULL);
+
+  tp_tests_contacts_connection_change_presences (f->service_conn, 2, handles,
+      statuses, messages);
+
+  tp_connection_get_contacts_by_handle (f->client_conn,
+      2, handles,
+      1, &feature,
+      by_handle_cb,
+      &result, finish, NULL);
+  g_main_loop_run (result.loop);
+  g_assert_no_error (result.error);
+  g_assert_cmpuint (result.contacts->len, ==, 2);
+
+  for (i = 0; i < 2; i++)
+    contacts[i] = g_object_ref (g_ptr_array_index (result.contacts, i));
+
+  /* both contacts use the same copy of each string */
+  g_assert_cmpstr (tp_contact_get_presence_status (contacts[0]), ==, "away");
+  g_assert (tp_contact_get_presence_status (contacts[0]) ==
+      tp_contact_get_presence_status (contacts[1]));
+  g_assert_cmpstr (tp_contact_get_presence_message (contacts[0]), ==,
+      "At lunch");
+  g_assert (tp_contact_get_presence_message (contacts[0]) ==
+      tp_contact_get_presence_message (contacts[1]));
+
+  /* changing one of them leaves the other alone */
+  tp_tests_contacts_connection_change_presences (f->service_conn, 1, handles,
+      &new_status, &new_message);
+  tp_tests_proxy_run_until_dbus_queue_processed (f->client_conn);
+
+  g_assert_cmpstr (tp_contact_get_presence_status (contacts[0]), ==, "busy");
+  g_assert_cmpstr (tp_contact_get_presence_message (contacts[0]), ==,
+      "Back to work");
+  g_assert_cmpstr (tp_contact_get_presence_status (contacts[1]), ==, "away");
+  g_assert_cmpstr (tp_contact_get_presence_message (contacts[1]), ==,
+      "At lunch");
+
+  /* contacts with no location, client types or contact info have none */
+  g_assert (tp_contact_get_location (contacts[1]) == NULL);
+  g_assert (tp_contact_get_client_types (contacts[1]) == NULL);
+
+  for (i = 0; i < 2; i++)
+    {
+      g_object_unref (contacts[i]);
+      tp_handle_unref (service_repo, handles[i]);
+    }
+
+  reset_result (&result);
+  g_main_loop_unref (result.loop);
+}
+
+typedef struct {
+    guint n_emissions;
+    GPtrArray *contacts;
+    GArray *flags;
+} ContactsChangedData;
+
+static void
+contacts_changed_cb (TpConnection *connection,
+    GPtrArray *contacts,
+    GArray *flags,
+    ContactsChangedData *data)
+{
+  g_assert_cmpuint (contacts->len, ==, flags->len);
+
+  data->n_emissions++;
+  tp_clear_pointer (&data->contacts, g_ptr_array_unref);
+  tp_clear_pointer (&data->flags, g_array_unref);
+  data->contacts = g_ptr_array_ref (contacts);
+  data->flags = g_array_ref (flags);
+}
+
+static void
+count_notify_cb (GObject *object,
+    GParamSpec *pspec,
+    guint *count)
+{
+  (*count)++;
+}
+
+static void
+test_contacts_changed (Fixture *f,
+    gconstpointer unused G_GNUC_UNUSED)
+{
+  Result result = { g_main_loop_new (NULL, FALSE), NULL, NULL, NULL };
+  TpHandleRepoIface *service_repo = tp_base_connection_get_handles (
+      (TpBaseConnection *) f->service_conn, TP_HANDLE_TYPE_CONTACT);
+  TpHandle handles[] = { 0, 0 };
+  static const gchar * const ids[] = { "batched-1", "batched-2" };
+  static TpTestsContactsConnectionPresenceStatusIndex statuses[] = {
+      TP_TESTS_CONTACTS_CONNECTION_STATUS_BUSY,
+      TP_TESTS_CONTACTS_CONNECTION_STATUS_AWAY };
+  static const gchar * const messages[] = { "Busy", "Away" };
+  TpContactFeature feature = TP_CONTACT_FEATURE_PRESENCE;
+  ContactsChangedData data = { 0, NULL, NULL };
+  guint n_notifies = 0;
+  TpContact *contacts[2];
+  guint i;
+
+  g_message (G_STRFUNC);
+
+  for (i = 0; i < 2; i++)
+    handles[i] = tp_handle_ensure (service_repo, ids[i], NULL, NULL);
+
+  tp_connection_get_contacts_by_handle (f->client_conn,
+      2, handles,
+      1, &feature,
+      by_handle_cb,
+      &result, finish, NULL);
+  g_main_loop_run (result.loop);
+  g_assert_no_error (result.error);
+  g_assert_cmpuint (result.contacts->len, ==, 2);
+
+  for (i = 0; i < 2; i++)
+    {
+      contacts[i] = g_object_ref (g_ptr_array_index (result.contacts, i));
+      g_signal_connect (contacts[i], "notify::presence-status",
+          G_CALLBACK (count_notify_cb), &n_notifies);
+    }
+
+  g_signal_connect (f->client_conn, "contacts-changed",
+      G_CALLBACK (contacts_changed_cb), &data);
+
+  /* by default, both the batched signal and the notifications are emitted */
+  tp_tests_contacts_connection_change_presences (f->service_conn, 2, handles,
+      statuses, messages);
+  tp_tests_proxy_run_until_dbus_queue_processed (f->client_conn);
+
+  g_assert_cmpuint (data.n_emissions, ==, 1);
+  g_assert_cmpuint (data.contacts->len, ==, 2);
+  g_assert_cmpuint (n_notifies, ==, 2);
+
+  for (i = 0; i < 2; i++)
+    {
+      g_assert (tp_g_ptr_array_contains (data.contacts, contacts[i]));
+      g_assert_cmpuint (g_array_index (data.flags, TpContactChangeFlags, i),
+          ==, TP_CONTACT_CHANGE_PRESENCE);
+    }
+
+  /* once batching is turned on, the contacts stay quiet */
+  tp_simple_client_factory_set_batch_contact_changes (
+      tp_proxy_get_factory (f->client_conn), TRUE);
+
+  tp_tests_contacts_connection_change_presences (f->service_conn, 1, handles,
+      statuses + 1, messages + 1);
+  tp_tests_proxy_run_until_dbus_queue_processed (f->client_conn);
+
+  g_assert_cmpuint (data.n_emissions, ==, 2);
+  g_assert_cmpuint (data.contacts->len, ==, 1);
+  g_assert (g_ptr_array_index (data.contacts, 0) == contacts[0]);
+  g_assert_cmpuint (n_notifies, ==, 2);
+  g_assert_cmpstr (tp_contact_get_presence_status (contacts[0]), ==, "away");
+
+  g_signal_handlers_disconnect_by_func (f->client_conn, contacts_changed_cb,
+      &data);
+
+  for (i = 0; i < 2; i++)
+    {
+      g_signal_handlers_disconnect_by_func (contacts[i], count_notify_cb,
+          &n_notifies);
+      g_object_unref (contacts[i]);
+      tp_handle_unref (service_repo, handles[i]);
+    }
+
+  tp_clear_pointer (&data.contacts, g_ptr_array_unref);
+  tp_clear_pointer (&data.flags, g_array_unref);
+  reset_result (&result);
+  g_main_loop_unref (result.loop);
+}
+
 /* Regression test case for fd.o#41414 */
 static void
 test_upgrade_noop (Fixture *f,
@@ -2188,6 +2909,131 @@ test_prepare_contact_caps_without_request (Fixture *f,
   g_main_loop_unref (result.loop);
 }
 
+static void
+capture_debug (const gchar *log_domain,
+    GLogLevelFlags log_level,
+    const gchar *message,
+    gpointer user_data)
+{
+  GString *debug = user_data;
+
+  g_string_append (debug, message);
+  g_string_append_c (debug, '\n');
+}
+
+static void
+assert_simple_presence (GHashTable *presences,
+    TpHandle handle,
+    const gchar *status,
+    const gchar *message)
+{
+  GValueArray *presence = g_hash_table_lookup (presences,
+      GUINT_TO_POINTER (handle));
+  guint type;
+  const gchar *got_status, *got_message;
+
+  g_assert (presence != NULL);
+  tp_value_array_unpack (presence, 3, &type, &got_status, &got_message);
+  g_assert_cmpstr (got_status, ==, status);
+  g_assert_cmpstr (got_message, ==, message);
+}
+
+static void
+test_presence_cache (Fixture *f,
+    gconstpointer unused G_GNUC_UNUSED)
+{
+  static const gchar * const ids[] = { "alice", "bob" };
+  static TpTestsContactsConnectionPresenceStatusIndex statuses[] = {
+      TP_TESTS_CONTACTS_CONNECTION_STATUS_BUSY,
+      TP_TESTS_CONTACTS_CONNECTION_STATUS_AWAY };
+  static const gchar * const messages[] = { "Fixing bugs", "At lunch" };
+  static const gchar *interfaces[] = {
+      TP_IFACE_CONNECTION_INTERFACE_SIMPLE_PRESENCE, NULL };
+  GString *debug = g_string_new ("");
+  guint handler_id;
+  TpHandle handles[2];
+  GArray *contacts;
+  GHashTable *presences;
+  GError *error = NULL;
+  guint i;
+
+  contacts = g_array_new (FALSE, FALSE, sizeof (TpHandle));
+
+  for (i = 0; i < 2; i++)
+    {
+      handles[i] = tp_handle_ensure (f->service_repo, ids[i], NULL, NULL);
+      g_array_append_val (contacts, handles[i]);
+    }
+
+  handler_id = g_log_set_handler ("tp-glib/presence", G_LOG_LEVEL_DEBUG,
+      capture_debug, debug);
+
+  /* The first time, the connection has to be asked... */
+  tp_cli_connection_interface_simple_presence_run_get_presences (
+      f->client_conn, -1, contacts, &presences, &error, NULL);
+  g_assert_no_error (error);
+  g_assert_cmpuint (g_hash_table_size (presences), ==, 2);
+  assert_simple_presence (presences, handles[0], "available", "");
+  g_hash_table_unref (presences);
+  g_assert (strstr (debug->str, "0 of 2 contacts cached") != NULL);
+
+  /* ... but not again */
+  g_string_truncate (debug, 0);
+  tp_cli_connection_interface_simple_presence_run_get_presences (
+      f->client_conn, -1, contacts, &presences, &error, NULL);
+  g_assert_no_error (error);
+  g_assert_cmpuint (g_hash_table_size (presences), ==, 2);
+  assert_simple_presence (presences, handles[0], "available", "");
+  assert_simple_presence (presences, handles[1], "available", "");
+  g_hash_table_unref (presences);
+  g_assert (strstr (debug->str, "2 of 2 contacts cached") != NULL);
+
+  /* A presence update replaces what was cached, so the new presence is
+   * returned without asking the connection again */
+  tp_tests_contacts_connection_change_presences (f->service_conn, 1,
+      handles, statuses, messages);
+
+  g_string_truncate (debug, 0);
+  tp_cli_connection_interface_simple_presence_run_get_presences (
+      f->client_conn, -1, contacts, &presences, &error, NULL);
+  g_assert_no_error (error);
+  assert_simple_presence (presences, handles[0], "busy", "Fixing bugs");
+  assert_simple_presence (presences, handles[1], "available", "");
+  g_hash_table_unref (presences);
+  g_assert (strstr (debug->str, "2 of 2 contacts cached") != NULL);
+
+  /* and so is the contact attribute */
+  tp_tests_contacts_connection_change_presences (f->service_conn, 2,
+      handles, statuses, messages);
+  tp_cli_connection_interface_contacts_run_get_contact_attributes (
+      f->client_conn, -1, contacts, interfaces, FALSE, &presences, &error,
+      NULL);
+  g_assert_no_error (error);
+
+  for (i = 0; i < 2; i++)
+    {
+      GHashTable *attrs = g_hash_table_lookup (presences,
+          GUINT_TO_POINTER (handles[i]));
+      GValueArray *presence;
+      const gchar *status, *message;
+      guint type;
+
+      g_assert (attrs != NULL);
+      presence = tp_asv_get_boxed (attrs,
+          TP_TOKEN_CONNECTION_INTERFACE_SIMPLE_PRESENCE_PRESENCE,
+          TP_STRUCT_TYPE_SIMPLE_PRESENCE);
+      g_assert (presence != NULL);
+      tp_value_array_unpack (presence, 3, &type, &status, &message);
+      g_assert_cmpstr (message, ==, messages[i]);
+    }
+
+  g_hash_table_unref (presences);
+
+  g_log_remove_handler ("tp-glib/presence", handler_id);
+  g_string_free (debug, TRUE);
+  g_array_unref (contacts);
+}
+
 static void
 test_dup_if_possible (Fixture *f,
     gconstpointer unused G_GNUC_UNUSED)
@@ -3032,17 +3878,26 @@ main (int argc,
 
   ADD (by_handle);
   ADD (by_handle_again);
+  ADD (by_handle_batched);
   ADD (by_handle_upgrade);
   ADD (no_features);
   ADD (features);
   ADD (upgrade);
   ADD (upgrade_noop);
+  ADD (shared_strings);
+  ADD (contacts_changed);
   ADD (by_id);
   ADD (avatar_requirements);
   ADD (avatar_data);
   ADD (avatar_data_after_token);
+  ADD (avatar_request_pacing);
+  ADD (avatar_cache_store_lookup);
+  ADD (avatar_cache_eviction);
+  ADD (avatar_cache_compaction);
   ADD (contact_info);
+  ADD (contact_info_batched);
   ADD (dup_if_possible);
+  ADD (presence_cache);
   ADD (subscription_states);
   ADD (contact_groups);
 
@@ -10,7 +10,9 @@
 
 #include "config.h"
 
+#include <errno.h>
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <string.h>
 
 #include <telepathy-glib/file-transfer-channel.h>
@@ -18,6 +20,8 @@
 #include <telepathy-glib/defs.h>
 #include <telepathy-glib/dbus.h>
 
+#include "telepathy-glib/file-transfer-channel-internal.h"
+
 #include "tests/lib/util.h"
 #include "tests/lib/debug.h"
 #include "tests/lib/simple-conn.h"
@@ -57,6 +61,7 @@ typedef struct {
 
     GError *error /* initialized where needed */;
     gint wait;
+    guint n_progress_notified;
 } Test;
 
 
@@ -74,6 +79,14 @@ state_notify_cb (GObject *source,
     g_main_loop_quit (test->mainloop);
 }
 
+static void
+transferred_bytes_notify_cb (GObject *source,
+    GParamSpec *pspec,
+    Test *test)
+{
+  test->n_progress_notified++;
+}
+
 static void
 channel_prepared_cb (GObject *source,
     GAsyncResult *result,
@@ -306,6 +319,48 @@ test_context_to_str (TestContext *ctx,
   return g_strdup_printf ("%s/%s/%s", base, socket, access_control);
 }
 
+static void
+capture_debug (const gchar *log_domain,
+    GLogLevelFlags log_level,
+    const gchar *message,
+    gpointer user_data)
+{
+  GString *debug = user_data;
+
+  g_string_append (debug, message);
+  g_string_append_c (debug, '\n');
+}
+
+/* Some bytes which don't repeat every power of two */
+static GBytes *
+make_content (gsize size)
+{
+  guchar *data = g_malloc (size);
+  gsize i;
+
+  for (i = 0; i < size; i++)
+    data[i] = i % 251;
+
+  return g_bytes_new_take (data, size);
+}
+
+static gboolean
+file_has_content (const gchar *path,
+    GBytes *content)
+{
+  gchar *data;
+  gsize len;
+  gboolean ret;
+
+  if (!g_file_get_contents (path, &data, &len, NULL))
+    return FALSE;
+
+  ret = (len == g_bytes_get_size (content) &&
+      memcmp (data, g_bytes_get_data (content, NULL), len) == 0);
+  g_free (data);
+  return ret;
+}
+
 static void
 socket_connected (GObject *source,
     GAsyncResult *result,
@@ -421,6 +476,16 @@ test_properties (Test *test,
   g_assert_cmpuint (g_strv_length ((GStrv) metadata_values), ==, 1);
   g_assert_cmpstr (metadata_values[0], ==, "cheese");
 
+  /* not a D-Bus property, but it has a getter all the same */
+  g_assert_cmpuint (tp_file_transfer_channel_get_buffer_size (test->channel),
+      ==, 256 * 1024);
+  tp_file_transfer_channel_set_buffer_size (test->channel, 3);
+  g_assert_cmpuint (tp_file_transfer_channel_get_buffer_size (test->channel),
+      ==, 3);
+  tp_file_transfer_channel_set_buffer_size (test->channel, 0);
+  g_assert_cmpuint (tp_file_transfer_channel_get_buffer_size (test->channel),
+      ==, 256 * 1024);
+
   error = tp_proxy_get_invalidated (test->channel);
   g_assert_no_error (error);
 }
@@ -445,6 +510,9 @@ test_provide_success (Test *test,
   /* not very pretty */
   g_file_set_contents ("/tmp/file-transfer", "test", -1, NULL);
 
+  /* move the file a byte or two at a time, if it's moved by the kernel */
+  tp_file_transfer_channel_set_buffer_size (test->channel, 2);
+
   file = g_file_new_for_uri ("file:///tmp/file-transfer");
   tp_file_transfer_channel_provide_file_async (test->channel,
       file, file_provide_cb, test);
@@ -580,6 +648,212 @@ test_accept_outgoing (Test *test, gconstpointer data G_GNUC_UNUSED)
   g_assert_error (test->error, TP_ERROR, TP_ERROR_INVALID_ARGUMENT);
 }
 
+/* Move a file a few KiB at a time, by sendfile() if possible. If @data is
+ * an errno, sendfile() fails with it, and we fall back to copying the file
+ * through the main loop */
+static void
+test_provide_content (Test *test,
+    gconstpointer data)
+{
+  int errsv = GPOINTER_TO_INT (data);
+  GString *debug = g_string_new ("");
+  guint handler_id;
+  GBytes *content, *received;
+  gchar *dir, *path;
+  GFile *file;
+  TpFileTransferStateChangeReason reason;
+
+  handler_id = g_log_set_handler ("tp-glib/channel", G_LOG_LEVEL_DEBUG,
+      capture_debug, debug);
+
+  create_file_transfer_channel (test, TRUE, TP_SOCKET_ADDRESS_TYPE_UNIX,
+      TP_SOCKET_ACCESS_CONTROL_LOCALHOST);
+
+  dir = g_dir_make_tmp ("tp-glib-tests.XXXXXX", &test->error);
+  g_assert_no_error (test->error);
+  path = g_build_filename (dir, "provided", NULL);
+
+  content = make_content (100000);
+  g_file_set_contents (path, g_bytes_get_data (content, NULL),
+      g_bytes_get_size (content), &test->error);
+  g_assert_no_error (test->error);
+
+  tp_file_transfer_channel_set_buffer_size (test->channel, 4096);
+  _tp_file_transfer_channel_set_zero_copy_error (test->channel, errsv);
+
+  file = g_file_new_for_path (path);
+  tp_file_transfer_channel_provide_file_async (test->channel,
+      file, file_provide_cb, test);
+  g_object_unref (file);
+
+  test->wait = 1;
+  g_main_loop_run (test->mainloop);
+  g_assert_no_error (test->error);
+
+  g_signal_connect (test->channel, "notify::state",
+      G_CALLBACK (state_notify_cb), test);
+
+  test->wait = 1;
+  g_main_loop_run (test->mainloop);
+  g_assert_cmpuint (tp_file_transfer_channel_get_state (test->channel, &reason),
+      ==, TP_FILE_TRANSFER_STATE_OPEN);
+
+  /* the CM has everything once we hang up */
+  while (tp_tests_file_transfer_channel_get_received (
+        test->chan_service) == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  received = tp_tests_file_transfer_channel_get_received (test->chan_service);
+  g_assert (g_bytes_equal (received, content));
+
+#if defined(HAVE_GIO_UNIX) && defined(HAVE_SYS_SENDFILE_H) && \
+    defined(HAVE_SENDFILE)
+  g_assert (strstr (debug->str, "sending with sendfile()") != NULL);
+
+  if (errsv != 0)
+    g_assert (strstr (debug->str, "falling back") != NULL);
+  else
+    g_assert (strstr (debug->str, "falling back") == NULL);
+#endif
+
+  g_unlink (path);
+  g_rmdir (dir);
+  g_free (path);
+  g_free (dir);
+  g_bytes_unref (content);
+  g_log_remove_handler ("tp-glib/channel", handler_id);
+  g_string_free (debug, TRUE);
+}
+
+/* The same, receiving through splice() */
+static void
+test_accept_content (Test *test,
+    gconstpointer data)
+{
+  int errsv = GPOINTER_TO_INT (data);
+  GString *debug = g_string_new ("");
+  guint handler_id;
+  GBytes *content;
+  gchar *dir, *path;
+  GFile *file;
+  TpFileTransferStateChangeReason reason;
+
+  handler_id = g_log_set_handler ("tp-glib/channel", G_LOG_LEVEL_DEBUG,
+      capture_debug, debug);
+
+  create_file_transfer_channel (test, FALSE, TP_SOCKET_ADDRESS_TYPE_UNIX,
+      TP_SOCKET_ACCESS_CONTROL_LOCALHOST);
+
+  dir = g_dir_make_tmp ("tp-glib-tests.XXXXXX", &test->error);
+  g_assert_no_error (test->error);
+  path = g_build_filename (dir, "accepted", NULL);
+
+  content = make_content (100000);
+  tp_tests_file_transfer_channel_set_content (test->chan_service, content);
+
+  tp_file_transfer_channel_set_buffer_size (test->channel, 4096);
+  _tp_file_transfer_channel_set_zero_copy_error (test->channel, errsv);
+
+  file = g_file_new_for_path (path);
+  tp_file_transfer_channel_accept_file_async (test->channel,
+      file, 0, file_accept_cb, test);
+  g_object_unref (file);
+
+  test->wait = 1;
+  g_main_loop_run (test->mainloop);
+  g_assert_no_error (test->error);
+
+  g_signal_connect (test->channel, "notify::state",
+      G_CALLBACK (state_notify_cb), test);
+
+  test->wait = 1;
+  g_main_loop_run (test->mainloop);
+  g_assert_cmpuint (tp_file_transfer_channel_get_state (test->channel, &reason),
+      ==, TP_FILE_TRANSFER_STATE_OPEN);
+
+  /* the CM hangs up once it has sent everything; by the time we've dealt
+   * with that, the whole file has been written */
+  while (!file_has_content (path, content))
+    g_main_context_iteration (NULL, TRUE);
+
+#if defined(HAVE_GIO_UNIX) && defined(HAVE_SPLICE)
+  g_assert (strstr (debug->str, "receiving with splice()") != NULL);
+
+  if (errsv != 0)
+    g_assert (strstr (debug->str, "falling back") != NULL);
+  else
+    g_assert (strstr (debug->str, "falling back") == NULL);
+#endif
+
+  g_unlink (path);
+  g_rmdir (dir);
+  g_free (path);
+  g_free (dir);
+  g_bytes_unref (content);
+  g_log_remove_handler ("tp-glib/channel", handler_id);
+  g_string_free (debug, TRUE);
+}
+
+static void
+test_progress (Test *test,
+    gconstpointer data G_GNUC_UNUSED)
+{
+  create_file_transfer_channel (test, FALSE, TP_SOCKET_ADDRESS_TYPE_UNIX,
+      TP_SOCKET_ACCESS_CONTROL_LOCALHOST);
+
+  g_assert_cmpuint (tp_file_transfer_channel_get_throughput (test->channel),
+      ==, 0);
+  g_assert_cmpint (
+      tp_file_transfer_channel_get_estimated_time_remaining (test->channel),
+      ==, -1);
+
+  g_signal_connect (test->channel, "notify::transferred-bytes",
+      G_CALLBACK (transferred_bytes_notify_cb), test);
+
+  /* The CM emits the first count straight away, and then only the latest
+   * one when the interval is over */
+  tp_tests_file_transfer_channel_set_transferred_bytes (test->chan_service,
+      100, 100);
+  tp_tests_file_transfer_channel_set_transferred_bytes (test->chan_service,
+      200, 100);
+  tp_tests_file_transfer_channel_set_transferred_bytes (test->chan_service,
+      300, 100);
+
+  while (tp_file_transfer_channel_get_transferred_bytes (test->channel) != 300)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert_cmpuint (test->n_progress_notified, ==, 2);
+
+  /* 200 bytes in about 100ms, with 8701 to go */
+  g_assert_cmpuint (tp_file_transfer_channel_get_throughput (test->channel),
+      >, 0);
+  g_assert_cmpint (
+      tp_file_transfer_channel_get_estimated_time_remaining (test->channel),
+      >, 0);
+
+  /* Now the CM emits everything, but we hold the notifications back */
+  g_assert_cmpuint (
+      tp_file_transfer_channel_get_progress_interval (test->channel), ==, 0);
+  tp_file_transfer_channel_set_progress_interval (test->channel, 10000);
+  g_assert_cmpuint (
+      tp_file_transfer_channel_get_progress_interval (test->channel),
+      ==, 10000);
+
+  tp_tests_file_transfer_channel_set_transferred_bytes (test->chan_service,
+      400, 0);
+  tp_tests_file_transfer_channel_set_transferred_bytes (test->chan_service,
+      500, 0);
+  tp_tests_proxy_run_until_dbus_queue_processed (test->channel);
+
+  g_assert_cmpuint (tp_file_transfer_channel_get_transferred_bytes (
+        test->channel), ==, 500);
+  g_assert_cmpuint (test->n_progress_notified, ==, 2);
+
+  /* which are released when we stop throttling them */
+  tp_file_transfer_channel_set_progress_interval (test->channel, 0);
+  g_assert_cmpuint (test->n_progress_notified, ==, 3);
+}
+
 int
 main (int argc,
       char **argv)
@@ -604,6 +878,18 @@ main (int argc,
   run_file_transfer_test ("/file-transfer-channel/provide/success",
       test_provide_success);
 
+  /* Check the data itself, however it is moved */
+  g_test_add ("/file-transfer-channel/provide/content", Test,
+      GINT_TO_POINTER (0), setup, test_provide_content, teardown);
+  g_test_add ("/file-transfer-channel/provide/content/einval", Test,
+      GINT_TO_POINTER (EINVAL), setup, test_provide_content, teardown);
+  g_test_add ("/file-transfer-channel/accept/content", Test,
+      GINT_TO_POINTER (0), setup, test_accept_content, teardown);
+  g_test_add ("/file-transfer-channel/accept/content/einval", Test,
+      GINT_TO_POINTER (EINVAL), setup, test_accept_content, teardown);
+  g_test_add ("/file-transfer-channel/accept/content/enosys", Test,
+      GINT_TO_POINTER (ENOSYS), setup, test_accept_content, teardown);
+
   /* Test edge cases */
   /* FIXME: accept_twice has to be after provide/accept_success */
   g_test_add ("/file-transfer-channel/accept/twice", Test, NULL, setup,
@@ -612,6 +898,8 @@ main (int argc,
       test_accept_outgoing, teardown);
   g_test_add ("/file-transfer-channel/provide/cancel", Test, NULL, setup,
       test_cancel_transfer, teardown);
+  g_test_add ("/file-transfer-channel/progress", Test, NULL, setup,
+      test_progress, teardown);
 
   return tp_tests_run_with_bus ();
 }
@@ -10,6 +10,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <telepathy-glib/channel.h>
 #include <telepathy-glib/connection.h>
 #include <telepathy-glib/dbus.h>
@@ -42,6 +44,10 @@ static TpHandle expected_actor;
 static TpChannelGroupChangeReason expected_reason;
 static diff_checker expected_diffs;
 
+/* In large-room mode: MembersChangedDetailed signals received, as
+ * GValueArrays of (added, removed, local_pending, remote_pending, details) */
+static GPtrArray *batches = NULL;
+
 static void
 expect_signals (const gchar *message,
                 TpHandle actor,
@@ -111,6 +117,18 @@ on_members_changed_detailed (TpChannel *proxy,
   TpChannelGroupChangeReason reason;
   gboolean valid;
 
+  if (batches != NULL)
+    {
+      g_ptr_array_add (batches, tp_value_array_build (5,
+            DBUS_TYPE_G_UINT_ARRAY, arg_Added,
+            DBUS_TYPE_G_UINT_ARRAY, arg_Removed,
+            DBUS_TYPE_G_UINT_ARRAY, arg_Local_Pending,
+            DBUS_TYPE_G_UINT_ARRAY, arg_Remote_Pending,
+            TP_HASH_TYPE_STRING_VARIANT_MAP, arg_Details,
+            G_TYPE_INVALID));
+      return;
+    }
+
   MYASSERT (expecting_members_changed_detailed,
       ": got unexpected MembersChangedDetailed");
   expecting_members_changed_detailed = FALSE;
@@ -489,6 +507,187 @@ in_the_desert (void)
   tp_handle_unref (contact_repo, camel2);
 }
 
+static void
+capture_debug (const gchar *log_domain,
+    GLogLevelFlags log_level,
+    const gchar *message,
+    gpointer user_data)
+{
+  GString *debug = user_data;
+
+  g_string_append (debug, message);
+  g_string_append_c (debug, '\n');
+}
+
+/* Check that batch number @i added @n_added handles starting with the
+ * @first_added'th of @herd, and so on, and carried IDs for exactly the
+ * handles it added or made pending */
+static void
+check_batch (guint i,
+    const TpHandle *herd,
+    guint first_added,
+    guint n_added,
+    guint first_removed,
+    guint n_removed,
+    guint first_local,
+    guint n_local)
+{
+  GValueArray *batch = g_ptr_array_index (batches, i);
+  const GArray *added, *removed, *local_pending, *remote_pending;
+  GHashTable *details, *contact_ids;
+  guint j;
+
+  tp_value_array_unpack (batch, 5, &added, &removed, &local_pending,
+      &remote_pending, &details);
+
+  g_assert_cmpuint (added->len, ==, n_added);
+  g_assert_cmpuint (removed->len, ==, n_removed);
+  g_assert_cmpuint (local_pending->len, ==, n_local);
+  g_assert_cmpuint (remote_pending->len, ==, 0);
+
+  for (j = 0; j < n_added; j++)
+    g_assert_cmpuint (g_array_index (added, TpHandle, j), ==,
+        herd[first_added + j]);
+
+  for (j = 0; j < n_removed; j++)
+    g_assert_cmpuint (g_array_index (removed, TpHandle, j), ==,
+        herd[first_removed + j]);
+
+  for (j = 0; j < n_local; j++)
+    g_assert_cmpuint (g_array_index (local_pending, TpHandle, j), ==,
+        herd[first_local + j]);
+
+  contact_ids = tp_asv_get_boxed (details, "contact-ids",
+      TP_HASH_TYPE_HANDLE_IDENTIFIER_MAP);
+
+  if (n_added + n_local == 0)
+    {
+      MYASSERT (contact_ids == NULL || g_hash_table_size (contact_ids) == 0,
+          "");
+      return;
+    }
+
+  g_assert (contact_ids != NULL);
+  g_assert_cmpuint (g_hash_table_size (contact_ids), ==, n_added + n_local);
+
+  for (j = 0; j < n_added; j++)
+    g_assert (g_hash_table_lookup (contact_ids,
+          GUINT_TO_POINTER (herd[first_added + j])) != NULL);
+
+  for (j = 0; j < n_local; j++)
+    g_assert (g_hash_table_lookup (contact_ids,
+          GUINT_TO_POINTER (herd[first_local + j])) != NULL);
+}
+
+#define HERD_SIZE 16
+
+static void
+large_room (void)
+{
+  TpHandle herd[HERD_SIZE];
+  TpIntset *add, *del, *local_pending;
+  GString *debug = g_string_new ("");
+  guint handler_id;
+  guint i;
+
+  /* Handles are allocated in order, so the arrays in the signals are in
+   * the same order as herd */
+  for (i = 0; i < HERD_SIZE; i++)
+    {
+      gchar *id = g_strdup_printf ("herd%02u", i);
+
+      herd[i] = tp_handle_ensure (contact_repo, id, NULL, NULL);
+      g_free (id);
+
+      if (i > 0)
+        g_assert_cmpuint (herd[i], >, herd[i - 1]);
+    }
+
+  /* on_members_changed() will complain if the deprecated signal is still
+   * emitted */
+  tp_group_mixin_enable_large_room_mode ((GObject *) service_chan, 4);
+  batches = g_ptr_array_new_with_free_func (
+      (GDestroyNotify) g_value_array_free);
+
+  handler_id = g_log_set_handler ("tp-glib/groups", G_LOG_LEVEL_DEBUG,
+      capture_debug, debug);
+
+  /* 14 new members: 4 + 4 + 4 + 2 */
+  add = tp_intset_new ();
+
+  for (i = 0; i < 14; i++)
+    tp_intset_add (add, herd[i]);
+
+  tp_group_mixin_change_members ((GObject *) service_chan, NULL, add, NULL,
+      NULL, NULL, 0, TP_CHANNEL_GROUP_CHANGE_REASON_NONE);
+  tp_tests_proxy_run_until_dbus_queue_processed (chan);
+
+  g_assert_cmpuint (batches->len, ==, 4);
+  check_batch (0, herd, 0, 4, 0, 0, 0, 0);
+  check_batch (1, herd, 4, 4, 0, 0, 0, 0);
+  check_batch (2, herd, 8, 4, 0, 0, 0, 0);
+  check_batch (3, herd, 12, 2, 0, 0, 0, 0);
+
+  /* Each batch is logged separately, and none is big enough to be
+   * truncated */
+  g_assert (strstr (debug->str, "(herd13)") != NULL);
+  g_assert (strstr (debug->str, "more)") == NULL);
+
+  g_ptr_array_set_size (batches, 0);
+  g_string_truncate (debug, 0);
+
+  /* Remove 3 members and make 2 more contacts local-pending: 3 + 1, then
+   * 1, since removals come before local-pending contacts */
+  del = tp_intset_new ();
+  local_pending = tp_intset_new ();
+
+  for (i = 0; i < 3; i++)
+    tp_intset_add (del, herd[i]);
+
+  tp_intset_add (local_pending, herd[14]);
+  tp_intset_add (local_pending, herd[15]);
+
+  tp_group_mixin_change_members ((GObject *) service_chan, NULL, NULL, del,
+      local_pending, NULL, 0, TP_CHANNEL_GROUP_CHANGE_REASON_NONE);
+  tp_tests_proxy_run_until_dbus_queue_processed (chan);
+
+  g_assert_cmpuint (batches->len, ==, 2);
+  check_batch (0, herd, 0, 0, 0, 3, 14, 1);
+  check_batch (1, herd, 0, 0, 0, 0, 15, 1);
+
+  g_ptr_array_set_size (batches, 0);
+  g_string_truncate (debug, 0);
+
+  /* With batches bigger than that, only the first 10 handles of each
+   * batch are logged, followed by a count of the rest */
+  tp_group_mixin_enable_large_room_mode ((GObject *) service_chan, 12);
+  tp_intset_clear (del);
+
+  for (i = 3; i < 14; i++)
+    tp_intset_add (del, herd[i]);
+
+  tp_group_mixin_change_members ((GObject *) service_chan, NULL, NULL, del,
+      NULL, NULL, 0, TP_CHANNEL_GROUP_CHANGE_REASON_NONE);
+  tp_tests_proxy_run_until_dbus_queue_processed (chan);
+
+  g_assert_cmpuint (batches->len, ==, 1);
+  check_batch (0, herd, 0, 0, 3, 11, 0, 0);
+
+  g_assert (strstr (debug->str, "(herd12)") != NULL);
+  g_assert (strstr (debug->str, "(herd13)") == NULL);
+  g_assert (strstr (debug->str, "(1 more)") != NULL);
+
+  g_log_remove_handler ("tp-glib/groups", handler_id);
+  g_string_free (debug, TRUE);
+  tp_clear_pointer (&batches, g_ptr_array_unref);
+  tp_intset_destroy (add);
+  tp_intset_destroy (del);
+  tp_intset_destroy (local_pending);
+
+  for (i = 0; i < HERD_SIZE; i++)
+    tp_handle_unref (contact_repo, herd[i]);
+}
+
 static void
 test_group_mixin (void)
 {
@@ -510,6 +709,9 @@ test_group_mixin (void)
   check_incoming_invitation ();
 
   in_the_desert ();
+
+  /* this must come last, since it turns off the deprecated signal */
+  large_room ();
 }
 
 int
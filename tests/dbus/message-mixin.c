@@ -16,6 +16,7 @@
 #include <telepathy-glib/debug.h>
 #include <telepathy-glib/gtypes.h>
 #include <telepathy-glib/interfaces.h>
+#include <telepathy-glib/util.h>
 
 #include "examples/cm/echo-message-parts/connection-manager.h"
 #include "examples/cm/echo-message-parts/chan.h"
@@ -1060,6 +1061,33 @@ main (int argc,
       g_array_unref (msgid);
     }
 
+  g_print ("\n\n==== Checking the order of the remaining messages ====\n");
+
+    {
+      GPtrArray *messages;
+      guint i, id, previous_id = 0;
+
+      tp_cli_channel_type_text_run_list_pending_messages (chan, -1,
+          FALSE, &messages, &error, NULL);
+      g_assert_no_error (error);
+      g_assert_cmpuint (messages->len, ==, 6);
+
+      /* acknowledging a message doesn't disturb the order of the others */
+      for (i = 0; i < messages->len; i++)
+        {
+          tp_value_array_unpack (g_ptr_array_index (messages, i), 1, &id);
+
+          g_assert_cmpuint (id, !=, last_received_id);
+
+          if (i > 0)
+            g_assert_cmpuint (id, >, previous_id);
+
+          previous_id = id;
+        }
+
+      g_boxed_free (TP_ARRAY_TYPE_PENDING_TEXT_MESSAGE_LIST, messages);
+    }
+
   g_print ("\n\n==== Acknowledging all remaining messages using deprecated "
       "API ====\n");
 
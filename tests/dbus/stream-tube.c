@@ -1047,6 +1047,74 @@ test_offer_bad_connection_sig_first (Test *test,
   g_assert (test->tube_conn == NULL);
 }
 
+/* A client connects to the tube we offered, but the CM never announces it.
+ * We give up on it after a while. */
+static void
+test_offer_match_timeout (Test *test,
+    gconstpointer data G_GNUC_UNUSED)
+{
+  GSocketAddress *address;
+  GSocketClient *client;
+  GInputStream *in;
+  gchar cm_buffer[BUFFER_SIZE];
+
+  create_tube_service (test, TRUE, TP_SOCKET_ADDRESS_TYPE_IPV4,
+      TP_SOCKET_ACCESS_CONTROL_PORT, FALSE);
+
+  g_assert_cmpint (tp_stream_tube_channel_get_accept_backlog (test->tube),
+      ==, 0);
+  tp_stream_tube_channel_set_accept_backlog (test->tube, 64);
+  g_assert_cmpint (tp_stream_tube_channel_get_accept_backlog (test->tube),
+      ==, 64);
+
+  g_assert_cmpuint (tp_stream_tube_channel_get_match_timeout (test->tube),
+      ==, 0);
+  tp_stream_tube_channel_set_match_timeout (test->tube, 50);
+  g_assert_cmpuint (tp_stream_tube_channel_get_match_timeout (test->tube),
+      ==, 50);
+
+  tp_stream_tube_channel_offer_async (test->tube, NULL, tube_offer_cb, test);
+
+  test->wait = 1;
+  g_main_loop_run (test->mainloop);
+  g_assert_no_error (test->error);
+
+  g_signal_connect (test->tube, "incoming",
+      G_CALLBACK (tube_incoming_cb), test);
+
+  address = tp_tests_stream_tube_channel_get_server_address (
+      test->tube_chan_service);
+  g_assert (address != NULL);
+
+  client = g_socket_client_new ();
+
+  g_socket_client_connect_async (client, G_SOCKET_CONNECTABLE (address),
+      NULL, socket_connected, test);
+
+  g_object_unref (client);
+  g_object_unref (address);
+
+  test->wait = 1;
+  g_main_loop_run (test->mainloop);
+  g_assert_no_error (test->error);
+  g_assert (test->cm_stream != NULL);
+
+  /* The connection is closed without NewRemoteConnection being emitted */
+  in = g_io_stream_get_input_stream (test->cm_stream);
+
+  g_input_stream_read_async (in, cm_buffer, BUFFER_SIZE,
+      G_PRIORITY_DEFAULT, NULL, read_eof_cb, test);
+
+  test->wait = 1;
+  g_main_loop_run (test->mainloop);
+
+  g_assert (test->tube_conn == NULL);
+  g_assert_cmpuint (
+      tp_stream_tube_channel_get_n_timed_out_connections (test->tube), ==, 1);
+  g_assert_cmpuint (
+      tp_stream_tube_channel_get_n_timed_out_signals (test->tube), ==, 0);
+}
+
 static gboolean
 check_ipv6_support (void)
 {
@@ -1128,6 +1196,8 @@ main (int argc,
       test_offer_bad_connection_conn_first, teardown);
   g_test_add ("/stream-tube/offer/bad-connection/sig-first", Test, NULL, setup,
       test_offer_bad_connection_sig_first, teardown);
+  g_test_add ("/stream-tube/offer/match-timeout", Test, NULL, setup,
+      test_offer_match_timeout, teardown);
 
   return tp_tests_run_with_bus ();
 }
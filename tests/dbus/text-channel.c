@@ -9,6 +9,7 @@
 
 #include "config.h"
 
+#include <stdlib.h>
 #include <string.h>
 
 #include <telepathy-glib/telepathy-glib.h>
@@ -36,6 +37,8 @@ typedef struct {
     TpTextChannel *sms_channel;
 
     TpMessage *received_msg;
+    /* (element-type utf8) static strings */
+    GPtrArray *callbacks;
     TpMessage *removed_msg;
     TpMessage *sent_msg;
     gchar *token;
@@ -1044,6 +1047,812 @@ test_chat_state (Test *test,
   g_assert_cmpuint (state, ==, TP_CHANNEL_CHAT_STATE_COMPOSING);
 }
 
+static void
+count_chat_state_changed_cb (TpTextChannel *channel,
+    TpContact *contact,
+    TpChannelChatState state,
+    gpointer user_data)
+{
+  guint *count = user_data;
+
+  (*count)++;
+}
+
+static gboolean
+quit_after_cb (gpointer user_data)
+{
+  g_main_loop_quit (user_data);
+  return FALSE;
+}
+
+static void
+test_chat_state_interval (Test *test,
+    gconstpointer data G_GNUC_UNUSED)
+{
+  GQuark features[] = {
+      TP_CHANNEL_FEATURE_CONTACTS,
+      TP_TEXT_CHANNEL_FEATURE_CHAT_STATES,
+      0 };
+  GObject *service = G_OBJECT (test->chan_service);
+  TpContact *contact;
+  guint n_changes = 0;
+
+  tp_tests_proxy_run_until_prepared (test->channel, features);
+  contact = tp_channel_get_target_contact ((TpChannel *) test->channel);
+
+  g_signal_connect (test->channel, "contact-chat-state-changed",
+      G_CALLBACK (count_chat_state_changed_cb), &n_changes);
+
+  tp_message_mixin_set_chat_state_interval (service, 200);
+
+  /* the first change goes through; the rest are merged */
+  tp_message_mixin_change_chat_state (service, test->bob,
+      TP_CHANNEL_CHAT_STATE_COMPOSING);
+  tp_message_mixin_change_chat_state (service, test->bob,
+      TP_CHANNEL_CHAT_STATE_PAUSED);
+  tp_message_mixin_change_chat_state (service, test->bob,
+      TP_CHANNEL_CHAT_STATE_ACTIVE);
+
+  tp_tests_proxy_run_until_dbus_queue_processed (test->connection);
+  g_assert_cmpuint (n_changes, ==, 1);
+  g_assert_cmpuint (tp_text_channel_get_chat_state (test->channel, contact),
+      ==, TP_CHANNEL_CHAT_STATE_COMPOSING);
+
+  g_timeout_add (400, quit_after_cb, test->mainloop);
+  g_main_loop_run (test->mainloop);
+  tp_tests_proxy_run_until_dbus_queue_processed (test->connection);
+
+  g_assert_cmpuint (n_changes, ==, 2);
+  g_assert_cmpuint (tp_text_channel_get_chat_state (test->channel, contact),
+      ==, TP_CHANNEL_CHAT_STATE_ACTIVE);
+
+  /* going back to the emitted state within the interval emits nothing */
+  tp_message_mixin_change_chat_state (service, test->bob,
+      TP_CHANNEL_CHAT_STATE_COMPOSING);
+  tp_message_mixin_change_chat_state (service, test->bob,
+      TP_CHANNEL_CHAT_STATE_ACTIVE);
+
+  g_timeout_add (400, quit_after_cb, test->mainloop);
+  g_main_loop_run (test->mainloop);
+  tp_tests_proxy_run_until_dbus_queue_processed (test->connection);
+
+  g_assert_cmpuint (n_changes, ==, 2);
+
+  /* our own state is accepted straight away even when held back */
+  tp_text_channel_set_chat_state_async (test->channel,
+      TP_CHANNEL_CHAT_STATE_COMPOSING, set_chat_state_cb, test);
+  g_main_loop_run (test->mainloop);
+  g_assert_no_error (test->error);
+
+  tp_text_channel_set_chat_state_async (test->channel,
+      TP_CHANNEL_CHAT_STATE_PAUSED, set_chat_state_cb, test);
+  g_main_loop_run (test->mainloop);
+  g_assert_no_error (test->error);
+}
+
+static void
+capture_debug (const gchar *log_domain,
+    GLogLevelFlags log_level,
+    const gchar *message,
+    gpointer user_data)
+{
+  GString *debug = user_data;
+
+  g_string_append (debug, message);
+  g_string_append_c (debug, '\n');
+}
+
+/* Return the chat state last passed to the channel's send_chat_state
+ * implementation, according to @debug */
+static guint
+last_chat_state_sent (GString *debug)
+{
+  const gchar *last = NULL;
+  const gchar *p;
+
+  for (p = strstr (debug->str, "chat state ");
+      p != NULL;
+      p = strstr (p + 1, "chat state "))
+    last = p;
+
+  g_assert (last != NULL);
+  return atoi (last + strlen ("chat state "));
+}
+
+static void
+test_chat_state_interval_supersede (Test *test,
+    gconstpointer data G_GNUC_UNUSED)
+{
+  GObject *service = G_OBJECT (test->chan_service);
+  GString *debug = g_string_new ("");
+  guint handler_id;
+
+  handler_id = g_log_set_handler ("tp-glib/im", G_LOG_LEVEL_DEBUG,
+      capture_debug, debug);
+
+  tp_message_mixin_set_chat_state_interval (service, 200);
+
+  /* the first state is sent straight away, so the next one is held back */
+  tp_text_channel_set_chat_state_async (test->channel,
+      TP_CHANNEL_CHAT_STATE_ACTIVE, set_chat_state_cb, test);
+  g_main_loop_run (test->mainloop);
+  g_assert_no_error (test->error);
+
+  tp_text_channel_set_chat_state_async (test->channel,
+      TP_CHANNEL_CHAT_STATE_COMPOSING, set_chat_state_cb, test);
+  g_main_loop_run (test->mainloop);
+  g_assert_no_error (test->error);
+  g_assert_cmpuint (last_chat_state_sent (debug), ==,
+      TP_CHANNEL_CHAT_STATE_ACTIVE);
+
+  /* by the time the next state arrives, the held one is due, but it has
+   * not been sent yet: the newer state must win */
+  g_usleep (300 * 1000);
+
+  tp_text_channel_set_chat_state_async (test->channel,
+      TP_CHANNEL_CHAT_STATE_PAUSED, set_chat_state_cb, test);
+  g_main_loop_run (test->mainloop);
+  g_assert_no_error (test->error);
+
+  g_timeout_add (400, quit_after_cb, test->mainloop);
+  g_main_loop_run (test->mainloop);
+
+  g_assert_cmpuint (last_chat_state_sent (debug), ==,
+      TP_CHANNEL_CHAT_STATE_PAUSED);
+
+  g_log_remove_handler ("tp-glib/im", handler_id);
+  g_string_free (debug, TRUE);
+}
+
+static void
+legacy_received_cb (TpChannel *proxy,
+    guint id,
+    guint timestamp,
+    guint sender,
+    guint type,
+    guint flags,
+    const gchar *text,
+    gpointer user_data,
+    GObject *weak_object)
+{
+  guint *count = user_data;
+
+  (*count)++;
+}
+
+static void
+test_receive_batch (Test *test,
+    gconstpointer data G_GNUC_UNUSED)
+{
+  GQuark features[] = { TP_TEXT_CHANNEL_FEATURE_INCOMING_MESSAGES, 0 };
+  const gchar * const texts[] = { "one", "two", "three" };
+  TpMessage *batch[G_N_ELEMENTS (texts)];
+  TpMessage *msg;
+  GList *messages, *l;
+  guint n_legacy = 0;
+  guint i;
+
+  tp_cli_channel_type_text_connect_to_received (TP_CHANNEL (test->channel),
+      legacy_received_cb, &n_legacy, NULL, NULL, &test->error);
+  g_assert_no_error (test->error);
+
+  tp_message_mixin_set_legacy_signals (G_OBJECT (test->chan_service),
+      TP_MESSAGE_MIXIN_LEGACY_SIGNALS_NEVER);
+
+  for (i = 0; i < G_N_ELEMENTS (texts); i++)
+    batch[i] = tp_cm_message_new_text (test->base_connection, test->bob,
+        TP_CHANNEL_TEXT_MESSAGE_TYPE_NORMAL, texts[i]);
+
+  tp_message_mixin_take_received_batch (G_OBJECT (test->chan_service),
+      G_N_ELEMENTS (batch), batch);
+
+  tp_tests_proxy_run_until_dbus_queue_processed (test->connection);
+  g_assert_cmpuint (n_legacy, ==, 0);
+
+  /* the messages are pending, in order */
+  test->wait = 1;
+  tp_proxy_prepare_async (test->channel, features, proxy_prepare_cb, test);
+  g_main_loop_run (test->mainloop);
+  g_assert_no_error (test->error);
+
+  messages = tp_text_channel_get_pending_messages (test->channel);
+  g_assert_cmpuint (g_list_length (messages), ==, G_N_ELEMENTS (texts));
+
+  for (l = messages, i = 0; l != NULL; l = l->next, i++)
+    {
+      gchar *text = tp_message_to_text (l->data, NULL);
+
+      g_assert_cmpstr (text, ==, texts[i]);
+      g_free (text);
+    }
+
+  g_list_free (messages);
+
+  /* legacy clients get Received again when asked for */
+  tp_message_mixin_set_legacy_signals (G_OBJECT (test->chan_service),
+      TP_MESSAGE_MIXIN_LEGACY_SIGNALS_ALWAYS);
+
+  msg = tp_cm_message_new_text (test->base_connection, test->bob,
+      TP_CHANNEL_TEXT_MESSAGE_TYPE_NORMAL, "four");
+  tp_message_mixin_take_received (G_OBJECT (test->chan_service), msg);
+
+  tp_tests_proxy_run_until_dbus_queue_processed (test->connection);
+  g_assert_cmpuint (n_legacy, ==, 1);
+}
+
+static void
+send_messages_cb (GObject *source,
+    GAsyncResult *result,
+    gpointer user_data)
+{
+  Test *test = user_data;
+  GPtrArray *tokens = NULL;
+
+  tp_text_channel_send_messages_finish (TP_TEXT_CHANNEL (source), result,
+      &tokens, &test->error);
+  g_assert_no_error (test->error);
+  g_assert (tokens != NULL);
+  g_assert_cmpuint (tokens->len, ==, 5);
+  /* the echo CM doesn't give tokens */
+  g_assert (g_ptr_array_index (tokens, 0) == NULL);
+  g_ptr_array_unref (tokens);
+
+  g_ptr_array_add (test->callbacks, "batch");
+}
+
+static void
+send_one_cb (GObject *source,
+    GAsyncResult *result,
+    gpointer user_data)
+{
+  Test *test = user_data;
+
+  tp_text_channel_send_message_finish (TP_TEXT_CHANNEL (source), result,
+      NULL, &test->error);
+  g_assert_no_error (test->error);
+
+  g_ptr_array_add (test->callbacks, "one");
+}
+
+static void
+flush_send_queue_cb (GObject *source,
+    GAsyncResult *result,
+    gpointer user_data)
+{
+  Test *test = user_data;
+
+  tp_text_channel_flush_send_queue_finish (TP_TEXT_CHANNEL (source), result,
+      &test->error);
+  g_assert_no_error (test->error);
+
+  g_ptr_array_add (test->callbacks, "flush");
+  g_main_loop_quit (test->mainloop);
+}
+
+static void
+collect_received_cb (TpTextChannel *chan,
+    TpSignalledMessage *msg,
+    GPtrArray *texts)
+{
+  g_ptr_array_add (texts, tp_message_to_text ((TpMessage *) msg, NULL));
+}
+
+static void
+test_send_pipeline (Test *test,
+    gconstpointer data G_GNUC_UNUSED)
+{
+  GQuark features[] = { TP_TEXT_CHANNEL_FEATURE_INCOMING_MESSAGES, 0 };
+  const gchar * const texts[] = { "1", "2", "3", "4", "5", "6" };
+  TpMessage *batch[5];
+  TpMessage *msg;
+  GPtrArray *received = g_ptr_array_new_with_free_func (g_free);
+  guint i;
+
+  tp_tests_proxy_run_until_prepared (test->channel, features);
+
+  g_signal_connect (test->channel, "message-received",
+      G_CALLBACK (collect_received_cb), received);
+
+  g_assert_cmpuint (tp_text_channel_get_send_window (test->channel), ==, 0);
+  tp_text_channel_set_send_window (test->channel, 2);
+  g_assert_cmpuint (tp_text_channel_get_send_window (test->channel), ==, 2);
+
+  test->callbacks = g_ptr_array_new ();
+
+  for (i = 0; i < G_N_ELEMENTS (batch); i++)
+    batch[i] = tp_client_message_new_text (TP_CHANNEL_TEXT_MESSAGE_TYPE_NORMAL,
+        texts[i]);
+
+  tp_text_channel_send_messages_async (test->channel, G_N_ELEMENTS (batch),
+      batch, 0, send_messages_cb, test);
+
+  msg = tp_client_message_new_text (TP_CHANNEL_TEXT_MESSAGE_TYPE_NORMAL,
+      texts[5]);
+  tp_text_channel_send_message_async (test->channel, msg, 0, send_one_cb,
+      test);
+
+  tp_text_channel_flush_send_queue_async (test->channel, flush_send_queue_cb,
+      test);
+
+  g_main_loop_run (test->mainloop);
+  g_assert_no_error (test->error);
+
+  /* the batch and the flush are reported after everything queued before
+   * them; the single message is reported when it has been sent, which here
+   * is after the batch */
+  g_assert_cmpuint (test->callbacks->len, ==, 3);
+  g_assert_cmpstr (g_ptr_array_index (test->callbacks, 0), ==, "batch");
+  g_assert_cmpstr (g_ptr_array_index (test->callbacks, 1), ==, "one");
+  g_assert_cmpstr (g_ptr_array_index (test->callbacks, 2), ==, "flush");
+
+  /* and the messages were sent in order: the CM echoes them back */
+  tp_tests_proxy_run_until_dbus_queue_processed (test->connection);
+
+  while (received->len < G_N_ELEMENTS (texts))
+    g_main_context_iteration (NULL, TRUE);
+
+  for (i = 0; i < G_N_ELEMENTS (texts); i++)
+    g_assert_cmpstr (g_ptr_array_index (received, i), ==, texts[i]);
+
+  for (i = 0; i < G_N_ELEMENTS (batch); i++)
+    g_object_unref (batch[i]);
+
+  g_object_unref (msg);
+  g_ptr_array_unref (received);
+  tp_clear_pointer (&test->callbacks, g_ptr_array_unref);
+}
+
+static void
+send_messages_fail_cb (GObject *source,
+    GAsyncResult *result,
+    gpointer user_data)
+{
+  Test *test = user_data;
+  GPtrArray *tokens = NULL;
+
+  g_assert (!tp_text_channel_send_messages_finish (TP_TEXT_CHANNEL (source),
+        result, &tokens, &test->error));
+  g_assert (tokens == NULL);
+  g_main_loop_quit (test->mainloop);
+}
+
+static void
+test_send_batch_failure (Test *test,
+    gconstpointer data G_GNUC_UNUSED)
+{
+  GQuark features[] = { TP_TEXT_CHANNEL_FEATURE_INCOMING_MESSAGES, 0 };
+  const gchar * const texts[] = { "1", "bad", "2", "3", "4" };
+  TpMessage *batch[5];
+  GPtrArray *received = g_ptr_array_new_with_free_func (g_free);
+  guint i;
+
+  tp_tests_proxy_run_until_prepared (test->channel, features);
+
+  g_signal_connect (test->channel, "message-received",
+      G_CALLBACK (collect_received_cb), received);
+
+  for (i = 0; i < G_N_ELEMENTS (batch); i++)
+    batch[i] = tp_client_message_new_text (TP_CHANNEL_TEXT_MESSAGE_TYPE_NORMAL,
+        texts[i]);
+
+  /* the connection manager rejects a body key in the header */
+  tp_message_set_string (batch[1], 0, "content-type", "text/plain");
+
+  /* "1" and "bad" are submitted together; "2" is submitted when "1" has
+   * been accepted, before "bad" is known to have failed, but the rest are
+   * not */
+  tp_text_channel_set_send_window (test->channel, 2);
+  tp_text_channel_send_messages_async (test->channel, G_N_ELEMENTS (batch),
+      batch, 0, send_messages_fail_cb, test);
+  g_main_loop_run (test->mainloop);
+  g_assert_error (test->error, TP_ERROR, TP_ERROR_INVALID_ARGUMENT);
+  g_clear_error (&test->error);
+
+  tp_tests_proxy_run_until_dbus_queue_processed (test->connection);
+
+  while (received->len < 2)
+    g_main_context_iteration (NULL, TRUE);
+
+  tp_tests_proxy_run_until_dbus_queue_processed (test->connection);
+  g_assert_cmpuint (received->len, ==, 2);
+  g_assert_cmpstr (g_ptr_array_index (received, 0), ==, "1");
+  g_assert_cmpstr (g_ptr_array_index (received, 1), ==, "2");
+
+  for (i = 0; i < G_N_ELEMENTS (batch); i++)
+    g_object_unref (batch[i]);
+
+  g_ptr_array_unref (received);
+}
+
+static void
+test_receive_bytes (Test *test,
+    gconstpointer data G_GNUC_UNUSED)
+{
+  GQuark features[] = { TP_TEXT_CHANNEL_FEATURE_INCOMING_MESSAGES, 0 };
+  guint8 payload[4096];
+  TpMessage *msg;
+  GBytes *bytes, *again;
+  gsize len;
+  guint n_parts;
+  guint i;
+
+  tp_proxy_prepare_async (test->channel, features, proxy_prepare_cb, test);
+  g_main_loop_run (test->mainloop);
+  g_assert_no_error (test->error);
+
+  g_signal_connect (test->channel, "message-received",
+      G_CALLBACK (message_received_cb), test);
+
+  for (i = 0; i < sizeof (payload); i++)
+    payload[i] = i % 251;
+
+  msg = tp_cm_message_new (test->base_connection, 2);
+  tp_cm_message_set_sender (msg, test->bob);
+  tp_message_set_string (msg, 1, "content-type", "application/octet-stream");
+  tp_message_take_bytes (msg, 1, "content",
+      g_bytes_new (payload, sizeof (payload)));
+
+  /* a mutable message hands out copies */
+  bytes = tp_message_dup_bytes (msg, 1, "content");
+  again = tp_message_dup_bytes (msg, 1, "content");
+  g_assert (g_bytes_equal (bytes, again));
+  g_assert (g_bytes_get_data (bytes, NULL) != g_bytes_get_data (again, NULL));
+  g_bytes_unref (bytes);
+  g_bytes_unref (again);
+
+  g_assert (tp_message_dup_bytes (msg, 1, "content-type") == NULL);
+  g_assert (tp_message_dup_bytes (msg, 1, "nope") == NULL);
+  g_assert (tp_message_dup_bytes (msg, 2, "content") == NULL);
+
+  tp_message_mixin_take_received (G_OBJECT (test->chan_service), msg);
+
+  test->wait = 1;
+  g_main_loop_run (test->mainloop);
+  g_assert (test->received_msg != NULL);
+
+  n_parts = tp_message_count_parts (test->received_msg);
+  g_assert_cmpuint (n_parts, ==, 2);
+
+  /* a signalled message is immutable, so its contents are shared */
+  bytes = tp_message_dup_bytes (test->received_msg, 1, "content");
+  again = tp_message_dup_bytes (test->received_msg, 1, "content");
+  g_assert (bytes != NULL);
+  g_assert (g_bytes_get_data (bytes, &len) ==
+      g_bytes_get_data (again, NULL));
+  g_assert_cmpuint (len, ==, sizeof (payload));
+  g_assert (memcmp (g_bytes_get_data (bytes, NULL), payload, len) == 0);
+
+  /* the bytes keep the message alive */
+  tp_clear_object (&test->received_msg);
+  g_assert (memcmp (g_bytes_get_data (again, NULL), payload, len) == 0);
+
+  g_bytes_unref (bytes);
+  g_bytes_unref (again);
+}
+
+static void
+test_pending_spill (Test *test,
+    gconstpointer data G_GNUC_UNUSED)
+{
+  GQuark features[] = { TP_TEXT_CHANNEL_FEATURE_INCOMING_MESSAGES, 0 };
+  const gchar * const texts[] = { "one", "two", "three", "four" };
+  GPtrArray *listed;
+  GList *messages, *l;
+  TpHandle first_sender = 0;
+  guint i;
+
+  tp_message_mixin_set_max_pending_in_memory (G_OBJECT (test->chan_service),
+      1);
+
+  for (i = 0; i < G_N_ELEMENTS (texts); i++)
+    tp_message_mixin_take_received (G_OBJECT (test->chan_service),
+        tp_cm_message_new_text (test->base_connection, test->bob,
+          TP_CHANNEL_TEXT_MESSAGE_TYPE_NORMAL, texts[i]));
+
+  /* give the mixin a chance to spill all but the first message */
+  tp_tests_proxy_run_until_dbus_queue_processed (test->connection);
+
+  /* PendingMessages reads them back */
+  tp_proxy_prepare_async (test->channel, features, proxy_prepare_cb, test);
+  g_main_loop_run (test->mainloop);
+  g_assert_no_error (test->error);
+
+  messages = tp_text_channel_get_pending_messages (test->channel);
+  g_assert_cmpuint (g_list_length (messages), ==, G_N_ELEMENTS (texts));
+
+  for (l = messages, i = 0; l != NULL; l = l->next, i++)
+    {
+      gchar *text = tp_message_to_text (l->data, NULL);
+      TpContact *sender = tp_signalled_message_get_sender (l->data);
+
+      g_assert_cmpstr (text, ==, texts[i]);
+      g_assert_cmpstr (tp_contact_get_identifier (sender), ==, "bob");
+      g_free (text);
+    }
+
+  g_list_free (messages);
+
+  /* so does ListPendingMessages */
+  tp_cli_channel_type_text_run_list_pending_messages (
+      TP_CHANNEL (test->channel), -1, FALSE, &listed, &test->error, NULL);
+  g_assert_no_error (test->error);
+  g_assert_cmpuint (listed->len, ==, G_N_ELEMENTS (texts));
+
+  for (i = 0; i < listed->len; i++)
+    {
+      guint id, timestamp, sender, type, flags;
+      const gchar *text;
+
+      tp_value_array_unpack (g_ptr_array_index (listed, i), 6,
+          &id, &timestamp, &sender, &type, &flags, &text);
+      g_assert_cmpuint (sender, ==, test->bob);
+      g_assert_cmpstr (text, ==, texts[i]);
+    }
+
+  g_boxed_free (TP_ARRAY_TYPE_PENDING_TEXT_MESSAGE_LIST, listed);
+
+  /* acknowledging everything empties the backlog, which is then reused */
+  tp_text_channel_ack_all_pending_messages_async (test->channel,
+      all_pending_messages_acked_cb, test);
+  g_main_loop_run (test->mainloop);
+  g_assert_no_error (test->error);
+
+  g_assert (!tp_message_mixin_has_pending_messages (
+        G_OBJECT (test->chan_service), NULL));
+
+  for (i = 0; i < 2; i++)
+    tp_message_mixin_take_received (G_OBJECT (test->chan_service),
+        tp_cm_message_new_text (test->base_connection, test->bob,
+          TP_CHANNEL_TEXT_MESSAGE_TYPE_NORMAL, texts[i]));
+
+  tp_tests_proxy_run_until_dbus_queue_processed (test->connection);
+
+  g_assert (tp_message_mixin_has_pending_messages (
+        G_OBJECT (test->chan_service), &first_sender));
+  g_assert_cmpuint (first_sender, ==, test->bob);
+
+  tp_cli_channel_type_text_run_list_pending_messages (
+      TP_CHANNEL (test->channel), -1, FALSE, &listed, &test->error, NULL);
+  g_assert_no_error (test->error);
+  g_assert_cmpuint (listed->len, ==, 2);
+
+  for (i = 0; i < listed->len; i++)
+    {
+      guint id, timestamp, sender, type, flags;
+      const gchar *text;
+
+      tp_value_array_unpack (g_ptr_array_index (listed, i), 6,
+          &id, &timestamp, &sender, &type, &flags, &text);
+      g_assert_cmpuint (sender, ==, test->bob);
+      g_assert_cmpstr (text, ==, texts[i]);
+    }
+
+  g_boxed_free (TP_ARRAY_TYPE_PENDING_TEXT_MESSAGE_LIST, listed);
+}
+
+static void
+test_pending_spill_compaction (Test *test,
+    gconstpointer data G_GNUC_UNUSED)
+{
+  GObject *service = G_OBJECT (test->chan_service);
+  GString *debug = g_string_new ("");
+  gchar *big = g_strnfill (4096, 'x');
+  GArray *acked = g_array_new (FALSE, FALSE, sizeof (guint));
+  GPtrArray *listed;
+  guint handler_id;
+  guint i;
+
+  handler_id = g_log_set_handler ("tp-glib/im", G_LOG_LEVEL_DEBUG,
+      capture_debug, debug);
+
+  tp_message_mixin_set_max_pending_in_memory (service, 1);
+
+  /* the first message stays in memory; an old message that is never
+   * acknowledged is spilled in the middle of lots of big ones that are */
+  tp_message_mixin_take_received (service,
+      tp_cm_message_new_text (test->base_connection, test->bob,
+        TP_CHANNEL_TEXT_MESSAGE_TYPE_NORMAL, "first"));
+
+  for (i = 0; i < 41; i++)
+    tp_message_mixin_take_received (service,
+        tp_cm_message_new_text (test->base_connection, test->bob,
+          TP_CHANNEL_TEXT_MESSAGE_TYPE_NORMAL, i == 20 ? "middle" : big));
+
+  tp_tests_proxy_run_until_dbus_queue_processed (test->connection);
+
+  tp_cli_channel_type_text_run_list_pending_messages (
+      TP_CHANNEL (test->channel), -1, FALSE, &listed, &test->error, NULL);
+  g_assert_no_error (test->error);
+  g_assert_cmpuint (listed->len, ==, 42);
+
+  for (i = 0; i < listed->len; i++)
+    {
+      guint id, timestamp, sender, type, flags;
+      const gchar *text;
+
+      tp_value_array_unpack (g_ptr_array_index (listed, i), 6,
+          &id, &timestamp, &sender, &type, &flags, &text);
+
+      if (!tp_strdiff (text, big))
+        g_array_append_val (acked, id);
+    }
+
+  g_boxed_free (TP_ARRAY_TYPE_PENDING_TEXT_MESSAGE_LIST, listed);
+  g_assert_cmpuint (acked->len, ==, 40);
+
+  tp_cli_channel_type_text_run_acknowledge_pending_messages (
+      TP_CHANNEL (test->channel), -1, acked, &test->error, NULL);
+  g_assert_no_error (test->error);
+
+  /* the old message no longer keeps the whole backlog alive... */
+  g_assert (strstr (debug->str, "compacted pending message backlog") != NULL);
+
+  /* ... and can still be read back from it */
+  tp_cli_channel_type_text_run_list_pending_messages (
+      TP_CHANNEL (test->channel), -1, FALSE, &listed, &test->error, NULL);
+  g_assert_no_error (test->error);
+  g_assert_cmpuint (listed->len, ==, 2);
+
+  for (i = 0; i < listed->len; i++)
+    {
+      guint id, timestamp, sender, type, flags;
+      const gchar *text;
+
+      tp_value_array_unpack (g_ptr_array_index (listed, i), 6,
+          &id, &timestamp, &sender, &type, &flags, &text);
+      g_assert_cmpuint (sender, ==, test->bob);
+      g_assert_cmpstr (text, ==, i == 0 ? "first" : "middle");
+    }
+
+  g_boxed_free (TP_ARRAY_TYPE_PENDING_TEXT_MESSAGE_LIST, listed);
+
+  g_log_remove_handler ("tp-glib/im", handler_id);
+  g_string_free (debug, TRUE);
+  g_array_unref (acked);
+  g_free (big);
+}
+
+#define N_REMOVED 50
+
+static void
+emit_message_with_id (Test *test,
+    guint id,
+    const gchar *text)
+{
+  GPtrArray *parts;
+  GHashTable *header;
+
+  parts = g_ptr_array_new_with_free_func ((GDestroyNotify) g_hash_table_unref);
+  header = tp_asv_new (
+      "message-type", G_TYPE_UINT, TP_CHANNEL_TEXT_MESSAGE_TYPE_NORMAL,
+      "pending-message-id", G_TYPE_UINT, id,
+      "message-sender", G_TYPE_UINT, test->bob,
+      "message-sender-id", G_TYPE_STRING, "bob",
+      NULL);
+  g_ptr_array_add (parts, header);
+  g_ptr_array_add (parts, tp_asv_new (
+      "content-type", G_TYPE_STRING, "text/plain",
+      "content", G_TYPE_STRING, text,
+      NULL));
+
+  tp_svc_channel_interface_messages_emit_message_received (test->chan_service,
+      parts);
+
+  g_ptr_array_unref (parts);
+}
+
+static void
+removed_text_cb (TpTextChannel *chan,
+    TpSignalledMessage *msg,
+    GPtrArray *removed)
+{
+  g_ptr_array_add (removed, tp_message_to_text ((TpMessage *) msg, NULL));
+}
+
+static void
+test_pending_removed_out_of_order (Test *test,
+    gconstpointer data G_GNUC_UNUSED)
+{
+  GQuark features[] = { TP_TEXT_CHANNEL_FEATURE_INCOMING_MESSAGES, 0 };
+  GPtrArray *removed;
+  GArray *ids;
+  GList *messages;
+  guint i;
+
+  tp_proxy_prepare_async (test->channel, features, proxy_prepare_cb, test);
+  g_main_loop_run (test->mainloop);
+  g_assert_no_error (test->error);
+
+  g_signal_connect (test->channel, "message-received",
+      G_CALLBACK (message_received_cb), test);
+
+  removed = g_ptr_array_new_with_free_func (g_free);
+  g_signal_connect (test->channel, "pending-message-removed",
+      G_CALLBACK (removed_text_cb), removed);
+
+  /* Bypass the message mixin to give messages 0 to N_REMOVED - 1 their own
+   * number as pending id, then reuse two ids, as a broken CM might */
+  for (i = 0; i < N_REMOVED; i++)
+    {
+      gchar *text = g_strdup_printf ("%u", i);
+
+      emit_message_with_id (test, i, text);
+      g_free (text);
+    }
+
+  emit_message_with_id (test, 7, "7 again");
+  emit_message_with_id (test, 7, "7 yet again");
+  emit_message_with_id (test, 23, "23 again");
+
+  test->wait = N_REMOVED + 3;
+  g_main_loop_run (test->mainloop);
+  g_assert_no_error (test->error);
+
+  messages = tp_text_channel_get_pending_messages (test->channel);
+  g_assert_cmpuint (g_list_length (messages), ==, N_REMOVED + 3);
+  g_list_free (messages);
+
+  /* Remove every id once, in a scrambled order; 17 is coprime with
+   * N_REMOVED, so each id comes up exactly once */
+  ids = g_array_sized_new (FALSE, FALSE, sizeof (guint), N_REMOVED);
+
+  for (i = 0; i < N_REMOVED; i++)
+    {
+      guint id = (i * 17 + 3) % N_REMOVED;
+
+      g_array_append_val (ids, id);
+    }
+
+  tp_svc_channel_interface_messages_emit_pending_messages_removed (
+      test->chan_service, ids);
+
+  while (removed->len < N_REMOVED)
+    g_main_context_iteration (NULL, TRUE);
+
+  /* nothing else was removed */
+  tp_tests_proxy_run_until_dbus_queue_processed (test->connection);
+  g_assert_cmpuint (removed->len, ==, N_REMOVED);
+
+  for (i = 0; i < N_REMOVED; i++)
+    {
+      gchar *expected = g_strdup_printf ("%u",
+          g_array_index (ids, guint, i));
+
+      g_assert_cmpstr (g_ptr_array_index (removed, i), ==, expected);
+      g_free (expected);
+    }
+
+  /* Only the messages with reused ids are left, oldest first */
+  messages = tp_text_channel_get_pending_messages (test->channel);
+  g_assert_cmpuint (g_list_length (messages), ==, 3);
+  g_list_free (messages);
+
+  g_ptr_array_set_size (removed, 0);
+  g_array_set_size (ids, 0);
+  i = 23;
+  g_array_append_val (ids, i);
+  i = 7;
+  g_array_append_val (ids, i);
+  g_array_append_val (ids, i);
+
+  tp_svc_channel_interface_messages_emit_pending_messages_removed (
+      test->chan_service, ids);
+
+  while (removed->len < 3)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert_cmpuint (removed->len, ==, 3);
+  g_assert_cmpstr (g_ptr_array_index (removed, 0), ==, "23 again");
+  g_assert_cmpstr (g_ptr_array_index (removed, 1), ==, "7 again");
+  g_assert_cmpstr (g_ptr_array_index (removed, 2), ==, "7 yet again");
+
+  messages = tp_text_channel_get_pending_messages (test->channel);
+  g_assert (messages == NULL);
+
+  g_array_unref (ids);
+  g_ptr_array_unref (removed);
+}
+
 int
 main (int argc,
       char **argv)
@@ -1081,6 +1890,24 @@ main (int argc,
       test_receive_muc_delivery, teardown);
   g_test_add ("/text-channel/chat-state", Test, NULL, setup,
       test_chat_state, teardown);
+  g_test_add ("/text-channel/chat-state-interval", Test, NULL, setup,
+      test_chat_state_interval, teardown);
+  g_test_add ("/text-channel/chat-state-interval-supersede", Test, NULL,
+      setup, test_chat_state_interval_supersede, teardown);
+  g_test_add ("/text-channel/receive-batch", Test, NULL, setup,
+      test_receive_batch, teardown);
+  g_test_add ("/text-channel/send-pipeline", Test, NULL, setup,
+      test_send_pipeline, teardown);
+  g_test_add ("/text-channel/send-batch-failure", Test, NULL, setup,
+      test_send_batch_failure, teardown);
+  g_test_add ("/text-channel/receive-bytes", Test, NULL, setup,
+      test_receive_bytes, teardown);
+  g_test_add ("/text-channel/pending-spill", Test, NULL, setup,
+      test_pending_spill, teardown);
+  g_test_add ("/text-channel/pending-spill-compaction", Test, NULL, setup,
+      test_pending_spill_compaction, teardown);
+  g_test_add ("/text-channel/pending-removed-out-of-order", Test, NULL,
+      setup, test_pending_removed_out_of_order, teardown);
 
   return tp_tests_run_with_bus ();
 }
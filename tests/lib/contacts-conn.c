@@ -168,6 +168,7 @@ finalize (GObject *object)
   TpTestsContactsConnection *self = TP_TESTS_CONTACTS_CONNECTION (object);
 
   tp_contacts_mixin_finalize (object);
+  tp_presence_mixin_finalize (object);
   g_hash_table_unref (self->priv->aliases);
   g_hash_table_unref (self->priv->avatars);
   g_hash_table_unref (self->priv->presence_statuses);
@@ -424,6 +425,7 @@ constructed (GObject *object)
 
   tp_presence_mixin_init (object,
       G_STRUCT_OFFSET (TpTestsContactsConnection, presence_mixin));
+  tp_presence_mixin_enable_cache (object);
   tp_presence_mixin_simple_presence_register_with_contacts_mixin (object);
 }
 
@@ -81,8 +81,23 @@ struct _TpTestsFileTransferChannelPrivate {
     TpSocketAccessControl access_control;
 
     guint timer_id;
+    TpTransferredBytesLimiter *limiter;
+    guint limiter_interval;
+
+    /* sent to whoever connects to accept the file */
+    GBytes *content;
+    /* read from whoever connected to provide the file, once they hang up */
+    GBytes *received;
+    GCancellable *cancellable;
 };
 
+/* One connection to the socket, while data is being sent or received */
+typedef struct {
+    /* not reffed: if it goes away, the operation is cancelled */
+    TpTestsFileTransferChannel *self;
+    GIOStream *stream;
+} Transfer;
+
 static void
 tp_tests_file_transfer_channel_init (TpTestsFileTransferChannel *self)
 {
@@ -121,6 +136,8 @@ constructor (GType type,
   TpTestsFileTransferChannel *self = TP_TESTS_FILE_TRANSFER_CHANNEL (object);
 
   self->priv->state = TP_FILE_TRANSFER_STATE_PENDING;
+  self->priv->limiter = tp_transferred_bytes_limiter_new (object, 0);
+  self->priv->cancellable = g_cancellable_new ();
 
   if (self->priv->available_socket_types == NULL)
     create_available_socket_types (self);
@@ -141,6 +158,16 @@ dispose (GObject *object)
       self->priv->timer_id = 0;
     }
 
+  tp_clear_pointer (&self->priv->limiter,
+      tp_transferred_bytes_limiter_destroy);
+
+  if (self->priv->cancellable != NULL)
+    g_cancellable_cancel (self->priv->cancellable);
+
+  tp_clear_object (&self->priv->cancellable);
+  tp_clear_pointer (&self->priv->content, g_bytes_unref);
+  tp_clear_pointer (&self->priv->received, g_bytes_unref);
+
   g_free (self->priv->content_hash);
   g_free (self->priv->content_type);
   g_free (self->priv->description);
@@ -353,6 +380,7 @@ change_state (TpTestsFileTransferChannel *self,
 {
   self->priv->state = state;
 
+  tp_transferred_bytes_limiter_flush (self->priv->limiter);
   tp_svc_channel_type_file_transfer_emit_file_transfer_state_changed (self,
       state, reason);
 }
@@ -401,6 +429,59 @@ check_address_type (TpTestsFileTransferChannel *self,
   return FALSE;
 }
 
+static void
+transfer_free (Transfer *transfer)
+{
+  g_io_stream_close (transfer->stream, NULL, NULL);
+  g_object_unref (transfer->stream);
+  g_slice_free (Transfer, transfer);
+}
+
+static void
+content_sent_cb (GObject *source,
+    GAsyncResult *result,
+    gpointer user_data)
+{
+  Transfer *transfer = user_data;
+  GError *error = NULL;
+
+  if (g_output_stream_splice_finish (G_OUTPUT_STREAM (source), result,
+        &error) < 0)
+    {
+      DEBUG ("Failed to send the file: %s", error->message);
+      g_error_free (error);
+    }
+
+  /* closing the connection tells the receiver that's all */
+  transfer_free (transfer);
+}
+
+static void
+content_received_cb (GObject *source,
+    GAsyncResult *result,
+    gpointer user_data)
+{
+  Transfer *transfer = user_data;
+  GError *error = NULL;
+
+  if (g_output_stream_splice_finish (G_OUTPUT_STREAM (source), result,
+        &error) < 0)
+    {
+      DEBUG ("Failed to receive the file: %s", error->message);
+      g_error_free (error);
+    }
+  else
+    {
+      TpTestsFileTransferChannel *self = transfer->self;
+
+      tp_clear_pointer (&self->priv->received, g_bytes_unref);
+      self->priv->received = g_memory_output_stream_steal_as_bytes (
+          G_MEMORY_OUTPUT_STREAM (source));
+    }
+
+  transfer_free (transfer);
+}
+
 static void
 service_incoming_cb (GSocketService *service,
     GSocketConnection *connection,
@@ -409,6 +490,7 @@ service_incoming_cb (GSocketService *service,
 {
   TpTestsFileTransferChannel *self = user_data;
   GError *error = NULL;
+  Transfer *transfer;
 
   DEBUG ("Servicing incoming connection");
   if (self->priv->access_control == TP_SOCKET_ACCESS_CONTROL_CREDENTIALS)
@@ -440,6 +522,37 @@ service_incoming_cb (GSocketService *service,
 
       g_object_unref (addr);
     }
+
+  transfer = g_slice_new0 (Transfer);
+  transfer->self = self;
+  transfer->stream = g_object_ref (connection);
+
+  if (tp_base_channel_is_requested ((TpBaseChannel *) self))
+    {
+      GOutputStream *received = g_memory_output_stream_new (NULL, 0,
+          g_realloc, g_free);
+
+      /* read whatever is provided, until the other side hangs up */
+      g_output_stream_splice_async (received,
+          g_io_stream_get_input_stream (transfer->stream),
+          G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET, G_PRIORITY_DEFAULT,
+          self->priv->cancellable, content_received_cb, transfer);
+      g_object_unref (received);
+    }
+  else
+    {
+      GInputStream *content = g_memory_input_stream_new ();
+
+      if (self->priv->content != NULL)
+        g_memory_input_stream_add_bytes (G_MEMORY_INPUT_STREAM (content),
+            self->priv->content);
+
+      g_output_stream_splice_async (
+          g_io_stream_get_output_stream (transfer->stream), content,
+          G_OUTPUT_STREAM_SPLICE_NONE, G_PRIORITY_DEFAULT,
+          self->priv->cancellable, content_sent_cb, transfer);
+      g_object_unref (content);
+    }
 }
 
 static void
@@ -494,6 +607,9 @@ file_transfer_provide_file (TpSvcChannelTypeFileTransfer *iface,
         goto fail;
       }
 
+  tp_g_signal_connect_object (self->priv->service, "incoming",
+      G_CALLBACK (service_incoming_cb), self, 0);
+
   self->priv->address_type = address_type;
   self->priv->access_control = access_control;
 
@@ -760,3 +876,41 @@ tp_tests_file_transfer_channel_get_server_address (
 
   return address;
 }
+
+/* Pretend @count bytes have been transferred, emitting TransferredBytesChanged
+ * at most once per @interval_ms */
+void
+tp_tests_file_transfer_channel_set_transferred_bytes (
+    TpTestsFileTransferChannel *self,
+    guint64 count,
+    guint interval_ms)
+{
+  if (interval_ms != self->priv->limiter_interval)
+    {
+      tp_transferred_bytes_limiter_flush (self->priv->limiter);
+      tp_transferred_bytes_limiter_destroy (self->priv->limiter);
+      self->priv->limiter = tp_transferred_bytes_limiter_new (
+          (GObject *) self, interval_ms);
+      self->priv->limiter_interval = interval_ms;
+    }
+
+  self->priv->transferred_bytes = count;
+  tp_transferred_bytes_limiter_update (self->priv->limiter, count);
+}
+
+/* Send @content to the receiver once the file has been accepted */
+void
+tp_tests_file_transfer_channel_set_content (TpTestsFileTransferChannel *self,
+    GBytes *content)
+{
+  tp_clear_pointer (&self->priv->content, g_bytes_unref);
+  self->priv->content = g_bytes_ref (content);
+}
+
+/* Return what the sender provided, or NULL if they haven't finished */
+GBytes *
+tp_tests_file_transfer_channel_get_received (
+    TpTestsFileTransferChannel *self)
+{
+  return self->priv->received;
+}
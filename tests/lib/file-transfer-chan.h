@@ -58,6 +58,18 @@ GHashTable * tp_tests_file_transfer_channel_get_props (
 GSocketAddress * tp_tests_file_transfer_channel_get_server_address (
         TpTestsFileTransferChannel *self);
 
+void tp_tests_file_transfer_channel_set_transferred_bytes (
+        TpTestsFileTransferChannel *self,
+        guint64 count,
+        guint interval_ms);
+
+void tp_tests_file_transfer_channel_set_content (
+        TpTestsFileTransferChannel *self,
+        GBytes *content);
+
+GBytes * tp_tests_file_transfer_channel_get_received (
+        TpTestsFileTransferChannel *self);
+
 G_END_DECLS
 
 #endif